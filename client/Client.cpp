@@ -0,0 +1,309 @@
+#include "Client.h"
+
+#include <poll.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace controllino {
+namespace client {
+
+namespace details {
+
+uint64_t now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void append_string(std::string& out, const char* text) {
+    out += '"';
+    for (const char* p = text; *p != '\0'; ++p) {
+        if (*p == '"' or *p == '\\') {
+            out += '\\';
+            out += *p;
+        } else if ((unsigned char) *p < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char) *p);
+            out += escaped;
+        } else {
+            out += *p;
+        }
+    }
+    out += '"';
+}
+
+} // namespace details
+
+Request& Request::set(const char* key, const char* value) {
+    std::string json;
+    details::append_string(json, value);
+    return set_raw(key, json);
+}
+
+Request& Request::set(const char* key, double value) {
+    char json[32];
+    snprintf(json, sizeof(json), "%.9g", value);
+    return set_raw(key, json);
+}
+
+Request& Request::set_raw(const char* key, const std::string& json) {
+    fields_ += ',';
+    details::append_string(fields_, key);
+    fields_ += ':';
+    fields_ += json;
+    return *this;
+}
+
+std::string Request::line(uint32_t job) const {
+    std::string line = "{\"command\":";
+    details::append_string(line, command_.c_str());
+    line += ",\"job\":";
+    line += std::to_string(job);
+    line += fields_;
+    line += "}\n";
+    return line;
+}
+
+bool Future::wait(Client& client, int timeout_ms) const {
+    uint64_t deadline = details::now_ms() + timeout_ms;
+    while (not state_->done) {
+        uint64_t now = details::now_ms();
+        if (now >= deadline) {
+            return false;
+        }
+        client.poll((int) (deadline - now));
+    }
+    return true;
+}
+
+Client::Client(const std::string& path, unsigned long baud) : path_(path), baud_(baud) {
+}
+
+bool Client::connect() {
+    if (not port_.open(path_, baud_)) {
+        reconnect_at_ = details::now_ms() + reconnect_interval_ms_;
+        return false;
+    }
+    ready_ = false;
+    ready_deadline_ = details::now_ms() + ready_timeout_ms_;
+    if (on_connect_) {
+        on_connect_();
+    }
+    return true;
+}
+
+uint32_t Client::send(const Request& request, reply_callback_t callback) {
+    uint32_t job = next_job();
+    pending_[job] = Pending{request.command(), callback, false, false, 0, 0};
+    queue_.push_back(std::make_pair(job, request.line(job)));
+    send_queued();
+    return job;
+}
+
+Future Client::call(const Request& request) {
+    Future future;
+    std::shared_ptr<Future::State> state = future.state_;
+    send(request, [state](const Reply& reply) {
+        if (not reply.completes()) {
+            return;
+        }
+        state->line = reply.line().str();
+        state->reply.parse(state->line.data(), state->line.size());
+        state->done = true;
+    });
+    return future;
+}
+
+uint32_t Client::log(const Request& request, LogBuffer& buffer) {
+    LogBuffer* sink = &buffer;
+    return send(request, [sink](const Reply& reply) {
+        if (reply.kind() == Reply::KIND_ERROR) {
+            sink->error = reply.get("error").str();
+            sink->done = true;
+            return;
+        }
+        if (reply.kind() != Reply::KIND_OUTPUT) {
+            return;
+        }
+        Sample sample;
+        sample.time = reply.get("time").as_uint();
+        sample.value = (int32_t) reply.get("value").as_int();
+        sample.seq = (uint32_t) reply.get("seq").as_uint();
+        sample.coalesced = (uint32_t) reply.get("coalesced").as_uint();
+        sample.min = (int32_t) reply.get("min").as_int(sample.value);
+        sample.max = (int32_t) reply.get("max").as_int(sample.value);
+        sink->samples.push_back(sample);
+        sink->done = reply.completes();
+    });
+}
+
+bool Client::poll(int timeout_ms) {
+    uint64_t now = details::now_ms();
+    if (not connected()) {
+        if (now >= reconnect_at_ and connect()) {
+            process();
+            return true;
+        }
+        uint64_t wait = std::min((uint64_t) timeout_ms,
+                                 reconnect_at_ - std::min(now, reconnect_at_));
+        usleep((useconds_t) wait * 1000);
+        return false;
+    }
+
+    if (not ready_) {
+        timeout_ms = (int) std::min((uint64_t) timeout_ms,
+                                    ready_deadline_ - std::min(now, ready_deadline_));
+    }
+    struct pollfd fd = {port_.fd(), (short) (POLLIN | (wants_write() ? POLLOUT : 0)), 0};
+    if (::poll(&fd, 1, timeout_ms) > 0 and (fd.revents & (POLLERR | POLLNVAL))) {
+        disconnect();
+        return false;
+    }
+    process();
+    return connected();
+}
+
+void Client::process() {
+    if (not connected()) {
+        return;
+    }
+    if (not ready_ and details::now_ms() >= ready_deadline_) {
+        set_ready();
+    }
+    bool ok = port_.read_lines([this](const char* line, size_t size) {
+        dispatch(line, size);
+    });
+    if (ok) {
+        send_queued();
+        ok = port_.flush();
+    }
+    if (not ok) {
+        disconnect();
+    }
+}
+
+uint32_t Client::next_job() {
+    // Job 0 belongs to `READY`, and the firmware takes jobs as `long`.
+    do {
+        job_ = job_ >= INT32_MAX ? 1 : job_ + 1;
+    } while (pending_.count(job_) > 0);
+    return job_;
+}
+
+void Client::send_queued() {
+    if (not connected() or not ready_) {
+        return;
+    }
+    while (not queue_.empty() and in_flight_ < max_in_flight_) {
+        const std::pair<uint32_t, std::string>& request = queue_.front();
+        size_t size = request.second.size();
+        // One request is always let through, however long it is.
+        if (in_flight_ > 0 and in_flight_bytes_ + size > max_in_flight_bytes_) {
+            break;
+        }
+        port_.write(request.second.data(), size);
+        Pending& pending = pending_[request.first];
+        pending.sent = true;
+        pending.size = size;
+        pending.order = sent_++;
+        in_flight_++;
+        in_flight_bytes_ += size;
+        queue_.pop_front();
+    }
+}
+
+void Client::dispatch(const char* line, size_t size) {
+    Reply reply;
+    if (not reply.parse(line, size)) {
+        malformed_++;
+        return;
+    }
+
+    auto it = pending_.end();
+    if (reply.job() > 0 and reply.job() <= INT32_MAX) {
+        it = pending_.find((uint32_t) reply.job());
+    } else if (reply.job() < 0 and reply.kind() == Reply::KIND_ERROR) {
+        it = find_unanswered(reply);
+    }
+    if (it == pending_.end() or not it->second.sent) {
+        if (on_unsolicited_) {
+            on_unsolicited_(reply);
+        }
+        if (reply.command().equals("RX_READY")) {
+            set_ready();
+        }
+        return;
+    }
+
+    Pending& pending = it->second;
+    if (not pending.replied) {
+        pending.replied = true;
+        in_flight_--;
+        in_flight_bytes_ -= pending.size;
+    }
+    if (reply.completes()) {
+        reply_callback_t callback = std::move(pending.callback);
+        pending_.erase(it);
+        if (callback) {
+            callback(reply);
+        }
+    } else if (pending.callback) {
+        // Nodes of the map stay where they are when requests are added.
+        pending.callback(reply);
+    }
+}
+
+// The board answers lines it can't read the job of without one, like those
+// which are too long; older firmware also answered missing keys that way. It
+// answers requests in order, so such an error belongs to the oldest unanswered
+// request of its command, or of any command for `ERR_ERROR`.
+std::unordered_map<uint32_t, Client::Pending>::iterator Client::find_unanswered(
+    const Reply& error) {
+    Span name = error.name();
+    bool any = name.equals("ERROR");
+    auto oldest = pending_.end();
+    for (auto it = pending_.begin(); it != pending_.end(); ++it) {
+        const Pending& pending = it->second;
+        if (not pending.sent or pending.replied or
+            (not any and not name.equals(pending.command.c_str()))) {
+            continue;
+        }
+        if (oldest == pending_.end() or pending.order < oldest->second.order) {
+            oldest = it;
+        }
+    }
+    return oldest;
+}
+
+void Client::disconnect() {
+    port_.close();
+    in_flight_ = 0;
+    in_flight_bytes_ = 0;
+    ready_ = false;
+    reconnect_at_ = details::now_ms() + reconnect_interval_ms_;
+    queue_.clear();
+
+    std::unordered_map<uint32_t, Pending> failed;
+    failed.swap(pending_);
+    for (auto& entry : failed) {
+        std::string line = "{\"command\":\"ERR_" + entry.second.command +
+                           "\",\"job\":" + std::to_string(entry.first) +
+                           ",\"error\":\"DISCONNECTED\",\"msg\":\"The port was closed\"}";
+        Reply reply;
+        reply.parse(line.data(), line.size());
+        if (entry.second.callback) {
+            entry.second.callback(reply);
+        }
+    }
+}
+
+void Client::set_ready() {
+    ready_ = true;
+    send_queued();
+}
+
+} // namespace client
+} // namespace controllino
@@ -0,0 +1,243 @@
+// A client for one board. Requests get their jobs from the client and any
+// number of them can be in flight; replies are matched to their requests by
+// job. The client runs in the caller's thread: `poll` does all the I/O and
+// calls the callbacks, which may send requests but must not poll.
+#ifndef CONTROLLINO_CLIENT_CLIENT_H
+#define CONTROLLINO_CLIENT_CLIENT_H
+
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "Reply.h"
+#include "SerialPort.h"
+
+// The receive buffer of the UART of the Due holds this many bytes.
+#define BOARD_RX_BUFFER_SIZE 127
+
+namespace controllino {
+namespace client {
+
+// A request without its job, e.g.
+// `Request("SET_OUTPUT").set("pin", "D40").set("level", "HIGH")`.
+class Request {
+public:
+    explicit Request(const char* command) : command_(command) {
+    }
+
+    Request& set(const char* key, const char* value);
+    Request& set(const char* key, const std::string& value) {
+        return set(key, value.c_str());
+    }
+    Request& set(const char* key, bool value) {
+        return set_raw(key, value ? "true" : "false");
+    }
+    Request& set(const char* key, double value);
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value, Request&>::type set(const char* key,
+                                                                             T value) {
+        return set_raw(key, std::to_string(value));
+    }
+    // Inserts `json` as it is, e.g. the commands of a batch.
+    Request& set_raw(const char* key, const std::string& json);
+
+    const std::string& command() const {
+        return command_;
+    }
+    // The line for `job`, including the line ending.
+    std::string line(uint32_t job) const;
+
+private:
+    std::string command_;
+    std::string fields_;
+};
+
+// A sample of a logging job; see `LOG_SIGNAL` in the README.
+struct Sample {
+    uint64_t time;
+    int32_t value;
+    uint32_t seq;
+    // Samples folded into this one while credit was exhausted, and their
+    // range.
+    uint32_t coalesced;
+    int32_t min;
+    int32_t max;
+};
+
+// Collects the samples of a logging job.
+struct LogBuffer {
+    std::vector<Sample> samples;
+    bool done = false;
+    // The error the job failed with, if any.
+    std::string error;
+};
+
+typedef std::function<void(const Reply&)> reply_callback_t;
+
+class Client;
+
+// The final reply to a request sent with `Client::call`. Unlike the replies
+// passed to callbacks, it owns its line.
+class Future {
+public:
+    bool done() const {
+        return state_->done;
+    }
+    const Reply& reply() const {
+        return state_->reply;
+    }
+    bool ok() const {
+        return state_->done and state_->reply.kind() == Reply::KIND_OUTPUT;
+    }
+    // Polls `client` until the reply arrived. Returns false on timeout.
+    bool wait(Client& client, int timeout_ms) const;
+
+private:
+    friend class Client;
+
+    struct State {
+        bool done = false;
+        std::string line;
+        Reply reply;
+    };
+
+    std::shared_ptr<State> state_ = std::make_shared<State>();
+};
+
+class Client {
+public:
+    explicit Client(const std::string& path, unsigned long baud = 19200);
+
+    // Requests which may await their first reply at once; more are queued.
+    void set_max_in_flight(size_t count) {
+        max_in_flight_ = count > 0 ? count : 1;
+    }
+    // The bytes of the requests awaiting their first reply. While the board
+    // is busy sending replies, requests wait in the receive buffer of its
+    // UART, which drops what doesn't fit.
+    void set_max_in_flight_bytes(size_t size) {
+        max_in_flight_bytes_ = size;
+    }
+    // While disconnected, `poll` tries to reopen the port this often.
+    void set_reconnect_interval(int ms) {
+        reconnect_interval_ms_ = ms;
+    }
+    // Called for lines which don't belong to a request, like `READY`.
+    void on_unsolicited(reply_callback_t callback) {
+        on_unsolicited_ = callback;
+    }
+    // Called when the port was (re)opened.
+    void on_connect(std::function<void()> callback) {
+        on_connect_ = callback;
+    }
+
+    // Opens the port. Opening the programming port of the Due resets the
+    // board, so requests are held back until it sent `READY`, or for at most
+    // the ready timeout.
+    bool connect();
+    bool connected() const {
+        return port_.is_open();
+    }
+    // Whether requests are sent, i.e. the board is connected and ready.
+    bool ready() const {
+        return connected() and ready_;
+    }
+    // The port to open from the next connect on, e.g. after the board was
+    // plugged into another one.
+    void set_path(const std::string& path) {
+        path_ = path;
+    }
+    const std::string& path() const {
+        return path_;
+    }
+    void set_ready_timeout(int ms) {
+        ready_timeout_ms_ = ms;
+    }
+    // For callers which wait with their own poll or epoll: the descriptor to
+    // watch, or -1 while disconnected, and whether to watch it for writing.
+    int fd() const {
+        return port_.fd();
+    }
+    bool wants_write() const {
+        return port_.wants_write();
+    }
+
+    // Sends `request` and calls `callback` with every reply to it until one
+    // completes it. Requests sent while disconnected are sent once
+    // reconnected; those pending when the port fails get a
+    // `DISCONNECTED` error. Returns the job.
+    uint32_t send(const Request& request, reply_callback_t callback);
+    Future call(const Request& request);
+    // Sends a request whose replies are samples, like `LOG_SIGNAL`, and
+    // appends them to `buffer` until the job is done.
+    uint32_t log(const Request& request, LogBuffer& buffer);
+
+    // Waits at most `timeout_ms` for the port, does the I/O it's ready for
+    // and calls the callbacks. Reconnects when it's time. Returns false while
+    // disconnected.
+    bool poll(int timeout_ms);
+    // Does the I/O `fd()` is ready for, without waiting.
+    void process();
+
+    // Requests sent and awaiting their first reply.
+    size_t in_flight() const {
+        return in_flight_;
+    }
+    // Jobs which aren't completed, including queued ones.
+    size_t pending() const {
+        return pending_.size();
+    }
+    // Lines which weren't valid replies.
+    unsigned long malformed() const {
+        return malformed_;
+    }
+
+private:
+    struct Pending {
+        std::string command;
+        reply_callback_t callback;
+        bool sent;
+        bool replied;
+        size_t size;
+        uint64_t order; // Of sending
+    };
+
+    uint32_t next_job();
+    void send_queued();
+    void dispatch(const char* line, size_t size);
+    std::unordered_map<uint32_t, Pending>::iterator find_unanswered(const Reply& error);
+    void disconnect();
+    void set_ready();
+
+    std::string path_;
+    unsigned long baud_;
+    SerialPort port_;
+    size_t max_in_flight_ = 8;
+    size_t max_in_flight_bytes_ = BOARD_RX_BUFFER_SIZE;
+    int reconnect_interval_ms_ = 1000;
+    int ready_timeout_ms_ = 3000;
+    reply_callback_t on_unsolicited_;
+    std::function<void()> on_connect_;
+
+    std::unordered_map<uint32_t, Pending> pending_;
+    std::deque<std::pair<uint32_t, std::string>> queue_;
+    size_t in_flight_ = 0;
+    size_t in_flight_bytes_ = 0;
+    uint32_t job_ = 0;
+    uint64_t sent_ = 0;
+    bool ready_ = false;
+    uint64_t ready_deadline_ = 0;
+    uint64_t reconnect_at_ = 0;
+    unsigned long malformed_ = 0;
+};
+
+} // namespace client
+} // namespace controllino
+
+#endif /* CONTROLLINO_CLIENT_CLIENT_H */
@@ -0,0 +1,82 @@
+#include "Recorder.h"
+
+namespace controllino {
+namespace client {
+
+namespace details {
+
+// Skips the time and direction of a capture entry. Returns -1 if `line`
+// isn't one, else whether the device received the line.
+int capture_entry(const char*& line, size_t& size) {
+    size_t i = 0;
+    while (i < size and line[i] >= '0' and line[i] <= '9') {
+        i++;
+    }
+    if (i == 0 or size - i < 4 or line[i] != ' ' or line[i + 3] != ' ' or
+        (line[i + 1] != 'R' and line[i + 1] != 'T') or line[i + 2] != 'X') {
+        return -1;
+    }
+    bool rx = line[i + 1] == 'R';
+    line += i + 4;
+    size -= i + 4;
+    return rx;
+}
+
+} // namespace details
+
+bool Recorder::ingest(const char* line, size_t size) {
+    int rx = details::capture_entry(line, size);
+    if (not reply_.parse(line, size)) {
+        return false;
+    }
+    job_key_t key(reply_.get("board").str(), reply_.job());
+    // Without a capture, requests are told apart by their command.
+    if (rx == 1 or (rx == -1 and reply_.kind() == Reply::KIND_OTHER)) {
+        request(reply_, key);
+    } else {
+        reply(reply_, key);
+    }
+    return true;
+}
+
+void Recorder::request(const Reply& request, job_key_t key) {
+    if (request.command().equals("LOG_SIGNAL") and request.job() >= 0) {
+        std::string name = request.get("pin").str();
+        if (not key.first.empty()) {
+            name = key.first + "/" + name;
+        }
+        jobs_[key] = {name, -1};
+    }
+}
+
+void Recorder::reply(const Reply& reply, job_key_t key) {
+    if (reply.name().equals("LOG_SIGNAL")) {
+        auto job = jobs_.find(key);
+        if (reply.kind() == Reply::KIND_OUTPUT) {
+            if (job == jobs_.end()) {
+                std::string name = "job " + std::to_string(key.second);
+                if (not key.first.empty()) {
+                    name = key.first + "/" + name;
+                }
+                job = jobs_.insert({key, {name, -1}}).first;
+            }
+            if (job->second.channel < 0) {
+                job->second.channel = writer_.channel(job->second.name);
+            }
+            if (job->second.channel >= 0 and
+                writer_.append(job->second.channel, reply.get("time").as_uint(),
+                               (int32_t) reply.get("value").as_int())) {
+                samples_++;
+            } else {
+                dropped_++;
+            }
+        }
+        // The job may be used again for another pin.
+        if (job != jobs_.end() and reply.completes()) {
+            jobs_.erase(job);
+        }
+    }
+}
+
+} // namespace client
+} // namespace controllino
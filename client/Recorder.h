@@ -0,0 +1,62 @@
+// Records the samples of logging jobs into a sample store. The recorder
+// takes the lines of the protocol as they are, from a board or from the
+// aggregator, whose lines have a `board`, or as the entries of a capture
+// (`<time> RX|TX <line>`, see sim/Capture.h). Each logging job gets the
+// channel of its pin, e.g. `A0`, or `b0/A0` on the board `b0`; the samples of
+// jobs whose request wasn't seen go to `job N`.
+#ifndef CONTROLLINO_CLIENT_RECORDER_H
+#define CONTROLLINO_CLIENT_RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include "Reply.h"
+#include "SampleStore.h"
+
+namespace controllino {
+namespace client {
+
+class Recorder {
+public:
+    explicit Recorder(SampleWriter& writer) : writer_(writer), samples_(0), dropped_(0) {
+    }
+
+    // Returns false if the line isn't a JSON object with a command.
+    bool ingest(const char* line, size_t size);
+
+    uint64_t samples() const {
+        return samples_;
+    }
+    // Samples older than the last one of their channel, or of channels whose
+    // name is too long.
+    uint64_t dropped() const {
+        return dropped_;
+    }
+
+private:
+    // Board and job.
+    typedef std::pair<std::string, int64_t> job_key_t;
+
+    struct Job {
+        std::string name;
+        int channel;
+    };
+
+    void request(const Reply& request, job_key_t key);
+    void reply(const Reply& reply, job_key_t key);
+
+    SampleWriter& writer_;
+    std::map<job_key_t, Job> jobs_;
+    Reply reply_;
+    uint64_t samples_;
+    uint64_t dropped_;
+};
+
+} // namespace client
+} // namespace controllino
+
+#endif /* CONTROLLINO_CLIENT_RECORDER_H */
@@ -0,0 +1,314 @@
+#include "Reply.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace controllino {
+namespace client {
+
+namespace details {
+
+// Scans JSON text between `p` and `end`. Each function moves past what it
+// scanned and returns false if the text is malformed.
+class Scanner {
+public:
+    Scanner(const char* p, const char* end) : p_(p), end_(end) {
+    }
+
+    bool at_end() const {
+        return p_ == end_;
+    }
+
+    void skip_space() {
+        while (p_ != end_ and (*p_ == ' ' or *p_ == '\t' or *p_ == '\r' or *p_ == '\n')) {
+            p_++;
+        }
+    }
+
+    bool consume(char c) {
+        skip_space();
+        if (p_ == end_ or *p_ != c) {
+            return false;
+        }
+        p_++;
+        return true;
+    }
+
+    // A string; `text` is set to its contents.
+    bool string(Span& text, bool& escaped) {
+        if (not consume('"')) {
+            return false;
+        }
+        const char* begin = p_;
+        escaped = false;
+        while (p_ != end_ and *p_ != '"') {
+            if (*p_ == '\\') {
+                escaped = true;
+                if (++p_ == end_) {
+                    return false;
+                }
+            }
+            p_++;
+        }
+        if (p_ == end_) {
+            return false;
+        }
+        text = Span{begin, (size_t) (p_ - begin)};
+        p_++;
+        return true;
+    }
+
+    bool value(Value& value) {
+        skip_space();
+        if (p_ == end_) {
+            return false;
+        }
+        const char* begin = p_;
+        switch (*p_) {
+            case '"': {
+                Span text;
+                bool escaped;
+                if (not string(text, escaped)) {
+                    return false;
+                }
+                value = Value(Value::TYPE_STRING, text, escaped);
+                return true;
+            }
+            case '{':
+            case '[': {
+                Value::type_t type = *p_ == '{' ? Value::TYPE_OBJECT : Value::TYPE_ARRAY;
+                if (not nested()) {
+                    return false;
+                }
+                value = Value(type, Span{begin, (size_t) (p_ - begin)});
+                return true;
+            }
+            case 't':
+                return literal("true", Value::TYPE_BOOL, value);
+            case 'f':
+                return literal("false", Value::TYPE_BOOL, value);
+            case 'n':
+                return literal("null", Value::TYPE_NULL, value);
+            default:
+                break;
+        }
+        while (p_ != end_ and (strchr("+-.eE", *p_) != NULL or (*p_ >= '0' and *p_ <= '9'))) {
+            p_++;
+        }
+        // Within an object, a number is followed by a delimiter; see `convert`.
+        if (p_ == begin or p_ == end_) {
+            return false;
+        }
+        value = Value(Value::TYPE_NUMBER, Span{begin, (size_t) (p_ - begin)});
+        return true;
+    }
+
+private:
+    bool literal(const char* text, Value::type_t type, Value& value) {
+        size_t size = strlen(text);
+        if ((size_t) (end_ - p_) < size or memcmp(p_, text, size) != 0) {
+            return false;
+        }
+        value = Value(type, Span{p_, size});
+        p_ += size;
+        return true;
+    }
+
+    // Skips a nested object or array, minding brackets within strings.
+    bool nested() {
+        int depth = 0;
+        do {
+            if (p_ == end_) {
+                return false;
+            }
+            if (*p_ == '"') {
+                Span text;
+                bool escaped;
+                if (not string(text, escaped)) {
+                    return false;
+                }
+                continue;
+            }
+            if (*p_ == '{' or *p_ == '[') {
+                depth++;
+            } else if (*p_ == '}' or *p_ == ']') {
+                depth--;
+            }
+            p_++;
+        } while (depth > 0);
+        return true;
+    }
+
+    const char* p_;
+    const char* end_;
+};
+
+// Converts a number in place. The scanner only accepts numbers followed by
+// a delimiter within the line, so `strto*` stops at their end.
+template<typename T>
+T convert(Span text, T (*function)(const char*, char**, int), T fallback) {
+    char* end;
+    T value = function(text.data, &end, 10);
+    return end == text.data + text.size ? value : fallback;
+}
+
+} // namespace details
+
+bool Span::equals(const char* text) const {
+    return strlen(text) == size and memcmp(data, text, size) == 0;
+}
+
+bool Span::starts_with(const char* prefix) const {
+    size_t length = strlen(prefix);
+    return length <= size and memcmp(data, prefix, length) == 0;
+}
+
+int64_t Value::as_int(int64_t fallback) const {
+    if (type_ != TYPE_NUMBER) {
+        return fallback;
+    }
+    return details::convert<long long>(text_, strtoll, fallback);
+}
+
+uint64_t Value::as_uint(uint64_t fallback) const {
+    if (type_ != TYPE_NUMBER or text_.data[0] == '-') {
+        return fallback;
+    }
+    return details::convert<unsigned long long>(text_, strtoull, fallback);
+}
+
+double Value::as_double(double fallback) const {
+    if (type_ != TYPE_NUMBER) {
+        return fallback;
+    }
+    char* end;
+    double value = strtod(text_.data, &end);
+    return end == text_.data + text_.size ? value : fallback;
+}
+
+bool Value::as_bool(bool fallback) const {
+    if (type_ != TYPE_BOOL) {
+        return fallback;
+    }
+    return text_.size == 4;
+}
+
+bool Value::equals(const char* text) const {
+    return type_ == TYPE_STRING and not escaped_ and text_.equals(text);
+}
+
+std::string Value::str() const {
+    if (not escaped_) {
+        return text_.str();
+    }
+    std::string unescaped;
+    for (size_t i = 0; i < text_.size; ++i) {
+        char c = text_.data[i];
+        if (c != '\\' or i + 1 == text_.size) {
+            unescaped += c;
+            continue;
+        }
+        c = text_.data[++i];
+        switch (c) {
+            case 'n':
+                unescaped += '\n';
+                break;
+            case 't':
+                unescaped += '\t';
+                break;
+            case 'r':
+                unescaped += '\r';
+                break;
+            case 'u':
+                // The firmware only escapes control characters.
+                if (i + 4 < text_.size) {
+                    std::string code(text_.data + i + 1, 4);
+                    unescaped += (char) strtol(code.c_str(), NULL, 16);
+                    i += 4;
+                }
+                break;
+            default:
+                unescaped += c;
+                break;
+        }
+    }
+    return unescaped;
+}
+
+bool Reply::parse(const char* line, size_t size) {
+    details::Scanner scanner(line, line + size);
+    count_ = 0;
+    line_ = Span{line, size};
+    command_ = Span{"", 0};
+    kind_ = KIND_OTHER;
+    job_ = -1;
+    bool has_command = false;
+
+    if (not scanner.consume('{')) {
+        return false;
+    }
+    if (not scanner.consume('}')) {
+        do {
+            Span key;
+            bool escaped;
+            Value value;
+            if (count_ == MAX_REPLY_FIELDS or not scanner.string(key, escaped) or
+                not scanner.consume(':') or not scanner.value(value)) {
+                return false;
+            }
+            keys_[count_] = key;
+            values_[count_] = value;
+            count_++;
+
+            if (key.equals("command") and value.type() == Value::TYPE_STRING) {
+                command_ = value.text();
+                has_command = true;
+            } else if (key.equals("job")) {
+                job_ = value.as_int(-1);
+            }
+        } while (scanner.consume(','));
+        if (not scanner.consume('}')) {
+            return false;
+        }
+    }
+    scanner.skip_space();
+    if (not scanner.at_end() or not has_command) {
+        return false;
+    }
+
+    if (command_.starts_with("RX_")) {
+        kind_ = KIND_OUTPUT;
+    } else if (command_.starts_with("ERR_") or command_.equals("ERROR")) {
+        // Lines the firmware couldn't read a command from are answered with
+        // `ERROR`.
+        kind_ = KIND_ERROR;
+    } else if (command_.starts_with("ACK_")) {
+        kind_ = KIND_ACK;
+    }
+    return true;
+}
+
+Span Reply::name() const {
+    static const size_t prefix_lengths[] = {3, 4, 4, 0};
+    size_t prefix = command_.equals("ERROR") ? 0 : prefix_lengths[kind_];
+    return Span{command_.data + prefix, command_.size - prefix};
+}
+
+bool Reply::completes() const {
+    if (kind_ == KIND_ACK or kind_ == KIND_OTHER) {
+        return false;
+    }
+    return get("done").as_bool(true);
+}
+
+Value Reply::get(const char* key) const {
+    for (size_t i = 0; i < count_; ++i) {
+        if (keys_[i].equals(key)) {
+            return values_[i];
+        }
+    }
+    return Value();
+}
+
+} // namespace client
+} // namespace controllino
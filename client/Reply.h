@@ -0,0 +1,135 @@
+// Replies of the board, parsed in place: a `Reply` points into the line it
+// was parsed from, so the line must outlive it. Replies are flat JSON
+// objects; nested objects and arrays, like the results of a batch, are kept
+// as raw text.
+#ifndef CONTROLLINO_CLIENT_REPLY_H
+#define CONTROLLINO_CLIENT_REPLY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+// Replies have at most this many keys; the longest, a coalesced logging
+// sample, has 10.
+#define MAX_REPLY_FIELDS 16
+
+namespace controllino {
+namespace client {
+
+// A piece of a line.
+struct Span {
+    const char* data;
+    size_t size;
+
+    bool equals(const char* text) const;
+    bool starts_with(const char* prefix) const;
+    std::string str() const {
+        return std::string(data, size);
+    }
+};
+
+class Value {
+public:
+    enum type_t {
+        TYPE_MISSING,
+        TYPE_NULL,
+        TYPE_BOOL,
+        TYPE_NUMBER,
+        TYPE_STRING,
+        TYPE_OBJECT,
+        TYPE_ARRAY,
+    };
+
+    Value() : type_(TYPE_MISSING), text_{"", 0}, escaped_(false) {
+    }
+    Value(type_t type, Span text, bool escaped = false)
+        : type_(type), text_(text), escaped_(escaped) {
+    }
+
+    type_t type() const {
+        return type_;
+    }
+    bool is_missing() const {
+        return type_ == TYPE_MISSING;
+    }
+    // The text of the value; strings without their quotes and still escaped.
+    Span text() const {
+        return text_;
+    }
+
+    // Numbers are converted where they are; `fallback` is returned for
+    // values of other types.
+    int64_t as_int(int64_t fallback = 0) const;
+    uint64_t as_uint(uint64_t fallback = 0) const;
+    double as_double(double fallback = 0.0) const;
+    bool as_bool(bool fallback = false) const;
+    // Compares a string value without copying it.
+    bool equals(const char* text) const;
+    // Copies the value; strings are unescaped.
+    std::string str() const;
+
+private:
+    type_t type_;
+    Span text_;
+    bool escaped_;
+};
+
+class Reply {
+public:
+    enum kind_t {
+        KIND_OUTPUT, // RX_
+        KIND_ERROR,  // ERR_, or ERROR
+        KIND_ACK,    // ACK_
+        KIND_OTHER,
+    };
+
+    // Parses `line`, which needn't be terminated. Returns false if it isn't a
+    // JSON object with a string `command`.
+    bool parse(const char* line, size_t size);
+
+    Span line() const {
+        return line_;
+    }
+    Span command() const {
+        return command_;
+    }
+    // The command without the prefix of its kind, e.g. `GET_INPUT`; `ERROR`
+    // for `ERROR`.
+    Span name() const;
+    kind_t kind() const {
+        return kind_;
+    }
+    // The job, or -1 if the reply has none.
+    int64_t job() const {
+        return job_;
+    }
+    // Whether this is the last reply to its job; logging samples have
+    // `"done": false` until the last one, and acknowledgements never are.
+    bool completes() const;
+
+    Value get(const char* key) const;
+    size_t size() const {
+        return count_;
+    }
+    Span key(size_t index) const {
+        return keys_[index];
+    }
+    Value value(size_t index) const {
+        return values_[index];
+    }
+
+private:
+    Span line_;
+    Span command_;
+    kind_t kind_;
+    int64_t job_;
+    size_t count_;
+    Span keys_[MAX_REPLY_FIELDS];
+    Value values_[MAX_REPLY_FIELDS];
+};
+
+} // namespace client
+} // namespace controllino
+
+#endif /* CONTROLLINO_CLIENT_REPLY_H */
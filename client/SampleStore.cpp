@@ -0,0 +1,976 @@
+#include "SampleStore.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+// Blocks are written by the buffer once it holds this many bytes.
+#define STORE_WRITE_BUFFER (1 << 20)
+
+namespace controllino {
+namespace client {
+
+namespace details {
+
+// The layout of the file, in the byte order of the host. Every block starts
+// with a `BlockHeader` and is padded to a multiple of 8 bytes:
+//
+//   FileHeader
+//   CHANNEL   names a channel
+//   CHUNK     samples of a channel
+//   INDEX     summaries of consecutive chunks of a channel
+//   DIRECTORY summaries of all index blocks, written by `close`
+//   FOOTER    points to the last index or channel block or to the directory
+//
+// Channel and index blocks are chained by `previous`, newest first, so the
+// chain from the last footer finds all of them.
+const char FILE_MAGIC[8] = {'C', 'T', 'L', 'S', 'T', 'O', 'R', 'E'};
+const char FOOTER_MAGIC[8] = {'C', 'T', 'L', 'S', 'E', 'N', 'D', '1'};
+const uint32_t STORE_VERSION = 1;
+
+enum block_type_t : uint32_t {
+    BLOCK_CHANNEL = 1,
+    BLOCK_CHUNK,
+    BLOCK_INDEX,
+    BLOCK_DIRECTORY,
+    BLOCK_FOOTER,
+};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct BlockHeader {
+    uint32_t type;
+    uint32_t size; // Of the whole block
+};
+
+struct ChannelHeader {
+    uint64_t previous;
+    uint32_t channel;
+    uint32_t reserved;
+    char name[MAX_CHANNEL_NAME];
+};
+
+// The first sample is in the header, the deltas of the others follow: first
+// the times as varints, then the values as zigzag varints.
+struct ChunkHeader {
+    uint32_t channel;
+    uint32_t count;
+    uint64_t first_time;
+    int32_t first_value;
+    uint32_t times_size;
+    uint32_t values_size;
+    uint32_t reserved;
+};
+
+// Summarizes a chunk, or in the header of an index block all of its chunks.
+struct IndexEntry {
+    uint64_t offset; // Of the chunk or the index block
+    uint64_t first_time;
+    uint64_t last_time;
+    int64_t sum;
+    uint64_t count;
+    int32_t min;
+    int32_t max;
+    uint32_t chunks;
+    uint32_t reserved;
+};
+
+struct IndexHeader {
+    uint64_t previous;
+    uint32_t channel;
+    uint32_t reserved;
+    IndexEntry summary; // The entries follow.
+};
+
+// Followed by a record per channel and the summaries of the index blocks of
+// the channels, in the order of the records.
+struct DirectoryHeader {
+    uint64_t previous;
+    uint32_t channels;
+    uint32_t segments;
+};
+
+struct ChannelRecord {
+    uint32_t channel;
+    uint32_t segments;
+    char name[MAX_CHANNEL_NAME];
+};
+
+struct Footer {
+    BlockHeader header;
+    uint64_t last;
+    char magic[8];
+};
+
+size_t padded(size_t size) {
+    return (size + 7) & ~(size_t) 7;
+}
+
+void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += (char) (value | 0x80);
+        value >>= 7;
+    }
+    out += (char) value;
+}
+
+// Reads at most 10 bytes, the longest varint.
+inline uint64_t get_varint(const uint8_t*& p) {
+    uint64_t byte = *p++;
+    if (byte < 0x80) {
+        return byte;
+    }
+    uint64_t value = byte & 0x7f;
+    for (unsigned shift = 7; shift < 70; shift += 7) {
+        byte = *p++;
+        value |= (byte & 0x7f) << shift;
+        if (byte < 0x80) {
+            break;
+        }
+    }
+    return value;
+}
+
+// Returns false if the varint doesn't end before `end`.
+inline bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    if (end - p >= 10) {
+        value = get_varint(p);
+        return true;
+    }
+    value = 0;
+    for (unsigned shift = 0; p < end and shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        value |= (uint64_t) (byte & 0x7f) << shift;
+        if (not(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t zigzag(int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+// Adds the samples summarized by `from` to `to`.
+void merge(IndexEntry& to, const IndexEntry& from) {
+    if (to.count == 0) {
+        to.first_time = from.first_time;
+        to.min = from.min;
+        to.max = from.max;
+    } else {
+        to.min = std::min(to.min, from.min);
+        to.max = std::max(to.max, from.max);
+    }
+    to.last_time = from.last_time;
+    to.sum += from.sum;
+    to.count += from.count;
+    to.chunks += from.chunks;
+}
+
+void add(Bucket& bucket, double& sum, uint64_t count, int32_t min, int32_t max,
+         double samples_sum) {
+    if (bucket.count == 0) {
+        bucket.min = min;
+        bucket.max = max;
+    } else {
+        bucket.min = std::min(bucket.min, min);
+        bucket.max = std::max(bucket.max, max);
+    }
+    bucket.count += count;
+    sum += samples_sum;
+}
+
+} // namespace details
+
+using details::BlockHeader;
+using details::ChannelHeader;
+using details::ChannelRecord;
+using details::ChunkHeader;
+using details::DirectoryHeader;
+using details::FileHeader;
+using details::Footer;
+using details::IndexEntry;
+using details::IndexHeader;
+
+SampleStore::SampleStore()
+    : fd_(-1),
+      data_(NULL),
+      size_(0),
+      valid_size_(0),
+      last_metadata_(0),
+      closed_(false),
+      directory_(false) {
+}
+
+SampleStore::~SampleStore() {
+    close();
+}
+
+bool SampleStore::open(const std::string& path) {
+    close();
+    error_.clear();
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        error_ = path + ": " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        error_ = path + ": " + strerror(errno);
+        close();
+        return false;
+    }
+    size_ = (size_t) st.st_size;
+    if (size_ < sizeof(FileHeader)) {
+        error_ = path + ": not a sample store";
+        close();
+        return false;
+    }
+    void* data = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (data == MAP_FAILED) {
+        error_ = path + ": " + strerror(errno);
+        data_ = NULL;
+        close();
+        return false;
+    }
+    data_ = (const uint8_t*) data;
+    // Queries touch a few pages of the index and of chunks all over the file,
+    // so reading ahead mostly reads what isn't needed.
+    madvise(data, size_, MADV_RANDOM);
+    const FileHeader* header = (const FileHeader*) data_;
+    if (memcmp(header->magic, details::FILE_MAGIC, sizeof(header->magic)) != 0 or
+        header->version != details::STORE_VERSION) {
+        error_ = path + ": not a sample store";
+        close();
+        return false;
+    }
+
+    const Footer* footer = NULL;
+    if (size_ >= sizeof(FileHeader) + sizeof(Footer) and size_ % 8 == 0) {
+        footer = (const Footer*) (data_ + size_ - sizeof(Footer));
+    }
+    if (footer != NULL and footer->header.type == details::BLOCK_FOOTER and
+        footer->header.size == sizeof(Footer) and
+        memcmp(footer->magic, details::FOOTER_MAGIC, sizeof(footer->magic)) == 0) {
+        closed_ = true;
+        valid_size_ = size_;
+        if (not walk_index(footer->last)) {
+            error_ = path + ": corrupt index";
+            close();
+            return false;
+        }
+    } else {
+        recover();
+    }
+    std::sort(channels_.begin(), channels_.end(),
+              [](const Channel& a, const Channel& b) { return a.id < b.id; });
+    return true;
+}
+
+void SampleStore::close() {
+    if (data_ != NULL) {
+        munmap((void*) data_, size_);
+        data_ = NULL;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+    valid_size_ = 0;
+    last_metadata_ = 0;
+    closed_ = false;
+    directory_ = false;
+    channels_.clear();
+}
+
+int SampleStore::find_channel(const std::string& name) const {
+    for (size_t i = 0; i < channels_.size(); ++i) {
+        if (channels_[i].name == name) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+uint64_t SampleStore::sample_count(size_t channel) const {
+    uint64_t count = 0;
+    for (const Segment& segment : channels_[channel].segments) {
+        count += segment.summary->count;
+    }
+    return count;
+}
+
+uint64_t SampleStore::first_time(size_t channel) const {
+    const std::vector<Segment>& segments = channels_[channel].segments;
+    return segments.empty() ? 0 : segments.front().summary->first_time;
+}
+
+uint64_t SampleStore::last_time(size_t channel) const {
+    const std::vector<Segment>& segments = channels_[channel].segments;
+    return segments.empty() ? 0 : segments.back().summary->last_time;
+}
+
+SampleStore::Channel& SampleStore::channel_by_id(uint32_t id) {
+    for (Channel& channel : channels_) {
+        if (channel.id == id) {
+            return channel;
+        }
+    }
+    channels_.emplace_back();
+    channels_.back().id = id;
+    return channels_.back();
+}
+
+// Checks that a summary of an index block points to its entries.
+bool SampleStore::add_segment(Channel& channel, const IndexEntry* summary) {
+    size_t begin = sizeof(BlockHeader) + sizeof(IndexHeader);
+    if (summary->offset % 8 != 0 or summary->offset > size_ - begin or summary->chunks == 0 or
+        summary->chunks > (size_ - begin - summary->offset) / sizeof(IndexEntry)) {
+        return false;
+    }
+    const IndexEntry* entries = (const IndexEntry*) (data_ + summary->offset + begin);
+    channel.segments.push_back({summary, entries});
+    return true;
+}
+
+const BlockHeader* SampleStore::block(uint64_t offset, size_t size) const {
+    if (offset < sizeof(FileHeader) or offset % 8 != 0 or offset > valid_size_ or
+        valid_size_ - offset < sizeof(BlockHeader) + size) {
+        return NULL;
+    }
+    const BlockHeader* header = (const BlockHeader*) (data_ + offset);
+    if (header->size < sizeof(BlockHeader) + size or header->size > valid_size_ - offset) {
+        return NULL;
+    }
+    return header;
+}
+
+bool SampleStore::walk_index(uint64_t last) {
+    const BlockHeader* header = block(last, sizeof(DirectoryHeader));
+    if (header != NULL and header->type == details::BLOCK_DIRECTORY) {
+        const DirectoryHeader* directory = (const DirectoryHeader*) (header + 1);
+        const ChannelRecord* records = (const ChannelRecord*) (directory + 1);
+        const IndexEntry* summaries = (const IndexEntry*) (records + directory->channels);
+        if (header->size < sizeof(BlockHeader) + sizeof(DirectoryHeader) +
+                               (uint64_t) directory->channels * sizeof(ChannelRecord) +
+                               (uint64_t) directory->segments * sizeof(IndexEntry)) {
+            return false;
+        }
+        // The directory is read as a whole.
+        size_t page = (size_t) sysconf(_SC_PAGESIZE);
+        madvise((void*) (data_ + last / page * page), last % page + header->size,
+                MADV_WILLNEED);
+        last_metadata_ = directory->previous;
+        directory_ = true;
+        uint64_t segments = 0;
+        for (uint32_t i = 0; i < directory->channels; ++i) {
+            Channel& channel = channel_by_id(records[i].channel);
+            channel.name.assign(records[i].name, strnlen(records[i].name, MAX_CHANNEL_NAME));
+            if (records[i].segments > directory->segments - segments) {
+                return false;
+            }
+            for (uint32_t j = 0; j < records[i].segments; ++j) {
+                if (not add_segment(channel, &summaries[segments++])) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    last_metadata_ = last;
+    for (uint64_t offset = last; offset != 0;) {
+        header = block(offset, sizeof(uint64_t));
+        if (header == NULL) {
+            return false;
+        }
+        uint64_t previous = *(const uint64_t*) (header + 1);
+        if (header->type == details::BLOCK_CHANNEL and
+            header->size >= sizeof(BlockHeader) + sizeof(ChannelHeader)) {
+            const ChannelHeader* channel = (const ChannelHeader*) (header + 1);
+            channel_by_id(channel->channel)
+                .name.assign(channel->name, strnlen(channel->name, MAX_CHANNEL_NAME));
+        } else if (header->type == details::BLOCK_INDEX and
+                   header->size >= sizeof(BlockHeader) + sizeof(IndexHeader)) {
+            const IndexHeader* index = (const IndexHeader*) (header + 1);
+            if (index->summary.offset != offset or
+                not add_segment(channel_by_id(index->channel), &index->summary)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+        // The chain only leads backwards.
+        if (previous >= offset) {
+            return false;
+        }
+        offset = previous;
+    }
+    for (Channel& channel : channels_) {
+        std::reverse(channel.segments.begin(), channel.segments.end());
+    }
+    return true;
+}
+
+void SampleStore::recover() {
+    struct Chunk {
+        uint32_t channel;
+        uint64_t offset;
+    };
+    std::vector<Chunk> chunks;
+    valid_size_ = size_;
+    size_t offset = sizeof(FileHeader);
+    const BlockHeader* header;
+    while ((header = block(offset, 0)) != NULL and header->size % 8 == 0) {
+        if (header->type == details::BLOCK_CHANNEL) {
+            if (header->size < sizeof(BlockHeader) + sizeof(ChannelHeader)) {
+                break;
+            }
+            const ChannelHeader* channel = (const ChannelHeader*) (header + 1);
+            channel_by_id(channel->channel)
+                .name.assign(channel->name, strnlen(channel->name, MAX_CHANNEL_NAME));
+            last_metadata_ = offset;
+        } else if (header->type == details::BLOCK_INDEX) {
+            if (header->size < sizeof(BlockHeader) + sizeof(IndexHeader)) {
+                break;
+            }
+            const IndexHeader* index = (const IndexHeader*) (header + 1);
+            if (index->summary.offset != offset or
+                header->size < sizeof(BlockHeader) + sizeof(IndexHeader) +
+                                   (uint64_t) index->summary.chunks * sizeof(IndexEntry) or
+                not add_segment(channel_by_id(index->channel), &index->summary)) {
+                break;
+            }
+            last_metadata_ = offset;
+        } else if (header->type == details::BLOCK_CHUNK) {
+            const ChunkHeader* chunk = (const ChunkHeader*) (header + 1);
+            if (header->size < sizeof(BlockHeader) + sizeof(ChunkHeader) or
+                header->size < sizeof(BlockHeader) + sizeof(ChunkHeader) +
+                                   (uint64_t) chunk->times_size + chunk->values_size) {
+                break;
+            }
+            chunks.push_back({chunk->channel, offset});
+        } else if (header->type != details::BLOCK_DIRECTORY and
+                   header->type != details::BLOCK_FOOTER) {
+            break;
+        }
+        offset += header->size;
+    }
+    valid_size_ = offset;
+
+    // Chunks after the last index block of their channel are summarized here.
+    uint64_t times[STORE_CHUNK_SAMPLES];
+    int32_t values[STORE_CHUNK_SAMPLES];
+    for (const Chunk& chunk : chunks) {
+        Channel& channel = channel_by_id(chunk.channel);
+        if (not channel.segments.empty()) {
+            const Segment& last = channel.segments.back();
+            if (chunk.offset <= last.entries[last.summary->chunks - 1].offset) {
+                continue;
+            }
+        }
+        IndexEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.offset = chunk.offset;
+        size_t count = decode(entry, times, values);
+        if (count == 0) {
+            continue;
+        }
+        entry.first_time = times[0];
+        entry.last_time = times[count - 1];
+        entry.count = count;
+        entry.chunks = 1;
+        entry.min = entry.max = values[0];
+        for (size_t i = 0; i < count; ++i) {
+            entry.sum += values[i];
+            entry.min = std::min(entry.min, values[i]);
+            entry.max = std::max(entry.max, values[i]);
+        }
+        channel.recovered.push_back(entry);
+    }
+    for (Channel& channel : channels_) {
+        if (channel.recovered.empty()) {
+            continue;
+        }
+        channel.recovered_summary.reset(new IndexEntry());
+        memset(channel.recovered_summary.get(), 0, sizeof(IndexEntry));
+        for (const IndexEntry& entry : channel.recovered) {
+            details::merge(*channel.recovered_summary, entry);
+        }
+        channel.segments.push_back(
+            {channel.recovered_summary.get(), channel.recovered.data()});
+    }
+}
+
+size_t SampleStore::decode(const IndexEntry& entry, uint64_t* times, int32_t* values) const {
+    const BlockHeader* header = block(entry.offset, sizeof(ChunkHeader));
+    if (header == NULL or header->type != details::BLOCK_CHUNK) {
+        return 0;
+    }
+    const ChunkHeader* chunk = (const ChunkHeader*) (header + 1);
+    const uint8_t* p = (const uint8_t*) (chunk + 1);
+    const uint8_t* end = (const uint8_t*) header + header->size;
+    if (chunk->count == 0 or chunk->count > STORE_CHUNK_SAMPLES or
+        (uint64_t) chunk->times_size + chunk->values_size > (size_t) (end - p)) {
+        return 0;
+    }
+    const uint8_t* times_end = p + chunk->times_size;
+    const uint8_t* values_end = times_end + chunk->values_size;
+    times[0] = chunk->first_time;
+    values[0] = chunk->first_value;
+    // Varints are only checked against the end of their column near it.
+    size_t count = 1;
+    uint64_t time = chunk->first_time;
+    for (; count < chunk->count and times_end - p >= 10; ++count) {
+        time += details::get_varint(p);
+        times[count] = time;
+    }
+    for (; count < chunk->count; ++count) {
+        uint64_t delta;
+        if (not details::get_varint(p, times_end, delta)) {
+            break;
+        }
+        time += delta;
+        times[count] = time;
+    }
+    p = times_end;
+    int64_t value = chunk->first_value;
+    size_t i = 1;
+    for (; i < count and values_end - p >= 10; ++i) {
+        value += details::unzigzag(details::get_varint(p));
+        values[i] = (int32_t) value;
+    }
+    for (; i < count; ++i) {
+        uint64_t delta;
+        if (not details::get_varint(p, values_end, delta)) {
+            return i;
+        }
+        value += details::unzigzag(delta);
+        values[i] = (int32_t) value;
+    }
+    return count;
+}
+
+void SampleStore::seek(const Channel& channel, uint64_t begin, size_t& segment,
+                       size_t& entry) const {
+    const std::vector<Segment>& segments = channel.segments;
+    segment = std::partition_point(segments.begin(), segments.end(),
+                                   [begin](const Segment& s) {
+                                       return s.summary->last_time < begin;
+                                   }) -
+              segments.begin();
+    entry = 0;
+    if (segment < segments.size()) {
+        const Segment& s = segments[segment];
+        entry = std::partition_point(s.entries, s.entries + s.summary->chunks,
+                                     [begin](const IndexEntry& e) {
+                                         return e.last_time < begin;
+                                     }) -
+                s.entries;
+    }
+}
+
+size_t SampleStore::read(size_t channel, uint64_t begin, uint64_t end,
+                         std::vector<StoredSample>& samples) const {
+    const std::vector<Segment>& segments = channels_[channel].segments;
+    uint64_t times[STORE_CHUNK_SAMPLES];
+    int32_t values[STORE_CHUNK_SAMPLES];
+    size_t found = 0;
+    size_t s, e;
+    for (seek(channels_[channel], begin, s, e); s < segments.size(); ++s, e = 0) {
+        for (; e < segments[s].summary->chunks; ++e) {
+            const IndexEntry& entry = segments[s].entries[e];
+            if (entry.first_time >= end) {
+                return found;
+            }
+            size_t count = decode(entry, times, values);
+            size_t first = std::lower_bound(times, times + count, begin) - times;
+            size_t last = std::lower_bound(times + first, times + count, end) - times;
+            size_t size = samples.size();
+            samples.resize(size + last - first);
+            for (size_t i = first; i < last; ++i) {
+                samples[size++] = {times[i], values[i]};
+            }
+            found += last - first;
+        }
+    }
+    return found;
+}
+
+std::vector<Bucket> SampleStore::downsample(size_t channel, uint64_t begin, uint64_t end,
+                                            size_t buckets) const {
+    std::vector<Bucket> result;
+    if (buckets == 0 or end <= begin) {
+        return result;
+    }
+    uint64_t width = (end - begin - 1) / buckets + 1;
+    result.resize(buckets);
+    std::vector<double> sums(buckets, 0.0);
+    for (size_t i = 0; i < buckets; ++i) {
+        result[i] = {begin + i * width, 0, 0, 0, 0.0};
+    }
+    // Whether the summary `entry` is in one bucket, which is then `bucket`.
+    auto in_one_bucket = [&](const IndexEntry& entry, size_t& bucket) {
+        if (entry.first_time < begin or entry.last_time >= end) {
+            return false;
+        }
+        bucket = (entry.first_time - begin) / width;
+        return bucket == (entry.last_time - begin) / width;
+    };
+
+    const std::vector<Segment>& segments = channels_[channel].segments;
+    uint64_t times[STORE_CHUNK_SAMPLES];
+    int32_t values[STORE_CHUNK_SAMPLES];
+    size_t s, e;
+    for (seek(channels_[channel], begin, s, e); s < segments.size(); ++s, e = 0) {
+        const IndexEntry& summary = *segments[s].summary;
+        if (summary.first_time >= end) {
+            break;
+        }
+        size_t bucket;
+        if (in_one_bucket(summary, bucket)) {
+            details::add(result[bucket], sums[bucket], summary.count, summary.min, summary.max,
+                         (double) summary.sum);
+            continue;
+        }
+        for (; e < summary.chunks; ++e) {
+            const IndexEntry& entry = segments[s].entries[e];
+            if (entry.first_time >= end) {
+                break;
+            }
+            if (in_one_bucket(entry, bucket)) {
+                details::add(result[bucket], sums[bucket], entry.count, entry.min, entry.max,
+                             (double) entry.sum);
+                continue;
+            }
+            // The samples are sorted, so buckets are only computed where
+            // they change.
+            size_t count = decode(entry, times, values);
+            size_t i = std::lower_bound(times, times + count, begin) - times;
+            while (i < count and times[i] < end) {
+                bucket = (times[i] - begin) / width;
+                uint64_t bucket_end = std::min(end, begin + (bucket + 1) * width);
+                size_t first = i;
+                int32_t min = values[i];
+                int32_t max = values[i];
+                int64_t sum = 0;
+                for (; i < count and times[i] < bucket_end; ++i) {
+                    min = std::min(min, values[i]);
+                    max = std::max(max, values[i]);
+                    sum += values[i];
+                }
+                details::add(result[bucket], sums[bucket], i - first, min, max, (double) sum);
+            }
+        }
+    }
+    for (size_t i = 0; i < buckets; ++i) {
+        if (result[i].count > 0) {
+            result[i].mean = sums[i] / result[i].count;
+        }
+    }
+    return result;
+}
+
+SampleWriter::SampleWriter()
+    : fd_(-1), size_(0), last_metadata_(0), flushed_size_(0), directory_(false) {
+}
+
+SampleWriter::~SampleWriter() {
+    close();
+}
+
+bool SampleWriter::open(const std::string& path) {
+    close();
+    error_.clear();
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (fd_ < 0 or fstat(fd_, &st) != 0) {
+        error_ = path + ": " + strerror(errno);
+        close();
+        return false;
+    }
+    if (st.st_size == 0) {
+        FileHeader header;
+        memcpy(header.magic, details::FILE_MAGIC, sizeof(header.magic));
+        header.version = details::STORE_VERSION;
+        header.reserved = 0;
+        write(&header, sizeof(header));
+        return true;
+    }
+
+    SampleStore store;
+    if (not store.open(path)) {
+        error_ = store.error();
+        close();
+        return false;
+    }
+    // A block that was cut off when the writer died is dropped.
+    if (ftruncate(fd_, (off_t) store.valid_size_) != 0 or
+        lseek(fd_, (off_t) store.valid_size_, SEEK_SET) < 0) {
+        error_ = path + ": " + strerror(errno);
+        close();
+        return false;
+    }
+    size_ = store.valid_size_;
+    flushed_size_ = store.closed_ ? size_ : 0;
+    directory_ = store.directory_;
+    last_metadata_ = store.last_metadata_;
+    for (const SampleStore::Channel& stored : store.channels_) {
+        if (channels_.size() <= stored.id) {
+            channels_.resize(stored.id + 1);
+        }
+        Channel& channel = channels_[stored.id];
+        channel.name = stored.name;
+        for (const SampleStore::Segment& segment : stored.segments) {
+            if (segment.entries == stored.recovered.data()) {
+                channel.entries = stored.recovered;
+            } else {
+                channel.segments.push_back(*segment.summary);
+            }
+            channel.last_time = segment.summary->last_time;
+        }
+    }
+    return true;
+}
+
+bool SampleWriter::flush() {
+    if (fd_ < 0) {
+        return false;
+    }
+    for (uint32_t id = 0; id < channels_.size(); ++id) {
+        write_chunk(id);
+        write_index(id);
+    }
+    if (size_ != flushed_size_) {
+        write_footer(last_metadata_);
+        flushed_size_ = size_;
+        directory_ = false;
+    }
+    return write_buffer();
+}
+
+bool SampleWriter::close() {
+    if (fd_ < 0) {
+        return error_.empty();
+    }
+    for (uint32_t id = 0; id < channels_.size(); ++id) {
+        write_chunk(id);
+        write_index(id);
+    }
+    if (size_ != flushed_size_ or not directory_) {
+        write_footer(write_directory());
+    }
+    bool ok = write_buffer();
+    ::close(fd_);
+    fd_ = -1;
+    size_ = 0;
+    last_metadata_ = 0;
+    flushed_size_ = 0;
+    directory_ = false;
+    buffer_.clear();
+    channels_.clear();
+    return ok;
+}
+
+int SampleWriter::channel(const std::string& name) {
+    for (size_t i = 0; i < channels_.size(); ++i) {
+        if (channels_[i].name == name) {
+            return (int) i;
+        }
+    }
+    if (fd_ < 0 or name.empty() or name.size() >= MAX_CHANNEL_NAME) {
+        return -1;
+    }
+    channels_.emplace_back();
+    channels_.back().name = name;
+    uint32_t id = (uint32_t) channels_.size() - 1;
+    ChannelHeader header;
+    memset(&header, 0, sizeof(header));
+    header.previous = last_metadata_;
+    header.channel = id;
+    memcpy(header.name, name.data(), name.size());
+    last_metadata_ = size_;
+    write_block(details::BLOCK_CHANNEL, sizeof(header));
+    write(&header, sizeof(header));
+    return (int) id;
+}
+
+bool SampleWriter::append(int channel, uint64_t time, int32_t value) {
+    Channel& c = channels_[channel];
+    if (time < c.last_time) {
+        return false;
+    }
+    c.last_time = time;
+    c.times.push_back(time);
+    c.values.push_back(value);
+    if (c.times.size() == STORE_CHUNK_SAMPLES) {
+        write_chunk((uint32_t) channel);
+        if (buffer_.size() >= STORE_WRITE_BUFFER) {
+            write_buffer();
+        }
+    }
+    return true;
+}
+
+void SampleWriter::write_chunk(uint32_t id) {
+    Channel& c = channels_[id];
+    if (c.times.empty()) {
+        return;
+    }
+    columns_.clear();
+    IndexEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.offset = size_;
+    entry.first_time = c.times.front();
+    entry.last_time = c.times.back();
+    entry.count = c.times.size();
+    entry.chunks = 1;
+    entry.min = entry.max = c.values[0];
+    entry.sum = c.values[0];
+    for (size_t i = 1; i < c.times.size(); ++i) {
+        details::put_varint(columns_, c.times[i] - c.times[i - 1]);
+    }
+    size_t times_size = columns_.size();
+    for (size_t i = 1; i < c.values.size(); ++i) {
+        int64_t delta = (int64_t) c.values[i] - c.values[i - 1];
+        details::put_varint(columns_, details::zigzag(delta));
+        entry.sum += c.values[i];
+        entry.min = std::min(entry.min, c.values[i]);
+        entry.max = std::max(entry.max, c.values[i]);
+    }
+
+    ChunkHeader header;
+    header.channel = id;
+    header.count = (uint32_t) c.times.size();
+    header.first_time = c.times[0];
+    header.first_value = c.values[0];
+    header.times_size = (uint32_t) times_size;
+    header.values_size = (uint32_t) (columns_.size() - times_size);
+    header.reserved = 0;
+    write_block(details::BLOCK_CHUNK, sizeof(header) + columns_.size());
+    write(&header, sizeof(header));
+    write(columns_.data(), columns_.size());
+    pad();
+
+    c.entries.push_back(entry);
+    c.times.clear();
+    c.values.clear();
+    if (c.entries.size() == STORE_INDEX_ENTRIES) {
+        write_index(id);
+    }
+}
+
+void SampleWriter::write_index(uint32_t id) {
+    Channel& c = channels_[id];
+    if (c.entries.empty()) {
+        return;
+    }
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    header.previous = last_metadata_;
+    header.channel = id;
+    for (const IndexEntry& entry : c.entries) {
+        details::merge(header.summary, entry);
+    }
+    header.summary.offset = size_;
+    last_metadata_ = size_;
+    write_block(details::BLOCK_INDEX, sizeof(header) + c.entries.size() * sizeof(IndexEntry));
+    write(&header, sizeof(header));
+    write(c.entries.data(), c.entries.size() * sizeof(IndexEntry));
+    c.segments.push_back(header.summary);
+    c.entries.clear();
+}
+
+uint64_t SampleWriter::write_directory() {
+    DirectoryHeader header;
+    memset(&header, 0, sizeof(header));
+    header.previous = last_metadata_;
+    for (const Channel& c : channels_) {
+        if (not c.name.empty()) {
+            header.channels++;
+            header.segments += (uint32_t) c.segments.size();
+        }
+    }
+    uint64_t offset = size_;
+    write_block(details::BLOCK_DIRECTORY,
+                sizeof(header) + header.channels * sizeof(ChannelRecord) +
+                    header.segments * sizeof(IndexEntry));
+    write(&header, sizeof(header));
+    for (uint32_t id = 0; id < channels_.size(); ++id) {
+        if (channels_[id].name.empty()) {
+            continue;
+        }
+        ChannelRecord record;
+        memset(&record, 0, sizeof(record));
+        record.channel = id;
+        record.segments = (uint32_t) channels_[id].segments.size();
+        memcpy(record.name, channels_[id].name.data(), channels_[id].name.size());
+        write(&record, sizeof(record));
+    }
+    for (const Channel& c : channels_) {
+        if (not c.name.empty()) {
+            write(c.segments.data(), c.segments.size() * sizeof(IndexEntry));
+        }
+    }
+    return offset;
+}
+
+void SampleWriter::write_footer(uint64_t last) {
+    Footer footer;
+    footer.header = {details::BLOCK_FOOTER, sizeof(footer)};
+    footer.last = last;
+    memcpy(footer.magic, details::FOOTER_MAGIC, sizeof(footer.magic));
+    write(&footer, sizeof(footer));
+}
+
+// Starts a block whose content has `size` bytes.
+void SampleWriter::write_block(uint32_t type, size_t size) {
+    BlockHeader header = {type, (uint32_t) details::padded(sizeof(BlockHeader) + size)};
+    write(&header, sizeof(header));
+}
+
+void SampleWriter::pad() {
+    static const char zeros[8] = {0};
+    write(zeros, details::padded(size_) - size_);
+}
+
+void SampleWriter::write(const void* data, size_t size) {
+    buffer_.append((const char*) data, size);
+    size_ += size;
+}
+
+bool SampleWriter::write_buffer() {
+    size_t written = 0;
+    while (written < buffer_.size()) {
+        ssize_t size = ::write(fd_, buffer_.data() + written, buffer_.size() - written);
+        if (size < 0 and errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            error_ = std::string("write: ") + strerror(errno);
+            buffer_.clear();
+            return false;
+        }
+        written += (size_t) size;
+    }
+    buffer_.clear();
+    return error_.empty();
+}
+
+} // namespace client
+} // namespace controllino
@@ -0,0 +1,201 @@
+// A store for logged samples, which are queried in place.
+//
+// The file is append-only. Each channel's samples go into chunks of up to
+// STORE_CHUNK_SAMPLES samples, with the times and the values in separate
+// columns, delta-encoded as varints. Index blocks summarize the chunks of a
+// channel: time range, count, minimum, maximum and sum. They are chained
+// back from a footer at the end of the file. A reader maps the file and finds
+// ranges by binary search over the index. Downsampled views take the
+// summaries of the chunks which fall into one bucket and decode only the
+// chunks which straddle bucket boundaries.
+//
+// A store that wasn't closed, e.g. because the recorder crashed, is scanned
+// when it's opened; reopening it to append indexes its unindexed chunks.
+#ifndef CONTROLLINO_CLIENT_SAMPLE_STORE_H
+#define CONTROLLINO_CLIENT_SAMPLE_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#define STORE_CHUNK_SAMPLES 1024
+// Chunks per index block.
+#define STORE_INDEX_ENTRIES 64
+// Including the terminating zero.
+#define MAX_CHANNEL_NAME 64
+
+namespace controllino {
+namespace client {
+
+namespace details {
+struct BlockHeader;
+struct IndexEntry;
+} // namespace details
+
+struct StoredSample {
+    uint64_t time;
+    int32_t value;
+};
+
+// A summary of the samples in [begin, begin + width), where the width is the
+// same for all buckets of a view; empty buckets have a count of 0.
+struct Bucket {
+    uint64_t begin;
+    uint64_t count;
+    int32_t min;
+    int32_t max;
+    double mean;
+};
+
+class SampleStore {
+public:
+    SampleStore();
+    ~SampleStore();
+    SampleStore(const SampleStore&) = delete;
+    SampleStore& operator=(const SampleStore&) = delete;
+
+    // Maps the store. Returns false if it can't be read or isn't a store; see
+    // `error`.
+    bool open(const std::string& path);
+    void close();
+    const std::string& error() const {
+        return error_;
+    }
+
+    size_t channel_count() const {
+        return channels_.size();
+    }
+    const std::string& channel_name(size_t channel) const {
+        return channels_[channel].name;
+    }
+    // The channel named `name`, or -1.
+    int find_channel(const std::string& name) const;
+    uint64_t sample_count(size_t channel) const;
+    // The times of the first and the last sample; 0 for empty channels.
+    uint64_t first_time(size_t channel) const;
+    uint64_t last_time(size_t channel) const;
+
+    // Appends the samples of `channel` in [begin, end) to `samples`. Returns
+    // their number.
+    size_t read(size_t channel, uint64_t begin, uint64_t end,
+                std::vector<StoredSample>& samples) const;
+    // Summarizes [begin, end) in `buckets` buckets.
+    std::vector<Bucket> downsample(size_t channel, uint64_t begin, uint64_t end,
+                                   size_t buckets) const;
+
+private:
+    friend class SampleWriter;
+
+    // The chunks of an index block: their summary and their entries.
+    struct Segment {
+        const details::IndexEntry* summary;
+        const details::IndexEntry* entries;
+    };
+
+    struct Channel {
+        uint32_t id;
+        std::string name;
+        std::vector<Segment> segments;
+        // The entries of chunks which weren't indexed, if the store wasn't
+        // closed, as the last segment.
+        std::vector<details::IndexEntry> recovered;
+        std::unique_ptr<details::IndexEntry> recovered_summary;
+    };
+
+    Channel& channel_by_id(uint32_t id);
+    bool add_segment(Channel& channel, const details::IndexEntry* summary);
+    // The block at `offset` if it holds at least `size` bytes after its
+    // header, or NULL.
+    const details::BlockHeader* block(uint64_t offset, size_t size) const;
+    bool walk_index(uint64_t last);
+    // Scans a store that wasn't closed up to its first incomplete block.
+    void recover();
+    // The first entry which ends at or after `begin`, as segment and entry.
+    void seek(const Channel& channel, uint64_t begin, size_t& segment, size_t& entry) const;
+    // Decodes a chunk into `times` and `values`, which hold
+    // STORE_CHUNK_SAMPLES. Returns the number of samples.
+    size_t decode(const details::IndexEntry& entry, uint64_t* times, int32_t* values) const;
+
+    int fd_;
+    const uint8_t* data_;
+    size_t size_;
+    // The end of the last complete block and the last block of the index
+    // chain, for appending.
+    size_t valid_size_;
+    uint64_t last_metadata_;
+    bool closed_;    // Ends with a footer
+    bool directory_; // whose index is a directory
+    std::vector<Channel> channels_;
+    std::string error_;
+};
+
+// Appends samples to a store.
+class SampleWriter {
+public:
+    SampleWriter();
+    ~SampleWriter();
+    SampleWriter(const SampleWriter&) = delete;
+    SampleWriter& operator=(const SampleWriter&) = delete;
+
+    // Creates the store at `path` or opens it to append.
+    bool open(const std::string& path);
+    // Writes what's buffered and closes the store.
+    bool close();
+    // Writes what's buffered and a footer, so that readers see everything
+    // appended so far.
+    bool flush();
+    const std::string& error() const {
+        return error_;
+    }
+
+    // The channel named `name`, created if it's new, or -1 if the name is
+    // empty or too long.
+    int channel(const std::string& name);
+    // Appends a sample to a channel returned by `channel`. Returns false if
+    // `time` is before the last sample of the channel; the sample isn't
+    // stored then.
+    bool append(int channel, uint64_t time, int32_t value);
+
+private:
+    struct Channel {
+        std::string name;
+        uint64_t last_time = 0;
+        // The samples of the next chunk.
+        std::vector<uint64_t> times;
+        std::vector<int32_t> values;
+        // The entries of the next index block, and the summaries of the
+        // index blocks for the directory.
+        std::vector<details::IndexEntry> entries;
+        std::vector<details::IndexEntry> segments;
+    };
+
+    void write_chunk(uint32_t id);
+    void write_index(uint32_t id);
+    // Returns the offset of the directory.
+    uint64_t write_directory();
+    void write_footer(uint64_t last);
+    void write_block(uint32_t type, size_t size);
+    void pad();
+    void write(const void* data, size_t size);
+    bool write_buffer();
+
+    int fd_;
+    uint64_t size_; // Including the buffer
+    uint64_t last_metadata_;
+    // The size when the last footer was written, and whether it points to a
+    // directory.
+    uint64_t flushed_size_;
+    bool directory_;
+    std::string buffer_;
+    std::string columns_;
+    std::vector<Channel> channels_;
+    std::string error_;
+};
+
+} // namespace client
+} // namespace controllino
+
+#endif /* CONTROLLINO_CLIENT_SAMPLE_STORE_H */
@@ -0,0 +1,155 @@
+#include "SerialPort.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <fstream>
+
+namespace controllino {
+namespace client {
+
+typedef struct {
+    unsigned long baud;
+    speed_t speed;
+} speed_map_t;
+
+const speed_map_t speed_map[] = {
+    {9600, B9600},
+    {19200, B19200},
+    {38400, B38400},
+    {57600, B57600},
+    {115200, B115200},
+    {230400, B230400},
+};
+
+SerialPort::SerialPort() : fd_(-1), written_(0), in_(MAX_LINE_LENGTH), in_size_(0) {
+}
+
+SerialPort::~SerialPort() {
+    close();
+}
+
+bool SerialPort::open(const std::string& path, unsigned long baud) {
+    close();
+    speed_t speed = 0;
+    for (const speed_map_t& entry : speed_map) {
+        if (entry.baud == baud) {
+            speed = entry.speed;
+        }
+    }
+    if (speed == 0) {
+        errno = EINVAL;
+        return false;
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct termios attributes;
+    if (tcgetattr(fd, &attributes) < 0) {
+        ::close(fd);
+        return false;
+    }
+    cfmakeraw(&attributes);
+    attributes.c_cflag |= CLOCAL | CREAD;
+    cfsetispeed(&attributes, speed);
+    cfsetospeed(&attributes, speed);
+    if (tcsetattr(fd, TCSANOW, &attributes) < 0) {
+        ::close(fd);
+        return false;
+    }
+    fd_ = fd;
+    return true;
+}
+
+void SerialPort::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    fd_ = -1;
+    out_.clear();
+    written_ = 0;
+    in_size_ = 0;
+}
+
+void SerialPort::write(const char* data, size_t size) {
+    out_.append(data, size);
+}
+
+bool SerialPort::flush() {
+    while (fd_ >= 0 and written_ < out_.size()) {
+        ssize_t count = ::write(fd_, out_.data() + written_, out_.size() - written_);
+        if (count < 0) {
+            return errno == EAGAIN or errno == EINTR;
+        }
+        written_ += count;
+    }
+    // Drop what was written once it's most of the queue.
+    if (written_ == out_.size() or written_ > out_.size() / 2) {
+        out_.erase(0, written_);
+        written_ = 0;
+    }
+    return fd_ >= 0;
+}
+
+long SerialPort::fill() {
+    if (fd_ < 0) {
+        return -1;
+    }
+    ssize_t count = ::read(fd_, &in_[in_size_], in_.size() - in_size_);
+    if (count < 0) {
+        return (errno == EAGAIN or errno == EINTR) ? 0 : -1;
+    }
+    if (count == 0) {
+        return -1;
+    }
+    in_size_ += count;
+    return count;
+}
+
+std::vector<UsbPort> list_usb_ports() {
+    std::vector<UsbPort> ports;
+    DIR* dir = opendir("/sys/class/tty");
+    if (dir == NULL) {
+        return ports;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        std::string device = std::string("/sys/class/tty/") + entry->d_name + "/device";
+        char real[PATH_MAX];
+        if (realpath(device.c_str(), real) == NULL) {
+            continue;
+        }
+        // The port belongs to an interface of the USB device, which is one of
+        // its ancestors and the first one with a serial number.
+        std::string path = real;
+        while (path.size() > sizeof("/sys/devices")) {
+            std::ifstream file(path + "/serial");
+            std::string serial_number;
+            if (std::getline(file, serial_number)) {
+                ports.push_back(UsbPort{std::string("/dev/") + entry->d_name, serial_number});
+                break;
+            }
+            path.erase(path.rfind('/'));
+        }
+    }
+    closedir(dir);
+    return ports;
+}
+
+std::string find_port(const std::string& serial_number) {
+    for (const UsbPort& port : list_usb_ports()) {
+        if (port.serial_number == serial_number) {
+            return port.port;
+        }
+    }
+    return "";
+}
+
+} // namespace client
+} // namespace controllino
@@ -0,0 +1,113 @@
+// A serial port in raw, non-blocking mode which frames what it receives into
+// lines. It never blocks: writes are queued and `flush` passes on what the
+// port takes, so the descriptor can be watched with poll or epoll.
+#ifndef CONTROLLINO_CLIENT_SERIAL_PORT_H
+#define CONTROLLINO_CLIENT_SERIAL_PORT_H
+
+#include <stddef.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+// Lines are expected to fit into this, like the messages of the firmware;
+// longer ones are passed on in pieces.
+#define MAX_LINE_LENGTH 4096
+
+namespace controllino {
+namespace client {
+
+class SerialPort {
+public:
+    SerialPort();
+    ~SerialPort();
+    SerialPort(const SerialPort&) = delete;
+    SerialPort& operator=(const SerialPort&) = delete;
+
+    // Returns false and leaves the port closed if it can't be opened at
+    // `baud` (8N1); `errno` tells why.
+    bool open(const std::string& path, unsigned long baud);
+    void close();
+    bool is_open() const {
+        return fd_ >= 0;
+    }
+    int fd() const {
+        return fd_;
+    }
+
+    void write(const char* data, size_t size);
+    // Writes as much of the queue as the port takes. Returns false if the
+    // port failed, e.g. because the board was unplugged.
+    bool flush();
+    bool wants_write() const {
+        return written_ < out_.size();
+    }
+
+    // Reads what's available and calls `on_line` for every complete line,
+    // without its line ending. The line is only valid during the call, but
+    // may be changed in place. Returns false if the port was closed at the
+    // other end or failed.
+    template<typename F>
+    bool read_lines(F on_line);
+
+private:
+    // Reads into the buffer; returns the number of bytes, 0 if there was
+    // nothing to read or -1 on failure or end of file.
+    long fill();
+
+    int fd_;
+    std::string out_;
+    size_t written_;
+    std::vector<char> in_;
+    size_t in_size_;
+};
+
+struct UsbPort {
+    std::string port; // e.g. `/dev/ttyACM0`
+    std::string serial_number;
+};
+
+// The serial ports of the USB devices which are plugged in, found like
+// `freeze_device` does.
+std::vector<UsbPort> list_usb_ports();
+// The port of the USB device with `serial_number`, or an empty string.
+std::string find_port(const std::string& serial_number);
+
+template<typename F>
+bool SerialPort::read_lines(F on_line) {
+    for (;;) {
+        size_t old_size = in_size_;
+        long count = fill();
+        if (count < 0) {
+            return false;
+        }
+        if (count == 0) {
+            return true;
+        }
+        size_t begin = 0;
+        for (size_t i = old_size; i < in_size_; ++i) {
+            if (in_[i] != '\n') {
+                continue;
+            }
+            size_t end = i;
+            if (end > begin and in_[end - 1] == '\r') {
+                end--;
+            }
+            on_line(&in_[begin], end - begin);
+            begin = i + 1;
+        }
+        if (begin == 0 and in_size_ == in_.size()) {
+            on_line(&in_[0], in_size_);
+            begin = in_size_;
+        }
+        in_size_ -= begin;
+        if (in_size_ > 0 and begin > 0) {
+            memmove(&in_[0], &in_[begin], in_size_);
+        }
+    }
+}
+
+} // namespace client
+} // namespace controllino
+
+#endif /* CONTROLLINO_CLIENT_SERIAL_PORT_H */
@@ -0,0 +1,832 @@
+// Shares boards between local clients. One process multiplexes the serial
+// ports of any number of boards with epoll and serves them on a Unix socket,
+// so that several clients can use a board at once.
+//
+// Usage: aggregator [--socket PATH] [--baud BAUD] [--board BOARD]...
+//
+// --socket Listen at PATH (default /tmp/controllino.sock).
+// --baud   Baudrate of the boards (default 19200).
+// --board  A board, named by the USB serial number of the Arduino, whose port
+//          is looked up like `freeze_device` does, or NAME=PORT. Without
+//          boards, CONTROLLINO_USB_SERIAL_NUMBER names one.
+//
+// Clients send the requests of the firmware, one per line, with a `board`
+// key naming the board. Each client has jobs of its own: requests are sent to
+// the board with jobs of the aggregator, and the replies are passed back with
+// the job of the request and the `board`. The targets of `CANCEL_JOB` are
+// translated likewise.
+//
+// The firmware logs a pin for one job at a time, so `LOG_SIGNAL` subscribes
+// to the pin: the first client starts the logging job and every client that
+// logs the pin with the same period gets its samples. `END_LOG_SIGNAL` ends
+// the subscription; the next sample is the last one of the client. The
+// logging job is ended once the last client ended its subscription or
+// disconnected.
+//
+// `{"command": "LIST_BOARDS", "job": 1}` lists the boards, their ports and
+// whether they are ready. Lines which don't belong to a request, like
+// `READY`, are passed to every client.
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Client.h"
+
+using namespace controllino::client;
+
+// Clients which don't read their replies are disconnected once this much
+// waits for them.
+static const size_t MAX_CLIENT_OUTPUT = 4 << 20;
+// Boards which aren't ready are checked this often; the ports of missing
+// boards are looked up every tenth time.
+static const int TICK_MS = 100;
+static const int TICKS_PER_LOOKUP = 10;
+
+typedef struct {
+    const char* socket;
+    unsigned long baud;
+    std::vector<std::string> boards;
+} options_t;
+
+static options_t options = {"/tmp/controllino.sock", 19200, {}};
+static volatile sig_atomic_t stop = 0;
+
+// What an epoll event is for: the upper byte of its data is the source and
+// the rest the board or client.
+enum source_t : uint64_t {
+    SOURCE_LISTENER,
+    SOURCE_BOARD,
+    SOURCE_CLIENT,
+};
+
+static uint64_t event_data(source_t source, uint64_t id) {
+    return ((uint64_t) source << 56) | id;
+}
+
+// A subscriber of a logging job.
+typedef struct {
+    uint64_t client;
+    int64_t job;
+    bool leaving; // Gets one more sample, marked as its last one.
+} subscriber_t;
+
+// A logging job on the board, shared by the clients logging its pin.
+typedef struct {
+    std::string pin;    // As JSON
+    std::string period; // As JSON
+    std::vector<subscriber_t> subscribers;
+    bool closing; // `END_LOG_SIGNAL` was sent to the board.
+} stream_t;
+
+typedef struct {
+    std::string name;
+    std::string quoted_name;   // As JSON
+    std::string serial_number; // Empty for boards given by port.
+    std::unique_ptr<Client> client;
+    int fd;                    // The descriptor registered with epoll.
+    uint32_t events;
+    bool dirty;                // Requests were queued since the last `process`.
+    std::map<std::string, stream_t> streams; // By pin
+} board_t;
+
+typedef struct {
+    int fd;
+    std::string in;
+    std::string out;
+    size_t written;
+    bool wants_write; // Registered for EPOLLOUT
+    bool dirty;       // Has output to flush.
+    bool closing;
+    // Jobs of the client which aren't completed: (board, job) -> job on the
+    // board.
+    std::map<std::pair<size_t, int64_t>, uint32_t> jobs;
+} client_t;
+
+static int epoll = -1;
+static int listener = -1;
+static std::vector<board_t> boards;
+static std::unordered_map<std::string, size_t> board_index;
+static std::unordered_map<uint64_t, client_t> clients;
+static uint64_t next_client = 1;
+static std::vector<uint64_t> dirty_clients;
+static std::vector<uint64_t> closing_clients;
+static unsigned long slow_clients = 0;
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void append_quoted(std::string& out, const std::string& text) {
+    out += '"';
+    for (char c : text) {
+        if (c == '"' or c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+// The JSON of a value, e.g. to pass it on in a request.
+static std::string json(const Value& value) {
+    if (value.type() == Value::TYPE_STRING) {
+        return '"' + value.text().str() + '"';
+    }
+    return value.text().str();
+}
+
+static client_t* find_client(uint64_t id) {
+    auto it = clients.find(id);
+    if (it == clients.end() or it->second.closing) {
+        return NULL;
+    }
+    return &it->second;
+}
+
+static void close_client_later(uint64_t id, client_t& client) {
+    if (not client.closing) {
+        client.closing = true;
+        closing_clients.push_back(id);
+    }
+}
+
+// Called after appending to the output of `client`.
+static void queued_output(uint64_t id, client_t& client) {
+    if (client.out.size() - client.written > MAX_CLIENT_OUTPUT) {
+        slow_clients++;
+        close_client_later(id, client);
+        return;
+    }
+    if (not client.dirty) {
+        client.dirty = true;
+        dirty_clients.push_back(id);
+    }
+}
+
+// A part of a line to replace.
+typedef struct {
+    Span span;
+    std::string text;
+} edit_t;
+
+// Appends the line of `reply` with `edits` and the name of the board.
+static void append_reply(std::string& out,
+                         const Reply& reply,
+                         edit_t* edits,
+                         size_t count,
+                         const board_t& board) {
+    std::sort(edits, edits + count, [](const edit_t& a, const edit_t& b) {
+        return a.span.data < b.span.data;
+    });
+    Span line = reply.line();
+    const char* p = line.data;
+    const char* brace = line.data + line.size;
+    while (brace > p and *(brace - 1) != '}') {
+        brace--;
+    }
+    brace--;
+    for (size_t i = 0; i < count; ++i) {
+        out.append(p, edits[i].span.data - p);
+        out += edits[i].text;
+        p = edits[i].span.data + edits[i].span.size;
+    }
+    out.append(p, brace - p);
+    out += ",\"board\":";
+    out += board.quoted_name;
+    out.append(brace, line.data + line.size - brace);
+    out += '\n';
+}
+
+// Replies to a request of `client` without the board, like the firmware
+// does. `board` and `job` are left out if they aren't known.
+static void reply_error(uint64_t id,
+                        client_t& client,
+                        const std::string& command,
+                        int64_t job,
+                        const board_t* board,
+                        const char* error,
+                        const std::string& msg) {
+    std::string& out = client.out;
+    out += "{\"command\":\"ERR_";
+    out += command;
+    out += '"';
+    if (job >= 0) {
+        out += ",\"job\":" + std::to_string(job);
+    }
+    out += ",\"error\":\"";
+    out += error;
+    out += "\",\"msg\":";
+    append_quoted(out, msg);
+    if (board != NULL) {
+        out += ",\"board\":" + board->quoted_name;
+    }
+    out += "}\n";
+    queued_output(id, client);
+}
+
+// Passes a reply on to the client which sent the request. The target of
+// `CANCEL_JOB` is given as `target`.
+static void on_reply(size_t index,
+                     uint64_t id,
+                     int64_t job,
+                     int64_t target,
+                     const Reply& reply) {
+    client_t* client = find_client(id);
+    if (client == NULL) {
+        return;
+    }
+    if (reply.completes()) {
+        client->jobs.erase(std::make_pair(index, job));
+    }
+    edit_t edits[2];
+    size_t count = 0;
+    Value value = reply.get("job");
+    if (value.type() == Value::TYPE_NUMBER) {
+        edits[count++] = edit_t{value.text(), std::to_string(job)};
+    } else {
+        // An error the board sent without the job, which the client matched to
+        // the request; the job follows the command.
+        Span command = reply.command();
+        edits[count++] = edit_t{Span{command.data + command.size + 1, 0},
+                                ",\"job\":" + std::to_string(job)};
+    }
+    value = reply.get("target");
+    if (target >= 0 and value.type() == Value::TYPE_NUMBER) {
+        edits[count++] = edit_t{value.text(), std::to_string(target)};
+    }
+    append_reply(client->out, reply, edits, count, boards[index]);
+    queued_output(id, *client);
+}
+
+// Sends `request` for the job `job` of a client.
+static void forward(size_t index, uint64_t id, int64_t job, const Request& request,
+                    int64_t target = -1) {
+    board_t& board = boards[index];
+    auto callback = [index, id, job, target](const Reply& reply) {
+        on_reply(index, id, job, target, reply);
+    };
+    uint32_t board_job = board.client->send(request, callback);
+    clients[id].jobs[std::make_pair(index, job)] = board_job;
+    board.dirty = true;
+}
+
+static void end_stream(size_t index, stream_t& stream) {
+    Request request("END_LOG_SIGNAL");
+    request.set_raw("pin", stream.pin);
+    boards[index].client->send(request, reply_callback_t());
+    boards[index].dirty = true;
+    stream.closing = true;
+}
+
+// Passes a sample, or the error, of a logging job on to its subscribers.
+static void on_sample(size_t index, const std::string& pin, const Reply& reply) {
+    board_t& board = boards[index];
+    auto it = board.streams.find(pin);
+    if (it == board.streams.end()) {
+        return;
+    }
+    stream_t& stream = it->second;
+    bool last = reply.completes();
+    Value job = reply.get("job");
+    Value done = reply.get("done");
+
+    size_t kept = 0;
+    for (size_t i = 0; i < stream.subscribers.size(); ++i) {
+        subscriber_t& subscriber = stream.subscribers[i];
+        client_t* client = find_client(subscriber.client);
+        if (client == NULL) {
+            continue;
+        }
+        edit_t edits[2];
+        size_t count = 0;
+        edits[count++] = edit_t{job.text(), std::to_string(subscriber.job)};
+        if (subscriber.leaving and done.type() == Value::TYPE_BOOL) {
+            edits[count++] = edit_t{done.text(), "true"};
+        }
+        append_reply(client->out, reply, edits, count, board);
+        queued_output(subscriber.client, *client);
+        if (last or subscriber.leaving) {
+            client->jobs.erase(std::make_pair(index, subscriber.job));
+            continue;
+        }
+        stream.subscribers[kept++] = subscriber;
+    }
+    stream.subscribers.resize(kept);
+
+    if (last) {
+        board.streams.erase(it);
+    } else if (stream.subscribers.empty() and not stream.closing) {
+        end_stream(index, stream);
+    }
+}
+
+static void subscribe(size_t index, uint64_t id, client_t& client, int64_t job,
+                      const Reply& request, const Request& forwarded) {
+    board_t& board = boards[index];
+    std::string pin = json(request.get("pin"));
+    std::string period = json(request.get("period"));
+    auto it = board.streams.find(pin);
+    if (it != board.streams.end()) {
+        stream_t& stream = it->second;
+        if (stream.closing) {
+            reply_error(id, client, "LOG_SIGNAL", job, &board, "BUSY",
+                        "The logging job of the pin is ending");
+            return;
+        }
+        if (stream.period != period) {
+            reply_error(id, client, "LOG_SIGNAL", job, &board, "PERIOD_MISMATCH",
+                        "The pin is logged with period " + stream.period);
+            return;
+        }
+        stream.subscribers.push_back(subscriber_t{id, job, false});
+        client.jobs[std::make_pair(index, job)] = 0;
+        return;
+    }
+
+    stream_t& stream = board.streams[pin];
+    stream = stream_t{pin, period, {subscriber_t{id, job, false}}, false};
+    board.client->send(forwarded, [index, pin](const Reply& reply) {
+        on_sample(index, pin, reply);
+    });
+    client.jobs[std::make_pair(index, job)] = 0;
+    board.dirty = true;
+}
+
+// Ends the subscription of `client` to the pin of `request`. Returns false if
+// nobody logs the pin, so the board answers.
+static bool unsubscribe(size_t index, uint64_t id, client_t& client, int64_t job,
+                        const Reply& request, const Request& forwarded) {
+    board_t& board = boards[index];
+    auto it = board.streams.find(json(request.get("pin")));
+    if (it == board.streams.end()) {
+        return false;
+    }
+    stream_t& stream = it->second;
+    subscriber_t* own = NULL;
+    size_t staying = 0;
+    for (subscriber_t& subscriber : stream.subscribers) {
+        if (subscriber.leaving) {
+            continue;
+        }
+        staying++;
+        if (subscriber.client == id) {
+            own = &subscriber;
+        }
+    }
+    if (own == NULL) {
+        reply_error(id, client, "END_LOG_SIGNAL", job, &board, "NOT_SUBSCRIBED",
+                    "Another client logs the pin");
+        return true;
+    }
+    if (staying == 1) {
+        stream.closing = true;
+        forward(index, id, job, forwarded);
+        return true;
+    }
+    own->leaving = true;
+    client.out += "{\"command\":\"RX_END_LOG_SIGNAL\",\"job\":" + std::to_string(job) +
+                  ",\"board\":" + board.quoted_name + "}\n";
+    queued_output(id, client);
+    return true;
+}
+
+static void list_boards(uint64_t id, client_t& client, int64_t job) {
+    std::string& out = client.out;
+    out += "{\"command\":\"RX_LIST_BOARDS\",\"job\":" + std::to_string(job) + ",\"boards\":[";
+    for (size_t i = 0; i < boards.size(); ++i) {
+        const board_t& board = boards[i];
+        out += i > 0 ? ",{\"name\":" : "{\"name\":";
+        out += board.quoted_name;
+        out += ",\"port\":";
+        append_quoted(out, board.client->path());
+        out += board.client->ready() ? ",\"ready\":true}" : ",\"ready\":false}";
+    }
+    out += "]}\n";
+    queued_output(id, client);
+}
+
+static void handle_request(uint64_t id, client_t& client, const char* line, size_t size) {
+    Reply request;
+    if (not request.parse(line, size)) {
+        reply_error(id, client, "ERROR", -1, NULL, "DESERIALIZE_JSON_FAILED",
+                    "Requests are JSON objects with a command");
+        return;
+    }
+    std::string command = request.command().str();
+    int64_t job = request.job();
+    if (job < 0) {
+        reply_error(id, client, "ERROR", -1, NULL, "NO_JOB_ID",
+                    "Requests need a non-negative job");
+        return;
+    }
+    if (command == "LIST_BOARDS") {
+        list_boards(id, client, job);
+        return;
+    }
+    Value name = request.get("board");
+    auto found = board_index.find(name.type() == Value::TYPE_STRING ? name.str() : "");
+    if (found == board_index.end()) {
+        reply_error(id, client, command, job, NULL, "UNKNOWN_BOARD",
+                    "No board is named " + json(name));
+        return;
+    }
+    size_t index = found->second;
+    board_t& board = boards[index];
+    if (client.jobs.count(std::make_pair(index, job)) > 0) {
+        reply_error(id, client, command, job, &board, "DUPLICATE_JOB",
+                    "An earlier request of the job isn't completed");
+        return;
+    }
+
+    Request forwarded(command.c_str());
+    for (size_t i = 0; i < request.size(); ++i) {
+        Span key = request.key(i);
+        if (key.equals("command") or key.equals("job") or key.equals("board") or
+            (key.equals("target") and command == "CANCEL_JOB")) {
+            continue;
+        }
+        forwarded.set_raw(key.str().c_str(), json(request.value(i)));
+    }
+
+    if (command == "LOG_SIGNAL") {
+        subscribe(index, id, client, job, request, forwarded);
+    } else if (command == "END_LOG_SIGNAL") {
+        if (not unsubscribe(index, id, client, job, request, forwarded)) {
+            forward(index, id, job, forwarded);
+        }
+    } else if (command == "CANCEL_JOB") {
+        int64_t target = request.get("target").as_int(-1);
+        auto it = client.jobs.find(std::make_pair(index, target));
+        if (it == client.jobs.end() or it->second == 0) {
+            reply_error(id, client, command, job, &board, "JOB_NOT_FOUND",
+                        "No pending job " + std::to_string(target));
+            return;
+        }
+        forwarded.set_raw("target", std::to_string(it->second));
+        forward(index, id, job, forwarded, target);
+    } else {
+        forward(index, id, job, forwarded);
+    }
+}
+
+// Passes a line which doesn't belong to a request on to every client. Errors
+// without a job are about a request of a single client, so they are dropped.
+static void broadcast(size_t index, const Reply& reply) {
+    if (reply.kind() == Reply::KIND_ERROR and reply.job() < 0) {
+        return;
+    }
+    for (auto& entry : clients) {
+        if (not entry.second.closing) {
+            append_reply(entry.second.out, reply, NULL, 0, boards[index]);
+            queued_output(entry.first, entry.second);
+        }
+    }
+}
+
+static void close_client(uint64_t id) {
+    auto found = clients.find(id);
+    if (found == clients.end()) {
+        return;
+    }
+    close(found->second.fd); // Which removes it from epoll.
+    clients.erase(found);
+
+    for (size_t index = 0; index < boards.size(); ++index) {
+        for (auto& entry : boards[index].streams) {
+            stream_t& stream = entry.second;
+            auto& subscribers = stream.subscribers;
+            size_t count = subscribers.size();
+            subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+                                             [id](const subscriber_t& subscriber) {
+                                                 return subscriber.client == id;
+                                             }),
+                              subscribers.end());
+            if (subscribers.size() < count and subscribers.empty() and not stream.closing) {
+                end_stream(index, stream);
+            }
+        }
+    }
+}
+
+static void flush_client(uint64_t id) {
+    client_t* client = find_client(id);
+    if (client == NULL) {
+        return;
+    }
+    client->dirty = false;
+    while (client->written < client->out.size()) {
+        ssize_t size = send(client->fd, client->out.data() + client->written,
+                            client->out.size() - client->written, MSG_NOSIGNAL);
+        if (size < 0) {
+            if (errno != EAGAIN and errno != EINTR) {
+                close_client_later(id, *client);
+                return;
+            }
+            break;
+        }
+        client->written += (size_t) size;
+    }
+    if (client->written == client->out.size()) {
+        client->out.clear();
+        client->written = 0;
+    } else if (client->written > client->out.size() / 2) {
+        client->out.erase(0, client->written);
+        client->written = 0;
+    }
+    bool wants_write = not client->out.empty();
+    if (wants_write != client->wants_write) {
+        struct epoll_event event;
+        event.events = EPOLLIN | (wants_write ? EPOLLOUT : 0);
+        event.data.u64 = event_data(SOURCE_CLIENT, id);
+        epoll_ctl(epoll, EPOLL_CTL_MOD, client->fd, &event);
+        client->wants_write = wants_write;
+    }
+}
+
+static void read_client(uint64_t id) {
+    client_t* client = find_client(id);
+    if (client == NULL) {
+        return;
+    }
+    char buffer[4096];
+    bool closed = false;
+    for (;;) {
+        ssize_t size = read(client->fd, buffer, sizeof(buffer));
+        if (size == 0 or (size < 0 and errno != EAGAIN and errno != EINTR)) {
+            closed = true;
+            break;
+        }
+        if (size < 0) {
+            break;
+        }
+        client->in.append(buffer, (size_t) size);
+    }
+
+    size_t begin = 0;
+    for (size_t end; (end = client->in.find('\n', begin)) != std::string::npos;) {
+        handle_request(id, *client, &client->in[begin], end - begin);
+        begin = end + 1;
+    }
+    client->in.erase(0, begin);
+    if (client->in.size() > MAX_LINE_LENGTH) {
+        reply_error(id, *client, "ERROR", -1, NULL, "MESSAGE_TOO_LONG",
+                    "Requests have at most " + std::to_string(MAX_LINE_LENGTH) +
+                        " characters");
+        client->in.clear();
+    }
+    if (closed) {
+        close_client_later(id, *client);
+    }
+}
+
+static void accept_clients(void) {
+    for (;;) {
+        int fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        uint64_t id = next_client++;
+        clients[id] = client_t{fd, "", "", 0, false, false, false, {}};
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = event_data(SOURCE_CLIENT, id);
+        epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+// Registers the port of a board with epoll once it changed. Closed ports
+// leave epoll by themselves.
+static void update_board(size_t index) {
+    board_t& board = boards[index];
+    board.dirty = false;
+    int fd = board.client->fd();
+    if (fd < 0) {
+        board.fd = -1;
+        return;
+    }
+    uint32_t events = EPOLLIN | (board.client->wants_write() ? EPOLLOUT : 0);
+    if (fd == board.fd and events == board.events) {
+        return;
+    }
+    struct epoll_event event;
+    event.events = events;
+    event.data.u64 = event_data(SOURCE_BOARD, index);
+    if (fd != board.fd or epoll_ctl(epoll, EPOLL_CTL_MOD, fd, &event) < 0) {
+        epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+    }
+    board.fd = fd;
+    board.events = events;
+}
+
+// Reconnects boards and lets boards which don't send `READY` time out.
+static void tick(bool lookup) {
+    std::vector<UsbPort> ports;
+    if (lookup) {
+        ports = list_usb_ports();
+    }
+    for (size_t index = 0; index < boards.size(); ++index) {
+        board_t& board = boards[index];
+        if (board.client->ready()) {
+            continue;
+        }
+        if (not board.client->connected()) {
+            for (const UsbPort& port : ports) {
+                if (port.serial_number == board.serial_number) {
+                    board.client->set_path(port.port);
+                }
+            }
+            if (board.client->path().empty()) {
+                continue;
+            }
+            board.client->poll(0);
+        } else {
+            board.client->process();
+        }
+        update_board(index);
+    }
+}
+
+static int add_board(const std::string& spec) {
+    size_t separator = spec.find('=');
+    size_t index = boards.size();
+    boards.push_back(board_t());
+    board_t& board = boards.back();
+    if (separator == std::string::npos) {
+        board.name = spec;
+        board.serial_number = spec;
+        board.client.reset(new Client(find_port(spec), options.baud));
+    } else {
+        board.name = spec.substr(0, separator);
+        board.client.reset(new Client(spec.substr(separator + 1), options.baud));
+    }
+    if (board.name.empty() or board_index.count(board.name) > 0) {
+        fprintf(stderr, "invalid or repeated board: %s\n", spec.c_str());
+        return 1;
+    }
+    append_quoted(board.quoted_name, board.name);
+    board.fd = -1;
+    board.events = 0;
+    board.dirty = false;
+    board_index[board.name] = index;
+
+    // A new port may have the number of the one it replaces.
+    board.client->on_connect([index]() { boards[index].fd = -1; });
+    board.client->on_unsolicited([index](const Reply& reply) { broadcast(index, reply); });
+    board.client->set_reconnect_interval(TICK_MS * TICKS_PER_LOOKUP);
+    if (not board.client->path().empty()) {
+        board.client->connect();
+    }
+    update_board(index);
+    return 0;
+}
+
+static int open_socket(void) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(options.socket) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", options.socket);
+        return 1;
+    }
+    strcpy(address.sun_path, options.socket);
+    unlink(options.socket);
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0 or bind(listener, (struct sockaddr*) &address, sizeof(address)) < 0 or
+        listen(listener, SOMAXCONN) < 0) {
+        perror(options.socket);
+        return 1;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = event_data(SOURCE_LISTENER, 0);
+    epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+    return 0;
+}
+
+static int parse_options(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        bool has_value = i + 1 < argc;
+        if (option == "--socket" and has_value) {
+            options.socket = argv[++i];
+        } else if (option == "--baud" and has_value) {
+            options.baud = strtoul(argv[++i], NULL, 10);
+        } else if (option == "--board" and has_value) {
+            options.boards.push_back(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--socket PATH] [--baud BAUD] [--board BOARD]...\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    const char* serial_number = getenv("CONTROLLINO_USB_SERIAL_NUMBER");
+    if (options.boards.empty() and serial_number != NULL) {
+        options.boards.push_back(serial_number);
+    }
+    if (options.boards.empty()) {
+        fprintf(stderr, "%s: no boards given\n", argv[0]);
+        return 1;
+    }
+    return 0;
+}
+
+static void handle_signal(int) {
+    stop = 1;
+}
+
+int main(int argc, char** argv) {
+    if (parse_options(argc, argv) != 0) {
+        return 1;
+    }
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll < 0 or open_socket() != 0) {
+        return 1;
+    }
+    // Boards are found by index, so they must not move.
+    boards.reserve(options.boards.size());
+    for (const std::string& spec : options.boards) {
+        if (add_board(spec) != 0) {
+            return 1;
+        }
+    }
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    printf("%s\n", options.socket);
+    fflush(stdout);
+
+    std::vector<struct epoll_event> events(64 + boards.size());
+    uint64_t next_tick = now_ms() + TICK_MS;
+    unsigned int ticks = 0;
+    while (not stop) {
+        uint64_t now = now_ms();
+        int timeout = next_tick > now ? (int) (next_tick - now) : 0;
+        int count = epoll_wait(epoll, events.data(), (int) events.size(), timeout);
+        for (int i = 0; i < count; ++i) {
+            uint64_t data = events[i].data.u64;
+            uint64_t id = data & ((1ull << 56) - 1);
+            switch ((source_t) (data >> 56)) {
+                case SOURCE_LISTENER:
+                    accept_clients();
+                    break;
+                case SOURCE_BOARD:
+                    // Requests queued by the replies are sent right away.
+                    boards[id].client->process();
+                    update_board(id);
+                    break;
+                case SOURCE_CLIENT:
+                    if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                        read_client(id);
+                    }
+                    if (events[i].events & EPOLLOUT) {
+                        flush_client(id);
+                    }
+                    break;
+            }
+        }
+
+        while (not closing_clients.empty()) {
+            uint64_t id = closing_clients.back();
+            closing_clients.pop_back();
+            close_client(id);
+        }
+        for (size_t index = 0; index < boards.size(); ++index) {
+            if (boards[index].dirty) {
+                // Sends what was queued; replies may queue more.
+                boards[index].client->process();
+                update_board(index);
+            }
+        }
+        std::vector<uint64_t> flushing;
+        flushing.swap(dirty_clients);
+        for (uint64_t id : flushing) {
+            flush_client(id);
+        }
+
+        if (now_ms() >= next_tick) {
+            tick(ticks++ % TICKS_PER_LOOKUP == 0);
+            next_tick = now_ms() + TICK_MS;
+        }
+    }
+
+    unlink(options.socket);
+    if (slow_clients > 0) {
+        fprintf(stderr, "%lu clients were disconnected for not reading\n", slow_clients);
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+// Records the samples of logging jobs into a sample store (client/SampleStore.h).
+//
+// Usage: recorder STORE [INPUT]...
+//
+// Reads the lines of the protocol, or captures, from the INPUT files or from
+// standard input and appends the samples to STORE, which is created if it
+// doesn't exist; see client/Recorder.h for how jobs are named. The store is
+// flushed every few seconds while reading, so that readers see the samples,
+// and closed on SIGINT or SIGTERM.
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Recorder.h"
+
+using namespace controllino::client;
+
+static const int FLUSH_SECONDS = 5;
+
+static volatile sig_atomic_t stop = 0;
+
+static void handle_signal(int) {
+    stop = 1;
+}
+
+// Returns false if `file` couldn't be read.
+static bool record(FILE* file, Recorder& recorder, SampleWriter& writer) {
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t size;
+    time_t next_flush = time(NULL) + FLUSH_SECONDS;
+    while (not stop and (size = getline(&line, &capacity, file)) >= 0) {
+        while (size > 0 and (line[size - 1] == '\n' or line[size - 1] == '\r')) {
+            size--;
+        }
+        recorder.ingest(line, (size_t) size);
+        if (time(NULL) >= next_flush) {
+            writer.flush();
+            next_flush = time(NULL) + FLUSH_SECONDS;
+        }
+    }
+    free(line);
+    return stop or not ferror(file);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 or argv[1][0] == '-') {
+        fprintf(stderr, "usage: %s STORE [INPUT]...\n", argv[0]);
+        return 1;
+    }
+    SampleWriter writer;
+    if (not writer.open(argv[1])) {
+        fprintf(stderr, "%s: %s\n", argv[0], writer.error().c_str());
+        return 1;
+    }
+    // Without SA_RESTART, a signal interrupts reading.
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    Recorder recorder(writer);
+    int status = 0;
+    if (argc == 2 and not record(stdin, recorder, writer)) {
+        perror("stdin");
+        status = 1;
+    }
+    for (int i = 2; i < argc and not stop; ++i) {
+        FILE* file = fopen(argv[i], "r");
+        if (file == NULL or not record(file, recorder, writer)) {
+            perror(argv[i]);
+            status = 1;
+        }
+        if (file != NULL) {
+            fclose(file);
+        }
+    }
+    if (not writer.close()) {
+        fprintf(stderr, "%s: %s\n", argv[0], writer.error().c_str());
+        return 1;
+    }
+    fprintf(stderr, "%llu samples recorded, %llu dropped\n",
+            (unsigned long long) recorder.samples(), (unsigned long long) recorder.dropped());
+    return status;
+}
@@ -0,0 +1,559 @@
+#include "Arduino.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "Sim.h"
+
+void setup();
+void loop();
+void serialEvent();
+
+UARTClass Serial;
+
+Pio sim_pio[4];
+Adc sim_adc;
+
+const PinDescription g_APinDescription[SIM_NUM_PINS] = {
+    {NULL, 0, NO_ADC}, // Only D30 to D49 and A0 to A11 are simulated.
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {PIOD, 1u << 9, NO_ADC}, // 30
+    {PIOA, 1u << 7, NO_ADC}, // 31
+    {PIOD, 1u << 10, NO_ADC}, // 32
+    {PIOC, 1u << 1, NO_ADC}, // 33
+    {PIOC, 1u << 2, NO_ADC}, // 34
+    {PIOC, 1u << 3, NO_ADC}, // 35
+    {PIOC, 1u << 4, NO_ADC}, // 36
+    {PIOC, 1u << 5, NO_ADC}, // 37
+    {PIOC, 1u << 6, NO_ADC}, // 38
+    {PIOC, 1u << 7, NO_ADC}, // 39
+    {PIOC, 1u << 8, NO_ADC}, // 40
+    {PIOC, 1u << 9, NO_ADC}, // 41
+    {PIOA, 1u << 19, NO_ADC}, // 42
+    {PIOA, 1u << 20, NO_ADC}, // 43
+    {PIOC, 1u << 19, NO_ADC}, // 44
+    {PIOC, 1u << 18, NO_ADC}, // 45
+    {PIOC, 1u << 17, NO_ADC}, // 46
+    {PIOC, 1u << 16, NO_ADC}, // 47
+    {PIOC, 1u << 15, NO_ADC}, // 48
+    {PIOC, 1u << 14, NO_ADC}, // 49
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, 7}, // A0
+    {NULL, 0, 6}, // A1
+    {NULL, 0, 5}, // A2
+    {NULL, 0, 4}, // A3
+    {NULL, 0, 3}, // A4
+    {NULL, 0, 2}, // A5
+    {NULL, 0, 1}, // A6
+    {NULL, 0, 0}, // A7
+    {NULL, 0, 10}, // A8
+    {NULL, 0, 11}, // A9
+    {NULL, 0, 12}, // A10
+    {NULL, 0, 13}, // A11
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+    {NULL, 0, NO_ADC},
+};
+
+static DWT_Type dwt_;
+static CoreDebug_Type core_debug_;
+DWT_Type* const DWT = &dwt_;
+CoreDebug_Type* const CoreDebug = &core_debug_;
+
+namespace sim {
+
+struct Pin {
+    uint32_t mode;
+    int level;
+    int analog; // 12-bit ADC reading, or the last value written
+    int noise;
+    voidFuncPtr handler;
+    uint32_t edge;
+    bool pending;
+};
+
+static Pin pins_[SIM_NUM_PINS];
+static uint64_t now_ = 0;
+static uint32_t primask_ = 0;
+static bool hold_ = false;
+static std::string rx_;
+static size_t rx_read_ = 0; // Bytes of `rx_` the firmware has read.
+static std::vector<std::string> tx_;
+static int read_resolution_ = 10;
+static uint32_t noise_state_ = 1;
+static unsigned long string_allocations_ = 0;
+static size_t string_heap_ = 0;
+static size_t string_heap_high_water_ = 0;
+static int write_resolution_ = 8;
+static void (*print_)(const std::string& line) = NULL;
+
+struct Wire {
+    uint8_t a;
+    uint8_t b;
+    int noise;
+};
+
+static std::vector<Wire> wires_;
+
+void advance_timers(uint64_t until); // Timer.cpp
+void reset_timers();                 // Timer.cpp
+
+void set_time(uint64_t us) {
+    now_ = us;
+    if (DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) {
+        DWT->CYCCNT = (uint32_t) (us * (VARIANT_MCK / 1000000));
+    }
+}
+
+static void set_level(uint8_t pin, int level) {
+    pins_[pin].level = level;
+    const PinDescription& description = g_APinDescription[pin];
+    if (description.pPort == NULL) {
+        return;
+    }
+    if (level) {
+        description.pPort->PIO_PDSR |= description.ulPin;
+    } else {
+        description.pPort->PIO_PDSR &= ~description.ulPin;
+    }
+}
+
+// A conversion of `pin` with its noise added, clamped to 12 bits.
+static uint32_t convert(uint8_t pin) {
+    const Pin& p = pins_[pin];
+    int value = p.analog;
+    if (p.noise > 0) {
+        noise_state_ = noise_state_ * 1103515245u + 12345u;
+        value += (int) ((noise_state_ >> 16) % (2 * p.noise + 1)) - p.noise;
+    }
+    return value < 0 ? 0 : (value > 4095 ? 4095 : value);
+}
+
+static bool fires(const Pin& p, int level) {
+    return p.edge == CHANGE or (p.edge == RISING and level == HIGH) or
+           (p.edge == FALLING and level == LOW);
+}
+
+static void fire_pending() {
+    for (uint8_t i = 0; i < SIM_NUM_PINS; ++i) {
+        if (pins_[i].pending and pins_[i].handler != NULL) {
+            pins_[i].pending = false;
+            pins_[i].handler();
+        }
+    }
+}
+
+void boot() {
+    for (uint8_t i = 0; i < SIM_NUM_PINS; ++i) {
+        pins_[i] = Pin();
+    }
+    now_ = 0;
+    primask_ = 0;
+    hold_ = false;
+    rx_.clear();
+    rx_read_ = 0;
+    tx_.clear();
+    for (int i = 0; i < 4; ++i) {
+        sim_pio[i] = Pio();
+    }
+    sim_adc = Adc();
+    read_resolution_ = 10;
+    write_resolution_ = 8;
+    noise_state_ = 1;
+    *DWT = DWT_Type();
+    *CoreDebug = CoreDebug_Type();
+    reset_timers();
+    setup();
+}
+
+void advance(uint64_t us) {
+    advance_timers(now_ + us);
+    set_time(now_ + us);
+}
+
+void run(uint64_t us, uint64_t step) {
+    for (uint64_t t = 0; t < us; t += step) {
+        advance(step);
+        loop();
+        if (Serial.available()) {
+            serialEvent();
+        }
+    }
+}
+
+uint64_t now() {
+    return now_;
+}
+
+void set_digital(uint8_t pin, int level) {
+    Pin& p = pins_[pin];
+    if (p.level == level) {
+        return;
+    }
+    set_level(pin, level);
+    if (p.handler == NULL or not fires(p, level)) {
+        return;
+    }
+    if (hold_ or primask_) {
+        p.pending = true;
+        return;
+    }
+    p.handler();
+}
+
+void set_analog(uint8_t pin, int value, int noise) {
+    pins_[pin].analog = value;
+    pins_[pin].noise = noise;
+}
+
+void hold_interrupts(bool hold) {
+    hold_ = hold;
+    if (not hold_ and not primask_) {
+        fire_pending();
+    }
+}
+
+void connect(uint8_t a, uint8_t b, int noise) {
+    wires_.push_back({a, b, noise});
+}
+
+void disconnect_all() {
+    wires_.clear();
+}
+
+void connect_loopbacks(int noise) {
+    connect(DAC0, A0, noise);
+    connect(41, 43);
+    connect(30, 40);
+}
+
+// The pin at the other end of `wire`, or `SIM_NUM_PINS` if `pin` isn't on it.
+static uint8_t other_end(const Wire& wire, uint8_t pin) {
+    if (wire.a == pin) {
+        return wire.b;
+    }
+    return wire.b == pin ? wire.a : SIM_NUM_PINS;
+}
+
+// A write of the firmware to `pin`, which also drives the pins wired to it.
+static void drive(uint8_t pin, int level) {
+    set_digital(pin, level);
+    if (pins_[pin].mode != OUTPUT) {
+        return;
+    }
+    for (const Wire& wire : wires_) {
+        uint8_t other = other_end(wire, pin);
+        if (other != SIM_NUM_PINS and pins_[other].mode != OUTPUT) {
+            set_digital(other, level);
+        }
+    }
+}
+
+static void drive_analog(uint8_t pin, uint32_t value) {
+    pins_[pin].analog = value;
+    if (pin != DAC0 and pin != DAC1) {
+        return;
+    }
+    uint32_t max = (1u << write_resolution_) - 1;
+    int reading = (int) (4095 / 6 + (uint64_t) value * (4095 * 4 / 6) / max);
+    for (const Wire& wire : wires_) {
+        uint8_t other = other_end(wire, pin);
+        if (other != SIM_NUM_PINS) {
+            set_analog(other, reading, wire.noise);
+        }
+    }
+}
+
+void send(const std::string& line) {
+    receive(line);
+    rx_ += '\n';
+    serialEvent();
+    loop();
+}
+
+void receive(const std::string& data) {
+    // Drop what was read before, so that pipelined lines don't pile up.
+    rx_.erase(0, rx_read_);
+    rx_read_ = 0;
+    rx_ += data;
+}
+
+void set_print_handler(void (*print)(const std::string& line)) {
+    print_ = print;
+}
+
+std::vector<std::string> output() {
+    std::vector<std::string> lines;
+    lines.swap(tx_);
+    return lines;
+}
+
+unsigned long string_allocations() {
+    return string_allocations_;
+}
+
+size_t string_heap() {
+    return string_heap_;
+}
+
+size_t string_heap_high_water() {
+    return string_heap_high_water_;
+}
+
+void reset_string_heap_high_water() {
+    string_heap_high_water_ = string_heap_;
+}
+
+// A buffer holds the terminating zero, too.
+void count_string_allocation(size_t size) {
+    ++string_allocations_;
+    string_heap_ += size + 1;
+    string_heap_high_water_ = std::max(string_heap_high_water_, string_heap_);
+}
+
+void count_string_release(size_t size) {
+    string_heap_ -= size + 1;
+}
+
+} // namespace sim
+
+void UARTClass::begin(unsigned long) {
+}
+
+int UARTClass::available(void) {
+    return (int) (sim::rx_.size() - sim::rx_read_);
+}
+
+// Reads by offset, so that long lines don't take quadratic time.
+int UARTClass::read(void) {
+    if (sim::rx_read_ == sim::rx_.size()) {
+        return -1;
+    }
+    int c = (unsigned char) sim::rx_[sim::rx_read_++];
+    if (sim::rx_read_ == sim::rx_.size()) {
+        sim::rx_.clear();
+        sim::rx_read_ = 0;
+    }
+    return c;
+}
+
+size_t UARTClass::println(const String& s) {
+    if (sim::print_ != NULL) {
+        sim::print_(s.c_str());
+    } else {
+        sim::tx_.push_back(s.c_str());
+    }
+    return s.length() + 2;
+}
+
+static std::string format(const char* fmt, long long value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), fmt, value);
+    return buffer;
+}
+
+static std::string format_base(unsigned long value, unsigned char base) {
+    if (base == 10) {
+        return format("%lld", (long long) value);
+    }
+    std::string digits;
+    do {
+        digits.insert(digits.begin(), "0123456789abcdefghijklmnopqrstuvwxyz"[value % base]);
+        value /= base;
+    } while (value);
+    return digits;
+}
+
+String::String(int value, unsigned char base)
+    : s_(value < 0 and base == 10 ? format("%lld", value) : format_base((unsigned) value, base)) {
+    allocate(s_.size());
+}
+
+String::String(unsigned int value, unsigned char base) : s_(format_base(value, base)) {
+    allocate(s_.size());
+}
+
+String::String(long value, unsigned char base)
+    : s_(value < 0 and base == 10 ? format("%lld", value) : format_base(value, base)) {
+    allocate(s_.size());
+}
+
+String::String(unsigned long value, unsigned char base) : s_(format_base(value, base)) {
+    allocate(s_.size());
+}
+
+String::String(float value, unsigned char decimal_places)
+    : String((double) value, decimal_places) {
+}
+
+String::String(double value, unsigned char decimal_places) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimal_places, value);
+    s_ = buffer;
+    allocate(s_.size());
+}
+
+void pinMode(uint32_t pin, uint32_t mode) {
+    sim::pins_[pin].mode = mode;
+    if (mode == INPUT_PULLUP) {
+        sim::set_level(pin, HIGH);
+    }
+}
+
+void digitalWrite(uint32_t pin, uint32_t value) {
+    sim::drive(pin, value ? HIGH : LOW);
+}
+
+int digitalRead(uint32_t pin) {
+    return sim::pins_[pin].level;
+}
+
+uint32_t analogRead(uint32_t pin) {
+    uint32_t value = sim::convert(pin);
+    if (sim::read_resolution_ < 12) {
+        return value >> (12 - sim::read_resolution_);
+    }
+    return value << (sim::read_resolution_ - 12);
+}
+
+void analogWrite(uint32_t pin, uint32_t value) {
+    sim::drive_analog(pin, value);
+}
+
+void analogReadResolution(int res) {
+    sim::read_resolution_ = res;
+}
+
+void analogWriteResolution(int res) {
+    sim::write_resolution_ = res;
+}
+
+uint32_t millis(void) {
+    return (uint32_t) (sim::now_ / 1000);
+}
+
+uint32_t micros(void) {
+    return (uint32_t) sim::now_;
+}
+
+void delay(uint32_t ms) {
+    sim::advance((uint64_t) ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+    sim::advance(us);
+}
+
+void attachInterrupt(uint32_t pin, voidFuncPtr callback, uint32_t mode) {
+    sim::pins_[pin].handler = callback;
+    sim::pins_[pin].edge = mode;
+    sim::pins_[pin].pending = false;
+}
+
+void detachInterrupt(uint32_t pin) {
+    sim::pins_[pin].handler = NULL;
+    sim::pins_[pin].pending = false;
+}
+
+uint32_t __get_PRIMASK(void) {
+    return sim::primask_;
+}
+
+void __set_PRIMASK(uint32_t primask) {
+    sim::primask_ = primask;
+    if (not sim::primask_ and not sim::hold_) {
+        sim::fire_pending();
+    }
+}
+
+void __disable_irq(void) {
+    __set_PRIMASK(1);
+}
+
+void __enable_irq(void) {
+    __set_PRIMASK(0);
+}
+
+static void write_port(const Pio* pio, uint32_t mask, int level) {
+    for (uint8_t pin = 0; pin < SIM_NUM_PINS; ++pin) {
+        const PinDescription& description = g_APinDescription[pin];
+        if (description.pPort == pio and (description.ulPin & mask)) {
+            sim::drive(pin, level);
+        }
+    }
+}
+
+void SimPioSetOutput::operator=(uint32_t mask) {
+    write_port((const Pio*) ((const char*) this - offsetof(Pio, PIO_SODR)), mask, HIGH);
+}
+
+void SimPioClearOutput::operator=(uint32_t mask) {
+    write_port((const Pio*) ((const char*) this - offsetof(Pio, PIO_CODR)), mask, LOW);
+}
+
+void SimAdcControl::operator=(uint32_t value) {
+    if (not(value & ADC_CR_START)) {
+        return;
+    }
+    for (uint8_t pin = 0; pin < SIM_NUM_PINS; ++pin) {
+        uint32_t channel = g_APinDescription[pin].ulADCChannelNumber;
+        if (channel == NO_ADC or not(sim_adc.ADC_CHSR & (1u << channel))) {
+            continue;
+        }
+        sim_adc.ADC_CDR[channel] = sim::convert(pin);
+        sim_adc.ADC_LCDR = sim_adc.ADC_CDR[channel];
+        sim_adc.ADC_ISR |= (1u << channel) | ADC_ISR_DRDY;
+    }
+}
+
+void SimAdcChannelEnable::operator=(uint32_t mask) {
+    sim_adc.ADC_CHSR |= mask;
+}
+
+void SimAdcChannelDisable::operator=(uint32_t mask) {
+    sim_adc.ADC_CHSR &= ~mask;
+}
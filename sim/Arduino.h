@@ -0,0 +1,380 @@
+// Host stand-in for the parts of the Arduino Due core used by the firmware.
+// Pins, time and interrupts are simulated; see Sim.h for the test-side API.
+#ifndef CONTROLLINO_SIM_ARDUINO_H
+#define CONTROLLINO_SIM_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <utility>
+
+#define VARIANT_MCK 84000000
+#define F_CPU VARIANT_MCK
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 2
+#define FALLING 3
+#define RISING 4
+
+#define SIM_NUM_PINS 80
+
+// Analog pin numbers of the Arduino Due variant.
+static const uint8_t A0 = 54;
+static const uint8_t A1 = 55;
+static const uint8_t A2 = 56;
+static const uint8_t A3 = 57;
+static const uint8_t A4 = 58;
+static const uint8_t A5 = 59;
+static const uint8_t A6 = 60;
+static const uint8_t A7 = 61;
+static const uint8_t A8 = 62;
+static const uint8_t A9 = 63;
+static const uint8_t A10 = 64;
+static const uint8_t A11 = 65;
+static const uint8_t DAC0 = 66;
+static const uint8_t DAC1 = 67;
+
+namespace sim {
+// Counts the heap allocations of `String` and the bytes of its buffers; see
+// `sim::string_allocations` and `sim::string_heap`.
+void count_string_allocation(size_t size);
+void count_string_release(size_t size);
+} // namespace sim
+
+// Backed by std::string, but keeps track of the buffer the Arduino `String`
+// would hold, so that its heap allocations can be counted.
+class String {
+public:
+    String(const char* cstr = "") : s_(cstr ? cstr : "") {
+        allocate(s_.size());
+    }
+    String(const std::string& s) : s_(s) {
+        allocate(s_.size());
+    }
+    explicit String(char c) : s_(1, c) {
+        allocate(1);
+    }
+    String(const String& other) : s_(other.s_) {
+        allocate(s_.size());
+    }
+    String(String&& other) :
+        s_(std::move(other.s_)), capacity_(other.capacity_), buffer_(other.buffer_) {
+        other.capacity_ = 0;
+        other.buffer_ = false;
+    }
+    ~String() {
+        release();
+    }
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(float value, unsigned char decimal_places = 2);
+    explicit String(double value, unsigned char decimal_places = 2);
+
+    String& operator=(const String& rhs) {
+        if (this != &rhs) {
+            s_ = rhs.s_;
+            allocate(s_.size());
+        }
+        return *this;
+    }
+    String& operator=(String&& rhs) {
+        if (this != &rhs) {
+            s_ = std::move(rhs.s_);
+            // Like the Arduino core, keep our buffer if it's large enough.
+            if (not buffer_ or capacity_ < rhs.capacity_) {
+                release();
+                capacity_ = rhs.capacity_;
+                buffer_ = rhs.buffer_;
+            } else {
+                rhs.release();
+            }
+            rhs.capacity_ = 0;
+            rhs.buffer_ = false;
+        }
+        return *this;
+    }
+    String& operator=(const char* cstr) {
+        s_ = cstr ? cstr : "";
+        allocate(s_.size());
+        return *this;
+    }
+
+    unsigned char reserve(unsigned int size) {
+        s_.reserve(size);
+        allocate(size);
+        return 1;
+    }
+    unsigned int length(void) const {
+        return s_.size();
+    }
+    const char* c_str() const {
+        return s_.c_str();
+    }
+
+    unsigned char concat(const String& str) {
+        s_ += str.s_;
+        allocate(s_.size());
+        return 1;
+    }
+    unsigned char concat(const char* cstr) {
+        if (cstr == NULL) {
+            return 0;
+        }
+        s_ += cstr;
+        allocate(s_.size());
+        return 1;
+    }
+    unsigned char concat(const char* cstr, unsigned int length) {
+        s_.append(cstr, length);
+        allocate(s_.size());
+        return 1;
+    }
+    unsigned char concat(char c) {
+        s_ += c;
+        allocate(s_.size());
+        return 1;
+    }
+    unsigned char concat(int num) {
+        return concat(String(num));
+    }
+    unsigned char concat(unsigned int num) {
+        return concat(String(num));
+    }
+    unsigned char concat(long num) {
+        return concat(String(num));
+    }
+    unsigned char concat(unsigned long num) {
+        return concat(String(num));
+    }
+
+    template<typename T>
+    String& operator+=(const T& rhs) {
+        concat(rhs);
+        return *this;
+    }
+
+    bool equals(const String& s) const {
+        return s_ == s.s_;
+    }
+    bool equals(const char* cstr) const {
+        return s_ == cstr;
+    }
+    bool operator==(const String& rhs) const {
+        return equals(rhs);
+    }
+    bool operator==(const char* cstr) const {
+        return equals(cstr);
+    }
+    bool operator!=(const String& rhs) const {
+        return not equals(rhs);
+    }
+    bool operator!=(const char* cstr) const {
+        return not equals(cstr);
+    }
+    bool operator<(const String& rhs) const {
+        return s_ < rhs.s_;
+    }
+    bool startsWith(const String& prefix) const {
+        return s_.compare(0, prefix.s_.size(), prefix.s_) == 0;
+    }
+
+    char charAt(unsigned int index) const {
+        return index < s_.size() ? s_[index] : 0;
+    }
+    char operator[](unsigned int index) const {
+        return charAt(index);
+    }
+    int indexOf(char c) const {
+        size_t pos = s_.find(c);
+        return pos == std::string::npos ? -1 : (int) pos;
+    }
+    String substring(unsigned int begin) const {
+        return begin < s_.size() ? String(s_.substr(begin)) : String();
+    }
+    String substring(unsigned int begin, unsigned int end) const {
+        return begin < s_.size() ? String(s_.substr(begin, end - begin)) : String();
+    }
+
+    long toInt(void) const {
+        return atol(s_.c_str());
+    }
+    float toFloat(void) const {
+        return atof(s_.c_str());
+    }
+
+private:
+    // The Arduino `String` reallocates its buffer whenever it's too small
+    // and allocates one even for empty strings.
+    void allocate(size_t size) {
+        if (not buffer_ or capacity_ < size) {
+            release();
+            sim::count_string_allocation(size);
+            capacity_ = size;
+            buffer_ = true;
+        }
+    }
+    void release() {
+        if (buffer_) {
+            sim::count_string_release(capacity_);
+            buffer_ = false;
+        }
+    }
+
+    std::string s_;
+    size_t capacity_ = 0;
+    bool buffer_ = false;
+};
+
+inline String operator+(const String& lhs, const String& rhs) {
+    String result = lhs;
+    result.concat(rhs);
+    return result;
+}
+inline String operator+(const String& lhs, const char* rhs) {
+    String result = lhs;
+    result.concat(rhs);
+    return result;
+}
+inline String operator+(const char* lhs, const String& rhs) {
+    String result = lhs;
+    result.concat(rhs);
+    return result;
+}
+inline String operator+(const String& lhs, char rhs) {
+    String result = lhs;
+    result.concat(rhs);
+    return result;
+}
+inline String operator+(const String& lhs, int rhs) {
+    return lhs + String(rhs);
+}
+inline String operator+(const String& lhs, unsigned int rhs) {
+    return lhs + String(rhs);
+}
+inline String operator+(const String& lhs, long rhs) {
+    return lhs + String(rhs);
+}
+inline String operator+(const String& lhs, unsigned long rhs) {
+    return lhs + String(rhs);
+}
+
+class UARTClass {
+public:
+    void begin(unsigned long baud);
+    int available(void);
+    int read(void);
+    size_t println(const String& s);
+};
+
+extern UARTClass Serial;
+
+void pinMode(uint32_t pin, uint32_t mode);
+void digitalWrite(uint32_t pin, uint32_t value);
+int digitalRead(uint32_t pin);
+uint32_t analogRead(uint32_t pin);
+void analogWrite(uint32_t pin, uint32_t value);
+void analogReadResolution(int res);
+void analogWriteResolution(int res);
+
+uint32_t millis(void);
+uint32_t micros(void);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+typedef void (*voidFuncPtr)(void);
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint32_t pin, voidFuncPtr callback, uint32_t mode);
+void detachInterrupt(uint32_t pin);
+
+// SAM3X PIO controllers and the pin table of the Arduino Due variant. Only
+// the members used by the firmware exist. Writes to the set and clear output
+// data registers drive the pins of the port like `digitalWrite`.
+struct SimPioSetOutput {
+    void operator=(uint32_t mask);
+};
+struct SimPioClearOutput {
+    void operator=(uint32_t mask);
+};
+typedef struct {
+    SimPioSetOutput PIO_SODR;
+    SimPioClearOutput PIO_CODR;
+    volatile uint32_t PIO_PDSR;
+} Pio;
+extern Pio sim_pio[4];
+#define PIOA (&sim_pio[0])
+#define PIOB (&sim_pio[1])
+#define PIOC (&sim_pio[2])
+#define PIOD (&sim_pio[3])
+
+typedef struct {
+    Pio* pPort;
+    uint32_t ulPin;
+    uint32_t ulADCChannelNumber;
+} PinDescription;
+extern const PinDescription g_APinDescription[];
+#define NO_ADC 0xffff
+
+// ADC registers whose accesses have side effects: starting a conversion
+// converts all enabled channels at once, and the enable/disable registers
+// update the channel status register.
+struct SimAdcControl {
+    void operator=(uint32_t value);
+};
+struct SimAdcChannelEnable {
+    void operator=(uint32_t mask);
+};
+struct SimAdcChannelDisable {
+    void operator=(uint32_t mask);
+};
+
+typedef struct {
+    SimAdcControl ADC_CR;
+    volatile uint32_t ADC_MR;
+    SimAdcChannelEnable ADC_CHER;
+    SimAdcChannelDisable ADC_CHDR;
+    volatile uint32_t ADC_CHSR;
+    volatile uint32_t ADC_LCDR;
+    volatile uint32_t ADC_ISR;
+    volatile uint32_t ADC_CDR[16];
+} Adc;
+extern Adc sim_adc;
+#define ADC (&sim_adc)
+
+#define ADC_CR_START (0x1u << 1)
+#define ADC_ISR_DRDY (0x1u << 24)
+#define ADC_MR_PRESCAL_Pos 8
+#define ADC_MR_PRESCAL_Msk (0xffu << ADC_MR_PRESCAL_Pos)
+#define ADC_MR_TRACKTIM_Pos 24
+#define ADC_MR_TRACKTIM_Msk (0xfu << ADC_MR_TRACKTIM_Pos)
+#define ADC_MR_TRACKTIM(value) ((ADC_MR_TRACKTIM_Msk & ((value) << ADC_MR_TRACKTIM_Pos)))
+
+// CMSIS core registers and intrinsics.
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+} DWT_Type;
+typedef struct {
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+extern DWT_Type* const DWT;
+extern CoreDebug_Type* const CoreDebug;
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+
+#endif /* CONTROLLINO_SIM_ARDUINO_H */
@@ -0,0 +1,39 @@
+#include "Capture.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+namespace sim {
+
+void write_capture_entry(FILE* file, const CaptureEntry& entry) {
+    fprintf(file, "%" PRIu64 " %s %s\n", entry.time, entry.rx ? "RX" : "TX", entry.line.c_str());
+}
+
+bool read_capture(const char* path, std::vector<CaptureEntry>& entries) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+    bool valid = true;
+    std::string line;
+    int c;
+    while (valid and (c = fgetc(file)) != EOF) {
+        if (c != '\n') {
+            line += (char) c;
+            continue;
+        }
+        CaptureEntry entry;
+        char direction[3] = {0};
+        int offset = (int) line.size();
+        valid = sscanf(line.c_str(), "%" SCNu64 " %2s %n", &entry.time, direction, &offset) == 2;
+        valid = valid and (strcmp(direction, "RX") == 0 or strcmp(direction, "TX") == 0);
+        entry.rx = strcmp(direction, "RX") == 0;
+        entry.line = line.substr(offset);
+        entries.push_back(entry);
+        line.clear();
+    }
+    fclose(file);
+    return valid and line.empty();
+}
+
+} // namespace sim
@@ -0,0 +1,33 @@
+// Sessions on the serial port, as recorded by the virtual device and
+// tools/record.py and replayed by sim/replay. A capture has one entry per
+// line on the port: the device time in microseconds, `RX` for lines the
+// device received or `TX` for lines it sent, and the line itself, separated
+// by single spaces.
+#ifndef CONTROLLINO_SIM_CAPTURE_H
+#define CONTROLLINO_SIM_CAPTURE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+namespace sim {
+
+// The virtual device runs the firmware in steps of `run` of this length and
+// the replay does the same, so that `loop()` runs at the same times.
+const uint64_t CAPTURE_STEP_US = 100;
+
+struct CaptureEntry {
+    uint64_t time;
+    bool rx;
+    std::string line;
+};
+
+void write_capture_entry(FILE* file, const CaptureEntry& entry);
+// Returns false if `path` can't be read or holds an invalid entry.
+bool read_capture(const char* path, std::vector<CaptureEntry>& entries);
+
+} // namespace sim
+
+#endif /* CONTROLLINO_SIM_CAPTURE_H */
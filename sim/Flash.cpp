@@ -0,0 +1,90 @@
+// Simulated replacement for src/Flash.cpp. The storage area lives in memory
+// that is shared with child processes, so it survives `sim::power_cycle`.
+#include "Flash.h"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Sim.h"
+
+namespace sim {
+
+struct Flash {
+    uint8_t pages[FLASH_STORAGE_PAGES][FLASH_STORAGE_PAGE_SIZE];
+    unsigned int erases[FLASH_STORAGE_PAGES];
+    unsigned int writes;
+    size_t tear; // Bytes the next write programs, or 0
+};
+
+static Flash* flash_ = NULL;
+
+static Flash& flash() {
+    if (flash_ == NULL) {
+        void* shared = mmap(
+            NULL, sizeof(Flash), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        flash_ = (Flash*) shared;
+        erase_flash();
+    }
+    return *flash_;
+}
+
+void erase_flash() {
+    Flash& f = flash();
+    memset(f.pages, 0xFF, sizeof(f.pages));
+    memset(f.erases, 0, sizeof(f.erases));
+    f.writes = 0;
+    f.tear = 0;
+}
+
+unsigned int flash_writes() {
+    return flash().writes;
+}
+
+unsigned int flash_erases(unsigned int page) {
+    return flash().erases[page];
+}
+
+void tear_flash_write(size_t bytes) {
+    flash().tear = bytes;
+}
+
+int power_cycle(void (*session)(void)) {
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == 0) {
+        boot();
+        session();
+        fflush(NULL);
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+} // namespace sim
+
+namespace controllino {
+
+const uint8_t* flash_read_page(unsigned int page) {
+    return sim::flash().pages[page];
+}
+
+int flash_write_page(unsigned int page, const uint8_t* data, bool erase) {
+    sim::Flash& f = sim::flash();
+    size_t bytes = f.tear ? f.tear : FLASH_STORAGE_PAGE_SIZE;
+    f.tear = 0;
+    f.writes++;
+    if (erase) {
+        f.erases[page]++;
+    }
+    // Like the hardware, from the end of the page towards its start.
+    uint8_t* dest = f.pages[page];
+    for (size_t i = FLASH_STORAGE_PAGE_SIZE - bytes; i < FLASH_STORAGE_PAGE_SIZE; ++i) {
+        dest[i] = erase ? data[i] : (dest[i] & data[i]);
+    }
+    return 0;
+}
+
+} // namespace controllino
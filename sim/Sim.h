@@ -0,0 +1,81 @@
+// Test-side control of the simulated board. The firmware runs unmodified on
+// top of Arduino.h; tests drive its inputs, the clock and the serial port.
+#ifndef CONTROLLINO_SIM_SIM_H
+#define CONTROLLINO_SIM_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace sim {
+
+// Resets the simulated board and calls `setup()`. Static state of the
+// firmware survives, so tests must remove what they set up. The noise of the
+// analog inputs restarts, so a session replays the same readings.
+void boot();
+
+// Advances the clock by `us` microseconds, firing due timers on the way and
+// calling `loop()` every `step` microseconds.
+void run(uint64_t us, uint64_t step = 100);
+// Advances the clock without running `loop()`.
+void advance(uint64_t us);
+uint64_t now();
+
+// Drives an input pin. Edges call the attached interrupt handler unless
+// interrupts are held; like the PIO controller, a held pin remembers at most
+// one pending interrupt, however many edges it saw. Interrupts are also
+// held while the firmware has them disabled.
+void set_digital(uint8_t pin, int level);
+// Analog inputs are given as 12-bit readings; every conversion adds a random
+// error of up to +-`noise`.
+void set_analog(uint8_t pin, int value, int noise = 0);
+void hold_interrupts(bool hold);
+
+// Wires two pins together, like the loopbacks of the hardware tests. While
+// one end is an output, writes to it drive the other end; a DAC drives an
+// analog input with the output range of the Due's DAC (1/6 to 5/6 of the
+// ADC range) and a conversion error of up to +-`noise`. Wires survive `boot`.
+void connect(uint8_t a, uint8_t b, int noise = 0);
+void disconnect_all();
+// Wires the loopbacks of the hardware tests: DAC0 to A0, D41 to D43 and D30
+// to D40.
+void connect_loopbacks(int noise);
+
+// Sends a line to the firmware and runs `loop()` until it was processed.
+void send(const std::string& line);
+// Lines printed by the firmware since the last call.
+std::vector<std::string> output();
+
+// Lower-level access to the serial port for the virtual device: `receive`
+// queues bytes for `serialEvent` without running anything, and printed lines
+// go to `print` instead of `output` until it's reset to NULL.
+void receive(const std::string& data);
+void set_print_handler(void (*print)(const std::string& line));
+
+// Heap allocations the Arduino `String` class would have made so far.
+unsigned long string_allocations();
+// The bytes of the buffers of all strings, and the most there were since the
+// last reset.
+size_t string_heap();
+size_t string_heap_high_water();
+void reset_string_heap_high_water();
+
+// Boots a fresh copy of the firmware in a child process and runs `session`
+// there; only the flash is shared with it. Returns the exit status of the
+// child, which is 0 unless the session exits otherwise or a CHECK fails.
+int power_cycle(void (*session)(void));
+
+// The flash starts erased and keeps its contents across `boot` and
+// `power_cycle`. `flash_writes` counts programming operations,
+// `flash_erases` how often a storage page was erased.
+void erase_flash();
+unsigned int flash_writes();
+unsigned int flash_erases(unsigned int page);
+// Cuts the next flash write short after `bytes` bytes, like a reset would.
+void tear_flash_write(size_t bytes);
+
+} // namespace sim
+
+#endif /* CONTROLLINO_SIM_SIM_H */
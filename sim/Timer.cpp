@@ -0,0 +1,75 @@
+// Simulated replacement for src/Timer.cpp: timers fire on the virtual clock
+// while `sim::advance` moves it forward.
+#include "Timer.h"
+
+#include "Sim.h"
+
+namespace sim {
+
+void set_time(uint64_t us); // Arduino.cpp
+
+struct Timer {
+    bool running;
+    bool once;
+    uint32_t period;
+    uint64_t next;
+    void (*callback)(void);
+};
+
+static Timer timers_[controllino::TIMER_COUNT];
+
+void reset_timers() {
+    for (int i = 0; i < controllino::TIMER_COUNT; ++i) {
+        timers_[i] = Timer();
+    }
+}
+
+void advance_timers(uint64_t until) {
+    for (;;) {
+        Timer* due = NULL;
+        for (int i = 0; i < controllino::TIMER_COUNT; ++i) {
+            Timer& t = timers_[i];
+            if (t.running and t.next <= until and (due == NULL or t.next < due->next)) {
+                due = &t;
+            }
+        }
+        if (due == NULL) {
+            return;
+        }
+
+        set_time(due->next);
+        if (due->once) {
+            due->running = false;
+        } else {
+            due->next += due->period;
+        }
+        due->callback();
+    }
+}
+
+} // namespace sim
+
+namespace controllino {
+
+void timer_start(timer_id_t timer, uint32_t period_us, void (*callback)(void)) {
+    sim::Timer& t = sim::timers_[timer];
+    t.running = true;
+    t.once = false;
+    t.period = period_us > 0 ? period_us : 1;
+    t.next = sim::now() + t.period;
+    t.callback = callback;
+}
+
+void timer_start_once(timer_id_t timer, uint32_t delay_us, void (*callback)(void)) {
+    sim::Timer& t = sim::timers_[timer];
+    t.running = true;
+    t.once = true;
+    t.next = sim::now() + (delay_us > 0 ? delay_us : 1);
+    t.callback = callback;
+}
+
+void timer_stop(timer_id_t timer) {
+    sim::timers_[timer].running = false;
+}
+
+} // namespace controllino
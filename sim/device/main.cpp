@@ -0,0 +1,325 @@
+// Runs the firmware as a virtual device: the simulated board from sim/ with
+// the loopbacks of the hardware tests wired in, its clock following the host
+// clock and its serial port exposed on a pseudo-terminal. Clients open the
+// printed path like the port of a real board; opening it resets the firmware
+// like the programming port of the Due does.
+//
+// Usage: device [--baud BAUD] [--noise LSB] [--link PATH] [--no-wiring]
+//               [--record CAPTURE] [--step US]
+//
+// --baud      Emulate the serial line at BAUD (8N1) in both directions,
+//             including the 128 byte buffers of the Due's UART. By default
+//             lines are passed on as fast as the host can.
+// --noise     Conversion error of the wired analog input (default 4).
+// --link      Create a symlink to the pseudo-terminal at PATH.
+// --no-wiring Leave all pins unconnected.
+// --record    Record the first session, from the reset when a client opened
+//             the port until it closed it, to CAPTURE (see sim/Capture.h).
+// --step      Run `loop()` every US µs of device time (default 100). Longer
+//             steps take less CPU time, e.g. to run many devices on one host,
+//             but captures only replay exactly with the default.
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <deque>
+#include <string>
+
+#include <Arduino.h>
+
+#include "Capture.h"
+#include "Sim.h"
+
+void loop();
+void serialEvent();
+
+// SERIAL_BUFFER_SIZE of the Arduino Due core.
+static const size_t UART_BUFFER_SIZE = 128;
+static const int BITS_PER_BYTE = 10;
+
+typedef struct {
+    unsigned long baud;
+    int noise;
+    const char* link;
+    bool wiring;
+    const char* record;
+    uint64_t step;
+} options_t;
+
+static options_t options = {0, 4, NULL, true, NULL, sim::CAPTURE_STEP_US};
+static int master = -1;
+static bool connected = false;
+static volatile sig_atomic_t stop = 0;
+
+// Bytes on the line, with the host time at which each one has been
+// transferred completely.
+typedef struct {
+    char c;
+    uint64_t done;
+} byte_t;
+
+static std::deque<byte_t> rx;
+static std::deque<byte_t> tx;
+static unsigned long rx_dropped = 0;
+
+static FILE* capture = NULL;
+static bool recording = false;
+static std::string rx_line; // The part of the line received so far
+
+// Lines are stamped with the time the firmware sees when it handles them.
+static void record(bool rx, const std::string& line) {
+    if (recording) {
+        sim::write_capture_entry(capture, {sim::now(), rx, line});
+    }
+}
+
+static uint64_t host_micros(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t start = 0;
+
+// The device clock, which starts at 0 when the board boots.
+static uint64_t device_micros(void) {
+    return host_micros() - start;
+}
+
+// Queues `data` behind the bytes already on `line`, paced at the baudrate.
+static void transmit(std::deque<byte_t>& line, const char* data, size_t size) {
+    uint64_t t = device_micros();
+    uint64_t byte_time = options.baud ? BITS_PER_BYTE * 1000000 / options.baud : 0;
+    if (not line.empty() and line.back().done > t) {
+        t = line.back().done;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        t += byte_time;
+        line.push_back({data[i], t});
+    }
+}
+
+// Advances the simulated clock to the device clock, firing due timers.
+static void catch_up(void) {
+    uint64_t now = device_micros();
+    if (now > sim::now()) {
+        sim::advance(now - sim::now());
+    }
+}
+
+// Writes the bytes of `tx` which have been sent by now to the client. What
+// the client doesn't take yet stays queued.
+static void flush_tx(void) {
+    uint64_t now = device_micros();
+    size_t count = 0;
+    while (count < tx.size() and tx[count].done <= now) {
+        count++;
+    }
+    // Without a client, the output is lost like on an unconnected UART.
+    if (not connected) {
+        tx.erase(tx.begin(), tx.begin() + count);
+        return;
+    }
+    if (count == 0) {
+        return;
+    }
+    std::string data;
+    for (size_t i = 0; i < count; ++i) {
+        data += tx[i].c;
+    }
+    ssize_t written = write(master, data.data(), data.size());
+    if (written < 0) {
+        if (errno != EAGAIN) {
+            perror("write");
+        }
+        return;
+    }
+    tx.erase(tx.begin(), tx.begin() + written);
+}
+
+// Hands the bytes of `rx` which have arrived by now to the firmware. Like
+// the UART, it drops what doesn't fit into its buffer.
+static void deliver_rx(void) {
+    uint64_t now = device_micros();
+    std::string data;
+    size_t buffered = (size_t) Serial.available();
+    while (not rx.empty() and rx.front().done <= now) {
+        char c = rx.front().c;
+        rx.pop_front();
+        if (options.baud and buffered + data.size() >= UART_BUFFER_SIZE) {
+            rx_dropped++;
+            continue;
+        }
+        data += c;
+        if (c == '\n') {
+            record(true, rx_line);
+            rx_line.clear();
+        } else {
+            rx_line += c;
+        }
+        // The firmware takes one line per `loop()`, which is always enough at
+        // the baudrate of the board. Unlimited lines are passed on one per
+        // step.
+        if (not options.baud and c == '\n') {
+            break;
+        }
+    }
+    sim::receive(data);
+}
+
+static void print(const std::string& line) {
+    record(false, line);
+    std::string data = line + "\r\n";
+    transmit(tx, data.data(), data.size());
+    if (not options.baud) {
+        flush_tx();
+        return;
+    }
+    // `Serial.println` blocks while the transmit buffer is full. Timers still
+    // fire meanwhile.
+    while (not stop and tx.size() > UART_BUFFER_SIZE) {
+        usleep(50);
+        catch_up();
+        flush_tx();
+    }
+}
+
+// Reads what the client sent and notices when it opens or closes the port;
+// the master side reports a hangup while no client has it open.
+static void poll_client(void) {
+    struct pollfd fd = {master, POLLIN, 0};
+    if (poll(&fd, 1, 0) < 0) {
+        return;
+    }
+    bool was_connected = connected;
+    connected = not(fd.revents & POLLHUP);
+    if (connected and not was_connected) {
+        rx.clear();
+        tx.clear();
+        rx_line.clear();
+        recording = capture != NULL;
+        start = host_micros();
+        sim::boot();
+    }
+    if (was_connected and not connected and recording) {
+        recording = false;
+        fclose(capture);
+        capture = NULL;
+    }
+    if (connected and (fd.revents & POLLIN)) {
+        char buffer[256];
+        ssize_t size = read(master, buffer, sizeof(buffer));
+        if (size > 0) {
+            transmit(rx, buffer, (size_t) size);
+        }
+    }
+}
+
+static int open_pty(void) {
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 or grantpt(master) < 0 or unlockpt(master) < 0) {
+        perror("posix_openpt");
+        return 1;
+    }
+    // Raw mode sticks to the terminal, so clients that don't configure the
+    // port see the lines unchanged and don't echo them back.
+    const char* path = ptsname(master);
+    int slave = open(path, O_RDWR | O_NOCTTY);
+    struct termios attributes;
+    if (slave < 0 or tcgetattr(slave, &attributes) < 0) {
+        perror(path);
+        return 1;
+    }
+    cfmakeraw(&attributes);
+    tcsetattr(slave, TCSANOW, &attributes);
+    close(slave);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    if (options.link != NULL) {
+        unlink(options.link);
+        if (symlink(path, options.link) < 0) {
+            perror(options.link);
+            return 1;
+        }
+    }
+    printf("%s\n", path);
+    fflush(stdout);
+    return 0;
+}
+
+static int parse_options(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        bool has_value = i + 1 < argc;
+        if (option == "--baud" and has_value) {
+            options.baud = strtoul(argv[++i], NULL, 10);
+        } else if (option == "--noise" and has_value) {
+            options.noise = atoi(argv[++i]);
+        } else if (option == "--link" and has_value) {
+            options.link = argv[++i];
+        } else if (option == "--no-wiring") {
+            options.wiring = false;
+        } else if (option == "--record" and has_value) {
+            options.record = argv[++i];
+        } else if (option == "--step" and has_value and atoi(argv[i + 1]) > 0) {
+            options.step = (uint64_t) atoi(argv[++i]);
+        } else {
+            fprintf(stderr,
+                    "usage: %s [--baud BAUD] [--noise LSB] [--link PATH] [--no-wiring] "
+                    "[--record CAPTURE] [--step US]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void handle_signal(int) {
+    stop = 1;
+}
+
+int main(int argc, char** argv) {
+    if (parse_options(argc, argv) != 0 or open_pty() != 0) {
+        return 1;
+    }
+    if (options.record != NULL and (capture = fopen(options.record, "w")) == NULL) {
+        perror(options.record);
+        return 1;
+    }
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    if (options.wiring) {
+        sim::connect_loopbacks(options.noise);
+    }
+    sim::set_print_handler(print);
+    start = host_micros();
+    sim::boot();
+
+    while (not stop) {
+        poll_client();
+        // A device which falls behind catches up, unless it's stopped.
+        while (not stop and device_micros() >= sim::now() + options.step) {
+            deliver_rx();
+            sim::run(options.step, options.step);
+            flush_tx();
+        }
+        usleep((useconds_t) options.step / 2);
+    }
+
+    if (options.link != NULL) {
+        unlink(options.link);
+    }
+    if (capture != NULL) {
+        fclose(capture);
+    }
+    if (rx_dropped > 0) {
+        fprintf(stderr, "%lu received bytes were dropped\n", rx_dropped);
+    }
+    return 0;
+}
@@ -0,0 +1,351 @@
+// Replays a recorded session (see sim/Capture.h) on the simulated board:
+// the received lines are sent to the firmware at their recorded times, the
+// replies are compared with the recorded ones and the time the firmware took
+// to answer each request is reported per command.
+//
+// Usage: replay CAPTURE [--ignore KEY]... [--noise LSB] [--no-wiring]
+//               [--save REPORT] [--baseline REPORT] [--tolerance PERCENT]
+//
+// --ignore    Leave KEY out when comparing replies, e.g. `time` for
+//             sessions recorded on a board.
+// --noise     Conversion error of the wired analog input; use the value the
+//             session was recorded with (default 4, like the device).
+// --no-wiring Leave all pins unconnected.
+// --save      Write the latencies to REPORT.
+// --baseline  Compare the latencies with REPORT, written by an earlier run.
+// --tolerance Allowed increase of the median and the 90th percentile over
+//             the baseline (default 25).
+//
+// Replies are compared job by job, so the order of lines of different jobs
+// doesn't matter; lines printed before the first request, like the boot
+// message, are left out. Sessions recorded on a board replay from a fresh
+// boot at their first entry, so timestamps in their replies differ; so do
+// those of sessions recorded with `--baud`, where printing blocks. Latencies are host times from handing a request to
+// the firmware until its first reply and include the `loop()` pass serving
+// it. They only compare between runs on the same host. Exits with 1 if
+// replies differ or a latency exceeds the baseline.
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <ArduinoJson.h>
+
+#include "Capture.h"
+#include "Sim.h"
+
+typedef std::chrono::steady_clock host_clock;
+
+typedef struct {
+    const char* capture;
+    std::vector<std::string> ignore;
+    int noise;
+    bool wiring;
+    const char* save;
+    const char* baseline;
+    double tolerance;
+} options_t;
+
+static options_t options = {NULL, {}, 4, true, NULL, NULL, 25.0};
+
+typedef struct {
+    sim::CaptureEntry entry;
+    host_clock::time_point printed;
+} reply_t;
+
+static std::vector<reply_t> replies;
+
+// A request sent to the firmware, with the replies printed before it.
+typedef struct {
+    std::string command;
+    long job;
+    host_clock::time_point sent;
+    size_t replies;
+} request_t;
+
+static void print(const std::string& line) {
+    replies.push_back({{sim::now(), false, line}, host_clock::now()});
+}
+
+// The job of a request or reply, or -1 if it has none or isn't JSON.
+static long get_job(const std::string& line, std::string* command = NULL) {
+    DynamicJsonDocument doc(2048);
+    if (deserializeJson(doc, line.c_str()) != DeserializationError::Ok) {
+        return -1;
+    }
+    if (command != NULL) {
+        *command = doc["command"] | "";
+    }
+    return doc["job"] | -1L;
+}
+
+// `line` without the ignored keys, for comparing.
+static std::string normalize(const std::string& line) {
+    if (options.ignore.empty()) {
+        return line;
+    }
+    DynamicJsonDocument doc(2048);
+    if (deserializeJson(doc, line.c_str()) != DeserializationError::Ok) {
+        return line;
+    }
+    for (const std::string& key : options.ignore) {
+        doc.remove(key.c_str());
+    }
+    String normalized;
+    serializeJson(doc, normalized);
+    return normalized.c_str();
+}
+
+// The TX lines of `entries` from the first request on, by job.
+static std::map<long, std::vector<std::string>> by_job(
+    const std::vector<sim::CaptureEntry>& entries) {
+    std::map<long, std::vector<std::string>> jobs;
+    bool requested = false;
+    for (const sim::CaptureEntry& entry : entries) {
+        requested = requested or entry.rx;
+        if (requested and not entry.rx) {
+            jobs[get_job(entry.line)].push_back(normalize(entry.line));
+        }
+    }
+    return jobs;
+}
+
+// Prints the differences between recorded and replayed replies and returns
+// their number.
+static unsigned int compare(const std::vector<sim::CaptureEntry>& recorded,
+                            const std::vector<sim::CaptureEntry>& replayed) {
+    std::map<long, std::vector<std::string>> expected = by_job(recorded);
+    std::map<long, std::vector<std::string>> actual = by_job(replayed);
+    for (const auto& job : actual) {
+        expected[job.first];
+    }
+
+    unsigned int differences = 0;
+    for (const auto& job : expected) {
+        const std::vector<std::string>& lines = job.second;
+        const std::vector<std::string>& other = actual[job.first];
+        for (size_t i = 0; i < std::max(lines.size(), other.size()); ++i) {
+            const std::string* a = i < lines.size() ? &lines[i] : NULL;
+            const std::string* b = i < other.size() ? &other[i] : NULL;
+            if (a != NULL and b != NULL and *a == *b) {
+                continue;
+            }
+            if (differences++ < 20) {
+                printf("job %ld, reply %zu:\n", job.first, i + 1);
+                printf("- %s\n", a != NULL ? a->c_str() : "(none)");
+                printf("+ %s\n", b != NULL ? b->c_str() : "(none)");
+            }
+        }
+    }
+    return differences;
+}
+
+typedef struct {
+    size_t count;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+} latency_t;
+
+typedef std::map<std::string, latency_t> report_t;
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    return sorted[(size_t) round(p * (sorted.size() - 1))];
+}
+
+static report_t summarize(std::map<std::string, std::vector<double>>& samples) {
+    report_t report;
+    for (auto& command : samples) {
+        std::vector<double>& us = command.second;
+        std::sort(us.begin(), us.end());
+        report[command.first] = {
+            us.size(), percentile(us, 0.5), percentile(us, 0.9), percentile(us, 0.99), us.back()};
+    }
+    return report;
+}
+
+static bool write_report(const char* path, const report_t& report) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        return false;
+    }
+    for (const auto& command : report) {
+        const latency_t& l = command.second;
+        fprintf(file,
+                "%s %zu %.3f %.3f %.3f %.3f\n",
+                command.first.c_str(),
+                l.count,
+                l.p50,
+                l.p90,
+                l.p99,
+                l.max);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool read_report(const char* path, report_t& report) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+    char command[64];
+    latency_t l;
+    const char* format = "%63s %zu %lf %lf %lf %lf";
+    while (fscanf(file, format, command, &l.count, &l.p50, &l.p90, &l.p99, &l.max) == 6) {
+        report[command] = l;
+    }
+    fclose(file);
+    return true;
+}
+
+// Prints the latencies next to the baseline and returns the number of
+// commands whose median or 90th percentile exceed it.
+static unsigned int print_report(const report_t& report, const report_t& baseline) {
+    printf("%-24s %7s %9s %9s %9s %9s\n", "latency (us)", "count", "p50", "p90", "p99", "max");
+    unsigned int regressions = 0;
+    for (const auto& command : report) {
+        const latency_t& l = command.second;
+        printf("%-24s %7zu %9.2f %9.2f %9.2f %9.2f\n",
+               command.first.c_str(),
+               l.count,
+               l.p50,
+               l.p90,
+               l.p99,
+               l.max);
+        auto base = baseline.find(command.first);
+        if (base == baseline.end()) {
+            continue;
+        }
+        const latency_t& b = base->second;
+        double limit = 1.0 + options.tolerance / 100.0;
+        bool regressed = l.p50 > b.p50 * limit or l.p90 > b.p90 * limit;
+        printf("%-24s %7s %9.2f %9.2f %9.2f %9.2f%s\n",
+               "  baseline",
+               "",
+               b.p50,
+               b.p90,
+               b.p99,
+               b.max,
+               regressed ? "  REGRESSION" : "");
+        if (regressed) {
+            regressions++;
+        }
+    }
+    return regressions;
+}
+
+static int parse_options(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        bool has_value = i + 1 < argc;
+        if (option == "--ignore" and has_value) {
+            options.ignore.push_back(argv[++i]);
+        } else if (option == "--noise" and has_value) {
+            options.noise = atoi(argv[++i]);
+        } else if (option == "--no-wiring") {
+            options.wiring = false;
+        } else if (option == "--save" and has_value) {
+            options.save = argv[++i];
+        } else if (option == "--baseline" and has_value) {
+            options.baseline = argv[++i];
+        } else if (option == "--tolerance" and has_value) {
+            options.tolerance = atof(argv[++i]);
+        } else if (options.capture == NULL and option[0] != '-') {
+            options.capture = argv[i];
+        } else {
+            options.capture = NULL;
+            break;
+        }
+    }
+    if (options.capture == NULL) {
+        fprintf(stderr,
+                "usage: %s CAPTURE [--ignore KEY]... [--noise LSB] [--no-wiring] "
+                "[--save REPORT] [--baseline REPORT] [--tolerance PERCENT]\n",
+                argv[0]);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (parse_options(argc, argv) != 0) {
+        return 1;
+    }
+    std::vector<sim::CaptureEntry> recorded;
+    if (not sim::read_capture(options.capture, recorded)) {
+        fprintf(stderr, "%s: can't read capture\n", options.capture);
+        return 1;
+    }
+    report_t baseline;
+    if (options.baseline != NULL and not read_report(options.baseline, baseline)) {
+        perror(options.baseline);
+        return 1;
+    }
+
+    if (options.wiring) {
+        sim::connect_loopbacks(options.noise);
+    }
+    sim::set_print_handler(print);
+    sim::boot();
+    replies.clear();
+
+    // Like the virtual device, received lines are handed over between steps.
+    // The board boots at the first entry, which is the boot message of
+    // sessions recorded by the virtual device.
+    uint64_t origin = recorded.empty() ? 0 : recorded[0].time;
+    std::vector<sim::CaptureEntry> replayed;
+    std::vector<request_t> requests;
+    for (const sim::CaptureEntry& entry : recorded) {
+        uint64_t time = entry.time - origin;
+        while (sim::now() < time) {
+            uint64_t step = std::min(sim::CAPTURE_STEP_US, time - sim::now());
+            sim::run(step, step);
+        }
+        if (not entry.rx) {
+            continue;
+        }
+        request_t request;
+        request.job = get_job(entry.line, &request.command);
+        request.replies = replies.size();
+        request.sent = host_clock::now();
+        sim::receive(entry.line + "\n");
+        requests.push_back(request);
+        replayed.push_back({time, true, entry.line});
+    }
+
+    std::map<std::string, std::vector<double>> samples;
+    for (const request_t& request : requests) {
+        for (size_t i = request.replies; request.job >= 0 and i < replies.size(); ++i) {
+            if (get_job(replies[i].entry.line) == request.job) {
+                std::chrono::duration<double, std::micro> latency =
+                    replies[i].printed - request.sent;
+                samples[request.command].push_back(latency.count());
+                break;
+            }
+        }
+    }
+    for (const reply_t& reply : replies) {
+        replayed.push_back(reply.entry);
+    }
+    std::stable_sort(replayed.begin(),
+                     replayed.end(),
+                     [](const sim::CaptureEntry& a, const sim::CaptureEntry& b) {
+                         return a.time < b.time;
+                     });
+
+    unsigned int differences = compare(recorded, replayed);
+    report_t report = summarize(samples);
+    unsigned int regressions = print_report(report, baseline);
+    printf("%u differing replies, %u latency regressions\n", differences, regressions);
+    if (options.save != NULL and not write_report(options.save, report)) {
+        perror(options.save);
+        return 1;
+    }
+    return (differences > 0 or regressions > 0) ? 1 : 0;
+}
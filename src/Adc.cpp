@@ -0,0 +1,184 @@
+#include "Adc.h"
+
+#include <Arduino.h>
+
+#include "GpioHandler.h"
+#include "InterruptLock.h"
+#include "Timer.h"
+
+namespace controllino {
+
+// Resolution of the conversion results; `analogRead` scales them to
+// ADC_DEFAULT_RESOLUTION.
+const uint8_t adc_native_resolution = 12;
+
+struct AnalogInput {
+    adc_config_t config;
+    bool configured;
+    uint32_t channel_mask;
+    uint8_t channel;
+    uint32_t sum; // Conversions accumulated by the scan
+    uint16_t conversions;
+    bool valid;
+    int value; // Last reading of the scan
+};
+
+// Shared with the timer interrupt, so every access from the main loop must
+// hold an `InterruptLock`.
+static AnalogInput inputs_[PIN_INVALID_PIN];
+static volatile uint32_t scan_mask_ = 0;
+// Channels of the scan pass in progress and those enabled before it.
+static uint32_t pending_mask_ = 0;
+static uint32_t enabled_channels_ = 0;
+
+namespace details {
+
+int decimate(uint32_t sum, const adc_config_t& config) {
+    return (sum / config.oversampling) >> (adc_native_resolution - config.resolution);
+}
+
+// Collects the pass in progress, if any. Called from the timer interrupt or
+// with interrupts disabled; a pass takes a few µs, so this only waits right
+// after it was started.
+void finish_scan() {
+    uint32_t mask = pending_mask_;
+    if (mask == 0) {
+        return;
+    }
+    while ((ADC->ADC_ISR & mask) != mask) {
+    }
+
+    for (int pin = 0; pin < (int) PIN_INVALID_PIN; ++pin) {
+        AnalogInput& in = inputs_[pin];
+        if (not(mask & in.channel_mask) or not in.config.scan) {
+            continue;
+        }
+        in.sum += ADC->ADC_CDR[in.channel];
+        in.conversions++;
+        if (in.conversions == in.config.oversampling) {
+            in.value = decimate(in.sum, in.config);
+            in.valid = true;
+            in.sum = 0;
+            in.conversions = 0;
+        }
+    }
+
+    // `analogRead` keeps the channel it used last enabled and expects DRDY to
+    // be clear, so restore both.
+    ADC->ADC_CHDR = mask & ~enabled_channels_;
+    (void) ADC->ADC_LCDR; // Clears DRDY.
+    pending_mask_ = 0;
+}
+
+// Called from the timer interrupt. A pass is collected on the next tick, so
+// the interrupt doesn't wait for the conversions.
+void scan_analog_inputs() {
+    finish_scan();
+    uint32_t mask = scan_mask_;
+    if (mask == 0) {
+        return;
+    }
+    enabled_channels_ = ADC->ADC_CHSR;
+    ADC->ADC_CHER = mask;
+    ADC->ADC_CR = ADC_CR_START;
+    pending_mask_ = mask;
+}
+
+// The SAM3X has one tracking time for all channels, so the longest settling
+// time wins.
+void apply_settling_time() {
+    uint32_t settling = 0;
+    for (int pin = 0; pin < (int) PIN_INVALID_PIN; ++pin) {
+        if (inputs_[pin].configured and inputs_[pin].config.settling > settling) {
+            settling = inputs_[pin].config.settling;
+        }
+    }
+
+    uint32_t mode = ADC->ADC_MR;
+    uint32_t prescal = (mode & ADC_MR_PRESCAL_Msk) >> ADC_MR_PRESCAL_Pos;
+    uint32_t adc_clock_khz = VARIANT_MCK / ((prescal + 1) * 2) / 1000;
+    uint32_t tracktim = (settling * adc_clock_khz + 999999) / 1000000;
+    tracktim = (tracktim > 0) ? tracktim - 1 : 0;
+    if (tracktim > 15) {
+        tracktim = 15;
+    }
+    ADC->ADC_MR = (mode & ~ADC_MR_TRACKTIM_Msk) | ADC_MR_TRACKTIM(tracktim);
+}
+
+} // namespace details
+
+int configure_adc(pin_t pin, const adc_config_t& config) {
+    if (get_pin_type(pin) != PIN_ANALOG or get_pin_mode(pin) != PIN_MODE_INPUT) {
+        return 1; // Error - not an analog input.
+    }
+    if (config.resolution < 8 or config.resolution > adc_native_resolution or
+        config.oversampling < 1 or config.oversampling > MAX_ADC_OVERSAMPLING or
+        config.settling > MAX_ADC_SETTLING_NS) {
+        return 2; // Error - invalid configuration.
+    }
+
+    AnalogInput in{};
+    in.config = config;
+    in.configured = config.resolution != ADC_DEFAULT_RESOLUTION or
+                    config.oversampling != 1 or config.settling != 0 or config.scan;
+    in.channel = get_adc_channel(pin);
+    in.channel_mask = 1u << in.channel;
+
+    uint32_t mask;
+    {
+        InterruptLock lock;
+        details::finish_scan();
+        inputs_[(int) pin] = in;
+        mask = scan_mask_ & ~in.channel_mask;
+        if (config.scan) {
+            mask |= in.channel_mask;
+        }
+        scan_mask_ = mask;
+        details::apply_settling_time();
+    }
+
+    if (mask == 0) {
+        timer_stop(TIMER_ADC_SCAN);
+    } else {
+        timer_start(TIMER_ADC_SCAN, ADC_SCAN_PERIOD_US, details::scan_analog_inputs);
+    }
+    return 0;
+}
+
+adc_config_t get_adc_config(pin_t pin) {
+    if (not is_adc_configured(pin)) {
+        return adc_config_t{ADC_DEFAULT_RESOLUTION, 1, 0, false};
+    }
+    return inputs_[(int) pin].config;
+}
+
+bool is_adc_configured(pin_t pin) {
+    return (int) pin < (int) PIN_INVALID_PIN and inputs_[(int) pin].configured;
+}
+
+int read_adc(pin_t pin) {
+    adc_config_t config = get_adc_config(pin);
+    if (config.scan) {
+        InterruptLock lock;
+        const AnalogInput& in = inputs_[(int) pin];
+        if (in.valid) {
+            return in.value;
+        }
+    }
+
+    // Not scanned (or no reading yet): convert now. Watches and the control
+    // loop convert from timer interrupts, so each conversion holds them off,
+    // but not the whole block.
+    uint8_t pin_number = get_pin_number(pin);
+    uint32_t sum = 0;
+    for (uint16_t i = 0; i < config.oversampling; ++i) {
+        InterruptLock lock;
+        details::finish_scan();
+        analogReadResolution(adc_native_resolution);
+        sum += analogRead(pin_number);
+        analogReadResolution(ADC_DEFAULT_RESOLUTION);
+    }
+    return details::decimate(sum, config);
+}
+
+} // namespace controllino
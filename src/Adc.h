@@ -0,0 +1,31 @@
+#ifndef CONTROLLINO_ADC_H
+#define CONTROLLINO_ADC_H
+
+#include "ProtocolHandler.h"
+
+#define ADC_SCAN_PERIOD_US 100
+#define ADC_DEFAULT_RESOLUTION 10
+#define MAX_ADC_OVERSAMPLING 256
+#define MAX_ADC_SETTLING_NS 1000
+
+namespace controllino {
+
+typedef struct {
+    uint8_t resolution;      // Bits, 8 to 12
+    uint16_t oversampling;   // Conversions averaged per reading
+    uint16_t settling;       // ns of tracking time before each conversion
+    bool scan;               // Convert in the background, reads are cached
+} adc_config_t;
+
+// Scanned inputs are converted together, one conversion each per
+// ADC_SCAN_PERIOD_US: a timer interrupt starts a pass and collects it on the
+// next tick. A new reading is cached after `oversampling` passes. Other inputs
+// are converted by `read_adc`, which works for any analog input.
+int configure_adc(pin_t pin, const adc_config_t& config);
+adc_config_t get_adc_config(pin_t pin);
+bool is_adc_configured(pin_t pin);
+int read_adc(pin_t pin);
+
+} // namespace controllino
+
+#endif /* CONTROLLINO_ADC_H */
@@ -0,0 +1,48 @@
+#ifndef CONTROLLINO_BOARD_H
+#define CONTROLLINO_BOARD_H
+
+// The pins of the board, the single description everything else is generated
+// from (see Pins.h). Each entry is
+//
+//     X(name, arduino_pin, capabilities, default_mode, port, bit, adc_channel)
+//
+// `name` is the pin's name in the protocol and `PIN_<name>` its `pin_t`.
+// `port` and `bit` locate the pin on the SAM3X PIO controllers and
+// `adc_channel` is its ADC channel, or `PIN_NO_ADC`. Another board, or a
+// subset of this one, is described by defining CONTROLLINO_BOARD_PINS before
+// this header is included, e.g. from a header passed with `-include`.
+#ifndef CONTROLLINO_BOARD_PINS
+#define CONTROLLINO_BOARD_PINS(X)                                                   \
+    /* Digital input */                                                             \
+    X(D30, 30, PIN_CAPS_DIGITAL_IO, PIN_MODE_INPUT, PIN_PORT_D, 9, PIN_NO_ADC)      \
+    X(D31, 31, PIN_CAPS_DIGITAL_IO, PIN_MODE_INPUT, PIN_PORT_A, 7, PIN_NO_ADC)      \
+    X(D32, 32, PIN_CAPS_DIGITAL_IO, PIN_MODE_INPUT, PIN_PORT_D, 10, PIN_NO_ADC)     \
+    X(D33, 33, PIN_CAPS_DIGITAL_IO, PIN_MODE_INPUT, PIN_PORT_C, 1, PIN_NO_ADC)      \
+    X(D34, 34, PIN_CAPS_DIGITAL_IO, PIN_MODE_INPUT, PIN_PORT_C, 2, PIN_NO_ADC)      \
+    X(D35, 35, PIN_CAPS_DIGITAL_IO, PIN_MODE_INPUT, PIN_PORT_C, 3, PIN_NO_ADC)      \
+    X(D36, 36, PIN_CAPS_DIGITAL_IO, PIN_MODE_INPUT, PIN_PORT_C, 4, PIN_NO_ADC)      \
+    X(D37, 37, PIN_CAPS_DIGITAL_IO, PIN_MODE_INPUT, PIN_PORT_C, 5, PIN_NO_ADC)      \
+    X(D38, 38, PIN_CAPS_DIGITAL_IO, PIN_MODE_INPUT, PIN_PORT_C, 6, PIN_NO_ADC)      \
+    X(D39, 39, PIN_CAPS_DIGITAL_IO, PIN_MODE_INPUT, PIN_PORT_C, 7, PIN_NO_ADC)      \
+    /* Digital output */                                                            \
+    X(D40, 40, PIN_CAPS_DIGITAL_IO, PIN_MODE_OUTPUT, PIN_PORT_C, 8, PIN_NO_ADC)     \
+    X(D41, 41, PIN_CAPS_DIGITAL_IO, PIN_MODE_OUTPUT, PIN_PORT_C, 9, PIN_NO_ADC)     \
+    X(D42, 42, PIN_CAPS_DIGITAL_IO, PIN_MODE_OUTPUT, PIN_PORT_A, 19, PIN_NO_ADC)    \
+    X(D43, 43, PIN_CAPS_DIGITAL_IO, PIN_MODE_OUTPUT, PIN_PORT_A, 20, PIN_NO_ADC)    \
+    X(D44, 44, PIN_CAPS_DIGITAL_IO, PIN_MODE_OUTPUT, PIN_PORT_C, 19, PIN_NO_ADC)    \
+    X(D45, 45, PIN_CAPS_DIGITAL_IO, PIN_MODE_OUTPUT, PIN_PORT_C, 18, PIN_NO_ADC)    \
+    X(D46, 46, PIN_CAPS_DIGITAL_IO, PIN_MODE_OUTPUT, PIN_PORT_C, 17, PIN_NO_ADC)    \
+    X(D47, 47, PIN_CAPS_DIGITAL_IO, PIN_MODE_OUTPUT, PIN_PORT_C, 16, PIN_NO_ADC)    \
+    X(D48, 48, PIN_CAPS_DIGITAL_IO, PIN_MODE_OUTPUT, PIN_PORT_C, 15, PIN_NO_ADC)    \
+    X(D49, 49, PIN_CAPS_DIGITAL_IO, PIN_MODE_OUTPUT, PIN_PORT_C, 14, PIN_NO_ADC)    \
+    /* Analog input */                                                              \
+    X(A0, A0, PIN_CAPS_ANALOG_IN, PIN_MODE_INPUT, PIN_PORT_A, 16, 7)                \
+    X(A1, A1, PIN_CAPS_ANALOG_IN, PIN_MODE_INPUT, PIN_PORT_A, 24, 6)                \
+    X(A2, A2, PIN_CAPS_ANALOG_IN, PIN_MODE_INPUT, PIN_PORT_A, 23, 5)                \
+    X(A3, A3, PIN_CAPS_ANALOG_IN, PIN_MODE_INPUT, PIN_PORT_A, 22, 4)                \
+    /* Analog output */                                                             \
+    X(DAC0, DAC0, PIN_CAPS_ANALOG_OUT, PIN_MODE_OUTPUT, PIN_PORT_B, 15, PIN_NO_ADC) \
+    X(DAC1, DAC1, PIN_CAPS_ANALOG_OUT, PIN_MODE_OUTPUT, PIN_PORT_B, 16, PIN_NO_ADC)
+#endif
+
+#endif /* CONTROLLINO_BOARD_H */
@@ -0,0 +1,38 @@
+#include "Clock.h"
+
+#include "InterruptLock.h"
+
+namespace controllino {
+
+static uint32_t last_micros_ = 0;
+static uint32_t wraps_ = 0;
+static uint64_t boot_time_ = 0;
+
+uint64_t clock_micros(void) {
+    InterruptLock lock;
+    uint32_t now = micros();
+    if (now < last_micros_) {
+        wraps_++;
+    }
+    last_micros_ = now;
+    return ((uint64_t) wraps_ << 32) | now;
+}
+
+void clock_enable_cycles(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t clock_cycles(void) {
+    return DWT->CYCCNT;
+}
+
+void clock_mark_boot(void) {
+    boot_time_ = clock_micros();
+}
+
+uint64_t clock_boot_time(void) {
+    return boot_time_;
+}
+
+} // namespace controllino
@@ -0,0 +1,25 @@
+#ifndef CONTROLLINO_CLOCK_H
+#define CONTROLLINO_CLOCK_H
+
+#include <Arduino.h>
+
+namespace controllino {
+
+// Device time in microseconds since boot. Extends the 32-bit `micros()`
+// counter to 64 bits; must be called at least once per wrap of `micros()`
+// (~71 minutes), which the main loop does.
+uint64_t clock_micros(void);
+
+// CPU cycle counter (84 MHz, wraps every ~51 seconds). Cycle-accurate, but
+// only counts after `clock_enable_cycles` was called.
+void clock_enable_cycles(void);
+uint32_t clock_cycles(void);
+
+// Device time at which the board became operational, i.e. `setup()` called
+// `clock_mark_boot` after restoring its settings.
+void clock_mark_boot(void);
+uint64_t clock_boot_time(void);
+
+} // namespace controllino
+
+#endif /* CONTROLLINO_CLOCK_H */
@@ -0,0 +1,233 @@
+#include "ControlLoop.h"
+
+#include <math.h>
+
+#include <Arduino.h>
+
+#include "Clock.h"
+#include "GpioHandler.h"
+#include "InterruptLock.h"
+#include "Logger.h"
+#include "Timer.h"
+
+namespace controllino {
+
+// Gains are Q16.16 and already scaled to one period, so the interrupt only
+// needs integer arithmetic.
+const int fraction_bits = 16;
+
+struct ControlLoop {
+    bool running;
+    unsigned int job;
+    control_loop_config_t config;
+    int32_t setpoint;
+    int32_t kp;
+    int32_t ki;
+    int32_t kd;
+    int64_t integral; // Q16.16
+    bool primed;
+    int last_input;
+    int last_output;
+    uint64_t last_time;
+    uint64_t exec_sum;
+    control_loop_stats_t stats;
+};
+
+// Shared with the timer interrupt, so every access from the main loop must
+// hold an `InterruptLock`.
+static ControlLoop loop_;
+static uint64_t next_telemetry_ = 0;
+
+namespace details {
+
+int32_t to_fixed_point(float value) {
+    return (int32_t) lroundf(value * (1 << fraction_bits));
+}
+
+// Gains must fit Q16.16 once scaled to the period; NaN doesn't.
+bool valid_gain(float value) {
+    return fabsf(value) < (float) (INT32_MAX >> fraction_bits);
+}
+
+bool valid_gains(const control_loop_config_t& config) {
+    float period = config.period / 1000000.0f;
+    return valid_gain(config.kp) and valid_gain(config.ki * period) and
+           valid_gain(config.kd / period);
+}
+
+void set_gains(const control_loop_config_t& config) {
+    float period = config.period / 1000000.0f;
+    loop_.setpoint = config.setpoint;
+    loop_.kp = to_fixed_point(config.kp);
+    loop_.ki = to_fixed_point(config.ki * period);
+    loop_.kd = to_fixed_point(config.kd / period);
+}
+
+// Called from the timer interrupt.
+void run_control_loop() {
+    uint64_t start = clock_micros();
+    const control_loop_config_t& config = loop_.config;
+
+    int input = read_analog_from_pin(config.input);
+    if (not loop_.primed) {
+        loop_.last_input = input;
+        loop_.primed = true;
+    }
+
+    int32_t error = loop_.setpoint - input;
+    int64_t p = (int64_t) loop_.kp * error;
+    // Derivative on measurement, so that setpoint changes don't kick.
+    int64_t d = -(int64_t) loop_.kd * (input - loop_.last_input);
+    int64_t integral = loop_.integral + (int64_t) loop_.ki * error;
+    int64_t lower = (int64_t) config.min << fraction_bits;
+    int64_t upper = (int64_t) config.max << fraction_bits;
+    if (integral < lower) {
+        integral = lower;
+    } else if (integral > upper) {
+        integral = upper;
+    }
+
+    int64_t output = (p + integral + d) >> fraction_bits;
+    // Anti-windup: stop integrating while the output is saturated and the
+    // error would push it further into saturation.
+    if (output > config.max) {
+        output = config.max;
+        if (error < 0) {
+            loop_.integral = integral;
+        }
+    } else if (output < config.min) {
+        output = config.min;
+        if (error > 0) {
+            loop_.integral = integral;
+        }
+    } else {
+        loop_.integral = integral;
+    }
+
+    write_analog_to_pin(config.output, (int) output);
+    loop_.last_input = input;
+    loop_.last_output = (int) output;
+    loop_.last_time = start;
+
+    uint32_t exec = (uint32_t) (clock_micros() - start);
+    control_loop_stats_t& stats = loop_.stats;
+    stats.iterations++;
+    stats.last_exec = exec;
+    if (exec > stats.max_exec) {
+        stats.max_exec = exec;
+    }
+    if (exec >= config.period) {
+        stats.overruns++;
+    }
+    loop_.exec_sum += exec;
+}
+
+} // namespace details
+
+void handle_control_loop() {
+    if (not loop_.running or loop_.config.telemetry == 0) {
+        return;
+    }
+
+    uint64_t now = clock_micros();
+    if (now < next_telemetry_) {
+        return;
+    }
+    if (not take_logging_credit()) {
+        return;
+    }
+    next_telemetry_ = now + (uint64_t) loop_.config.telemetry * 1000;
+
+    uint64_t time;
+    int input, output, setpoint;
+    {
+        InterruptLock lock;
+        time = loop_.last_time;
+        input = loop_.last_input;
+        output = loop_.last_output;
+        setpoint = loop_.setpoint;
+    }
+    build_command(
+        COMMAND_START_CONTROL_LOOP,
+        MSG_OUTPUT,
+        loop_.job,
+        "time",
+        time,
+        "input",
+        input,
+        "output",
+        output,
+        "setpoint",
+        setpoint);
+}
+
+int start_control_loop(unsigned int job, const control_loop_config_t& config) {
+    if (loop_.running) {
+        return 1; // Error - only one control loop at a time.
+    }
+    if (config.period < MIN_CONTROL_LOOP_PERIOD_US or
+        config.period > MAX_CONTROL_LOOP_PERIOD_US or config.min < 0 or
+        config.min > config.max or config.max > MAX_CONTROL_LOOP_OUTPUT or
+        not details::valid_gains(config)) {
+        return 2; // Error - invalid configuration.
+    }
+
+    loop_ = ControlLoop();
+    loop_.job = job;
+    loop_.config = config;
+    details::set_gains(config);
+    loop_.running = true;
+    next_telemetry_ = 0;
+
+    timer_start(TIMER_CONTROL_LOOP, config.period, details::run_control_loop);
+    return 0;
+}
+
+// Only setpoint and gains can be changed while the loop is running.
+int update_control_loop(const control_loop_config_t& config) {
+    if (not loop_.running) {
+        return 1; // Error - no control loop running.
+    }
+    control_loop_config_t updated = loop_.config;
+    updated.kp = config.kp;
+    updated.ki = config.ki;
+    updated.kd = config.kd;
+    if (not details::valid_gains(updated)) {
+        return 2; // Error - invalid gains.
+    }
+
+    InterruptLock lock;
+    loop_.config.setpoint = config.setpoint;
+    loop_.config.kp = config.kp;
+    loop_.config.ki = config.ki;
+    loop_.config.kd = config.kd;
+    loop_.config.telemetry = config.telemetry;
+    details::set_gains(loop_.config);
+    return 0;
+}
+
+int stop_control_loop() {
+    if (not loop_.running) {
+        return 1; // Error - no control loop running.
+    }
+
+    timer_stop(TIMER_CONTROL_LOOP);
+    loop_.running = false;
+    return 0;
+}
+
+int get_control_loop(control_loop_config_t* config, control_loop_stats_t* stats) {
+    if (not loop_.running) {
+        return 1; // Error - no control loop running.
+    }
+
+    InterruptLock lock;
+    *config = loop_.config;
+    *stats = loop_.stats;
+    if (stats->iterations > 0) {
+        stats->avg_exec = (uint32_t) (loop_.exec_sum / stats->iterations);
+    }
+    return 0;
+}
+
+} // namespace controllino
@@ -0,0 +1,43 @@
+#ifndef CONTROLLINO_CONTROL_LOOP_H
+#define CONTROLLINO_CONTROL_LOOP_H
+
+#include "ProtocolHandler.h"
+
+#define MIN_CONTROL_LOOP_PERIOD_US 200
+#define MAX_CONTROL_LOOP_PERIOD_US 1000000
+#define MAX_CONTROL_LOOP_OUTPUT 255
+
+namespace controllino {
+
+typedef struct {
+    pin_t input;
+    pin_t output;
+    int setpoint;
+    float kp;
+    float ki; // per second
+    float kd; // seconds
+    int min;
+    int max;
+    unsigned int period;    // µs
+    unsigned int telemetry; // ms; 0 disables telemetry
+} control_loop_config_t;
+
+typedef struct {
+    uint32_t iterations;
+    uint32_t last_exec; // µs
+    uint32_t max_exec;  // µs
+    uint32_t avg_exec;  // µs
+    uint32_t overruns;  // iterations which took longer than the period
+} control_loop_stats_t;
+
+// The loop runs in a timer interrupt with fixed-point gains; telemetry is
+// sent from `handle_control_loop` and is subject to logging flow control.
+void handle_control_loop();
+int start_control_loop(unsigned int job, const control_loop_config_t& config);
+int update_control_loop(const control_loop_config_t& config);
+int stop_control_loop();
+int get_control_loop(control_loop_config_t* config, control_loop_stats_t* stats);
+
+} // namespace controllino
+
+#endif /* CONTROLLINO_CONTROL_LOOP_H */
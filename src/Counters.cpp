@@ -0,0 +1,226 @@
+#include "Counters.h"
+
+#include <Arduino.h>
+
+#include "Clock.h"
+#include "GpioHandler.h"
+#include "InterruptLock.h"
+#include "Logger.h"
+#include "PinInterrupts.h"
+
+namespace controllino {
+
+struct Counter {
+    unsigned int id;
+    unsigned int job;
+    counter_t config;
+    int64_t count;
+    uint32_t errors; // Quadrature: transitions with both inputs changed
+    uint8_t state;   // Last level, or last A/B state in quadrature mode
+    uint64_t next_report;
+};
+
+// Shared with the pin interrupts, so every access from the main loop must
+// hold an `InterruptLock`.
+static Counter counters_[MAX_COUNTERS];
+static volatile unsigned int counter_count_ = 0;
+
+// Count change for a quadrature transition, indexed by the old and new A/B
+// state. 2 marks an invalid transition (both inputs changed).
+const int8_t quadrature_steps[4][4] = {
+    {0, -1, 1, 2},
+    {1, 0, 2, -1},
+    {-1, 2, 0, 1},
+    {2, 1, -1, 0},
+};
+
+namespace details {
+
+uint8_t read_quadrature_state(const counter_t& config) {
+    return (read_digital_from_pin(config.pin) << 1) | read_digital_from_pin(config.pin_b);
+}
+
+// Called from interrupt context.
+void count_edge(Counter& c) {
+    uint8_t level = read_digital_from_pin(c.config.pin);
+    if (level == c.state) {
+        // Two edges arrived before the interrupt was served: one rising, one
+        // falling.
+        c.count += (c.config.mode == COUNTER_MODE_CHANGE) ? 2 : 1;
+        return;
+    }
+
+    c.state = level;
+    if (c.config.mode == COUNTER_MODE_CHANGE or
+        (c.config.mode == COUNTER_MODE_RISING and level == HIGH) or
+        (c.config.mode == COUNTER_MODE_FALLING and level == LOW)) {
+        c.count++;
+    }
+}
+
+// Called from interrupt context.
+void count_quadrature(Counter& c) {
+    uint8_t state = read_quadrature_state(c.config);
+    int8_t step = quadrature_steps[c.state][state];
+    c.state = state;
+    if (step == 2) {
+        c.errors++;
+        return;
+    }
+    c.count += step;
+}
+
+// Called from interrupt context.
+void on_counter_pin_edge(pin_t pin) {
+    for (unsigned int i = 0; i < counter_count_; ++i) {
+        Counter& c = counters_[i];
+        if (c.config.mode == COUNTER_MODE_QUADRATURE) {
+            if (c.config.pin == pin or c.config.pin_b == pin) {
+                count_quadrature(c);
+                return;
+            }
+        } else if (c.config.pin == pin) {
+            count_edge(c);
+            return;
+        }
+    }
+}
+
+Counter* find_counter(unsigned int id) {
+    for (unsigned int i = 0; i < counter_count_; ++i) {
+        if (counters_[i].id == id) {
+            return &counters_[i];
+        }
+    }
+    return NULL;
+}
+
+} // namespace details
+
+void handle_counters() {
+    uint64_t now = clock_micros();
+    for (unsigned int i = 0; i < counter_count_; ++i) {
+        Counter& c = counters_[i];
+        if (c.config.period == 0 or now < c.next_report) {
+            continue;
+        }
+        if (not take_logging_credit()) {
+            return;
+        }
+        c.next_report = now + (uint64_t) c.config.period * 1000;
+
+        int64_t count;
+        uint32_t errors;
+        {
+            InterruptLock lock;
+            count = c.count;
+            errors = c.errors;
+        }
+        if (c.config.mode == COUNTER_MODE_QUADRATURE) {
+            build_command(
+                COMMAND_ADD_COUNTER,
+                MSG_OUTPUT,
+                c.job,
+                "time",
+                now,
+                "count",
+                count,
+                "errors",
+                errors);
+        } else {
+            build_command(COMMAND_ADD_COUNTER, MSG_OUTPUT, c.job, "time", now, "count", count);
+        }
+    }
+}
+
+int add_counter(unsigned int id, unsigned int job, const counter_t& counter) {
+    if (counter_count_ == MAX_COUNTERS) {
+        return 1; // Error - too many counters.
+    }
+    if (details::find_counter(id) != NULL) {
+        return 2; // Error - duplicate id.
+    }
+    bool quadrature = counter.mode == COUNTER_MODE_QUADRATURE;
+    if (has_pin_interrupt(counter.pin) or
+        (quadrature and (counter.pin_b == counter.pin or has_pin_interrupt(counter.pin_b)))) {
+        return 3; // Error - pin is already in use.
+    }
+
+    Counter c{};
+    c.id = id;
+    c.job = job;
+    c.config = counter;
+    c.next_report = clock_micros() + (uint64_t) counter.period * 1000;
+    if (quadrature) {
+        c.state = details::read_quadrature_state(counter);
+    } else {
+        c.state = read_digital_from_pin(counter.pin);
+    }
+    {
+        InterruptLock lock;
+        counters_[counter_count_] = c;
+        counter_count_++;
+    }
+
+    attach_pin_interrupt(counter.pin, details::on_counter_pin_edge);
+    if (quadrature) {
+        attach_pin_interrupt(counter.pin_b, details::on_counter_pin_edge);
+    }
+    return 0;
+}
+
+int delete_counter(unsigned int id) {
+    for (unsigned int i = 0; i < counter_count_; ++i) {
+        if (counters_[i].id != id) {
+            continue;
+        }
+
+        detach_pin_interrupt(counters_[i].config.pin);
+        if (counters_[i].config.mode == COUNTER_MODE_QUADRATURE) {
+            detach_pin_interrupt(counters_[i].config.pin_b);
+        }
+        {
+            InterruptLock lock;
+            for (unsigned int j = i; j < counter_count_ - 1; ++j) {
+                counters_[j] = counters_[j + 1];
+            }
+            counter_count_--;
+        }
+        return 0;
+    }
+    return 1; // Found no match!
+}
+
+int reset_counter(unsigned int id, int64_t* count) {
+    InterruptLock lock;
+    Counter* c = details::find_counter(id);
+    if (c == NULL) {
+        return 1; // Found no match!
+    }
+    *count = c->count;
+    c->count = 0;
+    c->errors = 0;
+    return 0;
+}
+
+size_t get_counter_ids(unsigned int* ids) {
+    for (unsigned int i = 0; i < counter_count_; ++i) {
+        ids[i] = counters_[i].id;
+    }
+    return counter_count_;
+}
+
+int latch_counters(const unsigned int* ids, size_t n, int64_t* counts, uint64_t* time) {
+    InterruptLock lock;
+    *time = clock_micros();
+    for (size_t i = 0; i < n; ++i) {
+        Counter* c = details::find_counter(ids[i]);
+        if (c == NULL) {
+            return 1; // Found no match!
+        }
+        counts[i] = c->count;
+    }
+    return 0;
+}
+
+} // namespace controllino
@@ -0,0 +1,29 @@
+#ifndef CONTROLLINO_COUNTERS_H
+#define CONTROLLINO_COUNTERS_H
+
+#include "ProtocolHandler.h"
+
+#define MAX_COUNTERS 4
+
+namespace controllino {
+
+typedef struct {
+    counter_mode_t mode;
+    pin_t pin;
+    pin_t pin_b;         // Quadrature only
+    unsigned int period; // ms; 0 disables streaming
+} counter_t;
+
+// Counters are maintained in the pin interrupts of their inputs. If a
+// counter has a period, `handle_counters` streams its count.
+void handle_counters();
+int add_counter(unsigned int id, unsigned int job, const counter_t& counter);
+int delete_counter(unsigned int id);
+int reset_counter(unsigned int id, int64_t* count);
+size_t get_counter_ids(unsigned int* ids);
+// Copies the counts of all `ids` at the same instant `time`.
+int latch_counters(const unsigned int* ids, size_t n, int64_t* counts, uint64_t* time);
+
+} // namespace controllino
+
+#endif /* CONTROLLINO_COUNTERS_H */
@@ -0,0 +1,159 @@
+#include "Debounce.h"
+
+#include <Arduino.h>
+
+#include "GpioHandler.h"
+#include "InterruptLock.h"
+#include "PinInterrupts.h"
+#include "Timer.h"
+
+namespace controllino {
+
+struct Debounce {
+    debounce_t config;
+    pin_port_t port;  // Index into `ports`
+    uint32_t mask;    // Bit of the pin in its port
+    uint16_t samples; // Samples needed to change the level
+    uint16_t count;   // Integrator value, or samples since the raw level changed
+    uint8_t level;
+    bool bouncing; // Raw level differed from `level` since the last change
+    uint32_t glitches;
+};
+
+// Indexed by `pin_port_t`.
+Pio* const ports[] = {PIOA, PIOB, PIOC, PIOD};
+const size_t len_ports = sizeof(ports) / sizeof(ports[0]);
+
+// Shared with the timer interrupt, so every access from the main loop must
+// hold an `InterruptLock`.
+static Debounce debounces_[PIN_INVALID_PIN];
+static volatile unsigned int debounced_count_ = 0;
+
+namespace details {
+
+// Returns true if the integrator reached the opposite rail.
+bool integrate(Debounce& d, bool raw) {
+    if (raw and d.count < d.samples) {
+        d.count++;
+    } else if (not raw and d.count > 0) {
+        d.count--;
+    }
+    bool rail = d.level ? (d.count == d.samples) : (d.count == 0);
+    if (d.bouncing and rail) {
+        d.glitches++; // Returned to the current level.
+        d.bouncing = false;
+    } else if (not rail) {
+        d.bouncing = true;
+    }
+    return d.level ? (d.count == 0) : (d.count == d.samples);
+}
+
+// Returns true if the raw level differed from the current one for `samples`
+// samples in a row.
+bool settle(Debounce& d, bool raw) {
+    if (raw == (bool) d.level) {
+        if (d.count > 0) {
+            d.glitches++;
+        }
+        d.count = 0;
+        return false;
+    }
+    d.count++;
+    return d.count >= d.samples;
+}
+
+// Called from the timer interrupt.
+void scan_debounced_pins() {
+    // One read per PIO controller instead of one `digitalRead` per pin.
+    uint32_t levels[len_ports];
+    for (size_t i = 0; i < len_ports; ++i) {
+        levels[i] = ports[i]->PIO_PDSR;
+    }
+
+    for (int pin = 0; pin < (int) PIN_INVALID_PIN; ++pin) {
+        Debounce& d = debounces_[pin];
+        if (d.samples == 0) {
+            continue;
+        }
+
+        bool raw = (levels[d.port] & d.mask) != 0;
+        bool changed;
+        if (d.config.filter == DEBOUNCE_FILTER_INTEGRATOR) {
+            changed = integrate(d, raw);
+        } else {
+            changed = settle(d, raw);
+        }
+        if (changed) {
+            // The integrator already sits on the rail of the new level.
+            d.level = not d.level;
+            d.bouncing = false;
+            if (d.config.filter == DEBOUNCE_FILTER_STABLE) {
+                d.count = 0;
+            }
+            notify_pin_edge((pin_t) pin);
+        }
+    }
+}
+
+} // namespace details
+
+int set_debounce(pin_t pin, const debounce_t& debounce) {
+    if (get_pin_type(pin) != PIN_DIGITAL) {
+        return 1; // Error - not a digital pin.
+    }
+    if (debounce.time > MAX_DEBOUNCE_TIME_US) {
+        return 2; // Error - invalid time.
+    }
+
+    Debounce d{};
+    d.config = debounce;
+    d.samples = (debounce.time + DEBOUNCE_SCAN_PERIOD_US - 1) / DEBOUNCE_SCAN_PERIOD_US;
+    d.port = get_pin_port(pin);
+    d.mask = get_pin_mask(pin);
+
+    bool was_debounced = is_debounced(pin);
+    {
+        InterruptLock lock;
+        d.level = (ports[d.port]->PIO_PDSR & d.mask) != 0;
+        if (debounce.filter == DEBOUNCE_FILTER_INTEGRATOR and d.level) {
+            d.count = d.samples;
+        }
+        debounces_[(int) pin] = d;
+    }
+
+    if (not was_debounced and is_debounced(pin)) {
+        refresh_pin_interrupt(pin);
+        debounced_count_++;
+        if (debounced_count_ == 1) {
+            timer_start(TIMER_DEBOUNCE, DEBOUNCE_SCAN_PERIOD_US, details::scan_debounced_pins);
+        }
+    } else if (was_debounced and not is_debounced(pin)) {
+        refresh_pin_interrupt(pin);
+        debounced_count_--;
+        if (debounced_count_ == 0) {
+            timer_stop(TIMER_DEBOUNCE);
+        }
+    }
+    return 0;
+}
+
+int get_debounce(pin_t pin, debounce_t* debounce, uint32_t* glitches) {
+    if (not is_debounced(pin)) {
+        return 1; // Found no match!
+    }
+
+    InterruptLock lock;
+    *debounce = debounces_[(int) pin].config;
+    *glitches = debounces_[(int) pin].glitches;
+    return 0;
+}
+
+bool is_debounced(pin_t pin) {
+    return (int) pin < (int) PIN_INVALID_PIN and debounces_[(int) pin].samples != 0;
+}
+
+int read_debounced(pin_t pin) {
+    return debounces_[(int) pin].level ? HIGH : LOW;
+}
+
+} // namespace controllino
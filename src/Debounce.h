@@ -0,0 +1,26 @@
+#ifndef CONTROLLINO_DEBOUNCE_H
+#define CONTROLLINO_DEBOUNCE_H
+
+#include "ProtocolHandler.h"
+
+#define DEBOUNCE_SCAN_PERIOD_US 100
+#define MAX_DEBOUNCE_TIME_US 100000
+
+namespace controllino {
+
+typedef struct {
+    debounce_filter_t filter;
+    uint32_t time; // µs; 0 disables debouncing
+} debounce_t;
+
+// Debounced digital inputs are sampled every DEBOUNCE_SCAN_PERIOD_US in a
+// timer interrupt. Their filtered level replaces the raw level everywhere,
+// and pin interrupt handlers only see filtered edges.
+int set_debounce(pin_t pin, const debounce_t& debounce);
+int get_debounce(pin_t pin, debounce_t* debounce, uint32_t* glitches);
+bool is_debounced(pin_t pin);
+int read_debounced(pin_t pin);
+
+} // namespace controllino
+
+#endif /* CONTROLLINO_DEBOUNCE_H */
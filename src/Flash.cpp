@@ -0,0 +1,61 @@
+#include "Flash.h"
+
+namespace controllino {
+
+const unsigned int hw_pages_per_page = FLASH_STORAGE_PAGE_SIZE / IFLASH1_PAGE_SIZE;
+const unsigned int first_hw_page =
+    IFLASH1_NB_OF_PAGES - FLASH_STORAGE_PAGES * hw_pages_per_page;
+
+// Programming needs more wait states than reading at 84 MHz (SAM3X errata).
+const uint32_t write_wait_states = 6;
+
+namespace details {
+
+uint8_t* page_address(unsigned int hw_page) {
+    return (uint8_t*) IFLASH1_ADDR + hw_page * IFLASH1_PAGE_SIZE;
+}
+
+int flash_command(uint32_t command, unsigned int hw_page) {
+    EFC1->EEFC_FCR =
+        EEFC_FCR_FKEY(0x5A) | EEFC_FCR_FARG(hw_page) | EEFC_FCR_FCMD(command);
+    uint32_t status;
+    do {
+        status = EFC1->EEFC_FSR;
+    } while (not(status & EEFC_FSR_FRDY));
+    return (status & (EEFC_FSR_FCMDE | EEFC_FSR_FLOCKE)) ? 1 : 0;
+}
+
+} // namespace details
+
+const uint8_t* flash_read_page(unsigned int page) {
+    return details::page_address(first_hw_page + page * hw_pages_per_page);
+}
+
+int flash_write_page(unsigned int page, const uint8_t* data, bool erase) {
+    uint32_t mode = EFC1->EEFC_FMR;
+    EFC1->EEFC_FMR = (mode & ~EEFC_FMR_FWS_Msk) | EEFC_FMR_FWS(write_wait_states);
+
+    // Hardware pages are programmed last to first, so that the start of the
+    // page, which holds the journal's page header, is only written once the
+    // rest is complete.
+    int error = 0;
+    for (unsigned int i = hw_pages_per_page; i-- > 0 and not error;) {
+        unsigned int hw_page = first_hw_page + page * hw_pages_per_page + i;
+        // Any write into the page fills the latch buffer; it has to be
+        // written as whole words.
+        volatile uint32_t* latch = (volatile uint32_t*) details::page_address(hw_page);
+        const uint8_t* src = data + i * IFLASH1_PAGE_SIZE;
+        for (unsigned int w = 0; w < IFLASH1_PAGE_SIZE / 4; ++w) {
+            uint32_t word;
+            memcpy(&word, src + 4 * w, 4);
+            latch[w] = word;
+        }
+        __DSB();
+        error = details::flash_command(erase ? EFC_FCMD_EWP : EFC_FCMD_WP, hw_page);
+    }
+
+    EFC1->EEFC_FMR = mode;
+    return error;
+}
+
+} // namespace controllino
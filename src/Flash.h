@@ -0,0 +1,25 @@
+#ifndef CONTROLLINO_FLASH_H
+#define CONTROLLINO_FLASH_H
+
+#include <Arduino.h>
+
+// The storage area is made of the last FLASH_STORAGE_PAGES pages of the second
+// flash bank, so programming it never stalls code fetches from the first one.
+// A storage page spans several hardware pages of IFLASH1_PAGE_SIZE bytes.
+#define FLASH_STORAGE_PAGES 8
+#define FLASH_STORAGE_PAGE_SIZE 1024
+
+namespace controllino {
+
+// Memory-mapped contents of storage page `page`.
+const uint8_t* flash_read_page(unsigned int page);
+
+// Programs storage page `page` with `data`. With `erase` the page is erased
+// first; without, bits can only be cleared, so bytes that should stay as they
+// are must be 0xFF in `data`. The page is programmed from its end towards its
+// start. Returns 1 if the flash controller reported an error.
+int flash_write_page(unsigned int page, const uint8_t* data, bool erase);
+
+} // namespace controllino
+
+#endif /* CONTROLLINO_FLASH_H */
@@ -0,0 +1,196 @@
+#include "Frequency.h"
+
+#include <Arduino.h>
+
+#include "Clock.h"
+#include "GpioHandler.h"
+#include "InterruptLock.h"
+#include "Logger.h"
+#include "PinInterrupts.h"
+
+namespace controllino {
+
+const float cycles_per_us = VARIANT_MCK / 1000000.0f;
+
+// Edges are timed with the 32-bit cycle counter, which wraps after about 51 s.
+// A gate and the rising edge carried over from the previous one must fit, so
+// no gate is extended beyond half of that.
+const uint64_t max_gate_span_us = (uint64_t) UINT32_MAX / (VARIANT_MCK / 1000000) / 2;
+
+struct Edges {
+    int level;
+    unsigned int rises;
+    unsigned int carried; // Rising edge carried over from the previous gate
+    uint32_t first_rise; // Cycle counter at the first rising edge of the gate
+    uint32_t last_rise;
+    uint32_t high_cycles; // Summed length of the completed high phases
+    unsigned int highs;
+};
+
+struct Measurement {
+    unsigned int job;
+    pin_t pin;
+    unsigned int gate; // ms
+    uint64_t gate_start;
+    uint64_t next_report;
+    Edges edges;
+};
+
+// Shared with the pin interrupts, so every access from the main loop must
+// hold an `InterruptLock`.
+static Measurement measurements_[MAX_FREQUENCY_MEASUREMENTS];
+static volatile unsigned int measurement_count_ = 0;
+
+namespace details {
+
+// Called from interrupt context.
+void on_frequency_pin_edge(pin_t pin) {
+    uint32_t now = clock_cycles();
+    for (unsigned int i = 0; i < measurement_count_; ++i) {
+        if (measurements_[i].pin != pin) {
+            continue;
+        }
+
+        Edges& e = measurements_[i].edges;
+        int level = read_digital_from_pin(pin);
+        if (level == e.level) {
+            return; // Missed the opposite edge; wait for the next one.
+        }
+        e.level = level;
+
+        if (level == HIGH) {
+            if (e.rises == 0) {
+                e.first_rise = now;
+            }
+            e.last_rise = now;
+            e.rises++;
+        } else if (e.rises > 0) {
+            e.high_cycles += now - e.last_rise;
+            e.highs++;
+        }
+        return;
+    }
+}
+
+void report(const Measurement& m, uint64_t now, const Edges& e) {
+    float frequency = 0.0f;
+    float period = 0.0f;
+    float duty = (e.level == HIGH) ? 1.0f : 0.0f;
+    if (e.rises > 1) {
+        // Reciprocal counting: time whole periods instead of counting edges
+        // during the gate, so the resolution doesn't depend on the gate time.
+        float cycles = (float) (uint32_t) (e.last_rise - e.first_rise) / (e.rises - 1);
+        period = cycles / cycles_per_us;
+        frequency = 1000000.0f / period;
+        if (e.highs > 0) {
+            duty = (float) e.high_cycles / e.highs / cycles;
+        }
+    }
+
+    build_command(
+        COMMAND_MEASURE_FREQUENCY,
+        MSG_OUTPUT,
+        m.job,
+        "time",
+        now,
+        "frequency",
+        frequency,
+        "period",
+        period,
+        "duty",
+        duty,
+        "edges",
+        e.rises - e.carried);
+}
+
+} // namespace details
+
+void handle_frequency_measurements() {
+    uint64_t now = clock_micros();
+    for (unsigned int i = 0; i < measurement_count_; ++i) {
+        Measurement& m = measurements_[i];
+        if (now < m.next_report) {
+            continue;
+        }
+        // Without credit the gate is extended until the host catches up. A
+        // gate which got too long is dropped and restarted.
+        if (now - m.gate_start >= max_gate_span_us) {
+            InterruptLock lock;
+            m.edges.rises = 0;
+            m.edges.carried = 0;
+            m.edges.high_cycles = 0;
+            m.edges.highs = 0;
+            m.gate_start = now;
+            m.next_report = now + (uint64_t) m.gate * 1000;
+            continue;
+        }
+        if (not take_logging_credit()) {
+            continue;
+        }
+        m.gate_start = now;
+        m.next_report = now + (uint64_t) m.gate * 1000;
+
+        Edges edges;
+        {
+            InterruptLock lock;
+            edges = m.edges;
+            // The last rising edge starts the next gate, unless it is older
+            // than the gate (bounds the span to less than a counter wrap).
+            m.edges.rises = (edges.rises > edges.carried) ? 1 : 0;
+            m.edges.carried = m.edges.rises;
+            m.edges.first_rise = edges.last_rise;
+            m.edges.high_cycles = 0;
+            m.edges.highs = 0;
+        }
+        details::report(m, now, edges);
+    }
+}
+
+int measure_frequency(unsigned int job, pin_t pin, unsigned int gate) {
+    if (measurement_count_ == MAX_FREQUENCY_MEASUREMENTS) {
+        return 1; // Error - too many measurements.
+    }
+    if (gate < MIN_FREQUENCY_GATE_MS or gate > MAX_FREQUENCY_GATE_MS) {
+        return 3; // Error - invalid gate time.
+    }
+    if (has_pin_interrupt(pin)) {
+        return 2; // Error - pin is already in use.
+    }
+
+    Measurement m{};
+    m.job = job;
+    m.pin = pin;
+    m.gate = gate;
+    m.gate_start = clock_micros();
+    m.next_report = m.gate_start + (uint64_t) gate * 1000;
+    m.edges.level = read_digital_from_pin(pin);
+    clock_enable_cycles();
+    {
+        InterruptLock lock;
+        measurements_[measurement_count_] = m;
+        measurement_count_++;
+    }
+    attach_pin_interrupt(pin, details::on_frequency_pin_edge);
+    return 0;
+}
+
+int end_measure_frequency(pin_t pin) {
+    for (unsigned int i = 0; i < measurement_count_; ++i) {
+        if (measurements_[i].pin != pin) {
+            continue;
+        }
+
+        detach_pin_interrupt(pin);
+        {
+            InterruptLock lock;
+            for (unsigned int j = i; j < measurement_count_ - 1; ++j) {
+                measurements_[j] = measurements_[j + 1];
+            }
+            measurement_count_--;
+        }
+        return 0;
+    }
+    return 1; // Found no match!
+}
+
+} // namespace controllino
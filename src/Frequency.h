@@ -0,0 +1,21 @@
+#ifndef CONTROLLINO_FREQUENCY_H
+#define CONTROLLINO_FREQUENCY_H
+
+#include "ProtocolHandler.h"
+
+#define MAX_FREQUENCY_MEASUREMENTS 4
+#define MIN_FREQUENCY_GATE_MS 10
+#define MAX_FREQUENCY_GATE_MS 10000
+
+namespace controllino {
+
+// Every edge of a measured digital input is timestamped with the CPU cycle
+// counter from its pin interrupt; `handle_frequency_measurements` reports
+// frequency, period and duty cycle once per gate time.
+void handle_frequency_measurements();
+int measure_frequency(unsigned int job, pin_t pin, unsigned int gate);
+int end_measure_frequency(pin_t pin);
+
+} // namespace controllino
+
+#endif /* CONTROLLINO_FREQUENCY_H */
@@ -1,49 +1,14 @@
 #include "GpioHandler.h"
 
-namespace controllino {
-
-typedef struct {
-    const pin_t pin;
-    const uint8_t pin_number;
-    const pin_type_t pin_type;
-    pin_mode_t pin_mode;
-    const pin_mode_type_t pin_mode_type;
-} inputs_outputs_t;
+#include "Adc.h"
+#include "Debounce.h"
+#include "InterruptLock.h"
+#include "Storage.h"
 
-inputs_outputs_t mapping_dict[] = {
-    // Digital input
-    {PIN_D30, 30, PIN_DIGITAL, PIN_MODE_INPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D31, 31, PIN_DIGITAL, PIN_MODE_INPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D32, 32, PIN_DIGITAL, PIN_MODE_INPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D33, 33, PIN_DIGITAL, PIN_MODE_INPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D34, 34, PIN_DIGITAL, PIN_MODE_INPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D35, 35, PIN_DIGITAL, PIN_MODE_INPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D36, 36, PIN_DIGITAL, PIN_MODE_INPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D37, 37, PIN_DIGITAL, PIN_MODE_INPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D38, 38, PIN_DIGITAL, PIN_MODE_INPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D39, 39, PIN_DIGITAL, PIN_MODE_INPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    // Digital output
-    {PIN_D40, 40, PIN_DIGITAL, PIN_MODE_OUTPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D41, 41, PIN_DIGITAL, PIN_MODE_OUTPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D42, 42, PIN_DIGITAL, PIN_MODE_OUTPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D43, 43, PIN_DIGITAL, PIN_MODE_OUTPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D44, 44, PIN_DIGITAL, PIN_MODE_OUTPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D45, 45, PIN_DIGITAL, PIN_MODE_OUTPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D46, 46, PIN_DIGITAL, PIN_MODE_OUTPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D47, 47, PIN_DIGITAL, PIN_MODE_OUTPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D48, 48, PIN_DIGITAL, PIN_MODE_OUTPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    {PIN_D49, 49, PIN_DIGITAL, PIN_MODE_OUTPUT, PIN_MODE_TYPE_INPUT_AND_OUTPUT},
-    // Analog input
-    {PIN_A0, A0, PIN_ANALOG, PIN_MODE_INPUT, PIN_MODE_TYPE_INPUT_ONLY},
-    {PIN_A1, A1, PIN_ANALOG, PIN_MODE_INPUT, PIN_MODE_TYPE_INPUT_ONLY},
-    {PIN_A2, A2, PIN_ANALOG, PIN_MODE_INPUT, PIN_MODE_TYPE_INPUT_ONLY},
-    {PIN_A3, A3, PIN_ANALOG, PIN_MODE_INPUT, PIN_MODE_TYPE_INPUT_ONLY},
-    // Analog output
-    {PIN_DAC0, DAC0, PIN_ANALOG, PIN_MODE_OUTPUT, PIN_MODE_TYPE_OUTPUT_ONLY},
-    {PIN_DAC1, DAC1, PIN_ANALOG, PIN_MODE_OUTPUT, PIN_MODE_TYPE_OUTPUT_ONLY},
-};
+namespace controllino {
 
-const size_t len_mapping_array = sizeof(mapping_dict) / sizeof(mapping_dict[0]);
+// Set from the stored or default modes by `load_pin_modes` in `setup()`.
+static pin_mode_t pin_modes_[PIN_INVALID_PIN];
 
 typedef struct {
     pin_mode_t pin_mode;
@@ -56,73 +21,69 @@ const pin_modes_map_t pin_modes_map[] = {
     {PIN_MODE_INPUT_PULLUP, INPUT_PULLUP},
 };
 
-pin_type_t get_pin_type(pin_t pin) {
-    return mapping_dict[(int) pin].pin_type;
-}
-
-pin_mode_type_t get_pin_mode_type(pin_t pin) {
-    return mapping_dict[(int) pin].pin_mode_type;
-}
-
 void set_pin_mode(pin_t pin, pin_mode_t pin_mode) {
-    mapping_dict[(int) pin].pin_mode = pin_mode;
-    uint8_t pin_number = mapping_dict[(int) pin].pin_number;
-    pinMode(pin_number, pin_modes_map[(int) pin_mode].pin_mode_define);
+    pin_modes_[(int) pin] = pin_mode;
+    pinMode(get_pin_number(pin), pin_modes_map[(int) pin_mode].pin_mode_define);
 }
 
 pin_mode_t get_pin_mode(pin_t pin) {
-    return mapping_dict[(int) pin].pin_mode;
+    return pin_modes_[(int) pin];
 }
 
 void write_digital_to_pin(pin_t pin, uint8_t level) {
-    uint8_t pin_number = mapping_dict[(int) pin].pin_number;
-    digitalWrite(pin_number, level);
+    if (get_pin_type(pin) == PIN_DIGITAL and pin_modes_[(int) pin] == PIN_MODE_OUTPUT) {
+        set_pin_level(pin, level);
+        return;
+    }
+    // `digitalWrite` switches the pull-up of inputs.
+    digitalWrite(get_pin_number(pin), level);
 }
 
 void write_analog_to_pin(pin_t pin, int level) {
-    uint8_t pin_number = mapping_dict[(int) pin].pin_number;
-    analogWrite(pin_number, level);
+    // The control loop and scheduled outputs write from timer interrupts, and
+    // `analogWrite` configures the shared PWM and DAC channels.
+    InterruptLock lock;
+    analogWrite(get_pin_number(pin), level);
 }
 
 int read_digital_from_pin(pin_t pin) {
-    uint8_t pin_number = mapping_dict[(int) pin].pin_number;
-    return digitalRead(pin_number);
+    if (is_debounced(pin)) {
+        return read_debounced(pin);
+    }
+    return get_pin_level(pin) ? HIGH : LOW;
 }
 
 int read_analog_from_pin(pin_t pin) {
-    uint8_t pin_number = mapping_dict[(int) pin].pin_number;
-    return analogRead(pin_number);
+    // Inputs without a configuration are converted with the defaults; the ADC
+    // is shared with the scan in a timer interrupt.
+    return read_adc(pin);
 }
 
 void load_pin_modes(void) {
-    for (uint8_t i = 0; i < (uint8_t) len_mapping_array; i++) {
-        pin_mode_t eeprom_pin_mode = mapping_dict[i].pin_mode;
-        // pin_mode_t eeprom_pin_mode = (pin_mode_t)EEPROM.read(pin_states[i].pin);
-        if (eeprom_pin_mode > PIN_MODE_INPUT_PULLUP) {
-            eeprom_pin_mode = PIN_MODE_INPUT;
+    uint8_t stored[PIN_INVALID_PIN];
+    bool valid = storage_read(STORAGE_KEY_PIN_MODES, stored, sizeof(stored)) ==
+                 (int) sizeof(stored);
+    for (uint8_t i = 0; i < (uint8_t) PIN_INVALID_PIN; i++) {
+        pin_mode_t pin_mode = get_default_pin_mode((pin_t) i);
+        if (valid and stored[i] <= PIN_MODE_INPUT_PULLUP) {
+            pin_mode = (pin_mode_t) stored[i];
         }
-        set_pin_mode(mapping_dict[i].pin, eeprom_pin_mode);
+        set_pin_mode((pin_t) i, pin_mode);
     }
 }
 
-void save_pin_modes(void) {
-    for (uint8_t i = 0; i < (uint8_t) len_mapping_array; i++) {
-        // EEPROM.update(pin_states[i].pin, pin_states[i].pin_mode);
+int save_pin_modes(void) {
+    uint8_t modes[PIN_INVALID_PIN];
+    for (uint8_t i = 0; i < (uint8_t) PIN_INVALID_PIN; i++) {
+        modes[i] = (uint8_t) pin_modes_[i];
     }
+    return storage_write(STORAGE_KEY_PIN_MODES, modes, sizeof(modes));
 }
 
 void reset_pin_modes(void) {
-    for (uint8_t i = 0; i < (uint8_t) len_mapping_array; i++) {
-        mapping_dict[i].pin_mode = PIN_MODE_INPUT;
-        // EEPROM.update(pin_states[i].pin, PIN_MODE_INPUT);
+    for (uint8_t i = 0; i < (uint8_t) PIN_INVALID_PIN; i++) {
+        set_pin_mode((pin_t) i, get_default_pin_mode((pin_t) i));
     }
 }
 
-void trigger_pulse(pin_t pin) {
-    uint8_t pin_number = mapping_dict[(int) pin].pin_number;
-    digitalWrite(pin_number, HIGH);
-    delay(100);
-    digitalWrite(pin_number, LOW);
-}
-
 } // namespace controllino
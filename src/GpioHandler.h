@@ -3,13 +3,11 @@
 
 #include <Arduino.h>
 
+#include "Pins.h"
 #include "ProtocolHandler.h"
 
 namespace controllino {
 
-pin_type_t get_pin_type(pin_t pin);
-pin_mode_type_t get_pin_mode_type(pin_t pin);
-
 void write_digital_to_pin(pin_t pin, uint8_t level);
 void write_analog_to_pin(pin_t pin, int level);
 
@@ -19,12 +17,14 @@ int read_analog_from_pin(pin_t pin);
 void set_pin_mode(pin_t pin, pin_mode_t pin_mode);
 pin_mode_t get_pin_mode(pin_t pin);
 
+// `load_pin_modes` applies the modes stored by `save_pin_modes`, or the
+// defaults of the board if there are none. `reset_pin_modes` applies the
+// defaults without touching the stored modes. `save_pin_modes` returns the
+// error of `storage_write`.
 void load_pin_modes(void);
-void save_pin_modes(void);
+int save_pin_modes(void);
 void reset_pin_modes(void);
 
-void trigger_pulse(pin_t pin);
-
 } // namespace controllino
 
 #endif /* CONTROLLINO_GPIO_HANDLER_H */
@@ -0,0 +1,29 @@
+#ifndef CONTROLLINO_INTERRUPT_LOCK_H
+#define CONTROLLINO_INTERRUPT_LOCK_H
+
+#include <Arduino.h>
+
+namespace controllino {
+
+// Disables interrupts for the lifetime of the object and restores the
+// previous state on destruction. Safe to use from interrupt handlers.
+class InterruptLock {
+public:
+    InterruptLock() : primask_{__get_PRIMASK()} {
+        __disable_irq();
+    }
+
+    ~InterruptLock() {
+        __set_PRIMASK(primask_);
+    }
+
+    InterruptLock(const InterruptLock&) = delete;
+    InterruptLock& operator=(const InterruptLock&) = delete;
+
+private:
+    uint32_t primask_;
+};
+
+} // namespace controllino
+
+#endif /* CONTROLLINO_INTERRUPT_LOCK_H */
@@ -1,21 +1,37 @@
 #include "Logger.h"
 
+#include <limits.h>
+
 #include <Arduino.h>
 
+#include "Clock.h"
 #include "GpioHandler.h"
+#include "Storage.h"
 
 namespace controllino {
 
 struct Data {
-    unsigned int time;
+    uint64_t time; // µs device time (see `clock_micros`)
     int value;
+    uint32_t seq; // Counts the samples of a request since it (re)started
+};
+
+// Value of STORAGE_KEY_LOGGING_REQUESTS is an array of these.
+struct StoredRequest {
+    uint32_t job;
+    uint32_t pin;
+    uint32_t period; // ms
 };
 
 class LoggingRequest {
 public:
     LoggingRequest() = default;
-    LoggingRequest(unsigned int job, pin_t pin, unsigned int period) :
-        job_{job}, pin_{pin}, pin_type_{get_pin_type(pin)}, period_{period} {
+    LoggingRequest(unsigned int job, pin_t pin, unsigned int period, bool persistent) :
+        job_{job},
+        pin_{pin},
+        pin_type_{get_pin_type(pin)},
+        period_{(uint64_t) period * 1000},
+        persistent_{persistent} {
     }
 
     unsigned int job() const {
@@ -26,16 +42,26 @@ public:
         return pin_;
     }
 
+    // Stored in flash, unless it was closed.
+    bool persistent() const {
+        return persistent_ and not close_;
+    }
+
+    StoredRequest stored() const {
+        return StoredRequest{job_, (uint32_t) pin_, (uint32_t) (period_ / 1000)};
+    }
+
+    // Closed and every sample has been sent.
     bool done() const {
-        return done_;
+        return done_ and count_ == 0;
     }
 
     void close() {
         close_ = true;
     }
 
-    Data read() {
-        last_read_ = millis();
+    void read() {
+        last_read_ = clock_micros();
         first_pass_ = false;
         int value;
         if (pin_type_ == PIN_DIGITAL) {
@@ -48,30 +74,113 @@ public:
             done_ = true;
         }
 
-        return Data{last_read_, value};
+        push(Data{last_read_, value, seq_++});
     }
 
     bool ready() const {
-        if (first_pass_ or last_read_ + period_ < millis()) {
+        if (done_) {
+            return false;
+        }
+        if (first_pass_ or last_read_ + period_ < clock_micros()) {
             return true;
         }
         return false;
     }
 
+    bool pending() const {
+        return count_ > 0;
+    }
+
+    // Sends the oldest buffered sample, together with a summary of the
+    // samples which were coalesced since the previous message.
+    void send() {
+        Data p = buffer_[head_];
+        head_ = (head_ + 1) % LOG_BUFFER_SIZE;
+        count_--;
+
+        if (coalesced_ == 0) {
+            build_command(
+                COMMAND_LOG_SIGNAL,
+                MSG_OUTPUT,
+                job_,
+                "time",
+                p.time,
+                "value",
+                p.value,
+                "seq",
+                p.seq,
+                "done",
+                done());
+            return;
+        }
+
+        build_command(
+            COMMAND_LOG_SIGNAL,
+            MSG_OUTPUT,
+            job_,
+            "time",
+            p.time,
+            "value",
+            p.value,
+            "seq",
+            p.seq,
+            "done",
+            done(),
+            "coalesced",
+            coalesced_,
+            "min",
+            min_,
+            "max",
+            max_);
+        coalesced_ = 0;
+    }
+
 private:
+    // If the buffer is full, the oldest sample is folded into the summary.
+    void push(const Data& p) {
+        if (count_ == LOG_BUFFER_SIZE) {
+            const Data& oldest = buffer_[head_];
+            if (coalesced_ == 0 or oldest.value < min_) {
+                min_ = oldest.value;
+            }
+            if (coalesced_ == 0 or oldest.value > max_) {
+                max_ = oldest.value;
+            }
+            coalesced_++;
+            head_ = (head_ + 1) % LOG_BUFFER_SIZE;
+            count_--;
+        }
+        buffer_[(head_ + count_) % LOG_BUFFER_SIZE] = p;
+        count_++;
+    }
+
     unsigned int job_{};
     pin_t pin_{};
     pin_type_t pin_type_{};
-    unsigned int period_{}; // in number of interrupts
-    unsigned int last_read_ = 0;
+    uint64_t period_{}; // in µs
+    bool persistent_ = false;
+    uint32_t seq_ = 0;
+    uint64_t last_read_ = 0;
     bool first_pass_ = true; // FIXME Slow?
     bool done_ = false;
     bool close_ = false;
+
+    // Samples waiting for credit.
+    Data buffer_[LOG_BUFFER_SIZE];
+    unsigned int head_ = 0;
+    unsigned int count_ = 0;
+    unsigned int coalesced_ = 0;
+    int min_ = 0;
+    int max_ = 0;
 };
 
 static LoggingRequest requests_[MAX_REQUESTS];
 static unsigned int request_count_ = 0;
 
+// Flow control is off until the host grants credit for the first time.
+static bool flow_control_ = false;
+static unsigned int credit_ = 0;
+
 namespace details {
 
 void del_request(unsigned int position) {
@@ -81,22 +190,59 @@ void del_request(unsigned int position) {
     request_count_--;
 }
 
+int add_request(unsigned int job, pin_t pin, unsigned int period, bool persistent) {
+    if (request_count_ == MAX_REQUESTS) {
+        return 1; // Error - too many requests.
+    }
+
+    for (unsigned int i = 0; i < request_count_; ++i) {
+        // Already have a logging job for this pin.
+        if (requests_[i].pin() == pin) {
+            return 2;
+        }
+    }
+
+    requests_[request_count_] = LoggingRequest{job, pin, period, persistent};
+    request_count_++;
+    return 0;
+}
+
+int store_requests() {
+    StoredRequest stored[MAX_REQUESTS];
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < request_count_; ++i) {
+        if (requests_[i].persistent()) {
+            stored[count++] = requests_[i].stored();
+        }
+    }
+    if (count == 0) {
+        return storage_erase(STORAGE_KEY_LOGGING_REQUESTS);
+    }
+    return storage_write(
+        STORAGE_KEY_LOGGING_REQUESTS,
+        stored,
+        count * sizeof(StoredRequest));
+}
+
 } // namespace details
 
 void handle_logging_requests() {
     for (unsigned int i = 0; i < request_count_; ++i) {
         if (requests_[i].ready()) {
-            auto p = requests_[i].read();
-            build_command(
-                COMMAND_LOG_SIGNAL,
-                MSG_OUTPUT,
-                requests_[i].job(),
-                "time",
-                p.time,
-                "value",
-                p.value,
-                "done",
-                requests_[i].done());
+            requests_[i].read();
+        }
+    }
+
+    // Send buffered samples round-robin so that a fast job can't starve the
+    // others of credit.
+    bool sent = true;
+    while (sent) {
+        sent = false;
+        for (unsigned int i = 0; i < request_count_; ++i) {
+            if (requests_[i].pending() and take_logging_credit()) {
+                requests_[i].send();
+                sent = true;
+            }
         }
     }
 
@@ -112,33 +258,85 @@ void handle_logging_requests() {
     }
 }
 
-// period in ms.
-int log_signal(unsigned int job, pin_t pin, unsigned int period) {
-    if (request_count_ == MAX_REQUESTS) {
-        return 1; // Error - too many requests.
+void restore_logging_requests() {
+    StoredRequest stored[MAX_REQUESTS];
+    int size = storage_read(STORAGE_KEY_LOGGING_REQUESTS, stored, sizeof(stored));
+    if (size <= 0 or size % sizeof(StoredRequest) != 0) {
+        return;
     }
-
-    for (unsigned int i = 0; i < request_count_; ++i) {
-        // Already have a logging job for this pin.
-        if (requests_[i].pin() == pin) {
-            return 2;
+    for (unsigned int i = 0; i < size / sizeof(StoredRequest); ++i) {
+        const StoredRequest& r = stored[i];
+        // Pin modes were restored before, but may have changed since the
+        // request was stored.
+        if (r.pin >= PIN_INVALID_PIN or
+            get_pin_mode((pin_t) r.pin) != PIN_MODE_INPUT) {
+            continue;
         }
+        details::add_request(r.job, (pin_t) r.pin, r.period, true);
     }
 
-    period = period; // period in ms
-    requests_[request_count_] = LoggingRequest{job, pin, period};
-    request_count_++;
+    // Nobody may be listening yet.
+    if (request_count_ > 0) {
+        flow_control_ = true;
+        credit_ = 0;
+    }
+}
+
+// period in ms.
+int log_signal(unsigned int job, pin_t pin, unsigned int period, bool persistent) {
+    auto error = details::add_request(job, pin, period, persistent);
+    if (error or not persistent) {
+        return error;
+    }
+    if (details::store_requests()) {
+        details::del_request(request_count_ - 1);
+        return 3; // Error - could not store the request.
+    }
     return 0;
 }
 
 int end_log_signal(pin_t pin) {
     for (unsigned int i = 0; i < request_count_; ++i) {
         if (requests_[i].pin() == pin) {
+            bool persistent = requests_[i].persistent();
             requests_[i].close();
+            if (persistent and details::store_requests()) {
+                return 2; // Error - the request is still stored.
+            }
             return 0; // Only one logging request per pin allowed!
         }
     }
     return 1; // Found no match!
 }
 
+void grant_logging_credit(int credit) {
+    if (credit < 0) {
+        flow_control_ = false;
+        credit_ = 0;
+        return;
+    }
+    flow_control_ = true;
+    // Saturates instead of wrapping to little or no credit.
+    if ((unsigned int) credit > UINT_MAX - credit_) {
+        credit_ = UINT_MAX;
+    } else {
+        credit_ += credit;
+    }
+}
+
+unsigned int get_logging_credit() {
+    return credit_;
+}
+
+bool take_logging_credit() {
+    if (not flow_control_) {
+        return true;
+    }
+    if (credit_ == 0) {
+        return false;
+    }
+    credit_--;
+    return true;
+}
+
 } // namespace controllino
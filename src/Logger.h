@@ -4,13 +4,25 @@
 #include "ProtocolHandler.h"
 
 #define MAX_REQUESTS 8
+#define LOG_BUFFER_SIZE 64
 
 namespace controllino {
 
+// Persistent logging requests are kept in flash and restarted by
+// `restore_logging_requests` at boot. If any was restarted, flow control starts
+// out on without credit, so their samples wait in RAM until the host grants
+// credit.
 void handle_logging_requests();
-int log_signal(unsigned int job, pin_t pin, unsigned int period);
+void restore_logging_requests();
+int log_signal(unsigned int job, pin_t pin, unsigned int period, bool persistent);
 int end_log_signal(pin_t);
 
+// Credit-based flow control for streamed messages. A negative credit turns
+// flow control off.
+void grant_logging_credit(int credit);
+unsigned int get_logging_credit();
+bool take_logging_credit();
+
 } // namespace controllino
 
 #endif /* CONTROLLINO_LOGGER_H */
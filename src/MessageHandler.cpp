@@ -2,56 +2,112 @@
 
 #include <ArduinoJson.h>
 
+#include "Adc.h"
+#include "Clock.h"
+#include "ControlLoop.h"
+#include "Counters.h"
+#include "Debounce.h"
+#include "Frequency.h"
 #include "GpioHandler.h"
 #include "Logger.h"
 #include "ProtocolHandler.h"
+#include "Rules.h"
+#include "Scheduler.h"
 #include "SerialHandler.h"
+#include "Storage.h"
+#include "Watch.h"
 
 namespace controllino {
 
 static message_struct_t message_struct;
+// Lines are copied here and parsed in place, so the strings of a message
+// point into this buffer instead of being copied into the document.
+static char message_buffer[MAX_MESSAGE_LENGTH + 1];
 
 void receive_message(void* data);
-void do_command_action(message_struct_t* message, const String command_string);
+void do_command_action(message_struct_t* message, const char* command_string);
+void run_command(message_struct_t* message, unsigned int job, const char* command_string);
 
-void command_get_input(unsigned int job, const String pin);
-void command_set_output(unsigned int job, const String pin, const String level);
-void command_log_signal(unsigned int job, const String& pin, int period);
-void command_end_log_signal(unsigned int job, const String& pin);
-void command_get_pin_mode(unsigned int job, const String pin_string);
-void command_set_pin_mode(unsigned int job, const String pin, const String mode);
-void command_trigger_pulse(unsigned int job, const String pin_string);
+void command_get_input(unsigned int job, pin_arg_t pin);
+void command_set_output(
+    unsigned int job, message_struct_t* message, pin_arg_t pin, bool scheduled, uint64_t at);
+void command_log_signal(
+    unsigned int job, pin_arg_t pin, unsigned int period, bool persistent);
+void command_end_log_signal(unsigned int job, pin_arg_t pin);
+void command_get_pin_mode(unsigned int job, pin_arg_t pin);
+void command_set_pin_mode(unsigned int job, pin_arg_t pin, const char* mode_string);
+void command_trigger_pulse(unsigned int job, pin_arg_t pin, unsigned int duration);
+void command_cancel_job(unsigned int job, unsigned int target);
+void command_sync_time(unsigned int job, uint64_t t0);
+void command_grant_credit(unsigned int job, int credit);
+void command_add_rule(
+    unsigned int job,
+    message_struct_t* message,
+    const char* condition_string,
+    const char* action_string);
+void command_delete_rule(unsigned int job, unsigned int rule);
+void command_get_rule(unsigned int job, unsigned int rule);
+void command_start_control_loop(
+    unsigned int job, message_struct_t* message, pin_arg_t input, pin_arg_t output);
+void command_update_control_loop(unsigned int job, message_struct_t* message);
+void command_stop_control_loop(unsigned int job);
+void command_get_control_loop(unsigned int job);
+void command_watch(unsigned int job, message_struct_t* message, pin_arg_t pin);
+void command_end_watch(unsigned int job, pin_arg_t pin);
+void command_measure_frequency(unsigned int job, pin_arg_t pin, int gate);
+void command_end_measure_frequency(unsigned int job, pin_arg_t pin);
+void command_add_counter(
+    unsigned int job, message_struct_t* message, unsigned int id, const char* mode_string);
+void command_delete_counter(unsigned int job, unsigned int id);
+void command_reset_counter(unsigned int job, unsigned int id);
+void command_get_counters(unsigned int job, message_struct_t* message);
+void command_set_debounce(
+    unsigned int job, message_struct_t* message, pin_arg_t pin, uint32_t time);
+void command_get_debounce(unsigned int job, pin_arg_t pin);
+void command_set_adc(unsigned int job, message_struct_t* message, pin_arg_t pin);
+void command_get_storage(unsigned int job);
+void command_batch(unsigned int job, message_struct_t* message);
 
 void init_message_handler(void) {
     serial_set_callback(receive_message);
 }
 
 void receive_message(void* data) {
-    String process_string = *(String*) data;
+    const String& process_string = *(const String*) data;
+    if (process_string.length() > MAX_MESSAGE_LENGTH) {
+        String error_message =
+            "Messages are limited to " + String(MAX_MESSAGE_LENGTH) + " characters";
+        build_error(COMMAND_ERROR, "MESSAGE_TOO_LONG", error_message);
+        return;
+    }
+    memcpy(message_buffer, process_string.c_str(), process_string.length() + 1);
 
-    if (receive_message_handler(process_string, &message_struct)) {
-        String command_string = "";
-        command_string.reserve(15);
+    if (receive_message_handler(message_buffer, &message_struct)) {
+        const char* command_string;
         if (has_object_given_key(&message_struct, command_string, "command")) {
             do_command_action(&message_struct, command_string);
         }
     }
 }
 
-void do_command_action(message_struct_t* message, const String command_string) {
-    message_struct.command = get_command(command_string);
-    String tmp;
-    if (not has_object_given_key(message, tmp, "job")) {
+void do_command_action(message_struct_t* message, const char* command_string) {
+    message->command = get_command(command_string);
+    long job;
+    if (not has_object_given_key(message, job, "job")) {
         String error_message = "received command without job id";
         build_error(COMMAND_ERROR, "NO_JOB_ID", error_message);
         return;
     }
-    int job = tmp.toInt();
+    message->job = job;
+
+    run_command(message, job, command_string);
+}
 
-    switch (message_struct.command) {
+// Runs the command in `message->fields`; also used for the items of a batch.
+void run_command(message_struct_t* message, unsigned int job, const char* command_string) {
+    switch (message->command) {
         case COMMAND_GET_INPUT: {
-            String pin = "";
-            pin.reserve(5);
+            pin_arg_t pin;
             if (has_object_given_key(message, pin, "pin")) {
                 command_get_input(job, pin);
             }
@@ -59,34 +115,40 @@ void do_command_action(message_struct_t* message, const String command_string) {
         }
 
         case COMMAND_SET_OUTPUT: {
-            String pin = "";
-            pin.reserve(5);
-            String level = "";
-            level.reserve(5);
+            pin_arg_t pin;
 
-            if (has_object_given_key(message, pin, "pin") &&
-                has_object_given_key(message, level, "level")) {
-                command_set_output(job, pin, level);
+            // `at` is optional; without it the output is set immediately.
+            bool scheduled = message->fields.containsKey("at");
+            uint64_t at = 0;
+            if (scheduled and not message->fields["at"].is<uint64_t>()) {
+                build_error(COMMAND_SET_OUTPUT,
+                            "INVALID_TIME",
+                            "Key 'at' must be a non-negative integer",
+                            job);
+                break;
+            }
+            at = message->fields["at"] | (uint64_t) 0;
+
+            if (has_object_given_key(message, pin, "pin")) {
+                command_set_output(job, message, pin, scheduled, at);
             }
             break;
         }
 
         case COMMAND_LOG_SIGNAL: {
-            String pin = "";
-            pin.reserve(5);
-            String period = "";
-            pin.reserve(10);
+            pin_arg_t pin;
+            unsigned int period;
 
             if (has_object_given_key(message, pin, "pin") &&
                 has_object_given_key(message, period, "period")) {
-                command_log_signal(job, pin, period.toInt());
+                bool persistent = message->fields["persistent"] | false;
+                command_log_signal(job, pin, period, persistent);
             }
             break;
         }
 
         case COMMAND_END_LOG_SIGNAL: {
-            String pin = "";
-            pin.reserve(5);
+            pin_arg_t pin;
 
             if (has_object_given_key(message, pin, "pin")) {
                 command_end_log_signal(job, pin);
@@ -95,8 +157,7 @@ void do_command_action(message_struct_t* message, const String command_string) {
         }
 
         case COMMAND_GET_PIN_MODE: {
-            String pin = "";
-            pin.reserve(5);
+            pin_arg_t pin;
 
             if (has_object_given_key(message, pin, "pin") == true) {
                 command_get_pin_mode(job, pin);
@@ -105,10 +166,8 @@ void do_command_action(message_struct_t* message, const String command_string) {
         }
 
         case COMMAND_SET_PIN_MODE: {
-            String pin = "";
-            pin.reserve(5);
-            String mode = "";
-            mode.reserve(10);
+            pin_arg_t pin;
+            const char* mode;
 
             // FIXME Raise an error here if a specific field is missing.
             if (has_object_given_key(message, pin, "pin") &&
@@ -125,7 +184,10 @@ void do_command_action(message_struct_t* message, const String command_string) {
         }
 
         case COMMAND_SAVE_PIN_MODES: {
-            save_pin_modes();
+            if (save_pin_modes()) {
+                build_error(COMMAND_SAVE_PIN_MODES, "STORAGE_ERROR", "", job);
+                break;
+            }
             build_command(COMMAND_SAVE_PIN_MODES, MSG_OUTPUT, job);
             break;
         }
@@ -137,18 +199,213 @@ void do_command_action(message_struct_t* message, const String command_string) {
         }
 
         case COMMAND_TRIGGER_PULSE: {
-            String pin = "";
-            pin.reserve(5);
+            pin_arg_t pin;
+            unsigned int duration; // In ms.
+
+            if (has_object_given_key(message, pin, "pin") and
+                get_optional_key(message, duration, "duration", 100)) {
+                command_trigger_pulse(job, pin, duration);
+            }
+            break;
+        }
+
+        case COMMAND_CANCEL_JOB: {
+            long target;
+
+            if (has_object_given_key(message, target, "target")) {
+                command_cancel_job(job, target);
+            }
+            break;
+        }
+
+        case COMMAND_SYNC_TIME: {
+            uint64_t t0;
+
+            if (has_object_given_key(message, t0, "t0")) {
+                command_sync_time(job, t0);
+            }
+            break;
+        }
+
+        case COMMAND_GRANT_CREDIT: {
+            long credit;
+
+            if (has_object_given_key(message, credit, "credit")) {
+                command_grant_credit(job, credit);
+            }
+            break;
+        }
+
+        case COMMAND_ADD_RULE: {
+            const char* condition;
+            const char* action;
+
+            if (has_object_given_key(message, condition, "condition") &&
+                has_object_given_key(message, action, "action")) {
+                command_add_rule(job, message, condition, action);
+            }
+            break;
+        }
+
+        case COMMAND_DELETE_RULE: {
+            long rule;
+
+            if (has_object_given_key(message, rule, "rule")) {
+                command_delete_rule(job, rule);
+            }
+            break;
+        }
+
+        case COMMAND_GET_RULE: {
+            long rule;
+
+            if (has_object_given_key(message, rule, "rule")) {
+                command_get_rule(job, rule);
+            }
+            break;
+        }
+
+        case COMMAND_START_CONTROL_LOOP: {
+            pin_arg_t input;
+            pin_arg_t output;
+
+            if (has_object_given_key(message, input, "input") &&
+                has_object_given_key(message, output, "output")) {
+                command_start_control_loop(job, message, input, output);
+            }
+            break;
+        }
+
+        case COMMAND_UPDATE_CONTROL_LOOP: {
+            command_update_control_loop(job, message);
+            break;
+        }
+
+        case COMMAND_STOP_CONTROL_LOOP: {
+            command_stop_control_loop(job);
+            break;
+        }
+
+        case COMMAND_GET_CONTROL_LOOP: {
+            command_get_control_loop(job);
+            break;
+        }
+
+        case COMMAND_WATCH: {
+            pin_arg_t pin;
 
             if (has_object_given_key(message, pin, "pin")) {
-                command_trigger_pulse(job, pin);
+                command_watch(job, message, pin);
             }
             break;
         }
 
+        case COMMAND_END_WATCH: {
+            pin_arg_t pin;
+
+            if (has_object_given_key(message, pin, "pin")) {
+                command_end_watch(job, pin);
+            }
+            break;
+        }
+
+        case COMMAND_MEASURE_FREQUENCY: {
+            pin_arg_t pin;
+            long gate;
+
+            if (has_object_given_key(message, pin, "pin") and
+                has_object_given_key(message, gate, "gate")) {
+                command_measure_frequency(job, pin, gate);
+            }
+            break;
+        }
+
+        case COMMAND_END_MEASURE_FREQUENCY: {
+            pin_arg_t pin;
+
+            if (has_object_given_key(message, pin, "pin")) {
+                command_end_measure_frequency(job, pin);
+            }
+            break;
+        }
+
+        case COMMAND_ADD_COUNTER: {
+            unsigned int counter;
+            const char* mode;
+
+            if (has_object_given_key(message, counter, "counter") and
+                has_object_given_key(message, mode, "mode")) {
+                command_add_counter(job, message, counter, mode);
+            }
+            break;
+        }
+
+        case COMMAND_DELETE_COUNTER: {
+            unsigned int counter;
+
+            if (has_object_given_key(message, counter, "counter")) {
+                command_delete_counter(job, counter);
+            }
+            break;
+        }
+
+        case COMMAND_RESET_COUNTER: {
+            unsigned int counter;
+
+            if (has_object_given_key(message, counter, "counter")) {
+                command_reset_counter(job, counter);
+            }
+            break;
+        }
+
+        case COMMAND_GET_COUNTERS: {
+            command_get_counters(job, message);
+            break;
+        }
+
+        case COMMAND_SET_DEBOUNCE: {
+            pin_arg_t pin;
+            unsigned int time;
+
+            if (has_object_given_key(message, pin, "pin") and
+                has_object_given_key(message, time, "time")) {
+                command_set_debounce(job, message, pin, time);
+            }
+            break;
+        }
+
+        case COMMAND_GET_DEBOUNCE: {
+            pin_arg_t pin;
+
+            if (has_object_given_key(message, pin, "pin")) {
+                command_get_debounce(job, pin);
+            }
+            break;
+        }
+
+        case COMMAND_SET_ADC: {
+            pin_arg_t pin;
+
+            if (has_object_given_key(message, pin, "pin")) {
+                command_set_adc(job, message, pin);
+            }
+            break;
+        }
+
+        case COMMAND_GET_STORAGE: {
+            command_get_storage(job);
+            break;
+        }
+
+        case COMMAND_BATCH: {
+            command_batch(job, message);
+            break;
+        }
+
         case COMMAND_INVALID:
         default: {
-            String error_message = "Command '" + command_string + "' is not valid";
+            String error_message =
+                String("Command '") + command_string + "' is not valid";
             // TODO This isn't flexible enough. Allow any string so that
             // incorrectly spelled commands can go back properly.
             build_error(COMMAND_INVALID, "INVALID_COMMAND", error_message, job);
@@ -162,21 +419,25 @@ void do_command_action(message_struct_t* message, const String command_string) {
 // ====================================================================
 
 void command_ready() {
-    build_command(COMMAND_READY, MSG_OUTPUT, 0); // READY is always job 0.
+    // READY is always job 0.
+    build_command(COMMAND_READY, MSG_OUTPUT, 0, "boot", get_boot_count());
 }
 
-void command_log_signal(unsigned int job, const String& pin, int period) {
-    auto pin_object = get_valid_pin_type(pin);
+void command_log_signal(
+    unsigned int job, pin_arg_t pin, unsigned int period, bool persistent) {
+    auto pin_object = pin.pin;
     if (pin_object == PIN_INVALID_PIN) {
         build_error(COMMAND_LOG_SIGNAL, "INVALID_PIN", "", job);
+        return;
     }
 
     auto pin_mode = get_pin_mode(pin_object);
     if (pin_mode != PIN_MODE_INPUT) {
         build_error(COMMAND_LOG_SIGNAL, "INVALID_INPUT_PIN", "", job);
+        return;
     }
 
-    auto error = log_signal(job, pin_object, period);
+    auto error = log_signal(job, pin_object, period, persistent);
     if (error) {
         String err;
         String msg = "";
@@ -184,17 +445,18 @@ void command_log_signal(unsigned int job, const String& pin, int period) {
             err = "TOO_MANY_LOGGING_JOBS";
         } else if (error == 2) {
             err = "DUPLICATE_LOGGING_JOB";
+        } else {
+            err = "STORAGE_ERROR";
         }
         build_error(COMMAND_LOG_SIGNAL, err, msg, job);
         return;
     }
 }
 
-void command_end_log_signal(unsigned int job, const String& pin) {
-    auto pin_object = get_valid_pin_type(pin);
-    auto error = end_log_signal(pin_object);
+void command_end_log_signal(unsigned int job, pin_arg_t pin) {
+    auto error = end_log_signal(pin.pin);
     if (error) {
-        String err = "LOGGING_REQUEST_NOT_FOUND";
+        String err = (error == 1) ? "LOGGING_REQUEST_NOT_FOUND" : "STORAGE_ERROR";
         String msg = "";
         build_error(COMMAND_END_LOG_SIGNAL, err, msg, job);
         return;
@@ -203,148 +465,149 @@ void command_end_log_signal(unsigned int job, const String& pin) {
     build_command(COMMAND_END_LOG_SIGNAL, MSG_OUTPUT, job);
 }
 
-void command_get_input(unsigned int job, const String pin_string) {
-    pin_t pin = get_valid_pin_type(pin_string);
-    if (pin != PIN_INVALID_PIN) {
-        pin_type_t pin_type = get_pin_type(pin);
+void command_get_input(unsigned int job, pin_arg_t pin) {
+    if (pin.pin != PIN_INVALID_PIN) {
+        pin_type_t pin_type = get_pin_type(pin.pin);
         if (pin_type == PIN_DIGITAL) {
-            String pin_value = "";
-            pin_value.reserve(5);
-            pin_value = (read_digital_from_pin(pin) == HIGH) ? "HIGH" : "LOW";
             build_command(
                 COMMAND_GET_INPUT,
                 MSG_OUTPUT,
                 job,
                 "pin",
-                pin_string,
+                pin.name,
                 "level",
-                pin_value);
+                get_pin_level_string(read_digital_from_pin(pin.pin)));
         } else {
-            auto pin_value = read_analog_from_pin(pin);
+            auto pin_value = read_analog_from_pin(pin.pin);
             build_command(
                 COMMAND_GET_INPUT,
                 MSG_OUTPUT,
                 job,
                 "pin",
-                pin_string,
+                pin.name,
                 "level",
                 pin_value);
         }
     } else {
-        String error_message = "Pin '" + pin_string + "' is not valid";
+        String error_message = String("Pin '") + pin.name + "' is not valid";
         build_error(COMMAND_GET_INPUT, "INVALID_PIN", error_message, job);
     }
 }
 
+// Reads the level under `key` for the output `pin`: HIGH or LOW for digital
+// pins and a duty cycle of 0 to 255 for analog ones. Reports an error and
+// returns -1 if the key is missing or the level isn't valid.
+int get_output_level(
+    unsigned int job, message_struct_t* message, pin_t pin, const char* key) {
+    int level;
+    if (get_pin_type(pin) == PIN_DIGITAL) {
+        const char* level_string;
+        if (not has_object_given_key(message, level_string, key)) {
+            return -1;
+        }
+        level = get_valid_pin_level(level_string);
+    } else {
+        long level_value;
+        if (not has_object_given_key(message, level_value, key)) {
+            return -1;
+        }
+        level = (level_value < 0 or level_value > 255) ? -1 : level_value;
+    }
+
+    if (level < 0) {
+        String error_message =
+            "Level '" + message->fields[key].as<String>() + "' is not valid";
+        build_error(message->command, "INVALID_OUTPUT_LEVEL", error_message, job);
+    }
+    return level;
+}
+
 void command_set_output(
-    unsigned int job, const String pin_string, const String level_string) {
-    pin_t pin = get_valid_pin_type(pin_string);
-    if (pin != PIN_INVALID_PIN) {
-        pin_mode_t pin_mode = get_pin_mode(pin);
-        if (pin_mode == PIN_MODE_OUTPUT) {
-            bool couldSetOutput = true;
-
-            pin_type_t pin_type = get_pin_type(pin);
-            if (pin_type == PIN_DIGITAL) {
-                if (level_string.equals("HIGH")) {
-                    write_digital_to_pin(pin, HIGH);
-                } else if (level_string.equals("LOW")) {
-                    write_digital_to_pin(pin, LOW);
-                } else {
-                    couldSetOutput = false;
-                }
+    unsigned int job, message_struct_t* message, pin_arg_t pin, bool scheduled, uint64_t at) {
+    if (pin.pin == PIN_INVALID_PIN) {
+        String error_message = String("Pin '") + pin.name + "' is not valid";
+        build_error(COMMAND_SET_OUTPUT, "INVALID_PIN", error_message, job);
+        return;
+    }
 
-                if (couldSetOutput == true) {
-                    build_command(
-                        COMMAND_SET_OUTPUT,
-                        MSG_OUTPUT,
-                        job,
-                        "pin",
-                        pin_string,
-                        "level",
-                        level_string);
-                } else {
-                    String error_message = "Level '" + level_string + "' is not valid";
-                    build_error(
-                        COMMAND_SET_OUTPUT, "INVALID_OUTPUT_LEVEL", error_message, job);
-                }
-            } else // (pin_type == PIN_ANALOG)
-            {
-                int analog_value = level_string.toInt();
-                if (analog_value <= 255) {
-                    write_analog_to_pin(pin, analog_value);
-                } else {
-                    couldSetOutput = false;
-                }
+    pin_mode_t pin_mode = get_pin_mode(pin.pin);
+    if (pin_mode != PIN_MODE_OUTPUT) {
+        String error_message = String("Pin '") + pin.name + "' is not an output";
+        build_error(COMMAND_SET_OUTPUT, "INVALID_OUTPUT_PIN", error_message, job);
+        return;
+    }
 
-                if (couldSetOutput == true) {
-                    build_command(
-                        COMMAND_SET_OUTPUT,
-                        MSG_OUTPUT,
-                        job,
-                        "pin",
-                        pin_string,
-                        "level",
-                        analog_value);
-                } else {
-                    String error_message = "Level '" + level_string + "' is not valid";
-                    build_error(
-                        COMMAND_SET_OUTPUT, "INVALID_OUTPUT_LEVEL", error_message, job);
-                }
-            }
+    int level = get_output_level(job, message, pin.pin, "level");
+    if (level < 0) {
+        return;
+    }
 
-        } else {
-            String error_message = "Pin '" + pin_string + "' is not an output";
-            build_error(COMMAND_SET_OUTPUT, "INVALID_OUTPUT_PIN", error_message, job);
+    // Scheduled outputs are acknowledged now and answered by the scheduler
+    // once they've run.
+    if (scheduled) {
+        if (schedule_output(job, pin.pin, level, at, true)) {
+            build_error(COMMAND_SET_OUTPUT, "TOO_MANY_SCHEDULED_JOBS", "", job);
+            return;
         }
+        build_command(COMMAND_SET_OUTPUT, MSG_ACK, job, "pin", pin.name, "at", at);
+        return;
+    }
+
+    if (get_pin_type(pin.pin) == PIN_DIGITAL) {
+        write_digital_to_pin(pin.pin, level);
+        build_command(
+            COMMAND_SET_OUTPUT,
+            MSG_OUTPUT,
+            job,
+            "pin",
+            pin.name,
+            "level",
+            get_pin_level_string(level));
     } else {
-        String error_message = "Pin '" + pin_string + "' is not valid";
-        build_error(COMMAND_SET_OUTPUT, "INVALID_PIN", error_message, job);
+        write_analog_to_pin(pin.pin, level);
+        build_command(COMMAND_SET_OUTPUT, MSG_OUTPUT, job, "pin", pin.name, "level", level);
     }
 }
 
-void command_get_pin_mode(unsigned int job, const String pin_string) {
-    pin_t pin = get_valid_pin_type(pin_string);
-    if (pin != PIN_INVALID_PIN) {
-        pin_mode_t pin_mode = get_pin_mode(pin);
+void command_get_pin_mode(unsigned int job, pin_arg_t pin) {
+    if (pin.pin != PIN_INVALID_PIN) {
+        pin_mode_t pin_mode = get_pin_mode(pin.pin);
 
         build_command(
             COMMAND_GET_PIN_MODE,
             MSG_OUTPUT,
             job,
             "pin",
-            pin_string,
+            pin.name,
             "mode",
             get_pin_mode_string(pin_mode));
     } else {
-        String error_message = "Pin '" + pin_string + "' is not valid";
+        String error_message = String("Pin '") + pin.name + "' is not valid";
         build_error(COMMAND_GET_PIN_MODE, "INVALID_PIN", error_message, job);
     }
 }
 
-void command_set_pin_mode(
-    unsigned int job, const String pin_string, const String mode_string) {
-    pin_t pin = get_valid_pin_type(pin_string);
-
-    if (pin != PIN_INVALID_PIN) {
-        pin_mode_type_t pin_mode_type = get_pin_mode_type(pin);
+void command_set_pin_mode(unsigned int job, pin_arg_t pin, const char* mode_string) {
+    if (pin.pin != PIN_INVALID_PIN) {
+        pin_mode_type_t pin_mode_type = get_pin_mode_type(pin.pin);
         pin_mode_t pin_mode_target = get_valid_pin_mode(mode_string);
         switch (pin_mode_target) {
             case PIN_MODE_INPUT:
             case PIN_MODE_INPUT_PULLUP:
                 if ((pin_mode_type == PIN_MODE_TYPE_INPUT_ONLY) ||
                     (pin_mode_type == PIN_MODE_TYPE_INPUT_AND_OUTPUT)) {
-                    set_pin_mode(pin, pin_mode_target);
+                    set_pin_mode(pin.pin, pin_mode_target);
                     build_command(
                         COMMAND_SET_PIN_MODE,
                         MSG_OUTPUT,
                         job,
                         "pin",
-                        pin_string,
+                        pin.name,
                         "mode",
                         mode_string);
                 } else {
-                    String error_message = "Pin '" + pin_string + "' is a output only";
+                    String error_message =
+                        String("Pin '") + pin.name + "' is a output only";
                     build_error(
                         COMMAND_SET_PIN_MODE, "INVALID_PIN_MODE", error_message, job);
                 }
@@ -353,48 +616,860 @@ void command_set_pin_mode(
             case PIN_MODE_OUTPUT:
                 if ((pin_mode_type == PIN_MODE_TYPE_OUTPUT_ONLY) ||
                     (pin_mode_type == PIN_MODE_TYPE_INPUT_AND_OUTPUT)) {
-                    set_pin_mode(pin, pin_mode_target);
+                    set_pin_mode(pin.pin, pin_mode_target);
 
                     build_command(
                         COMMAND_SET_PIN_MODE,
                         MSG_OUTPUT,
                         job,
                         "pin",
-                        pin_string,
+                        pin.name,
                         "mode",
                         mode_string);
                 } else {
-                    String error_message = "Pin '" + pin_string + "' is a input only";
+                    String error_message =
+                        String("Pin '") + pin.name + "' is a input only";
                     build_error(
                         COMMAND_SET_PIN_MODE, "INVALID_PIN_MODE", error_message, job);
                 }
                 break;
 
-            default:
+            default: {
+                String error_message = String("Mode '") + mode_string + "' is not valid";
+                build_error(COMMAND_SET_PIN_MODE, "INVALID_PIN_MODE", error_message, job);
                 break;
+            }
         }
     } else {
-        String error_message = "Pin '" + pin_string + "' is not valid";
+        String error_message = String("Pin '") + pin.name + "' is not valid";
         build_error(COMMAND_SET_PIN_MODE, "INVALID_PIN", error_message, job);
     }
 }
 
-void command_trigger_pulse(unsigned int job, const String pin_string) {
-    pin_t pin = get_valid_pin_type(pin_string);
+// The pulse runs in the background: it's acknowledged now and answered by the
+// scheduler once it ended.
+void command_trigger_pulse(unsigned int job, pin_arg_t pin, unsigned int duration) {
+    if (pin.pin == PIN_INVALID_PIN) {
+        String error_message = String("Pin '") + pin.name + "' is not valid";
+        build_error(COMMAND_TRIGGER_PULSE, "INVALID_PIN", error_message, job);
+        return;
+    }
+    if (get_pin_mode(pin.pin) != PIN_MODE_OUTPUT) {
+        String error_message = String("Pin '") + pin.name + "' is not an output";
+        build_error(COMMAND_TRIGGER_PULSE, "INVALID_OUTPUT_PIN", error_message, job);
+        return;
+    }
+    auto error = schedule_pulse(job, pin.pin, (uint64_t) duration * 1000);
+    if (error) {
+        String err = (error == 1) ? "TOO_MANY_SCHEDULED_JOBS" : "PIN_BUSY";
+        build_error(COMMAND_TRIGGER_PULSE, err, "", job);
+        return;
+    }
+
+    build_command(COMMAND_TRIGGER_PULSE, MSG_ACK, job, "pin", pin.name);
+}
+
+void command_cancel_job(unsigned int job, unsigned int target) {
+    if (cancel_scheduled_job(target)) {
+        String error_message = "No pending job " + String(target);
+        build_error(COMMAND_CANCEL_JOB, "JOB_NOT_FOUND", error_message, job);
+        return;
+    }
+
+    // Resolve the cancelled job so that the host isn't left waiting for it.
+    build_error(COMMAND_SET_OUTPUT, "CANCELLED", "", target);
+    build_command(COMMAND_CANCEL_JOB, MSG_OUTPUT, job, "target", target);
+}
+
+// NTP-style exchange: t0 is the host's send time, t1 the device time at which
+// the request was received and t2 the device time at which the reply is sent.
+void command_sync_time(unsigned int job, uint64_t t0) {
+    build_command(
+        COMMAND_SYNC_TIME,
+        MSG_OUTPUT,
+        job,
+        "t0",
+        t0,
+        "t1",
+        serial_receive_time(),
+        "t2",
+        clock_micros());
+}
+
+void command_grant_credit(unsigned int job, int credit) {
+    grant_logging_credit(credit);
+    build_command(COMMAND_GRANT_CREDIT, MSG_OUTPUT, job, "credit", get_logging_credit());
+}
+
+// Reads the pin stored under `key`. Reports an error and returns
+// PIN_INVALID_PIN if the key is missing or the pin doesn't exist.
+pin_t get_rule_pin(unsigned int job, message_struct_t* message, const char* key) {
+    pin_arg_t pin;
+    if (not has_object_given_key(message, pin, key)) {
+        return PIN_INVALID_PIN;
+    }
+
+    if (pin.pin == PIN_INVALID_PIN) {
+        String error_message = String("Pin '") + pin.name + "' is not valid";
+        build_error(COMMAND_ADD_RULE, "INVALID_PIN", error_message, job);
+    }
+    return pin.pin;
+}
+
+void command_add_rule(
+    unsigned int job,
+    message_struct_t* message,
+    const char* condition_string,
+    const char* action_string) {
+    rule_t rule{};
+    rule.condition = get_valid_rule_condition(condition_string);
+    if (rule.condition == RULE_CONDITION_NOT_VALID) {
+        String error_message = String("Condition '") + condition_string + "' is not valid";
+        build_error(COMMAND_ADD_RULE, "INVALID_CONDITION", error_message, job);
+        return;
+    }
+
+    rule.action = get_valid_rule_action(action_string);
+    if (rule.action == RULE_ACTION_NOT_VALID) {
+        String error_message = String("Action '") + action_string + "' is not valid";
+        build_error(COMMAND_ADD_RULE, "INVALID_ACTION", error_message, job);
+        return;
+    }
+
+    long value;
+
+    switch (rule.condition) {
+        case RULE_CONDITION_TIMER:
+            if (not has_object_given_key(message, rule.interval, "interval")) {
+                return;
+            }
+            if (rule.interval == 0) {
+                build_error(COMMAND_ADD_RULE, "INVALID_INTERVAL", "", job);
+                return;
+            }
+            break;
+
+        case RULE_CONDITION_ABOVE:
+        case RULE_CONDITION_BELOW:
+            rule.pin = get_rule_pin(job, message, "pin");
+            if (rule.pin == PIN_INVALID_PIN) {
+                return;
+            }
+            if (get_pin_type(rule.pin) != PIN_ANALOG or
+                get_pin_mode(rule.pin) != PIN_MODE_INPUT) {
+                build_error(COMMAND_ADD_RULE, "INVALID_INPUT_PIN", "", job);
+                return;
+            }
+            if (not has_object_given_key(message, value, "threshold")) {
+                return;
+            }
+            rule.threshold = value;
+            if (not get_optional_key(message, rule.hysteresis, "hysteresis", 0)) {
+                return;
+            }
+            break;
+
+        default:
+            rule.pin = get_rule_pin(job, message, "pin");
+            if (rule.pin == PIN_INVALID_PIN) {
+                return;
+            }
+            if (get_pin_type(rule.pin) != PIN_DIGITAL) {
+                build_error(COMMAND_ADD_RULE, "INVALID_INPUT_PIN", "", job);
+                return;
+            }
+            break;
+    }
+
+    if (rule.action != RULE_ACTION_EVENT) {
+        rule.target = get_rule_pin(job, message, "target");
+        if (rule.target == PIN_INVALID_PIN) {
+            return;
+        }
+    }
+
+    switch (rule.action) {
+        case RULE_ACTION_SET_OUTPUT:
+            if (get_pin_mode(rule.target) != PIN_MODE_OUTPUT) {
+                build_error(COMMAND_ADD_RULE, "INVALID_OUTPUT_PIN", "", job);
+                return;
+            }
+            rule.level = get_output_level(job, message, rule.target, "level");
+            if (rule.level < 0) {
+                return;
+            }
+            break;
+
+        case RULE_ACTION_PULSE:
+            if (get_pin_type(rule.target) != PIN_DIGITAL or
+                get_pin_mode(rule.target) != PIN_MODE_OUTPUT) {
+                build_error(COMMAND_ADD_RULE, "INVALID_OUTPUT_PIN", "", job);
+                return;
+            }
+            if (not has_object_given_key(message, rule.duration, "duration")) {
+                return;
+            }
+            break;
+
+        case RULE_ACTION_START_LOG:
+            if (get_pin_mode(rule.target) != PIN_MODE_INPUT) {
+                build_error(COMMAND_ADD_RULE, "INVALID_INPUT_PIN", "", job);
+                return;
+            }
+            if (not has_object_given_key(message, rule.duration, "period")) {
+                return;
+            }
+            break;
 
-    if (pin != PIN_INVALID_PIN) {
-        pin_mode_t pin_mode = get_pin_mode(pin);
-        if (pin_mode == PIN_MODE_OUTPUT) {
-            trigger_pulse(pin);
-            build_command(COMMAND_TRIGGER_PULSE, MSG_OUTPUT, job, "pin", pin_string);
+        default:
+            break;
+    }
+
+    auto error = add_rule(job, rule);
+    if (error) {
+        String err;
+        if (error == 1) {
+            err = "TOO_MANY_RULES";
+        } else if (error == 2) {
+            err = "DUPLICATE_RULE";
+        } else {
+            err = "PIN_BUSY";
+        }
+        build_error(COMMAND_ADD_RULE, err, "", job);
+        return;
+    }
+
+    build_command(COMMAND_ADD_RULE, MSG_OUTPUT, job);
+}
+
+void command_delete_rule(unsigned int job, unsigned int rule) {
+    if (delete_rule(rule)) {
+        build_error(COMMAND_DELETE_RULE, "RULE_NOT_FOUND", "", job);
+        return;
+    }
+
+    build_command(COMMAND_DELETE_RULE, MSG_OUTPUT, job, "rule", rule);
+}
+
+void command_get_rule(unsigned int job, unsigned int rule) {
+    rule_stats_t stats;
+    if (get_rule_stats(rule, &stats)) {
+        build_error(COMMAND_GET_RULE, "RULE_NOT_FOUND", "", job);
+        return;
+    }
+
+    build_command(
+        COMMAND_GET_RULE,
+        MSG_OUTPUT,
+        job,
+        "rule",
+        rule,
+        "hits",
+        stats.hits,
+        "last_reaction",
+        stats.last_reaction,
+        "max_reaction",
+        stats.max_reaction,
+        "failures",
+        stats.failures);
+}
+
+void command_start_control_loop(
+    unsigned int job, message_struct_t* message, pin_arg_t input, pin_arg_t output) {
+    control_loop_config_t config{};
+    config.input = input.pin;
+    config.output = output.pin;
+    if (config.input == PIN_INVALID_PIN or config.output == PIN_INVALID_PIN) {
+        build_error(COMMAND_START_CONTROL_LOOP, "INVALID_PIN", "", job);
+        return;
+    }
+    if (get_pin_type(config.input) != PIN_ANALOG or
+        get_pin_mode(config.input) != PIN_MODE_INPUT) {
+        String error_message = String("Pin '") + input.name + "' is not an analog input";
+        build_error(COMMAND_START_CONTROL_LOOP, "INVALID_INPUT_PIN", error_message, job);
+        return;
+    }
+    if (get_pin_type(config.output) != PIN_ANALOG or
+        get_pin_mode(config.output) != PIN_MODE_OUTPUT) {
+        String error_message = String("Pin '") + output.name + "' is not an analog output";
+        build_error(COMMAND_START_CONTROL_LOOP, "INVALID_OUTPUT_PIN", error_message, job);
+        return;
+    }
+
+    long setpoint;
+    float kp;
+    if (not has_object_given_key(message, setpoint, "setpoint") or
+        not has_object_given_key(message, kp, "kp") or
+        not has_object_given_key(message, config.period, "period") or
+        not get_optional_key(message, config.telemetry, "telemetry", 0)) {
+        return;
+    }
+
+    config.setpoint = setpoint;
+    config.kp = kp;
+    config.ki = message->fields["ki"] | 0.0f;
+    config.kd = message->fields["kd"] | 0.0f;
+    config.min = message->fields["min"] | 0;
+    config.max = message->fields["max"] | 255;
+
+    auto error = start_control_loop(job, config);
+    if (error) {
+        String err;
+        String msg = "";
+        if (error == 1) {
+            err = "CONTROL_LOOP_RUNNING";
         } else {
-            String error_message = "Pin '" + pin_string + "' is not an output";
-            build_error(COMMAND_TRIGGER_PULSE, "INVALID_OUTPUT_PIN", error_message, job);
+            err = "INVALID_CONFIGURATION";
+            msg = "period must be " + String(MIN_CONTROL_LOOP_PERIOD_US) + " to " +
+                  String(MAX_CONTROL_LOOP_PERIOD_US) + " us, 0 <= min <= max <= " +
+                  String(MAX_CONTROL_LOOP_OUTPUT) + " and the gains in range";
         }
+        build_error(COMMAND_START_CONTROL_LOOP, err, msg, job);
+        return;
+    }
+
+    build_command(COMMAND_START_CONTROL_LOOP, MSG_OUTPUT, job);
+}
+
+void command_update_control_loop(unsigned int job, message_struct_t* message) {
+    control_loop_config_t config;
+    control_loop_stats_t stats;
+    if (get_control_loop(&config, &stats)) {
+        build_error(COMMAND_UPDATE_CONTROL_LOOP, "NO_CONTROL_LOOP", "", job);
+        return;
+    }
+
+    // Every key is optional and defaults to its current value.
+    config.setpoint = message->fields["setpoint"] | config.setpoint;
+    config.kp = message->fields["kp"] | config.kp;
+    config.ki = message->fields["ki"] | config.ki;
+    config.kd = message->fields["kd"] | config.kd;
+    if (not get_optional_key(message, config.telemetry, "telemetry", config.telemetry)) {
+        return;
+    }
+    if (update_control_loop(config)) {
+        build_error(
+            COMMAND_UPDATE_CONTROL_LOOP, "INVALID_CONFIGURATION", "gains out of range", job);
+        return;
+    }
+
+    build_command(COMMAND_UPDATE_CONTROL_LOOP, MSG_OUTPUT, job);
+}
+
+void command_stop_control_loop(unsigned int job) {
+    if (stop_control_loop()) {
+        build_error(COMMAND_STOP_CONTROL_LOOP, "NO_CONTROL_LOOP", "", job);
+        return;
+    }
+
+    build_command(COMMAND_STOP_CONTROL_LOOP, MSG_OUTPUT, job);
+}
+
+void command_get_control_loop(unsigned int job) {
+    control_loop_config_t config;
+    control_loop_stats_t stats;
+    if (get_control_loop(&config, &stats)) {
+        build_error(COMMAND_GET_CONTROL_LOOP, "NO_CONTROL_LOOP", "", job);
+        return;
+    }
+
+    build_command(
+        COMMAND_GET_CONTROL_LOOP,
+        MSG_OUTPUT,
+        job,
+        "setpoint",
+        config.setpoint,
+        "kp",
+        config.kp,
+        "ki",
+        config.ki,
+        "kd",
+        config.kd,
+        "iterations",
+        stats.iterations,
+        "last_exec",
+        stats.last_exec,
+        "max_exec",
+        stats.max_exec,
+        "avg_exec",
+        stats.avg_exec,
+        "overruns",
+        stats.overruns);
+}
+
+void command_watch(unsigned int job, message_struct_t* message, pin_arg_t pin_arg) {
+    pin_t pin = pin_arg.pin;
+    if (pin == PIN_INVALID_PIN) {
+        String error_message = String("Pin '") + pin_arg.name + "' is not valid";
+        build_error(COMMAND_WATCH, "INVALID_PIN", error_message, job);
+        return;
+    }
+    if (get_pin_type(pin) != PIN_ANALOG or get_pin_mode(pin) != PIN_MODE_INPUT) {
+        String error_message = String("Pin '") + pin_arg.name + "' is not an analog input";
+        build_error(COMMAND_WATCH, "INVALID_INPUT_PIN", error_message, job);
+        return;
+    }
+
+    // Both thresholds are optional, but at least one is required.
+    if (not message->fields.containsKey("low") and not message->fields.containsKey("high")) {
+        build_error(COMMAND_WATCH, "INVALID_KEY", "Key 'low' or 'high' is missing", job);
+        return;
+    }
+
+    watch_config_t config;
+    config.low = message->fields["low"] | INT32_MIN;
+    config.high = message->fields["high"] | INT32_MAX;
+    if (not get_optional_key(message, config.hysteresis, "hysteresis", 0) or
+        not get_optional_key(message, config.dwell, "dwell", 0)) {
+        return;
+    }
+    bool persistent = message->fields["persistent"] | false;
+
+    auto error = watch(job, pin, config, persistent);
+    if (error) {
+        String err;
+        if (error == 1) {
+            err = "TOO_MANY_WATCHES";
+        } else if (error == 2) {
+            err = "DUPLICATE_WATCH";
+        } else {
+            err = "STORAGE_ERROR";
+        }
+        build_error(COMMAND_WATCH, err, "", job);
+        return;
+    }
+
+    build_command(COMMAND_WATCH, MSG_OUTPUT, job, "pin", pin_arg.name);
+}
+
+void command_end_watch(unsigned int job, pin_arg_t pin) {
+    auto error = end_watch(pin.pin);
+    if (error) {
+        build_error(
+            COMMAND_END_WATCH,
+            (error == 1) ? "WATCH_NOT_FOUND" : "STORAGE_ERROR",
+            "",
+            job);
+        return;
+    }
+
+    build_command(COMMAND_END_WATCH, MSG_OUTPUT, job, "pin", pin.name);
+}
+
+void command_measure_frequency(unsigned int job, pin_arg_t pin_arg, int gate) {
+    pin_t pin = pin_arg.pin;
+    if (pin == PIN_INVALID_PIN) {
+        String error_message = String("Pin '") + pin_arg.name + "' is not valid";
+        build_error(COMMAND_MEASURE_FREQUENCY, "INVALID_PIN", error_message, job);
+        return;
+    }
+    if (get_pin_type(pin) != PIN_DIGITAL or get_pin_mode(pin) == PIN_MODE_OUTPUT) {
+        String error_message = String("Pin '") + pin_arg.name + "' is not a digital input";
+        build_error(COMMAND_MEASURE_FREQUENCY, "INVALID_INPUT_PIN", error_message, job);
+        return;
+    }
+
+    auto error = measure_frequency(job, pin, gate < 0 ? 0 : gate);
+    if (error) {
+        String err;
+        if (error == 1) {
+            err = "TOO_MANY_MEASUREMENTS";
+        } else if (error == 2) {
+            err = "PIN_BUSY";
+        } else {
+            err = "INVALID_GATE";
+        }
+        build_error(COMMAND_MEASURE_FREQUENCY, err, "", job);
+        return;
+    }
+
+    build_command(COMMAND_MEASURE_FREQUENCY, MSG_OUTPUT, job, "pin", pin_arg.name);
+}
+
+void command_end_measure_frequency(unsigned int job, pin_arg_t pin) {
+    if (end_measure_frequency(pin.pin)) {
+        build_error(COMMAND_END_MEASURE_FREQUENCY, "MEASUREMENT_NOT_FOUND", "", job);
+        return;
+    }
+
+    build_command(COMMAND_END_MEASURE_FREQUENCY, MSG_OUTPUT, job, "pin", pin.name);
+}
+
+pin_t get_counter_pin(unsigned int job, message_struct_t* message, const char* key) {
+    pin_arg_t pin;
+    if (not has_object_given_key(message, pin, key)) {
+        return PIN_INVALID_PIN;
+    }
+
+    if (pin.pin == PIN_INVALID_PIN) {
+        String error_message = String("Pin '") + pin.name + "' is not valid";
+        build_error(COMMAND_ADD_COUNTER, "INVALID_PIN", error_message, job);
+        return PIN_INVALID_PIN;
+    }
+    if (get_pin_type(pin.pin) != PIN_DIGITAL or get_pin_mode(pin.pin) == PIN_MODE_OUTPUT) {
+        String error_message = String("Pin '") + pin.name + "' is not a digital input";
+        build_error(COMMAND_ADD_COUNTER, "INVALID_INPUT_PIN", error_message, job);
+        return PIN_INVALID_PIN;
+    }
+    return pin.pin;
+}
+
+void command_add_counter(
+    unsigned int job, message_struct_t* message, unsigned int id, const char* mode_string) {
+    counter_t counter{};
+    counter.mode = get_valid_counter_mode(mode_string);
+    if (counter.mode == COUNTER_MODE_NOT_VALID) {
+        String error_message = String("Mode '") + mode_string + "' is not valid";
+        build_error(COMMAND_ADD_COUNTER, "INVALID_MODE", error_message, job);
+        return;
+    }
+
+    counter.pin = get_counter_pin(job, message, "pin");
+    if (counter.pin == PIN_INVALID_PIN) {
+        return;
+    }
+    if (counter.mode == COUNTER_MODE_QUADRATURE) {
+        counter.pin_b = get_counter_pin(job, message, "pin_b");
+        if (counter.pin_b == PIN_INVALID_PIN) {
+            return;
+        }
+    }
+    if (not get_optional_key(message, counter.period, "period", 0)) {
+        return;
+    }
+
+    auto error = add_counter(id, job, counter);
+    if (error) {
+        String err;
+        if (error == 1) {
+            err = "TOO_MANY_COUNTERS";
+        } else if (error == 2) {
+            err = "DUPLICATE_COUNTER";
+        } else {
+            err = "PIN_BUSY";
+        }
+        build_error(COMMAND_ADD_COUNTER, err, "", job);
+        return;
+    }
+
+    build_command(COMMAND_ADD_COUNTER, MSG_OUTPUT, job, "counter", id);
+}
+
+void command_delete_counter(unsigned int job, unsigned int id) {
+    if (delete_counter(id)) {
+        build_error(COMMAND_DELETE_COUNTER, "COUNTER_NOT_FOUND", "", job);
+        return;
+    }
+
+    build_command(COMMAND_DELETE_COUNTER, MSG_OUTPUT, job, "counter", id);
+}
+
+void command_reset_counter(unsigned int job, unsigned int id) {
+    int64_t count;
+    if (reset_counter(id, &count)) {
+        build_error(COMMAND_RESET_COUNTER, "COUNTER_NOT_FOUND", "", job);
+        return;
+    }
+
+    build_command(COMMAND_RESET_COUNTER, MSG_OUTPUT, job, "counter", id, "count", count);
+}
+
+void command_get_counters(unsigned int job, message_struct_t* message) {
+    unsigned int ids[MAX_COUNTERS];
+    size_t n = 0;
+    JsonArray requested = message->fields["counters"].as<JsonArray>(); // Optional.
+    if (requested.isNull()) {
+        n = get_counter_ids(ids);
     } else {
-        String error_message = "Pin '" + pin_string + "' is not valid";
-        build_error(COMMAND_TRIGGER_PULSE, "INVALID_PIN", error_message, job);
+        for (JsonVariant id : requested) {
+            if (n == MAX_COUNTERS) {
+                break;
+            }
+            if (not id.is<unsigned int>()) {
+                build_error(COMMAND_GET_COUNTERS,
+                            "INVALID_KEY",
+                            "Key 'counters' must hold non-negative integers",
+                            job);
+                return;
+            }
+            ids[n++] = id.as<unsigned int>();
+        }
+    }
+
+    int64_t counts[MAX_COUNTERS];
+    uint64_t time;
+    if (latch_counters(ids, n, counts, &time)) {
+        build_error(COMMAND_GET_COUNTERS, "COUNTER_NOT_FOUND", "", job);
+        return;
+    }
+
+    StaticJsonDocument<capacity> doc;
+    doc["command"] = get_command_string(COMMAND_GET_COUNTERS, MSG_OUTPUT);
+    doc["job"] = job;
+    doc["time"] = time;
+    JsonObject counts_object = doc.createNestedObject("counts");
+    for (size_t i = 0; i < n; ++i) {
+        counts_object[String(ids[i])] = counts[i];
+    }
+
+    String output;
+    serializeJson(doc, output);
+    details::send_message(output, MSG_OUTPUT, job);
+}
+
+void command_set_debounce(
+    unsigned int job, message_struct_t* message, pin_arg_t pin_arg, uint32_t time) {
+    pin_t pin = pin_arg.pin;
+    if (pin == PIN_INVALID_PIN) {
+        String error_message = String("Pin '") + pin_arg.name + "' is not valid";
+        build_error(COMMAND_SET_DEBOUNCE, "INVALID_PIN", error_message, job);
+        return;
+    }
+
+    debounce_t debounce;
+    debounce.time = time;
+    const char* filter_string = message->fields["filter"] | "INTEGRATOR"; // Optional.
+    debounce.filter = get_valid_debounce_filter(filter_string);
+    if (debounce.filter == DEBOUNCE_FILTER_NOT_VALID) {
+        String error_message = String("Filter '") + filter_string + "' is not valid";
+        build_error(COMMAND_SET_DEBOUNCE, "INVALID_FILTER", error_message, job);
+        return;
+    }
+
+    auto error = set_debounce(pin, debounce);
+    if (error) {
+        String err;
+        if (error == 1) {
+            err = "INVALID_INPUT_PIN";
+        } else {
+            err = "INVALID_TIME";
+        }
+        build_error(COMMAND_SET_DEBOUNCE, err, "", job);
+        return;
     }
+
+    build_command(COMMAND_SET_DEBOUNCE, MSG_OUTPUT, job, "pin", pin_arg.name);
+}
+
+void command_get_debounce(unsigned int job, pin_arg_t pin) {
+    debounce_t debounce;
+    uint32_t glitches;
+    if (pin.pin == PIN_INVALID_PIN or get_debounce(pin.pin, &debounce, &glitches)) {
+        build_error(COMMAND_GET_DEBOUNCE, "DEBOUNCE_NOT_FOUND", "", job);
+        return;
+    }
+
+    build_command(
+        COMMAND_GET_DEBOUNCE,
+        MSG_OUTPUT,
+        job,
+        "pin",
+        pin.name,
+        "filter",
+        get_debounce_filter_string(debounce.filter),
+        "time",
+        debounce.time,
+        "glitches",
+        glitches);
+}
+
+void command_set_adc(unsigned int job, message_struct_t* message, pin_arg_t pin_arg) {
+    pin_t pin = pin_arg.pin;
+    if (pin == PIN_INVALID_PIN) {
+        String error_message = String("Pin '") + pin_arg.name + "' is not valid";
+        build_error(COMMAND_SET_ADC, "INVALID_PIN", error_message, job);
+        return;
+    }
+
+    // Missing keys fall back to the defaults of `analogRead`.
+    adc_config_t config;
+    config.resolution = message->fields["resolution"] | ADC_DEFAULT_RESOLUTION;
+    config.oversampling = message->fields["oversampling"] | 1;
+    config.settling = message->fields["settling"] | 0;
+    config.scan = message->fields["scan"] | false;
+
+    auto error = configure_adc(pin, config);
+    if (error) {
+        String err;
+        if (error == 1) {
+            err = "INVALID_INPUT_PIN";
+        } else {
+            err = "INVALID_CONFIGURATION";
+        }
+        build_error(COMMAND_SET_ADC, err, "", job);
+        return;
+    }
+
+    build_command(
+        COMMAND_SET_ADC,
+        MSG_OUTPUT,
+        job,
+        "pin",
+        pin_arg.name,
+        "resolution",
+        config.resolution,
+        "oversampling",
+        config.oversampling,
+        "settling",
+        config.settling,
+        "scan",
+        config.scan);
+}
+
+void command_get_storage(unsigned int job) {
+    storage_stats_t stats = get_storage_stats();
+    build_command(
+        COMMAND_GET_STORAGE,
+        MSG_OUTPUT,
+        job,
+        "boot",
+        get_boot_count(),
+        "boot_time",
+        clock_boot_time(),
+        "sequence",
+        stats.sequence,
+        "writes",
+        stats.writes,
+        "used",
+        stats.used,
+        "free",
+        stats.free);
+}
+
+typedef struct {
+    command_type_t command;
+    const char* keys[6];
+} required_keys_t;
+
+// The keys `run_command` requires. Atomic batches check them up front.
+const required_keys_t required_keys[] = {
+    {COMMAND_GET_INPUT, {"pin"}},
+    {COMMAND_SET_OUTPUT, {"pin", "level"}},
+    {COMMAND_LOG_SIGNAL, {"pin", "period"}},
+    {COMMAND_END_LOG_SIGNAL, {"pin"}},
+    {COMMAND_GET_PIN_MODE, {"pin"}},
+    {COMMAND_SET_PIN_MODE, {"pin", "mode"}},
+    {COMMAND_TRIGGER_PULSE, {"pin"}},
+    {COMMAND_CANCEL_JOB, {"target"}},
+    {COMMAND_SYNC_TIME, {"t0"}},
+    {COMMAND_GRANT_CREDIT, {"credit"}},
+    {COMMAND_ADD_RULE, {"condition", "action"}},
+    {COMMAND_DELETE_RULE, {"rule"}},
+    {COMMAND_GET_RULE, {"rule"}},
+    {COMMAND_START_CONTROL_LOOP, {"input", "output", "setpoint", "kp", "period"}},
+    {COMMAND_WATCH, {"pin"}},
+    {COMMAND_END_WATCH, {"pin"}},
+    {COMMAND_MEASURE_FREQUENCY, {"pin", "gate"}},
+    {COMMAND_END_MEASURE_FREQUENCY, {"pin"}},
+    {COMMAND_ADD_COUNTER, {"counter", "mode"}},
+    {COMMAND_DELETE_COUNTER, {"counter"}},
+    {COMMAND_RESET_COUNTER, {"counter"}},
+    {COMMAND_SET_DEBOUNCE, {"pin", "time"}},
+    {COMMAND_GET_DEBOUNCE, {"pin"}},
+    {COMMAND_SET_ADC, {"pin"}},
+};
+
+const size_t len_required_keys_array = sizeof(required_keys) / sizeof(required_keys[0]);
+
+// Checks what can be checked before anything runs: the command exists, its
+// keys are present and pins exist. Whether a pin is in the right mode may
+// depend on the items before it, so that's left to the handlers.
+bool validate_batch_item(JsonObject item, String& error_message) {
+    const char* command_string = item["command"] | "";
+    command_type_t command = get_command(command_string);
+    if (command == COMMAND_INVALID or command == COMMAND_BATCH or
+        command == COMMAND_READY or command == COMMAND_ERROR) {
+        error_message = String("Command '") + command_string + "' is not valid";
+        return false;
+    }
+
+    for (size_t i = 0; i < len_required_keys_array; i++) {
+        if (required_keys[i].command != command) {
+            continue;
+        }
+        for (const char* key : required_keys[i].keys) {
+            if (key == NULL) {
+                break;
+            }
+            if (not item.containsKey(key)) {
+                error_message = String("Key '") + key + "' is missing";
+                return false;
+            }
+            bool is_pin = strcmp(key, "pin") == 0 or strcmp(key, "input") == 0 or
+                          strcmp(key, "output") == 0;
+            const char* pin_string = item[key] | "";
+            if (is_pin and get_valid_pin_type(pin_string) == PIN_INVALID_PIN) {
+                error_message = String("Pin '") + pin_string + "' is not valid";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Runs the items in order with the job of the batch and answers with one
+// result per item. An atomic batch is validated first and stops at the first
+// failing item, skipping the rest; items that already ran aren't undone.
+void command_batch(unsigned int job, message_struct_t* message) {
+    JsonArray commands = message->fields["commands"].as<JsonArray>();
+    if (commands.isNull()) {
+        build_error(COMMAND_BATCH, "INVALID_KEY", "Key 'commands' is missing", job);
+        return;
+    }
+    if (commands.size() > MAX_BATCH_COMMANDS) {
+        String error_message =
+            "Batches are limited to " + String(MAX_BATCH_COMMANDS) + " commands";
+        build_error(COMMAND_BATCH, "TOO_MANY_COMMANDS", error_message, job);
+        return;
+    }
+
+    bool atomic = message->fields["atomic"] | false;
+    if (atomic) {
+        unsigned int i = 0;
+        for (JsonVariant item : commands) {
+            String error_message;
+            if (not validate_batch_item(item.as<JsonObject>(), error_message)) {
+                error_message = "Command " + String(i) + ": " + error_message;
+                build_error(COMMAND_BATCH, "INVALID_BATCH", error_message, job);
+                return;
+            }
+            i++;
+        }
+    }
+
+    JsonObject batch = message->fields;
+    unsigned int failed = 0;
+    begin_batch(job);
+    for (JsonVariant item : commands) {
+        message->fields = item.as<JsonObject>();
+        const char* command_string = message->fields["command"] | "";
+        message->command = get_command(command_string);
+
+        begin_batch_item();
+        if (atomic and failed > 0) {
+            build_error(
+                message->command, "SKIPPED", "An earlier command of the batch failed", job);
+        } else if (message->command == COMMAND_BATCH) {
+            build_error(COMMAND_BATCH, "INVALID_COMMAND", "Batches can't be nested", job);
+        } else {
+            run_command(message, job, command_string);
+        }
+        if (end_batch_item()) {
+            failed++;
+        }
+    }
+    message->fields = batch;
+    message->command = COMMAND_BATCH;
+
+    const String& results = end_batch();
+    build_command(
+        COMMAND_BATCH,
+        MSG_OUTPUT,
+        job,
+        "failed",
+        failed,
+        "results",
+        serialized(results.c_str()));
 }
 
 } // namespace controllino
@@ -0,0 +1,81 @@
+#include "PinInterrupts.h"
+
+#include <Arduino.h>
+
+#include "Debounce.h"
+#include "GpioHandler.h"
+
+namespace controllino {
+
+static volatile pin_interrupt_t handlers_[PIN_INVALID_PIN];
+
+namespace details {
+
+// `attachInterrupt` callbacks don't take arguments, so every pin gets its own
+// trampoline.
+template<int N>
+void pin_interrupt_trampoline() {
+    pin_interrupt_t handler = handlers_[N];
+    if (handler != NULL) {
+        handler((pin_t) N);
+    }
+}
+
+bool has_trampoline(pin_t pin) {
+    return pin < PIN_INVALID_PIN and get_pin_type(pin) == PIN_DIGITAL;
+}
+
+} // namespace details
+
+#define CONTROLLINO_PIN_TRAMPOLINE(name, ...) details::pin_interrupt_trampoline<PIN_##name>,
+
+// Indexed by `pin_t`; only digital pins use theirs.
+const voidFuncPtr pin_interrupt_trampolines[] = {
+    CONTROLLINO_BOARD_PINS(CONTROLLINO_PIN_TRAMPOLINE)};
+
+int attach_pin_interrupt(pin_t pin, pin_interrupt_t handler) {
+    if (not details::has_trampoline(pin)) {
+        return 1; // Error - not a digital pin.
+    }
+    if (handlers_[(int) pin] != NULL) {
+        return 2; // Error - pin is already in use.
+    }
+
+    handlers_[(int) pin] = handler;
+    refresh_pin_interrupt(pin);
+    return 0;
+}
+
+void detach_pin_interrupt(pin_t pin) {
+    if (not details::has_trampoline(pin)) {
+        return;
+    }
+    detachInterrupt(digitalPinToInterrupt(get_pin_number(pin)));
+    handlers_[(int) pin] = NULL;
+}
+
+bool has_pin_interrupt(pin_t pin) {
+    return details::has_trampoline(pin) and handlers_[(int) pin] != NULL;
+}
+
+void refresh_pin_interrupt(pin_t pin) {
+    if (not has_pin_interrupt(pin)) {
+        return;
+    }
+    uint8_t pin_number = get_pin_number(pin);
+    if (is_debounced(pin)) {
+        detachInterrupt(digitalPinToInterrupt(pin_number));
+    } else {
+        attachInterrupt(
+            digitalPinToInterrupt(pin_number), pin_interrupt_trampolines[(int) pin], CHANGE);
+    }
+}
+
+void notify_pin_edge(pin_t pin) {
+    pin_interrupt_t handler = handlers_[(int) pin];
+    if (handler != NULL) {
+        handler(pin);
+    }
+}
+
+} // namespace controllino
@@ -0,0 +1,24 @@
+#ifndef CONTROLLINO_PIN_INTERRUPTS_H
+#define CONTROLLINO_PIN_INTERRUPTS_H
+
+#include "ProtocolHandler.h"
+
+namespace controllino {
+
+typedef void (*pin_interrupt_t)(pin_t pin);
+
+// Calls `handler` from interrupt context on every edge of a digital pin.
+// Each pin can only have one handler at a time.
+int attach_pin_interrupt(pin_t pin, pin_interrupt_t handler);
+void detach_pin_interrupt(pin_t pin);
+bool has_pin_interrupt(pin_t pin);
+
+// Debounced pins don't use their hardware interrupt; the debounce scan calls
+// `notify_pin_edge` on filtered edges instead. `refresh_pin_interrupt` must be
+// called whenever a pin's debouncing is switched on or off.
+void refresh_pin_interrupt(pin_t pin);
+void notify_pin_edge(pin_t pin);
+
+} // namespace controllino
+
+#endif /* CONTROLLINO_PIN_INTERRUPTS_H */
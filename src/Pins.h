@@ -0,0 +1,123 @@
+#ifndef CONTROLLINO_PINS_H
+#define CONTROLLINO_PINS_H
+
+#include <Arduino.h>
+
+#include "Board.h"
+#include "ProtocolHandler.h"
+
+namespace controllino {
+
+typedef enum
+{
+    PIN_CAP_INPUT = 1 << 0,
+    PIN_CAP_OUTPUT = 1 << 1,
+    PIN_CAP_ANALOG = 1 << 2, // Converted by the ADC or DAC instead of a level
+} pin_capability_t;
+
+const uint8_t PIN_CAPS_DIGITAL_IO = PIN_CAP_INPUT | PIN_CAP_OUTPUT;
+const uint8_t PIN_CAPS_ANALOG_IN = PIN_CAP_ANALOG | PIN_CAP_INPUT;
+const uint8_t PIN_CAPS_ANALOG_OUT = PIN_CAP_ANALOG | PIN_CAP_OUTPUT;
+const uint8_t PIN_NO_ADC = 0xFF;
+
+typedef enum
+{
+    PIN_PORT_A = 0,
+    PIN_PORT_B,
+    PIN_PORT_C,
+    PIN_PORT_D,
+} pin_port_t;
+
+typedef struct {
+    const char* name;
+    uint8_t number; // Arduino pin number
+    uint8_t capabilities;
+    pin_mode_t default_mode;
+    pin_port_t port;
+    uint8_t bit;
+    uint8_t adc_channel;
+} pin_description_t;
+
+namespace details {
+
+#define CONTROLLINO_PIN_DESCRIPTION(name, number, caps, mode, port, bit, adc) \
+    {#name, number, caps, mode, port, bit, adc},
+
+// Indexed by `pin_t`, which is generated from the same list.
+constexpr pin_description_t pin_descriptions[] = {
+    CONTROLLINO_BOARD_PINS(CONTROLLINO_PIN_DESCRIPTION)};
+
+} // namespace details
+
+// All of these are constant expressions for a constant `pin`, and plain array
+// lookups otherwise.
+constexpr const char* get_pin_name(pin_t pin) {
+    return details::pin_descriptions[pin].name;
+}
+
+constexpr uint8_t get_pin_number(pin_t pin) {
+    return details::pin_descriptions[pin].number;
+}
+
+constexpr bool has_pin_capability(pin_t pin, pin_capability_t capability) {
+    return (details::pin_descriptions[pin].capabilities & capability) != 0;
+}
+
+constexpr pin_type_t get_pin_type(pin_t pin) {
+    return has_pin_capability(pin, PIN_CAP_ANALOG) ? PIN_ANALOG : PIN_DIGITAL;
+}
+
+constexpr pin_mode_type_t get_pin_mode_type(pin_t pin) {
+    return not has_pin_capability(pin, PIN_CAP_OUTPUT) ? PIN_MODE_TYPE_INPUT_ONLY
+           : not has_pin_capability(pin, PIN_CAP_INPUT) ? PIN_MODE_TYPE_OUTPUT_ONLY
+                                                         : PIN_MODE_TYPE_INPUT_AND_OUTPUT;
+}
+
+constexpr pin_mode_t get_default_pin_mode(pin_t pin) {
+    return details::pin_descriptions[pin].default_mode;
+}
+
+constexpr uint32_t get_pin_mask(pin_t pin) {
+    return 1u << details::pin_descriptions[pin].bit;
+}
+
+constexpr uint8_t get_adc_channel(pin_t pin) {
+    return details::pin_descriptions[pin].adc_channel;
+}
+
+constexpr pin_port_t get_pin_port(pin_t pin) {
+    return details::pin_descriptions[pin].port;
+}
+
+inline Pio* get_pin_pio(pin_t pin) {
+    switch (get_pin_port(pin)) {
+        case PIN_PORT_A:
+            return PIOA;
+        case PIN_PORT_B:
+            return PIOB;
+        case PIN_PORT_C:
+            return PIOC;
+        case PIN_PORT_D:
+        default:
+            return PIOD;
+    }
+}
+
+// Direct register accesses for digital pins, without the table lookups of
+// `digitalRead` and `digitalWrite`. For a constant `pin` each is a single load
+// or store. `set_pin_level` only drives pins in output mode.
+inline bool get_pin_level(pin_t pin) {
+    return (get_pin_pio(pin)->PIO_PDSR & get_pin_mask(pin)) != 0;
+}
+
+inline void set_pin_level(pin_t pin, bool level) {
+    if (level) {
+        get_pin_pio(pin)->PIO_SODR = get_pin_mask(pin);
+    } else {
+        get_pin_pio(pin)->PIO_CODR = get_pin_mask(pin);
+    }
+}
+
+} // namespace controllino
+
+#endif /* CONTROLLINO_PINS_H */
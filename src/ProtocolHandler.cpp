@@ -1,12 +1,13 @@
 #include <Arduino.h>
 
+#include "Pins.h"
 #include "ProtocolHandler.h"
 
 namespace controllino {
 
 typedef struct {
     command_type_t command;
-    String command_string;
+    const char* command_string;
 } command_struct_t;
 
 // FIXME: Warning! These commands must be in the same order as in
@@ -22,6 +23,30 @@ const command_struct_t command_mapping[] = {
     {COMMAND_SAVE_PIN_MODES, "SAVE_PIN_MODES"},
     {COMMAND_RESET_PIN_MODES, "RESET_PIN_MODES"},
     {COMMAND_TRIGGER_PULSE, "TRIGGER_PULSE"},
+    {COMMAND_CANCEL_JOB, "CANCEL_JOB"},
+    {COMMAND_SYNC_TIME, "SYNC_TIME"},
+    {COMMAND_GRANT_CREDIT, "GRANT_CREDIT"},
+    {COMMAND_ADD_RULE, "ADD_RULE"},
+    {COMMAND_DELETE_RULE, "DELETE_RULE"},
+    {COMMAND_GET_RULE, "GET_RULE"},
+    {COMMAND_RULE_EVENT, "RULE_EVENT"},
+    {COMMAND_START_CONTROL_LOOP, "START_CONTROL_LOOP"},
+    {COMMAND_UPDATE_CONTROL_LOOP, "UPDATE_CONTROL_LOOP"},
+    {COMMAND_STOP_CONTROL_LOOP, "STOP_CONTROL_LOOP"},
+    {COMMAND_GET_CONTROL_LOOP, "GET_CONTROL_LOOP"},
+    {COMMAND_WATCH, "WATCH"},
+    {COMMAND_END_WATCH, "END_WATCH"},
+    {COMMAND_MEASURE_FREQUENCY, "MEASURE_FREQUENCY"},
+    {COMMAND_END_MEASURE_FREQUENCY, "END_MEASURE_FREQUENCY"},
+    {COMMAND_ADD_COUNTER, "ADD_COUNTER"},
+    {COMMAND_DELETE_COUNTER, "DELETE_COUNTER"},
+    {COMMAND_RESET_COUNTER, "RESET_COUNTER"},
+    {COMMAND_GET_COUNTERS, "GET_COUNTERS"},
+    {COMMAND_SET_DEBOUNCE, "SET_DEBOUNCE"},
+    {COMMAND_GET_DEBOUNCE, "GET_DEBOUNCE"},
+    {COMMAND_SET_ADC, "SET_ADC"},
+    {COMMAND_GET_STORAGE, "GET_STORAGE"},
+    {COMMAND_BATCH, "BATCH"},
     {COMMAND_READY, "READY"},
     {COMMAND_ERROR, "ERROR"},
     {COMMAND_INVALID, "ERROR"},
@@ -29,26 +54,6 @@ const command_struct_t command_mapping[] = {
 
 const size_t len_command_array = sizeof(command_mapping) / sizeof(command_mapping[0]);
 
-typedef struct {
-    pin_t pin;
-    char pin_name[5];
-} io_mapping_t;
-
-const io_mapping_t input_output_mapping[] = {
-    {PIN_D30, "D30"},   {PIN_D31, "D31"},   {PIN_D32, "D32"}, {PIN_D33, "D33"},
-    {PIN_D34, "D34"},   {PIN_D35, "D35"},   {PIN_D36, "D36"}, {PIN_D37, "D37"},
-    {PIN_D38, "D38"},   {PIN_D39, "D39"},   {PIN_D40, "D40"}, {PIN_D41, "D41"},
-    {PIN_D42, "D42"},   {PIN_D43, "D43"},   {PIN_D44, "D44"}, {PIN_D45, "D45"},
-    {PIN_D46, "D46"},   {PIN_D47, "D47"},   {PIN_D48, "D48"}, {PIN_D49, "D49"},
-    {PIN_A0, "A0"},     {PIN_A1, "A1"},     {PIN_A2, "A2"},   {PIN_A3, "A3"},
-    {PIN_DAC0, "DAC0"}, {PIN_DAC1, "DAC1"},
-    //{PIN_IN0, "IN0"},
-    //{PIN_IN1, "IN1"},
-};
-
-const size_t len_io_array =
-    sizeof(input_output_mapping) / sizeof(input_output_mapping[0]);
-
 typedef struct {
     uint8_t pin_mode_number;
     char pin_level[5];
@@ -59,6 +64,9 @@ const pin_level_t pin_level_mapping[] = {
     {LOW, "LOW"},
 };
 
+const size_t len_pin_level_array =
+    sizeof(pin_level_mapping) / sizeof(pin_level_mapping[0]);
+
 typedef struct {
     pin_mode_t pin_mode;
     char pin_mode_string[15];
@@ -73,11 +81,74 @@ const pin_modes_mapping_t pin_modes_mapping[] = {
 const size_t len_pin_mode_array =
     sizeof(pin_modes_mapping) / sizeof(pin_modes_mapping[0]);
 
+typedef struct {
+    rule_condition_t condition;
+    char condition_string[10];
+} rule_conditions_mapping_t;
+
+const rule_conditions_mapping_t rule_conditions_mapping[] = {
+    {RULE_CONDITION_RISING, "RISING"},
+    {RULE_CONDITION_FALLING, "FALLING"},
+    {RULE_CONDITION_CHANGE, "CHANGE"},
+    {RULE_CONDITION_ABOVE, "ABOVE"},
+    {RULE_CONDITION_BELOW, "BELOW"},
+    {RULE_CONDITION_TIMER, "TIMER"},
+};
+
+const size_t len_rule_condition_array =
+    sizeof(rule_conditions_mapping) / sizeof(rule_conditions_mapping[0]);
+
+typedef struct {
+    rule_action_t action;
+    char action_string[15];
+} rule_actions_mapping_t;
+
+const rule_actions_mapping_t rule_actions_mapping[] = {
+    {RULE_ACTION_SET_OUTPUT, "SET_OUTPUT"},
+    {RULE_ACTION_PULSE, "PULSE"},
+    {RULE_ACTION_START_LOG, "START_LOG"},
+    {RULE_ACTION_END_LOG, "END_LOG"},
+    {RULE_ACTION_EVENT, "EVENT"},
+};
+
+const size_t len_rule_action_array =
+    sizeof(rule_actions_mapping) / sizeof(rule_actions_mapping[0]);
+
+typedef struct {
+    counter_mode_t mode;
+    char mode_string[11];
+} counter_modes_mapping_t;
+
+const counter_modes_mapping_t counter_modes_mapping[] = {
+    {COUNTER_MODE_RISING, "RISING"},
+    {COUNTER_MODE_FALLING, "FALLING"},
+    {COUNTER_MODE_CHANGE, "CHANGE"},
+    {COUNTER_MODE_QUADRATURE, "QUADRATURE"},
+};
+
+const size_t len_counter_mode_array =
+    sizeof(counter_modes_mapping) / sizeof(counter_modes_mapping[0]);
+
+typedef struct {
+    debounce_filter_t filter;
+    char filter_string[11];
+} debounce_filters_mapping_t;
+
+// FIXME: Warning! These filters must be in the same order as in
+// `debounce_filter_t`!
+const debounce_filters_mapping_t debounce_filters_mapping[] = {
+    {DEBOUNCE_FILTER_INTEGRATOR, "INTEGRATOR"},
+    {DEBOUNCE_FILTER_STABLE, "STABLE"},
+};
+
+const size_t len_debounce_filter_array =
+    sizeof(debounce_filters_mapping) / sizeof(debounce_filters_mapping[0]);
+
 // ====================================================================
 //                  PARSER PROTOCOL JSON
 // ====================================================================
 
-bool receive_message_handler(String process_string, message_struct_t* message) {
+bool receive_message_handler(char* process_string, message_struct_t* message) {
     bool couldDeserializeMessage = true;
 
     // Deserialize the JSON document
@@ -87,6 +158,8 @@ bool receive_message_handler(String process_string, message_struct_t* message) {
         build_error(COMMAND_ERROR, "DESERIALIZE_JSON_FAILED", error.c_str());
         couldDeserializeMessage = false;
     }
+    message->fields = message->doc.as<JsonObject>();
+    message->job = details::NO_JOB;
     return couldDeserializeMessage;
 }
 
@@ -94,32 +167,126 @@ bool receive_message_handler(String process_string, message_struct_t* message) {
 //                  INTERPRETER PROTOCOL JSON
 // ====================================================================
 
-bool has_object_given_key(message_struct_t* message, String& data, String key_word) {
-    bool foundKey = false;
+namespace details {
+
+void build_key_error(message_struct_t* message, const String& error_message) {
+    make_command_imp(
+        message->command, MSG_ERROR, message->job, "error", "INVALID_KEY", "msg", error_message);
+}
+
+bool has_key(message_struct_t* message, const char* key) {
+    if (message->fields.containsKey(key)) {
+        return true;
+    }
+    String error_message = String("Key '") + key + "' is missing";
+    build_key_error(message, error_message);
+    return false;
+}
+
+template<typename T>
+bool is_unsigned(message_struct_t* message, const char* key) {
+    if (message->fields[key].is<T>()) {
+        return true;
+    }
+    String error_message = String("Key '") + key + "' must be a non-negative integer";
+    build_key_error(message, error_message);
+    return false;
+}
 
-    if (message->doc.containsKey(key_word)) {
-        data = message->doc[key_word].as<String>();
-        foundKey = true;
-    } else {
-        String error_message = "Key '" + key_word + "' is missing";
-        build_error(message->command, "INVALID_KEY", error_message);
+} // namespace details
+
+bool has_object_given_key(message_struct_t* message, const char*& data, const char* key) {
+    if (not details::has_key(message, key)) {
+        return false;
     }
+    // Values of other types read as "" and are rejected by the callers.
+    data = message->fields[key] | "";
+    return true;
+}
 
-    return foundKey;
+bool has_object_given_key(message_struct_t* message, long& data, const char* key) {
+    if (not details::has_key(message, key)) {
+        return false;
+    }
+    if (not message->fields[key].is<long>()) {
+        String error_message = String("Key '") + key + "' must be an integer";
+        details::build_key_error(message, error_message);
+        return false;
+    }
+    data = message->fields[key].as<long>();
+    return true;
+}
+
+bool has_object_given_key(message_struct_t* message, unsigned int& data, const char* key) {
+    if (not details::has_key(message, key) or
+        not details::is_unsigned<unsigned int>(message, key)) {
+        return false;
+    }
+    data = message->fields[key].as<unsigned int>();
+    return true;
 }
 
-command_type_t get_command(String command_string) {
+bool has_object_given_key(message_struct_t* message, uint64_t& data, const char* key) {
+    if (not details::has_key(message, key) or not details::is_unsigned<uint64_t>(message, key)) {
+        return false;
+    }
+    data = message->fields[key].as<uint64_t>();
+    return true;
+}
+
+bool has_object_given_key(message_struct_t* message, float& data, const char* key) {
+    if (not details::has_key(message, key)) {
+        return false;
+    }
+    data = message->fields[key].as<float>();
+    return true;
+}
+
+bool has_object_given_key(message_struct_t* message, pin_arg_t& data, const char* key) {
+    if (not has_object_given_key(message, data.name, key)) {
+        return false;
+    }
+    data.pin = get_valid_pin_type(data.name);
+    return true;
+}
+
+bool get_optional_key(message_struct_t* message,
+                      unsigned int& data,
+                      const char* key,
+                      unsigned int fallback) {
+    if (not message->fields.containsKey(key)) {
+        data = fallback;
+        return true;
+    }
+    if (not details::is_unsigned<unsigned int>(message, key)) {
+        return false;
+    }
+    data = message->fields[key].as<unsigned int>();
+    return true;
+}
+
+command_type_t get_command(const char* command_string) {
     for (uint16_t i = 0; i < (uint16_t) len_command_array; i++) {
-        if (command_string == command_mapping[i].command_string) {
+        if (strcmp(command_string, command_mapping[i].command_string) == 0) {
             return command_mapping[i].command;
         }
     }
     return COMMAND_INVALID;
 }
 
-pin_mode_t get_valid_pin_mode(const String& pin_mode_string) {
+int get_valid_pin_level(const char* level_string) {
+    for (uint16_t i = 0; i < (uint16_t) len_pin_level_array; i++) {
+        if (strcmp(level_string, pin_level_mapping[i].pin_level) == 0) {
+            return pin_level_mapping[i].pin_mode_number;
+        }
+    }
+
+    return -1;
+}
+
+pin_mode_t get_valid_pin_mode(const char* pin_mode_string) {
     for (uint16_t i = 0; i < (uint16_t) len_pin_mode_array; i++) {
-        if (pin_mode_string.equals(pin_modes_mapping[i].pin_mode_string)) {
+        if (strcmp(pin_mode_string, pin_modes_mapping[i].pin_mode_string) == 0) {
             return pin_modes_mapping[i].pin_mode;
         }
     }
@@ -127,6 +294,46 @@ pin_mode_t get_valid_pin_mode(const String& pin_mode_string) {
     return PIN_MODE_NOT_VALID;
 }
 
+rule_condition_t get_valid_rule_condition(const char* condition_string) {
+    for (uint16_t i = 0; i < (uint16_t) len_rule_condition_array; i++) {
+        if (strcmp(condition_string, rule_conditions_mapping[i].condition_string) == 0) {
+            return rule_conditions_mapping[i].condition;
+        }
+    }
+
+    return RULE_CONDITION_NOT_VALID;
+}
+
+rule_action_t get_valid_rule_action(const char* action_string) {
+    for (uint16_t i = 0; i < (uint16_t) len_rule_action_array; i++) {
+        if (strcmp(action_string, rule_actions_mapping[i].action_string) == 0) {
+            return rule_actions_mapping[i].action;
+        }
+    }
+
+    return RULE_ACTION_NOT_VALID;
+}
+
+counter_mode_t get_valid_counter_mode(const char* mode_string) {
+    for (uint16_t i = 0; i < (uint16_t) len_counter_mode_array; i++) {
+        if (strcmp(mode_string, counter_modes_mapping[i].mode_string) == 0) {
+            return counter_modes_mapping[i].mode;
+        }
+    }
+
+    return COUNTER_MODE_NOT_VALID;
+}
+
+debounce_filter_t get_valid_debounce_filter(const char* filter_string) {
+    for (uint16_t i = 0; i < (uint16_t) len_debounce_filter_array; i++) {
+        if (strcmp(filter_string, debounce_filters_mapping[i].filter_string) == 0) {
+            return debounce_filters_mapping[i].filter;
+        }
+    }
+
+    return DEBOUNCE_FILTER_NOT_VALID;
+}
+
 // ====================================================================
 //                  BUILDER PROTOCOL JSON
 // ====================================================================
@@ -147,6 +354,10 @@ String get_command_string(command_type_t command, msg_type_t type) {
             return (command != COMMAND_ERROR) ? "ERR_" + command_string : command_string;
             break;
 
+        case MSG_ACK:
+            return "ACK_" + command_string;
+            break;
+
         default:
             break;
     }
@@ -155,10 +366,10 @@ String get_command_string(command_type_t command, msg_type_t type) {
 }
 
 // TODO Rename this function to get_valid_pin; or rather string_to_pin?
-pin_t get_valid_pin_type(const String& pin_string) {
-    for (uint16_t i = 0; i < (uint16_t) len_io_array; i++) {
-        if (pin_string.equals(input_output_mapping[i].pin_name)) {
-            return input_output_mapping[i].pin;
+pin_t get_valid_pin_type(const char* pin_string) {
+    for (uint16_t i = 0; i < (uint16_t) PIN_INVALID_PIN; i++) {
+        if (strcmp(pin_string, get_pin_name((pin_t) i)) == 0) {
+            return (pin_t) i;
         }
     }
 
@@ -169,12 +380,74 @@ String get_pin_mode_string(pin_mode_t pin_mode) {
     return pin_modes_mapping[(int) pin_mode].pin_mode_string;
 }
 
+const char* get_pin_level_string(int level) {
+    return (level == HIGH) ? "HIGH" : "LOW";
+}
+
+const char* get_pin_string(pin_t pin) {
+    return get_pin_name(pin);
+}
+
+const char* get_debounce_filter_string(debounce_filter_t filter) {
+    return debounce_filters_mapping[(int) filter].filter_string;
+}
+
+// ====================================================================
+//                  BATCH COLLECTOR
+// ====================================================================
+
+static bool batch_running_ = false;
+static long batch_job_ = 0;
+static String batch_results_ = "";
+static String batch_reply_ = "";
+static msg_type_t batch_reply_type_ = MSG_OUTPUT;
+static bool batch_replied_ = false;
+
+void begin_batch(unsigned int job) {
+    batch_running_ = true;
+    batch_job_ = job;
+    batch_results_ = "[";
+}
+
+void begin_batch_item(void) {
+    batch_replied_ = false;
+}
+
+bool end_batch_item(void) {
+    if (batch_results_.length() > 1) {
+        batch_results_ += ',';
+    }
+    // Commands that answer later, like LOG_SIGNAL, have no result yet.
+    batch_results_ += batch_replied_ ? batch_reply_ : String("null");
+    return batch_replied_ and batch_reply_type_ == MSG_ERROR;
+}
+
+const String& end_batch(void) {
+    batch_running_ = false;
+    batch_results_ += ']';
+    return batch_results_;
+}
+
+namespace details {
+
+void send_message(const String& output, msg_type_t type, long job) {
+    if (batch_running_ and (job == NO_JOB or job == batch_job_)) {
+        batch_reply_ = output;
+        batch_reply_type_ = type;
+        batch_replied_ = true;
+        return;
+    }
+    serial_print_message(output);
+}
+
+} // namespace details
+
 // ====================================================================
 //                  COMPASER PROTOCOL JSON
 // ====================================================================
 
 void build_error(const command_type_t& command, const String& error, const String& msg) {
-    details::make_command_imp(command, MSG_ERROR, "error", error, "msg", msg);
+    details::make_command_imp(command, MSG_ERROR, details::NO_JOB, "error", error, "msg", msg);
 }
 
 void build_error(
@@ -4,8 +4,11 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 
+#include "Board.h"
 #include "SerialHandler.h"
 
+#define MAX_BATCH_COMMANDS 32
+
 namespace controllino {
 
 typedef enum
@@ -20,6 +23,30 @@ typedef enum
     COMMAND_SAVE_PIN_MODES,
     COMMAND_RESET_PIN_MODES,
     COMMAND_TRIGGER_PULSE,
+    COMMAND_CANCEL_JOB,
+    COMMAND_SYNC_TIME,
+    COMMAND_GRANT_CREDIT,
+    COMMAND_ADD_RULE,
+    COMMAND_DELETE_RULE,
+    COMMAND_GET_RULE,
+    COMMAND_RULE_EVENT,
+    COMMAND_START_CONTROL_LOOP,
+    COMMAND_UPDATE_CONTROL_LOOP,
+    COMMAND_STOP_CONTROL_LOOP,
+    COMMAND_GET_CONTROL_LOOP,
+    COMMAND_WATCH,
+    COMMAND_END_WATCH,
+    COMMAND_MEASURE_FREQUENCY,
+    COMMAND_END_MEASURE_FREQUENCY,
+    COMMAND_ADD_COUNTER,
+    COMMAND_DELETE_COUNTER,
+    COMMAND_RESET_COUNTER,
+    COMMAND_GET_COUNTERS,
+    COMMAND_SET_DEBOUNCE,
+    COMMAND_GET_DEBOUNCE,
+    COMMAND_SET_ADC,
+    COMMAND_GET_STORAGE,
+    COMMAND_BATCH,
     COMMAND_READY,
     COMMAND_ERROR,
     COMMAND_INVALID,
@@ -30,39 +57,24 @@ typedef enum
     MSG_INPUT = 0,
     MSG_OUTPUT,
     MSG_ERROR,
+    MSG_ACK,
 } msg_type_t;
 
+#define CONTROLLINO_PIN_ENUM(name, ...) PIN_##name,
+
 typedef enum
 {
-    PIN_D30 = 0,
-    PIN_D31,
-    PIN_D32,
-    PIN_D33,
-    PIN_D34,
-    PIN_D35,
-    PIN_D36,
-    PIN_D37,
-    PIN_D38,
-    PIN_D39,
-    PIN_D40,
-    PIN_D41,
-    PIN_D42,
-    PIN_D43,
-    PIN_D44,
-    PIN_D45,
-    PIN_D46,
-    PIN_D47,
-    PIN_D48,
-    PIN_D49,
-    PIN_A0,
-    PIN_A1,
-    PIN_A2,
-    PIN_A3,
-    PIN_DAC0,
-    PIN_DAC1,
+    CONTROLLINO_BOARD_PINS(CONTROLLINO_PIN_ENUM)
     PIN_INVALID_PIN,
 } pin_t;
 
+// A pin as named in a message. `name` points into the message and `pin` is
+// PIN_INVALID_PIN if no such pin exists.
+typedef struct {
+    pin_t pin;
+    const char* name;
+} pin_arg_t;
+
 typedef enum
 {
     PIN_DIGITAL = 0,
@@ -84,31 +96,112 @@ typedef enum
     PIN_MODE_NOT_VALID,
 } pin_mode_t;
 
+typedef enum
+{
+    RULE_CONDITION_RISING = 0,
+    RULE_CONDITION_FALLING,
+    RULE_CONDITION_CHANGE,
+    RULE_CONDITION_ABOVE,
+    RULE_CONDITION_BELOW,
+    RULE_CONDITION_TIMER,
+    RULE_CONDITION_NOT_VALID,
+} rule_condition_t;
+
+typedef enum
+{
+    RULE_ACTION_SET_OUTPUT = 0,
+    RULE_ACTION_PULSE,
+    RULE_ACTION_START_LOG,
+    RULE_ACTION_END_LOG,
+    RULE_ACTION_EVENT,
+    RULE_ACTION_NOT_VALID,
+} rule_action_t;
+
+typedef enum
+{
+    COUNTER_MODE_RISING = 0,
+    COUNTER_MODE_FALLING,
+    COUNTER_MODE_CHANGE,
+    COUNTER_MODE_QUADRATURE,
+    COUNTER_MODE_NOT_VALID,
+} counter_mode_t;
+
+typedef enum
+{
+    DEBOUNCE_FILTER_INTEGRATOR = 0,
+    DEBOUNCE_FILTER_STABLE,
+    DEBOUNCE_FILTER_NOT_VALID,
+} debounce_filter_t;
+
 const int capacity = JSON_OBJECT_SIZE(32);
+// Room for a batch of MAX_BATCH_COMMANDS commands with six keys each.
+const int message_capacity = JSON_OBJECT_SIZE(4) + JSON_ARRAY_SIZE(MAX_BATCH_COMMANDS) +
+                             MAX_BATCH_COMMANDS * JSON_OBJECT_SIZE(6);
 
 typedef struct {
     command_type_t command;
-    StaticJsonDocument<capacity> doc;
+    StaticJsonDocument<message_capacity> doc;
+    // The keys of the command being run: the received object, or the current
+    // item of a batch.
+    JsonObject fields;
+    // The job, once it was read; errors about keys carry it.
+    long job;
 } message_struct_t;
 
 // ====================================================================
 //                  PARSER PROTOCOL JSON
 // ====================================================================
-bool receive_message_handler(String process_string, message_struct_t* message);
+// Parses `process_string` in place: strings of the message point into it, so
+// it must stay untouched until the message was handled.
+bool receive_message_handler(char* process_string, message_struct_t* message);
 
 // ====================================================================
 //                  INTERPRETER PROTOCOL JSON
 // ====================================================================
-bool has_object_given_key(message_struct_t* message, String& data, String key);
-command_type_t get_command(String command_string);
-pin_t get_valid_pin_type(const String& pin_string);
-pin_mode_t get_valid_pin_mode(const String& pin_mode_string);
+// Read the value of `key` without copying it. If the key is missing, an
+// INVALID_KEY error is sent and false is returned. Unsigned values must be
+// non-negative integers; other values are answered the same way instead of
+// wrapping around.
+bool has_object_given_key(message_struct_t* message, const char*& data, const char* key);
+bool has_object_given_key(message_struct_t* message, long& data, const char* key);
+bool has_object_given_key(message_struct_t* message, unsigned int& data, const char* key);
+bool has_object_given_key(message_struct_t* message, uint64_t& data, const char* key);
+bool has_object_given_key(message_struct_t* message, float& data, const char* key);
+bool has_object_given_key(message_struct_t* message, pin_arg_t& data, const char* key);
+// Like `has_object_given_key`, but a missing key reads as `fallback`.
+bool get_optional_key(message_struct_t* message,
+                      unsigned int& data,
+                      const char* key,
+                      unsigned int fallback);
+command_type_t get_command(const char* command_string);
+pin_t get_valid_pin_type(const char* pin_string);
+int get_valid_pin_level(const char* level_string);
+pin_mode_t get_valid_pin_mode(const char* pin_mode_string);
+rule_condition_t get_valid_rule_condition(const char* condition_string);
+rule_action_t get_valid_rule_action(const char* action_string);
+counter_mode_t get_valid_counter_mode(const char* mode_string);
+debounce_filter_t get_valid_debounce_filter(const char* filter_string);
 
 // ====================================================================
 //                  BUILDER PROTOCOL JSON
 // ====================================================================
 String get_command_string(command_type_t command, msg_type_t type);
 String get_pin_mode_string(pin_mode_t pin_mode);
+const char* get_pin_level_string(int level);
+const char* get_pin_string(pin_t pin);
+const char* get_debounce_filter_string(debounce_filter_t filter);
+
+// ====================================================================
+//                  BATCH COLLECTOR
+// ====================================================================
+// While a batch runs, replies to its job (and replies without job) are
+// collected instead of being sent. The last reply to each item is its result.
+void begin_batch(unsigned int job);
+void begin_batch_item(void);
+// Returns true if the item failed.
+bool end_batch_item(void);
+// Returns the results of the items as a JSON array.
+const String& end_batch(void);
 
 // ====================================================================
 //                  COMPASER PROTOCOL JSON
@@ -124,6 +217,11 @@ void build_error(
 
 namespace details {
 
+const long NO_JOB = -1;
+
+// Sends `output`, unless a batch collects it.
+void send_message(const String& output, msg_type_t type, long job);
+
 template<typename Document>
 void write_to_json_doc(Document& doc) {
     // noop
@@ -137,18 +235,21 @@ void write_to_json_doc(Document& doc, const T1& key, const T2& value, const Ts&.
 
 template<typename... Ts>
 void make_command_imp(
-    const command_type_t& command, const msg_type_t& type, const Ts&... data) {
+    const command_type_t& command, const msg_type_t& type, long job, const Ts&... data) {
     String command_string = get_command_string(command, type);
 
     const int capacity = JSON_OBJECT_SIZE(32); // FIXME Always sufficient?
     StaticJsonDocument<capacity> doc;
 
     doc["command"] = command_string;
+    if (job != NO_JOB) {
+        doc["job"] = job;
+    }
     details::write_to_json_doc(doc, data...);
 
     String output;
     serializeJson(doc, output);
-    serial_print_message(output);
+    send_message(output, type, job);
 }
 
 } // namespace details
@@ -159,7 +260,7 @@ void build_command(
     const msg_type_t& type,
     unsigned int job,
     const Ts&... data) {
-    details::make_command_imp(command, type, "job", job, data...);
+    details::make_command_imp(command, type, (long) job, data...);
 }
 
 } // namespace controllino
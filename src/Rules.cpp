@@ -0,0 +1,281 @@
+#include "Rules.h"
+
+#include <Arduino.h>
+
+#include "Clock.h"
+#include "GpioHandler.h"
+#include "InterruptLock.h"
+#include "Logger.h"
+#include "PinInterrupts.h"
+#include "Scheduler.h"
+#include "Timer.h"
+
+namespace controllino {
+
+struct Rule {
+    unsigned int id;
+    rule_t rule;
+    bool primed;   // Analog thresholds: first sample taken?
+    bool armed;    // Analog thresholds: back on the near side of the band?
+    uint64_t next; // Timers: µs device time of the next firing
+    uint64_t detected;
+    unsigned int pending; // Deferred actions waiting for the main loop
+    rule_stats_t stats;
+};
+
+// Shared with interrupts, so every access from the main loop must hold an
+// `InterruptLock`.
+static Rule rules_[MAX_RULES];
+static volatile unsigned int rule_count_ = 0;
+
+namespace details {
+
+bool is_edge_rule(const rule_t& rule) {
+    return rule.condition == RULE_CONDITION_RISING or
+           rule.condition == RULE_CONDITION_FALLING or
+           rule.condition == RULE_CONDITION_CHANGE;
+}
+
+bool uses_edge_interrupt(pin_t pin) {
+    for (unsigned int i = 0; i < rule_count_; ++i) {
+        if (is_edge_rule(rules_[i].rule) and rules_[i].rule.pin == pin) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool uses_scan() {
+    for (unsigned int i = 0; i < rule_count_; ++i) {
+        if (not is_edge_rule(rules_[i].rule)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void record_reaction(Rule& rule, uint64_t detected) {
+    uint32_t reaction = (uint32_t) (clock_micros() - detected);
+    rule.stats.last_reaction = reaction;
+    if (reaction > rule.stats.max_reaction) {
+        rule.stats.max_reaction = reaction;
+    }
+}
+
+// Called from interrupt context.
+void fire(Rule& rule, uint64_t detected) {
+    const rule_t& r = rule.rule;
+    rule.stats.hits++;
+
+    switch (r.action) {
+        case RULE_ACTION_SET_OUTPUT:
+            if (get_pin_type(r.target) == PIN_DIGITAL) {
+                write_digital_to_pin(r.target, r.level);
+            } else {
+                write_analog_to_pin(r.target, r.level);
+            }
+            record_reaction(rule, detected);
+            break;
+
+        case RULE_ACTION_PULSE: {
+            // The end of the pulse is scheduled first; if the scheduler is
+            // full, the output isn't touched instead of staying HIGH.
+            InterruptLock lock;
+            if (schedule_output(rule.id,
+                                r.target,
+                                LOW,
+                                clock_micros() + (uint64_t) r.duration * 1000,
+                                false)) {
+                rule.stats.failures++;
+                break;
+            }
+            write_digital_to_pin(r.target, HIGH);
+            record_reaction(rule, detected);
+            break;
+        }
+
+        default:
+            rule.detected = detected;
+            rule.pending++;
+            break;
+    }
+}
+
+void on_rule_pin_edge(pin_t pin) {
+    uint64_t now = clock_micros();
+    int level = read_digital_from_pin(pin);
+    for (unsigned int i = 0; i < rule_count_; ++i) {
+        const rule_t& r = rules_[i].rule;
+        if (not is_edge_rule(r) or r.pin != pin) {
+            continue;
+        }
+        if ((r.condition == RULE_CONDITION_RISING and level == HIGH) or
+            (r.condition == RULE_CONDITION_FALLING and level == LOW) or
+            r.condition == RULE_CONDITION_CHANGE) {
+            fire(rules_[i], now);
+        }
+    }
+}
+
+void scan_rules() {
+    uint64_t now = clock_micros();
+    for (unsigned int i = 0; i < rule_count_; ++i) {
+        Rule& rule = rules_[i];
+        const rule_t& r = rule.rule;
+
+        if (r.condition == RULE_CONDITION_TIMER) {
+            if (now >= rule.next) {
+                rule.next += (uint64_t) r.interval * 1000;
+                fire(rule, now);
+            }
+            continue;
+        }
+
+        bool above = (r.condition == RULE_CONDITION_ABOVE);
+        if (not above and r.condition != RULE_CONDITION_BELOW) {
+            continue;
+        }
+
+        int value = read_analog_from_pin(r.pin);
+        bool beyond = above ? (value > r.threshold) : (value < r.threshold);
+        bool rearm = above ? (value < (int64_t) r.threshold - r.hysteresis)
+                           : (value > (int64_t) r.threshold + r.hysteresis);
+        if (not rule.primed) {
+            rule.primed = true;
+            rule.armed = not beyond;
+        } else if (rule.armed and beyond) {
+            rule.armed = false;
+            fire(rule, now);
+        } else if (not rule.armed and rearm) {
+            rule.armed = true;
+        }
+    }
+}
+
+// Returns false if the action couldn't run.
+bool run_deferred_action(Rule& rule) {
+    const rule_t& r = rule.rule;
+    switch (r.action) {
+        case RULE_ACTION_START_LOG:
+            return log_signal(rule.id, r.target, r.duration, false) == 0;
+
+        case RULE_ACTION_END_LOG:
+            end_log_signal(r.target);
+            break;
+
+        case RULE_ACTION_EVENT:
+            build_command(
+                COMMAND_RULE_EVENT,
+                MSG_OUTPUT,
+                rule.id,
+                "time",
+                rule.detected,
+                "hits",
+                rule.stats.hits);
+            break;
+
+        default:
+            break;
+    }
+    return true;
+}
+
+} // namespace details
+
+void handle_rules() {
+    for (unsigned int i = 0; i < rule_count_; ++i) {
+        uint64_t detected;
+        {
+            InterruptLock lock;
+            if (rules_[i].pending == 0) {
+                continue;
+            }
+            rules_[i].pending--;
+            detected = rules_[i].detected;
+        }
+        bool done = details::run_deferred_action(rules_[i]);
+        InterruptLock lock;
+        if (done) {
+            details::record_reaction(rules_[i], detected);
+        } else {
+            rules_[i].stats.failures++;
+        }
+    }
+}
+
+int add_rule(unsigned int id, const rule_t& rule) {
+    if (rule_count_ == MAX_RULES) {
+        return 1; // Error - too many rules.
+    }
+    for (unsigned int i = 0; i < rule_count_; ++i) {
+        if (rules_[i].id == id) {
+            return 2; // Error - duplicate id.
+        }
+    }
+
+    bool edge = details::is_edge_rule(rule);
+    if (edge and not details::uses_edge_interrupt(rule.pin) and
+        has_pin_interrupt(rule.pin)) {
+        return 3; // Error - pin is used by another feature.
+    }
+
+    Rule r{};
+    r.id = id;
+    r.rule = rule;
+    r.next = clock_micros() + (uint64_t) rule.interval * 1000;
+
+    bool attach = edge and not details::uses_edge_interrupt(rule.pin);
+    bool start_scan = not edge and not details::uses_scan();
+    {
+        InterruptLock lock;
+        rules_[rule_count_] = r;
+        rule_count_++;
+    }
+
+    if (attach) {
+        attach_pin_interrupt(rule.pin, details::on_rule_pin_edge);
+    }
+    if (start_scan) {
+        timer_start(TIMER_RULES, RULE_SCAN_PERIOD_US, details::scan_rules);
+    }
+    return 0;
+}
+
+int delete_rule(unsigned int id) {
+    for (unsigned int i = 0; i < rule_count_; ++i) {
+        if (rules_[i].id != id) {
+            continue;
+        }
+
+        rule_t rule = rules_[i].rule;
+        {
+            InterruptLock lock;
+            for (unsigned int j = i; j < rule_count_ - 1; ++j) {
+                rules_[j] = rules_[j + 1];
+            }
+            rule_count_--;
+        }
+
+        if (details::is_edge_rule(rule) and not details::uses_edge_interrupt(rule.pin)) {
+            detach_pin_interrupt(rule.pin);
+        }
+        if (not details::is_edge_rule(rule) and not details::uses_scan()) {
+            timer_stop(TIMER_RULES);
+        }
+        return 0;
+    }
+    return 1; // Found no match!
+}
+
+int get_rule_stats(unsigned int id, rule_stats_t* stats) {
+    InterruptLock lock;
+    for (unsigned int i = 0; i < rule_count_; ++i) {
+        if (rules_[i].id == id) {
+            *stats = rules_[i].stats;
+            return 0;
+        }
+    }
+    return 1; // Found no match!
+}
+
+} // namespace controllino
@@ -0,0 +1,40 @@
+#ifndef CONTROLLINO_RULES_H
+#define CONTROLLINO_RULES_H
+
+#include "ProtocolHandler.h"
+
+#define MAX_RULES 8
+#define RULE_SCAN_PERIOD_US 1000
+
+namespace controllino {
+
+typedef struct {
+    rule_condition_t condition;
+    pin_t pin;
+    int threshold;
+    unsigned int hysteresis;
+    unsigned int interval; // ms
+    rule_action_t action;
+    pin_t target;
+    int level;
+    unsigned int duration; // ms; pulse length or logging period
+} rule_t;
+
+typedef struct {
+    unsigned int hits;
+    uint32_t last_reaction; // µs
+    uint32_t max_reaction;  // µs
+    unsigned int failures;  // firings whose action couldn't run
+} rule_stats_t;
+
+// Digital edges are evaluated in the pin interrupt, analog thresholds and
+// timers every RULE_SCAN_PERIOD_US in a timer interrupt. Actions which can't
+// run in interrupt context are deferred to `handle_rules`.
+void handle_rules();
+int add_rule(unsigned int id, const rule_t& rule);
+int delete_rule(unsigned int id);
+int get_rule_stats(unsigned int id, rule_stats_t* stats);
+
+} // namespace controllino
+
+#endif /* CONTROLLINO_RULES_H */
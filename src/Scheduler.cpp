@@ -0,0 +1,208 @@
+#include "Scheduler.h"
+
+#include <Arduino.h>
+
+#include "Clock.h"
+#include "GpioHandler.h"
+#include "InterruptLock.h"
+#include "Timer.h"
+
+namespace controllino {
+
+// The timer is never armed further ahead than this; if the next job is
+// further away, the interrupt simply re-arms the timer.
+const uint32_t max_arm_delay_us = 1000000;
+
+struct ScheduledJob {
+    unsigned int job;
+    pin_t pin;
+    int level;
+    uint64_t at;
+    uint64_t executed;
+    bool fired;
+    bool notify;
+    command_type_t command; // The command a notified job is answered as.
+};
+
+// Sorted by `at`. Shared with the timer interrupt, so every access from
+// the main loop must hold an `InterruptLock`.
+static ScheduledJob jobs_[MAX_SCHEDULED_JOBS];
+static volatile unsigned int job_count_ = 0;
+
+namespace details {
+
+void del_scheduled_job(unsigned int position) {
+    for (unsigned int i = position; i < job_count_ - 1; ++i) {
+        jobs_[i] = jobs_[i + 1];
+    }
+    job_count_--;
+}
+
+void run_due_jobs();
+void arm_scheduler(uint64_t now);
+
+// Must hold an `InterruptLock`.
+int add_scheduled_job(const ScheduledJob& job) {
+    if (job_count_ == MAX_SCHEDULED_JOBS) {
+        return 1; // Error - too many scheduled jobs.
+    }
+
+    unsigned int position = job_count_;
+    while (position > 0 and jobs_[position - 1].at > job.at) {
+        jobs_[position] = jobs_[position - 1];
+        position--;
+    }
+    jobs_[position] = job;
+    job_count_++;
+
+    arm_scheduler(clock_micros());
+    return 0;
+}
+
+void arm_scheduler(uint64_t now) {
+    for (unsigned int i = 0; i < job_count_; ++i) {
+        if (jobs_[i].fired) {
+            continue;
+        }
+        uint64_t delay = (jobs_[i].at > now) ? jobs_[i].at - now : 0;
+        if (delay > max_arm_delay_us) {
+            delay = max_arm_delay_us;
+        }
+        timer_start_once(TIMER_SCHEDULER, (uint32_t) delay, run_due_jobs);
+        return;
+    }
+    timer_stop(TIMER_SCHEDULER);
+}
+
+// Called from the timer interrupt.
+void run_due_jobs() {
+    uint64_t now = clock_micros();
+    for (unsigned int i = 0; i < job_count_; ++i) {
+        ScheduledJob& job = jobs_[i];
+        if (job.fired) {
+            continue;
+        }
+        if (job.at > now) {
+            break;
+        }
+
+        if (get_pin_type(job.pin) == PIN_DIGITAL) {
+            write_digital_to_pin(job.pin, job.level);
+        } else {
+            write_analog_to_pin(job.pin, job.level);
+        }
+        job.executed = clock_micros();
+        job.fired = true;
+    }
+    arm_scheduler(clock_micros());
+}
+
+} // namespace details
+
+void handle_scheduled_jobs() {
+    // Also keeps the 64-bit clock from missing a wrap of `micros()`.
+    clock_micros();
+
+    for (;;) {
+        ScheduledJob job;
+        {
+            InterruptLock lock;
+            unsigned int i = 0;
+            while (i < job_count_ and not jobs_[i].fired) {
+                i++;
+            }
+            if (i == job_count_) {
+                return;
+            }
+            job = jobs_[i];
+            details::del_scheduled_job(i);
+        }
+        if (not job.notify) {
+            continue;
+        }
+
+        int64_t lateness = (int64_t) (job.executed - job.at);
+        if (job.command == COMMAND_TRIGGER_PULSE) {
+            build_command(
+                COMMAND_TRIGGER_PULSE,
+                MSG_OUTPUT,
+                job.job,
+                "pin",
+                get_pin_string(job.pin),
+                "time",
+                job.executed,
+                "lateness",
+                lateness);
+        } else if (get_pin_type(job.pin) == PIN_DIGITAL) {
+            build_command(
+                COMMAND_SET_OUTPUT,
+                MSG_OUTPUT,
+                job.job,
+                "pin",
+                get_pin_string(job.pin),
+                "level",
+                (job.level == HIGH) ? "HIGH" : "LOW",
+                "at",
+                job.at,
+                "time",
+                job.executed,
+                "lateness",
+                lateness);
+        } else {
+            build_command(
+                COMMAND_SET_OUTPUT,
+                MSG_OUTPUT,
+                job.job,
+                "pin",
+                get_pin_string(job.pin),
+                "level",
+                job.level,
+                "at",
+                job.at,
+                "time",
+                job.executed,
+                "lateness",
+                lateness);
+        }
+    }
+}
+
+// at in µs device time (see `clock_micros`).
+int schedule_output(unsigned int job, pin_t pin, int level, uint64_t at, bool notify) {
+    InterruptLock lock;
+    return details::add_scheduled_job(
+        ScheduledJob{job, pin, level, at, 0, false, notify, COMMAND_SET_OUTPUT});
+}
+
+int schedule_pulse(unsigned int job, pin_t pin, uint64_t duration_us) {
+    InterruptLock lock;
+    if (job_count_ == MAX_SCHEDULED_JOBS) {
+        return 1; // Error - too many scheduled jobs.
+    }
+    for (unsigned int i = 0; i < job_count_; ++i) {
+        if (jobs_[i].pin == pin and jobs_[i].command == COMMAND_TRIGGER_PULSE and
+            not jobs_[i].fired) {
+            return 2; // Error - the pin is still pulsing.
+        }
+    }
+
+    write_digital_to_pin(pin, HIGH);
+    uint64_t at = clock_micros() + duration_us;
+    return details::add_scheduled_job(
+        ScheduledJob{job, pin, LOW, at, 0, false, true, COMMAND_TRIGGER_PULSE});
+}
+
+int cancel_scheduled_job(unsigned int job) {
+    InterruptLock lock;
+    for (unsigned int i = 0; i < job_count_; ++i) {
+        if (jobs_[i].job == job and jobs_[i].notify and not jobs_[i].fired and
+            jobs_[i].command == COMMAND_SET_OUTPUT) {
+            details::del_scheduled_job(i);
+            details::arm_scheduler(clock_micros());
+            return 0;
+        }
+    }
+    return 1; // Found no match (or the job already ran)!
+}
+
+} // namespace controllino
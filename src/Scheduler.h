@@ -0,0 +1,20 @@
+#ifndef CONTROLLINO_SCHEDULER_H
+#define CONTROLLINO_SCHEDULER_H
+
+#include "ProtocolHandler.h"
+
+#define MAX_SCHEDULED_JOBS 16
+
+namespace controllino {
+
+void handle_scheduled_jobs();
+// Without `notify`, the job isn't answered and can't be cancelled.
+int schedule_output(unsigned int job, pin_t pin, int level, uint64_t at, bool notify);
+// Drives `pin` HIGH now and LOW after `duration_us`. The job is answered once
+// the pulse ended and can't be cancelled.
+int schedule_pulse(unsigned int job, pin_t pin, uint64_t duration_us);
+int cancel_scheduled_job(unsigned int job);
+
+} // namespace controllino
+
+#endif /* CONTROLLINO_SCHEDULER_H */
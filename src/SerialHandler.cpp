@@ -1,5 +1,7 @@
 #include "SerialHandler.h"
 
+#include "Clock.h"
+
 namespace controllino {
 
 struct Callback {
@@ -12,6 +14,7 @@ struct Callback {
 String string_input = "";
 String string_buffer = "";
 bool string_complete = false;
+uint64_t string_time = 0; // Device time at which `string_input` was completed.
 Callback message_callback;
 
 void serial_init(void) {
@@ -40,19 +43,28 @@ void serial_print_message(const String& string_to_print) {
     Serial.println(string_to_print);
 }
 
+uint64_t serial_receive_time(void) {
+    return string_time;
+}
+
 } // namespace controllino
 
 // Documentation incorrectly states that `serialEvent` doesn't work on
 // Arduino Due. See https://github.com/arduino/reference-en/issues/819
 // for details.
+// A completed line waits for `serial_process`; the following ones stay in the
+// buffer of the UART meanwhile, so pipelined requests aren't overwritten.
 void serialEvent() {
-    while (Serial.available()) {
+    while (not controllino::string_complete and Serial.available()) {
         char inChar = (char) Serial.read();
         if (inChar == '\n') {
             controllino::string_complete = true;
+            controllino::string_time = controllino::clock_micros();
             controllino::string_input = controllino::string_buffer;
             controllino::string_buffer = "";
-        } else {
+        } else if (controllino::string_buffer.length() <= MAX_MESSAGE_LENGTH) {
+            // One character more than allowed gets the line rejected; the rest
+            // of a longer one is dropped, so it can't exhaust the heap.
             controllino::string_buffer += inChar;
         }
     }
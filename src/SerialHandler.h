@@ -4,12 +4,16 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 
+// Longer lines are rejected by the message handler.
+#define MAX_MESSAGE_LENGTH 2047
+
 namespace controllino {
 
 void serial_init(void);
 void serial_set_callback(void (*function)(void*));
 void serial_process(void);
 void serial_print_message(const String& string_to_print);
+uint64_t serial_receive_time(void);
 
 } // namespace controllino
 
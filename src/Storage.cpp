@@ -0,0 +1,280 @@
+#include "Storage.h"
+
+#include <stddef.h>
+
+#include "Flash.h"
+
+namespace controllino {
+
+const uint32_t page_magic = 0x4a4c5443; // "CTLJ"
+const uint16_t end_of_records = 0xFFFF; // Key of erased flash
+
+struct PageHeader {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t crc;
+};
+
+// Followed by `size` bytes of value, padded to whole words. A record without
+// a value deletes the key.
+struct RecordHeader {
+    uint16_t key;
+    uint16_t size;
+    uint32_t crc;
+};
+
+static int page_ = -1; // No page in use yet
+static uint32_t sequence_ = 0;
+static unsigned int used_ = 0;
+static bool sealed_ = false; // Page has a broken record, no more appends
+static unsigned int writes_ = 0;
+static uint32_t boot_count_ = 0;
+
+static uint8_t buffer_[FLASH_STORAGE_PAGE_SIZE];
+
+namespace details {
+
+uint32_t crc32(uint32_t crc, const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*) data;
+    crc = ~crc;
+    while (size--) {
+        crc ^= *p++;
+        for (int k = 0; k < 8; ++k) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+size_t record_length(size_t size) {
+    return sizeof(RecordHeader) + ((size + 3) & ~(size_t) 3);
+}
+
+uint32_t record_crc(const RecordHeader& h, const uint8_t* value) {
+    uint32_t crc = crc32(0, &h.key, sizeof(h.key));
+    crc = crc32(crc, &h.size, sizeof(h.size));
+    return crc32(crc, value, h.size);
+}
+
+RecordHeader get_record(const uint8_t* page, unsigned int offset) {
+    RecordHeader h;
+    memcpy(&h, page + offset, sizeof(h));
+    return h;
+}
+
+bool read_page_header(const uint8_t* page, uint32_t* sequence) {
+    PageHeader h;
+    memcpy(&h, page, sizeof(h));
+    if (h.magic != page_magic or h.crc != crc32(0, &h, offsetof(PageHeader, crc))) {
+        return false;
+    }
+    *sequence = h.sequence;
+    return true;
+}
+
+// Length of the intact record at `offset`, or 0 if there is none.
+size_t valid_record(const uint8_t* page, unsigned int offset) {
+    if (offset + sizeof(RecordHeader) > FLASH_STORAGE_PAGE_SIZE) {
+        return 0;
+    }
+    RecordHeader h = get_record(page, offset);
+    size_t length = record_length(h.size);
+    if (h.key == end_of_records or offset + length > FLASH_STORAGE_PAGE_SIZE) {
+        return 0;
+    }
+    if (h.crc != record_crc(h, page + offset + sizeof(h))) {
+        return 0;
+    }
+    return length;
+}
+
+bool is_erased(const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Offset of the latest record of `key` in the current page, or 0.
+unsigned int find_record(uint16_t key) {
+    if (page_ < 0) {
+        return 0;
+    }
+    const uint8_t* page = flash_read_page(page_);
+    unsigned int found = 0;
+    for (unsigned int offset = sizeof(PageHeader); offset < used_;) {
+        RecordHeader h = get_record(page, offset);
+        if (h.key == key) {
+            found = offset;
+        }
+        offset += record_length(h.size);
+    }
+    return found;
+}
+
+size_t put_record(uint8_t* dest, uint16_t key, const void* data, size_t size) {
+    RecordHeader h;
+    h.key = key;
+    h.size = size;
+    // Erased records have no data.
+    if (size > 0) {
+        memcpy(dest + sizeof(h), data, size);
+    }
+    h.crc = record_crc(h, dest + sizeof(h));
+    memcpy(dest, &h, sizeof(h));
+    return record_length(size);
+}
+
+int append(uint16_t key, const void* data, size_t size) {
+    memset(buffer_, 0xFF, sizeof(buffer_));
+    size_t length = put_record(buffer_ + used_, key, data, size);
+    writes_++;
+    if (flash_write_page(page_, buffer_, false)) {
+        sealed_ = true;
+        return 2;
+    }
+    used_ += length;
+    return 0;
+}
+
+// Starts the next page with the latest records of all keys but `key`, followed
+// by the new value of `key` unless `size` is 0.
+int compact(uint16_t key, const void* data, size_t size) {
+    memset(buffer_, 0xFF, sizeof(buffer_));
+    size_t length = sizeof(PageHeader);
+    if (page_ >= 0) {
+        const uint8_t* page = flash_read_page(page_);
+        for (unsigned int offset = sizeof(PageHeader); offset < used_;) {
+            RecordHeader h = get_record(page, offset);
+            size_t record = record_length(h.size);
+            if (h.key != key and h.size > 0 and find_record(h.key) == offset) {
+                memcpy(buffer_ + length, page + offset, record);
+                length += record;
+            }
+            offset += record;
+        }
+    }
+    if (size > 0) {
+        if (length + record_length(size) > FLASH_STORAGE_PAGE_SIZE) {
+            return 1;
+        }
+        length += put_record(buffer_ + length, key, data, size);
+    }
+
+    PageHeader header;
+    header.magic = page_magic;
+    header.sequence = sequence_ + 1;
+    header.crc = crc32(0, &header, offsetof(PageHeader, crc));
+    memcpy(buffer_, &header, sizeof(header));
+
+    unsigned int next = (page_ + 1) % FLASH_STORAGE_PAGES;
+    writes_++;
+    if (flash_write_page(next, buffer_, true)) {
+        return 2;
+    }
+    page_ = next;
+    sequence_++;
+    used_ = length;
+    sealed_ = false;
+    return 0;
+}
+
+int write_record(uint16_t key, const void* data, size_t size) {
+    if (page_ < 0 or sealed_ or used_ + record_length(size) > FLASH_STORAGE_PAGE_SIZE) {
+        return compact(key, data, size);
+    }
+    return append(key, data, size);
+}
+
+} // namespace details
+
+void storage_init(void) {
+    page_ = -1;
+    sequence_ = 0;
+    used_ = 0;
+    sealed_ = false;
+    writes_ = 0;
+
+    for (unsigned int i = 0; i < FLASH_STORAGE_PAGES; ++i) {
+        uint32_t sequence;
+        if (details::read_page_header(flash_read_page(i), &sequence) and
+            (page_ < 0 or sequence > sequence_)) {
+            page_ = i;
+            sequence_ = sequence;
+        }
+    }
+    if (page_ < 0) {
+        return;
+    }
+
+    const uint8_t* page = flash_read_page(page_);
+    used_ = sizeof(PageHeader);
+    while (size_t length = details::valid_record(page, used_)) {
+        used_ += length;
+    }
+    // Programmed bytes behind the last intact record are left from a write
+    // that was cut short; only erasing the page clears them.
+    sealed_ = not details::is_erased(page + used_, FLASH_STORAGE_PAGE_SIZE - used_);
+}
+
+int storage_read(storage_key_t key, void* data, size_t size) {
+    unsigned int offset = details::find_record(key);
+    if (offset == 0) {
+        return -1;
+    }
+    const uint8_t* page = flash_read_page(page_);
+    RecordHeader h = details::get_record(page, offset);
+    if (h.size == 0) {
+        return -1;
+    }
+    memcpy(data, page + offset + sizeof(h), (size < h.size) ? size : h.size);
+    return h.size;
+}
+
+int storage_write(storage_key_t key, const void* data, size_t size) {
+    if (size == 0 or details::record_length(size) > FLASH_STORAGE_PAGE_SIZE) {
+        return 1;
+    }
+    unsigned int offset = details::find_record(key);
+    if (offset != 0) {
+        // Rewriting an unchanged value would only wear the flash.
+        const uint8_t* page = flash_read_page(page_);
+        RecordHeader h = details::get_record(page, offset);
+        if (h.size == size and memcmp(page + offset + sizeof(h), data, size) == 0) {
+            return 0;
+        }
+    }
+    return details::write_record(key, data, size);
+}
+
+int storage_erase(storage_key_t key) {
+    unsigned int offset = details::find_record(key);
+    if (offset == 0 or details::get_record(flash_read_page(page_), offset).size == 0) {
+        return 0;
+    }
+    return details::write_record(key, NULL, 0);
+}
+
+storage_stats_t get_storage_stats(void) {
+    storage_stats_t stats;
+    stats.sequence = sequence_;
+    stats.writes = writes_;
+    stats.used = (page_ < 0) ? 0 : used_;
+    stats.free = FLASH_STORAGE_PAGE_SIZE - stats.used;
+    return stats;
+}
+
+void count_boot(void) {
+    uint32_t count = 0;
+    storage_read(STORAGE_KEY_BOOT_COUNT, &count, sizeof(count));
+    boot_count_ = count + 1;
+    storage_write(STORAGE_KEY_BOOT_COUNT, &boot_count_, sizeof(boot_count_));
+}
+
+uint32_t get_boot_count(void) {
+    return boot_count_;
+}
+
+} // namespace controllino
@@ -0,0 +1,51 @@
+#ifndef CONTROLLINO_STORAGE_H
+#define CONTROLLINO_STORAGE_H
+
+#include <Arduino.h>
+
+namespace controllino {
+
+// FIXME: Warning! Values are stored in flash, so existing keys must never be
+// renumbered.
+typedef enum
+{
+    STORAGE_KEY_PIN_MODES = 1,
+    STORAGE_KEY_WATCHES = 2,
+    STORAGE_KEY_BOOT_COUNT = 3,
+    STORAGE_KEY_LOGGING_REQUESTS = 4,
+} storage_key_t;
+
+typedef struct {
+    uint32_t sequence;   // Pages started so far; each one erased a page
+    unsigned int writes; // Flash programming operations since boot
+    unsigned int used;   // Bytes used in the current page
+    unsigned int free;
+} storage_stats_t;
+
+// Settings are kept in a journal in flash (see Flash.h). Every write appends a
+// record to the current page; once it is full, the latest record of every key
+// is copied into the next page, which becomes current. Pages are used round
+// robin, so every page is erased once per FLASH_STORAGE_PAGES page changes.
+// Records and page headers carry a CRC, and a write that was cut short by a
+// reset is ignored at the next boot.
+void storage_init(void);
+
+// Copies up to `size` bytes of the value of `key` to `data`. Returns the size
+// of the stored value, or -1 if there is none.
+int storage_read(storage_key_t key, void* data, size_t size);
+
+// Stores `size` (> 0) bytes from `data` as the value of `key`. Returns 1 if the
+// value does not fit into a page together with all other values, 2 on a flash
+// error.
+int storage_write(storage_key_t key, const void* data, size_t size);
+int storage_erase(storage_key_t key);
+
+storage_stats_t get_storage_stats(void);
+
+// Boots so far including this one, counted in flash by `count_boot`.
+void count_boot(void);
+uint32_t get_boot_count(void);
+
+} // namespace controllino
+
+#endif /* CONTROLLINO_STORAGE_H */
@@ -0,0 +1,104 @@
+#include "Timer.h"
+
+namespace controllino {
+
+typedef struct {
+    Tc* tc;
+    uint32_t channel;
+    IRQn_Type irq;
+} timer_channel_t;
+
+// FIXME: Warning! These channels must be in the same order as in
+// `timer_id_t`! TC0 is left alone because its channels drive the PWM of
+// pins 2 and 13.
+const timer_channel_t timer_channels[] = {
+    {TC1, 0, TC3_IRQn},
+    {TC1, 1, TC4_IRQn},
+    {TC1, 2, TC5_IRQn},
+    {TC2, 0, TC6_IRQn},
+    {TC2, 1, TC7_IRQn},
+    {TC2, 2, TC8_IRQn},
+};
+
+// All channels run from TIMER_CLOCK1, which is MCK/2 = 42 MHz.
+const uint32_t ticks_per_us = VARIANT_MCK / 2 / 1000000;
+
+static void (*volatile callbacks_[TIMER_COUNT])(void);
+
+namespace details {
+
+void timer_configure(
+    timer_id_t timer, uint32_t us, void (*callback)(void), uint32_t mode) {
+    const timer_channel_t& t = timer_channels[(int) timer];
+    uint32_t ticks = us * ticks_per_us;
+    if (ticks < 2) {
+        ticks = 2;
+    }
+
+    NVIC_DisableIRQ(t.irq);
+    callbacks_[(int) timer] = callback;
+    pmc_enable_periph_clk((uint32_t) t.irq);
+    TC_Configure(
+        t.tc,
+        t.channel,
+        TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC | TC_CMR_TCCLKS_TIMER_CLOCK1 | mode);
+    TC_SetRC(t.tc, t.channel, ticks);
+    t.tc->TC_CHANNEL[t.channel].TC_IER = TC_IER_CPCS;
+    t.tc->TC_CHANNEL[t.channel].TC_IDR = ~TC_IER_CPCS;
+    TC_GetStatus(t.tc, t.channel);
+    NVIC_ClearPendingIRQ(t.irq);
+    NVIC_EnableIRQ(t.irq);
+    TC_Start(t.tc, t.channel);
+}
+
+void timer_dispatch(timer_id_t timer) {
+    const timer_channel_t& t = timer_channels[(int) timer];
+    TC_GetStatus(t.tc, t.channel); // Clears the interrupt flag.
+    if (callbacks_[(int) timer] != NULL) {
+        callbacks_[(int) timer]();
+    }
+}
+
+} // namespace details
+
+void timer_start(timer_id_t timer, uint32_t period_us, void (*callback)(void)) {
+    details::timer_configure(timer, period_us, callback, 0);
+}
+
+void timer_start_once(timer_id_t timer, uint32_t delay_us, void (*callback)(void)) {
+    details::timer_configure(timer, delay_us, callback, TC_CMR_CPCSTOP);
+}
+
+void timer_stop(timer_id_t timer) {
+    const timer_channel_t& t = timer_channels[(int) timer];
+    TC_Stop(t.tc, t.channel);
+    t.tc->TC_CHANNEL[t.channel].TC_IDR = TC_IDR_CPCS;
+    NVIC_DisableIRQ(t.irq);
+    callbacks_[(int) timer] = NULL;
+}
+
+} // namespace controllino
+
+void TC3_Handler() {
+    controllino::details::timer_dispatch(controllino::TIMER_SCHEDULER);
+}
+
+void TC4_Handler() {
+    controllino::details::timer_dispatch(controllino::TIMER_RULES);
+}
+
+void TC5_Handler() {
+    controllino::details::timer_dispatch(controllino::TIMER_CONTROL_LOOP);
+}
+
+void TC6_Handler() {
+    controllino::details::timer_dispatch(controllino::TIMER_WATCH);
+}
+
+void TC7_Handler() {
+    controllino::details::timer_dispatch(controllino::TIMER_DEBOUNCE);
+}
+
+void TC8_Handler() {
+    controllino::details::timer_dispatch(controllino::TIMER_ADC_SCAN);
+}
@@ -0,0 +1,28 @@
+#ifndef CONTROLLINO_TIMER_H
+#define CONTROLLINO_TIMER_H
+
+#include <Arduino.h>
+
+namespace controllino {
+
+// Each feature that needs a hardware timer owns one of these.
+typedef enum
+{
+    TIMER_SCHEDULER = 0,
+    TIMER_RULES,
+    TIMER_CONTROL_LOOP,
+    TIMER_WATCH,
+    TIMER_DEBOUNCE,
+    TIMER_ADC_SCAN,
+    TIMER_COUNT,
+} timer_id_t;
+
+// Calls `callback` from interrupt context every `period_us` microseconds.
+void timer_start(timer_id_t timer, uint32_t period_us, void (*callback)(void));
+// Calls `callback` from interrupt context once after `delay_us` microseconds.
+void timer_start_once(timer_id_t timer, uint32_t delay_us, void (*callback)(void));
+void timer_stop(timer_id_t timer);
+
+} // namespace controllino
+
+#endif /* CONTROLLINO_TIMER_H */
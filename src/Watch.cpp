@@ -0,0 +1,262 @@
+#include "Watch.h"
+
+#include <Arduino.h>
+
+#include "Clock.h"
+#include "GpioHandler.h"
+#include "InterruptLock.h"
+#include "Storage.h"
+#include "Timer.h"
+
+namespace controllino {
+
+typedef enum
+{
+    WATCH_NORMAL = 0,
+    WATCH_HIGH,
+    WATCH_LOW,
+} watch_state_t;
+
+const char* const watch_state_strings[] = {"NORMAL", "HIGH", "LOW"};
+
+struct Watch {
+    unsigned int job;
+    pin_t pin;
+    watch_config_t config;
+    bool persistent;
+    watch_state_t state;
+    watch_state_t candidate; // State the input is about to change to
+    uint64_t candidate_since;
+    int candidate_peak; // Extreme value since the candidate was seen
+    int peak;           // Extreme value since the current state was entered
+};
+
+// Value of STORAGE_KEY_WATCHES is an array of these.
+struct StoredWatch {
+    uint32_t job;
+    uint32_t pin;
+    watch_config_t config;
+};
+
+struct WatchEvent {
+    unsigned int job;
+    watch_state_t state;
+    uint64_t time;
+    int value;
+    int peak;
+};
+
+// Shared with the timer interrupt, so every access from the main loop must
+// hold an `InterruptLock`.
+static Watch watches_[MAX_WATCHES];
+static volatile unsigned int watch_count_ = 0;
+
+static WatchEvent events_[WATCH_EVENT_QUEUE_SIZE];
+static volatile unsigned int event_head_ = 0;
+static volatile unsigned int event_count_ = 0;
+static volatile unsigned int events_dropped_ = 0;
+
+namespace details {
+
+watch_state_t classify(const Watch& w, int value) {
+    const watch_config_t& c = w.config;
+    // Leaving an alarm band requires passing the hysteresis. Bands may reach
+    // the limits of `int`, so the margins are computed in 64 bits.
+    if (w.state == WATCH_HIGH and value >= (int64_t) c.high - c.hysteresis) {
+        return WATCH_HIGH;
+    }
+    if (w.state == WATCH_LOW and value <= (int64_t) c.low + c.hysteresis) {
+        return WATCH_LOW;
+    }
+    if (value > c.high) {
+        return WATCH_HIGH;
+    }
+    if (value < c.low) {
+        return WATCH_LOW;
+    }
+    return WATCH_NORMAL;
+}
+
+void push_event(const Watch& w, uint64_t time, int value, int peak) {
+    if (event_count_ == WATCH_EVENT_QUEUE_SIZE) {
+        events_dropped_++;
+        return;
+    }
+    events_[(event_head_ + event_count_) % WATCH_EVENT_QUEUE_SIZE] =
+        WatchEvent{w.job, w.state, time, value, peak};
+    event_count_++;
+}
+
+void track_peak(int& peak, watch_state_t direction, int value) {
+    if ((direction == WATCH_HIGH and value > peak) or
+        (direction == WATCH_LOW and value < peak)) {
+        peak = value;
+    }
+}
+
+// Called from the timer interrupt.
+void sample_watches() {
+    uint64_t now = clock_micros();
+    for (unsigned int i = 0; i < watch_count_; ++i) {
+        Watch& w = watches_[i];
+        int value = read_analog_from_pin(w.pin);
+        watch_state_t target = classify(w, value);
+        track_peak(w.peak, w.state, value);
+
+        if (target == w.state) {
+            w.candidate = w.state;
+            continue;
+        }
+
+        if (target != w.candidate) {
+            w.candidate = target;
+            w.candidate_since = now;
+            w.candidate_peak = value;
+        }
+        track_peak(w.candidate_peak, target, value);
+
+        if (now - w.candidate_since < (uint64_t) w.config.dwell * 1000) {
+            continue;
+        }
+
+        // Leaving an alarm band reports the extreme of the whole excursion,
+        // entering one the extreme seen while dwelling.
+        int peak = (target == WATCH_NORMAL) ? w.peak : w.candidate_peak;
+        w.state = target;
+        w.peak = w.candidate_peak;
+        push_event(w, w.candidate_since, value, peak);
+    }
+}
+
+int add_watch(unsigned int job, pin_t pin, const watch_config_t& config, bool persistent) {
+    if (watch_count_ == MAX_WATCHES) {
+        return 1; // Error - too many watches.
+    }
+    for (unsigned int i = 0; i < watch_count_; ++i) {
+        if (watches_[i].pin == pin) {
+            return 2; // Error - pin is already watched.
+        }
+    }
+
+    Watch w{};
+    w.job = job;
+    w.pin = pin;
+    w.config = config;
+    w.persistent = persistent;
+    w.state = WATCH_NORMAL;
+    w.candidate = WATCH_NORMAL;
+    {
+        InterruptLock lock;
+        watches_[watch_count_] = w;
+        watch_count_++;
+    }
+
+    if (watch_count_ == 1) {
+        timer_start(TIMER_WATCH, WATCH_SAMPLE_PERIOD_US, sample_watches);
+    }
+    return 0;
+}
+
+int store_watches() {
+    StoredWatch stored[MAX_WATCHES];
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < watch_count_; ++i) {
+        if (watches_[i].persistent) {
+            const Watch& w = watches_[i];
+            stored[count++] = StoredWatch{w.job, (uint32_t) w.pin, w.config};
+        }
+    }
+    if (count == 0) {
+        return storage_erase(STORAGE_KEY_WATCHES);
+    }
+    return storage_write(STORAGE_KEY_WATCHES, stored, count * sizeof(StoredWatch));
+}
+
+} // namespace details
+
+void handle_watches() {
+    for (;;) {
+        WatchEvent event;
+        unsigned int dropped;
+        {
+            InterruptLock lock;
+            if (event_count_ == 0) {
+                return;
+            }
+            event = events_[event_head_];
+            event_head_ = (event_head_ + 1) % WATCH_EVENT_QUEUE_SIZE;
+            event_count_--;
+            dropped = events_dropped_;
+            events_dropped_ = 0;
+        }
+
+        build_command(
+            COMMAND_WATCH,
+            MSG_OUTPUT,
+            event.job,
+            "time",
+            event.time,
+            "state",
+            watch_state_strings[(int) event.state],
+            "value",
+            event.value,
+            "peak",
+            event.peak,
+            "dropped",
+            dropped);
+    }
+}
+
+void restore_watches() {
+    StoredWatch stored[MAX_WATCHES];
+    int size = storage_read(STORAGE_KEY_WATCHES, stored, sizeof(stored));
+    if (size <= 0 or size % sizeof(StoredWatch) != 0) {
+        return;
+    }
+    for (unsigned int i = 0; i < size / sizeof(StoredWatch); ++i) {
+        const StoredWatch& w = stored[i];
+        if (w.pin >= PIN_INVALID_PIN or get_pin_type((pin_t) w.pin) != PIN_ANALOG) {
+            continue;
+        }
+        details::add_watch(w.job, (pin_t) w.pin, w.config, true);
+    }
+}
+
+int watch(unsigned int job, pin_t pin, const watch_config_t& config, bool persistent) {
+    auto error = details::add_watch(job, pin, config, persistent);
+    if (error or not persistent) {
+        return error;
+    }
+    if (details::store_watches()) {
+        end_watch(pin);
+        return 3; // Error - could not store the watch.
+    }
+    return 0;
+}
+
+int end_watch(pin_t pin) {
+    for (unsigned int i = 0; i < watch_count_; ++i) {
+        if (watches_[i].pin != pin) {
+            continue;
+        }
+
+        bool persistent = watches_[i].persistent;
+        {
+            InterruptLock lock;
+            for (unsigned int j = i; j < watch_count_ - 1; ++j) {
+                watches_[j] = watches_[j + 1];
+            }
+            watch_count_--;
+        }
+        if (watch_count_ == 0) {
+            timer_stop(TIMER_WATCH);
+        }
+        if (persistent and details::store_watches()) {
+            return 2; // Error - the watch is still stored.
+        }
+        return 0;
+    }
+    return 1; // Found no match!
+}
+
+} // namespace controllino
@@ -0,0 +1,30 @@
+#ifndef CONTROLLINO_WATCH_H
+#define CONTROLLINO_WATCH_H
+
+#include "ProtocolHandler.h"
+
+#define MAX_WATCHES 4
+#define WATCH_SAMPLE_PERIOD_US 1000
+#define WATCH_EVENT_QUEUE_SIZE 16
+
+namespace controllino {
+
+typedef struct {
+    int low;
+    int high;
+    unsigned int hysteresis;
+    unsigned int dwell; // ms
+} watch_config_t;
+
+// Analog inputs are sampled every WATCH_SAMPLE_PERIOD_US in a timer
+// interrupt; `handle_watches` sends an event whenever a watched input enters
+// or leaves its alarm band. Persistent watches are kept in flash and come back
+// with `restore_watches` at boot, still reporting to the job that started them.
+void handle_watches();
+void restore_watches();
+int watch(unsigned int job, pin_t pin, const watch_config_t& config, bool persistent);
+int end_watch(pin_t pin);
+
+} // namespace controllino
+
+#endif /* CONTROLLINO_WATCH_H */
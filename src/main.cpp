@@ -1,21 +1,40 @@
 #include <Arduino.h>
 
+#include "Clock.h"
+#include "ControlLoop.h"
+#include "Counters.h"
+#include "Frequency.h"
 #include "GpioHandler.h"
 #include "Logger.h"
 #include "MessageHandler.h"
+#include "Rules.h"
+#include "Scheduler.h"
 #include "SerialHandler.h"
+#include "Storage.h"
+#include "Watch.h"
 
 using namespace controllino;
 
 void setup() {
     serial_init();
+    storage_init();
+    count_boot();
     load_pin_modes();
+    restore_logging_requests();
+    restore_watches();
     init_message_handler();
 
+    clock_mark_boot();
     command_ready();
 }
 
 void loop() {
     serial_process();
     handle_logging_requests();
+    handle_scheduled_jobs();
+    handle_rules();
+    handle_control_loop();
+    handle_watches();
+    handle_frequency_measurements();
+    handle_counters();
 }
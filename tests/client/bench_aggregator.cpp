@@ -0,0 +1,113 @@
+#include "client_test.h"
+
+#include <time.h>
+
+#include <memory>
+
+using namespace controllino::client;
+
+const char* socket_path = "build/client/bench_aggregator.sock";
+
+double seconds() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// The CPU time `pid` used so far.
+double cpu_seconds(pid_t pid) {
+    std::string path = "/proc/" + std::to_string(pid) + "/stat";
+    FILE* file = fopen(path.c_str(), "r");
+    CHECK(file != NULL);
+    unsigned long user = 0;
+    unsigned long system = 0;
+    CHECK(fscanf(file, "%*d %*s %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &user,
+                 &system) == 2);
+    fclose(file);
+    return (double) (user + system) / sysconf(_SC_CLK_TCK);
+}
+
+void wait_ready(Connection& connection, int boards) {
+    Reply reply;
+    for (int i = 0; i < 10 * boards; ++i) {
+        connection.send(R"({"command": "LIST_BOARDS", "job": 1})");
+        do {
+            CHECK(connection.receive(reply, 10000));
+        } while (reply.job() != 1);
+        if (reply.get("boards").text().str().find("false") == std::string::npos) {
+            return;
+        }
+        usleep(100000);
+    }
+    CHECK(false);
+}
+
+// Sequential requests through the aggregator.
+void bench_requests(Connection& connection) {
+    const int count = 200;
+    Reply reply;
+    double start = seconds();
+    for (int i = 0; i < count; ++i) {
+        connection.send(R"({"command": "GET_INPUT", "job": 2, "board": "b0", "pin": "D30"})");
+        do {
+            CHECK(connection.receive(reply));
+        } while (reply.job() != 2);
+        CHECK(reply.kind() == Reply::KIND_OUTPUT);
+    }
+    printf("requests: %.0f us per round trip\n", (seconds() - start) / count * 1e6);
+}
+
+// Two clients subscribe to a pin of every board; the aggregator's CPU time is
+// compared with the lines it passes on.
+void bench_logging(pid_t aggregator, Connection& a, Connection& b, int boards,
+                   double duration) {
+    for (int i = 0; i < boards; ++i) {
+        std::string request = R"({"command": "LOG_SIGNAL", "job": 3, "board": "b)" +
+                              std::to_string(i) + R"(", "pin": "A0", "period": 10})";
+        a.send(request);
+        b.send(request);
+    }
+    Reply reply;
+    unsigned long lines = 0;
+    double start = seconds();
+    double cpu_start = cpu_seconds(aggregator);
+    while (seconds() - start < duration) {
+        for (Connection* connection : {&a, &b}) {
+            while (connection->receive(reply, 0)) {
+                lines++;
+            }
+        }
+        usleep(1000);
+    }
+    double elapsed = seconds() - start;
+    double cpu = cpu_seconds(aggregator) - cpu_start;
+    printf("logging, %d boards, 2 subscribers: %.0f lines/s, aggregator CPU %.1f%%, "
+           "%.1f us/line\n",
+           boards, lines / elapsed, cpu / elapsed * 100, cpu / lines * 1e6);
+}
+
+int main(int argc, char** argv) {
+    int boards = argc > 1 ? atoi(argv[1]) : 100;
+    std::vector<std::unique_ptr<VirtualDevice>> devices;
+    std::vector<std::string> specs;
+    for (int i = 0; i < boards; ++i) {
+        std::string link = "build/client/bench_aggregator" + std::to_string(i) + ".pty";
+        // Coarse steps let many devices share a core.
+        devices.emplace_back(new VirtualDevice(link, {"--step", "5000"}));
+        specs.push_back("b" + std::to_string(i) + "=" + link);
+    }
+    Aggregator aggregator(socket_path, specs);
+    Connection a(socket_path);
+    Connection b(socket_path);
+    wait_ready(a, boards);
+
+    double start = seconds();
+    double cpu_start = cpu_seconds(aggregator.pid());
+    sleep(2);
+    printf("idle, %d boards: aggregator CPU %.2f%%\n", boards,
+           (cpu_seconds(aggregator.pid()) - cpu_start) / (seconds() - start) * 100);
+
+    bench_requests(a);
+    bench_logging(aggregator.pid(), a, b, boards, 5.0);
+    return 0;
+}
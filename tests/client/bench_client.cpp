@@ -0,0 +1,114 @@
+#include "client_test.h"
+
+#include <string.h>
+#include <time.h>
+
+using namespace controllino::client;
+
+const char* port_link = "build/client/bench_client.pty";
+
+double seconds(clockid_t clock) {
+    timespec now;
+    clock_gettime(clock, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Parsing the samples of a logging job, without the port.
+void bench_parse() {
+    const int count = 1000000;
+    const char* line = R"({"command":"RX_LOG_SIGNAL","job":12,"time":1234567890123,)"
+                       R"("value":517,"seq":4242,"done":false})";
+    size_t size = strlen(line);
+    Reply reply;
+    uint64_t sum = 0;
+    double start = seconds(CLOCK_MONOTONIC);
+    for (int i = 0; i < count; ++i) {
+        CHECK(reply.parse(line, size));
+        sum += reply.get("time").as_uint() + reply.get("value").as_int() +
+               reply.get("seq").as_uint();
+    }
+    double elapsed = seconds(CLOCK_MONOTONIC) - start;
+    CHECK(sum > 0);
+    printf("parse: %.0f samples/s (%.0f ns/sample)\n", count / elapsed, elapsed / count * 1e9);
+}
+
+// Round trips with `window` requests in flight.
+void bench_requests(Client& client, unsigned long baud, size_t window, int count) {
+    client.set_max_in_flight(window);
+    int answered = 0;
+    double start = seconds(CLOCK_MONOTONIC);
+    for (int i = 0; i < count; ++i) {
+        client.send(Request("GET_INPUT").set("pin", "D30"),
+                    [&answered](const Reply& reply) {
+                        CHECK(reply.kind() == Reply::KIND_OUTPUT);
+                        answered++;
+                    });
+    }
+    while (answered < count) {
+        CHECK(client.poll(2000));
+    }
+    double elapsed = seconds(CLOCK_MONOTONIC) - start;
+    printf("requests at %lu baud, %zu in flight: %.0f/s\n", baud, window, count / elapsed);
+}
+
+// Samples of all analog inputs at 1 ms; the client's CPU time per sample
+// includes polling.
+void bench_logging(Client& client, double duration) {
+    const int channels = 8;
+    LogBuffer buffers[channels];
+    for (int i = 0; i < channels; ++i) {
+        std::string pin = "A" + std::to_string(i);
+        client.log(Request("LOG_SIGNAL").set("pin", pin).set("period", 1), buffers[i]);
+    }
+    double start = seconds(CLOCK_MONOTONIC);
+    double cpu_start = seconds(CLOCK_PROCESS_CPUTIME_ID);
+    while (seconds(CLOCK_MONOTONIC) - start < duration) {
+        CHECK(client.poll(100));
+    }
+    double elapsed = seconds(CLOCK_MONOTONIC) - start;
+    double cpu = seconds(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+
+    size_t samples = 0;
+    unsigned long coalesced = 0;
+    for (int i = 0; i < channels; ++i) {
+        samples += buffers[i].samples.size();
+        for (const Sample& sample : buffers[i].samples) {
+            coalesced += sample.coalesced;
+        }
+        std::string pin = "A" + std::to_string(i);
+        client.send(Request("END_LOG_SIGNAL").set("pin", pin), [](const Reply&) {});
+    }
+    for (int i = 0; i < channels; ++i) {
+        while (not buffers[i].done) {
+            CHECK(client.poll(2000));
+        }
+    }
+    printf("logging, %d channels at 1 ms: %.0f samples/s, %lu coalesced, %.0f ns CPU/sample\n",
+           channels, samples / elapsed, coalesced, cpu / samples * 1e9);
+}
+
+// Requests over the emulated serial line. The board runs at 19200 baud;
+// faster lines show what the client itself sustains.
+void bench_line(unsigned long baud, int count) {
+    VirtualDevice device(port_link, {"--baud", std::to_string(baud)});
+    Client client(device.path(), baud);
+    CHECK(client.connect());
+    bench_requests(client, baud, 1, count / 5);
+    bench_requests(client, baud, 8, count);
+    bench_requests(client, baud, 32, count);
+}
+
+int main() {
+    bench_parse();
+    bench_line(19200, 200);
+    bench_line(115200, 1000);
+    {
+        // Samples as fast as the simulation produces them, which loads the
+        // client.
+        VirtualDevice device(port_link);
+        Client client(device.path());
+        CHECK(client.connect());
+        bench_logging(client, 3.0);
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "client_test.h"
+
+#include <math.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <algorithm>
+#include <random>
+
+#include "SampleStore.h"
+
+using namespace controllino::client;
+
+const char* store_path = "build/client/bench_store.store";
+
+double seconds() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Records `hours` of an analog input on `channels` pins at `rate` samples per
+// second: a slow sine with some noise, sampled with a jitter of a few
+// microseconds.
+void bench_write(double hours, double rate, int channels) {
+    remove(store_path);
+    SampleWriter writer;
+    CHECK(writer.open(store_path));
+    std::vector<int> ids;
+    for (int c = 0; c < channels; ++c) {
+        ids.push_back(writer.channel("A" + std::to_string(c)));
+    }
+    std::mt19937 random(1);
+    uint64_t count = (uint64_t) (hours * 3600 * rate);
+    double period_us = 1e6 / rate;
+    double start = seconds();
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t time = (uint64_t) (i * period_us) + random() % 5;
+        for (int c = 0; c < channels; ++c) {
+            int32_t value = 512 + (int32_t) (300 * sin(time * 1e-8 * (c + 1))) + random() % 7;
+            writer.append(ids[c], time, value);
+        }
+    }
+    CHECK(writer.close());
+    double elapsed = seconds() - start;
+    struct stat st;
+    CHECK(stat(store_path, &st) == 0);
+    uint64_t samples = count * channels;
+    printf("write: %.1f h, %d channels at %.0f Hz, %.0fM samples in %.1f s, %.1fM samples/s, "
+           "%.2f bytes/sample\n",
+           hours, channels, rate, samples / 1e6, elapsed, samples / elapsed / 1e6,
+           (double) st.st_size / samples);
+}
+
+template <typename F> void time_queries(const char* name, int count, F query) {
+    double total = 0;
+    double worst = 0;
+    for (int i = 0; i < count; ++i) {
+        double start = seconds();
+        query(i);
+        double elapsed = seconds() - start;
+        total += elapsed;
+        worst = std::max(worst, elapsed);
+    }
+    printf("%s: %.3f ms mean, %.3f ms max\n", name, total / count * 1e3, worst * 1e3);
+}
+
+void bench_read() {
+    SampleStore store;
+    double start = seconds();
+    CHECK(store.open(store_path));
+    printf("open: %.3f ms\n", (seconds() - start) * 1e3);
+
+    std::mt19937 random(2);
+    uint64_t first = store.first_time(0);
+    uint64_t last = store.last_time(0);
+    size_t channels = store.channel_count();
+    time_queries("downsample all to 1000 buckets", 20, [&](int i) {
+        std::vector<Bucket> view = store.downsample(i % channels, first, last + 1, 1000);
+        CHECK(view.size() == 1000);
+    });
+    time_queries("downsample an hour to 1000 buckets", 100, [&](int i) {
+        uint64_t begin = first + random() % std::max<uint64_t>(last - first, 1);
+        store.downsample(i % channels, begin, begin + 3600000000ull, 1000);
+    });
+    std::vector<StoredSample> samples;
+    time_queries("read a second", 1000, [&](int i) {
+        uint64_t begin = first + random() % std::max<uint64_t>(last - first, 1);
+        samples.clear();
+        store.read(i % channels, begin, begin + 1000000, samples);
+    });
+    uint64_t total = 0;
+    for (size_t c = 0; c < channels; ++c) {
+        total += store.sample_count(c);
+    }
+    start = seconds();
+    samples.clear();
+    store.read(0, first, first + 3600000000ull, samples);
+    double elapsed = seconds() - start;
+    printf("read an hour: %.1fM samples in %.0f ms, %.0fM samples/s (%.0fM samples stored)\n",
+           samples.size() / 1e6, elapsed * 1e3, samples.size() / elapsed / 1e6, total / 1e6);
+}
+
+// bench_store [HOURS [RATE [CHANNELS]]]
+int main(int argc, char** argv) {
+    double hours = argc > 1 ? atof(argv[1]) : 6;
+    double rate = argc > 2 ? atof(argv[2]) : 1000;
+    int channels = argc > 3 ? atoi(argv[3]) : 4;
+    bench_write(hours, rate, channels);
+    bench_read();
+    remove(store_path);
+    return 0;
+}
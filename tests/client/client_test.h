@@ -0,0 +1,199 @@
+// Helpers for the tests and benchmarks of the host client and the aggregator,
+// which run against the virtual device (`make host-device`).
+#ifndef CONTROLLINO_CLIENT_TEST_H
+#define CONTROLLINO_CLIENT_TEST_H
+
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "Client.h"
+
+#define CHECK(condition)                                                               \
+    do {                                                                               \
+        if (not(condition)) {                                                          \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            exit(1);                                                                   \
+        }                                                                              \
+    } while (0)
+
+// Runs a program until it's stopped or destroyed. Programs print a line once
+// they're ready, e.g. the path of their port or socket.
+class Process {
+public:
+    explicit Process(std::vector<std::string> args) {
+        int out[2];
+        CHECK(pipe(out) == 0);
+        pid_ = fork();
+        CHECK(pid_ >= 0);
+        if (pid_ == 0) {
+            // `CHECK` exits without stopping the program.
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            dup2(out[1], STDOUT_FILENO);
+            std::vector<char*> argv;
+            for (std::string& arg : args) {
+                argv.push_back(&arg[0]);
+            }
+            argv.push_back(NULL);
+            execv(argv[0], argv.data());
+            perror(argv[0]);
+            _exit(1);
+        }
+        close(out[1]);
+        char c;
+        while (read(out[0], &c, 1) == 1 and c != '\n') {
+        }
+        close(out[0]);
+    }
+    ~Process() {
+        stop();
+    }
+    Process(const Process&) = delete;
+    Process& operator=(const Process&) = delete;
+
+    pid_t pid() const {
+        return pid_;
+    }
+    void stop() {
+        if (pid_ > 0) {
+            kill(pid_, SIGTERM);
+            waitpid(pid_, NULL, 0);
+            pid_ = -1;
+        }
+    }
+
+private:
+    pid_t pid_;
+};
+
+static std::string build_path(const char* variable, const char* fallback) {
+    const char* path = getenv(variable);
+    return path ? path : fallback;
+}
+
+// Runs build/host/device, or `CONTROLLINO_DEVICE`, with its port linked to
+// `link`.
+class VirtualDevice : public Process {
+public:
+    explicit VirtualDevice(const std::string& link, std::vector<std::string> args = {})
+        : Process(device_args(link, args)), link_(link) {
+    }
+
+    const std::string& path() const {
+        return link_;
+    }
+
+private:
+    static std::vector<std::string> device_args(const std::string& link,
+                                                std::vector<std::string> args) {
+        args.insert(args.begin(),
+                    {build_path("CONTROLLINO_DEVICE", "build/host/device"), "--link", link});
+        return args;
+    }
+
+    std::string link_;
+};
+
+// Runs build/client/aggregator, or `CONTROLLINO_AGGREGATOR`, for `boards`
+// (NAME=PORT).
+class Aggregator : public Process {
+public:
+    Aggregator(const std::string& socket, const std::vector<std::string>& boards)
+        : Process(aggregator_args(socket, boards)), socket_(socket) {
+    }
+
+    const std::string& socket() const {
+        return socket_;
+    }
+
+private:
+    static std::vector<std::string> aggregator_args(const std::string& socket,
+                                                    const std::vector<std::string>& boards) {
+        std::vector<std::string> args = {
+            build_path("CONTROLLINO_AGGREGATOR", "build/client/aggregator"),
+            "--socket",
+            socket,
+        };
+        for (const std::string& board : boards) {
+            args.push_back("--board");
+            args.push_back(board);
+        }
+        return args;
+    }
+
+    std::string socket_;
+};
+
+// A client of the aggregator.
+class Connection {
+public:
+    explicit Connection(const std::string& socket) {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, socket.c_str(), sizeof(address.sun_path) - 1);
+        fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        CHECK(fd_ >= 0);
+        CHECK(connect(fd_, (struct sockaddr*) &address, sizeof(address)) == 0);
+    }
+    ~Connection() {
+        close();
+    }
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    int fd() const {
+        return fd_;
+    }
+    void close() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+    void send(const std::string& line) {
+        std::string data = line + "\n";
+        CHECK(write(fd_, data.data(), data.size()) == (ssize_t) data.size());
+    }
+    // Waits at most `timeout_ms` for the next line and parses it into `reply`,
+    // which is valid until the next call.
+    bool receive(controllino::client::Reply& reply, int timeout_ms = 2000) {
+        size_t end;
+        while ((end = buffer_.find('\n', begin_)) == std::string::npos) {
+            struct pollfd fd = {fd_, POLLIN, 0};
+            char data[65536];
+            if (::poll(&fd, 1, timeout_ms) <= 0) {
+                return false;
+            }
+            ssize_t size = read(fd_, data, sizeof(data));
+            if (size <= 0) {
+                return false;
+            }
+            buffer_.erase(0, begin_);
+            begin_ = 0;
+            buffer_.append(data, (size_t) size);
+        }
+        line_.assign(buffer_, begin_, end - begin_);
+        begin_ = end + 1;
+        CHECK(reply.parse(line_.data(), line_.size()));
+        return true;
+    }
+
+private:
+    int fd_;
+    std::string buffer_;
+    size_t begin_ = 0;
+    std::string line_;
+};
+
+#endif /* CONTROLLINO_CLIENT_TEST_H */
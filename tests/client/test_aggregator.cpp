@@ -0,0 +1,186 @@
+#include "client_test.h"
+
+using namespace controllino::client;
+
+const char* socket_path = "build/client/test_aggregator.sock";
+
+// Receives lines until one of `job` arrives.
+Reply& receive_job(Connection& connection, Reply& reply, int64_t job) {
+    do {
+        CHECK(connection.receive(reply));
+    } while (reply.job() != job);
+    return reply;
+}
+
+void test_list_boards(Connection& connection) {
+    Reply reply;
+    // The boards send READY when the aggregator opens their ports.
+    for (int i = 0; i < 50; ++i) {
+        connection.send(R"({"command": "LIST_BOARDS", "job": 1})");
+        receive_job(connection, reply, 1);
+        CHECK(reply.command().equals("RX_LIST_BOARDS"));
+        if (reply.get("boards").text().str().find("false") == std::string::npos) {
+            break;
+        }
+        usleep(100000);
+    }
+    std::string boards = reply.get("boards").text().str();
+    CHECK(boards.find(R"({"name":"b0","port":"build/client/test_aggregator0.pty","ready":true})") !=
+          std::string::npos);
+    CHECK(boards.find(R"("name":"b1")") != std::string::npos);
+}
+
+// Clients may use the same jobs, on the same or on different boards.
+void test_jobs(Connection& a, Connection& b) {
+    a.send(R"({"command": "GET_PIN_MODE", "job": 1, "board": "b0", "pin": "D43"})");
+    b.send(R"({"command": "SET_OUTPUT", "job": 1, "board": "b0", "pin": "D40", "level": "HIGH"})");
+    Reply reply;
+    receive_job(a, reply, 1);
+    CHECK(reply.command().equals("RX_GET_PIN_MODE"));
+    CHECK(reply.get("board").equals("b0"));
+    CHECK(reply.get("mode").equals("OUTPUT"));
+    receive_job(b, reply, 1);
+    CHECK(reply.command().equals("RX_SET_OUTPUT"));
+    CHECK(reply.get("level").equals("HIGH"));
+
+    a.send(R"({"command": "GET_PIN_MODE", "job": 2, "board": "b1", "pin": "D30"})");
+    receive_job(a, reply, 2);
+    CHECK(reply.get("board").equals("b1"));
+    CHECK(reply.get("mode").equals("INPUT"));
+
+    a.send(R"({"command": "GET_INPUT", "job": 3, "board": "b9", "pin": "D30"})");
+    receive_job(a, reply, 3);
+    CHECK(reply.command().equals("ERR_GET_INPUT"));
+    CHECK(reply.get("error").equals("UNKNOWN_BOARD"));
+    a.send(R"({"command": "GET_INPUT", "board": "b0", "pin": "D30"})");
+    receive_job(a, reply, -1);
+    CHECK(reply.get("error").equals("NO_JOB_ID"));
+    a.send(R"({"command": "GET_INPUT", "job": 4, "board": "b0", "pin": "D99"})");
+    receive_job(a, reply, 4);
+    CHECK(reply.get("error").equals("INVALID_PIN"));
+}
+
+// An error the board sends without a job goes to the client of the request, whose
+// job may then be used again.
+void test_errors_without_job(Connection& a, Connection& b) {
+    a.send(R"({"command": "GET_INPUT", "job": 5, "board": "b0", "pin": ")" +
+           std::string(3000, 'x') + R"("})");
+    Reply reply;
+    receive_job(a, reply, 5);
+    CHECK(reply.kind() == Reply::KIND_ERROR);
+    CHECK(reply.get("error").equals("MESSAGE_TOO_LONG"));
+    CHECK(reply.get("board").equals("b0"));
+    a.send(R"({"command": "GET_INPUT", "job": 5, "board": "b0", "pin": "D30"})");
+    receive_job(a, reply, 5);
+    CHECK(reply.command().equals("RX_GET_INPUT"));
+
+    b.send(R"({"command": "GET_INPUT", "job": 2, "board": "b0", "pin": "D30"})");
+    do {
+        CHECK(b.receive(reply));
+        CHECK(reply.kind() != Reply::KIND_ERROR);
+    } while (reply.job() != 2);
+}
+
+// A scheduled output is cancelled by the job the client gave it.
+void test_cancel(Connection& a, Connection& b) {
+    // b keeps a job of the board pending, so that a's jobs differ from the board's.
+    b.send(R"({"command": "LOG_SIGNAL", "job": 20, "board": "b1", "pin": "D30", "period": 50})");
+    a.send(R"({"command": "SET_OUTPUT", "job": 1, "board": "b1", "pin": "D40", "level": "HIGH",)"
+           R"( "at": 1000000000000})");
+    Reply reply;
+    receive_job(a, reply, 1);
+    CHECK(reply.command().equals("ACK_SET_OUTPUT"));
+    a.send(R"({"command": "CANCEL_JOB", "job": 2, "board": "b1", "target": 1})");
+    receive_job(a, reply, 1);
+    CHECK(reply.get("error").equals("CANCELLED"));
+    receive_job(a, reply, 2);
+    CHECK(reply.command().equals("RX_CANCEL_JOB"));
+    CHECK(reply.get("target").as_int() == 1);
+
+    a.send(R"({"command": "CANCEL_JOB", "job": 3, "board": "b1", "target": 1})");
+    receive_job(a, reply, 3);
+    CHECK(reply.get("error").equals("JOB_NOT_FOUND"));
+    b.send(R"({"command": "END_LOG_SIGNAL", "job": 21, "board": "b1", "pin": "D30"})");
+    receive_job(b, reply, 21);
+    do {
+        receive_job(b, reply, 20);
+    } while (not reply.completes());
+}
+
+// Clients logging the same pin share the logging job of the board.
+void test_subscriptions(Connection& a, Connection& b) {
+    a.send(R"({"command": "LOG_SIGNAL", "job": 7, "board": "b0", "pin": "A0", "period": 5})");
+    b.send(R"({"command": "LOG_SIGNAL", "job": 3, "board": "b0", "pin": "A0", "period": 5})");
+    Reply reply;
+    for (int i = 0; i < 10; ++i) {
+        receive_job(a, reply, 7);
+        CHECK(reply.command().equals("RX_LOG_SIGNAL"));
+        CHECK(not reply.completes());
+    }
+    uint64_t seq = 0;
+    for (int i = 0; i < 10; ++i) {
+        receive_job(b, reply, 3);
+        CHECK(i == 0 or reply.get("seq").as_uint() == seq + 1);
+        seq = reply.get("seq").as_uint();
+    }
+
+    Connection c(socket_path);
+    c.send(R"({"command": "LOG_SIGNAL", "job": 1, "board": "b0", "pin": "A0", "period": 10})");
+    receive_job(c, reply, 1);
+    CHECK(reply.get("error").equals("PERIOD_MISMATCH"));
+    c.send(R"({"command": "END_LOG_SIGNAL", "job": 2, "board": "b0", "pin": "A0"})");
+    receive_job(c, reply, 2);
+    CHECK(reply.get("error").equals("NOT_SUBSCRIBED"));
+    a.send(R"({"command": "LOG_SIGNAL", "job": 7, "board": "b0", "pin": "A1", "period": 5})");
+    receive_job(a, reply, 7);
+    CHECK(reply.get("error").equals("DUPLICATE_JOB"));
+
+    // b leaves; its next sample is its last one.
+    b.send(R"({"command": "END_LOG_SIGNAL", "job": 4, "board": "b0", "pin": "A0"})");
+    receive_job(b, reply, 4);
+    CHECK(reply.command().equals("RX_END_LOG_SIGNAL"));
+    do {
+        receive_job(b, reply, 3);
+    } while (not reply.completes());
+    CHECK(reply.get("done").as_bool());
+    for (int i = 0; i < 5; ++i) {
+        receive_job(a, reply, 7);
+        CHECK(not reply.completes());
+    }
+
+    // The logging job ends with its last subscriber.
+    a.close();
+    for (int i = 0; i < 50; ++i) {
+        c.send(R"({"command": "LOG_SIGNAL", "job": 3, "board": "b0", "pin": "A0", "period": 10})");
+        receive_job(c, reply, 3);
+        if (reply.kind() == Reply::KIND_OUTPUT) {
+            break;
+        }
+        CHECK(reply.get("error").equals("BUSY") or reply.get("error").equals("PERIOD_MISMATCH"));
+        usleep(20000);
+    }
+    CHECK(reply.kind() == Reply::KIND_OUTPUT);
+    CHECK(reply.get("seq").as_uint() == 0);
+    c.send(R"({"command": "END_LOG_SIGNAL", "job": 4, "board": "b0", "pin": "A0"})");
+    receive_job(c, reply, 4);
+    CHECK(reply.command().equals("RX_END_LOG_SIGNAL"));
+    do {
+        receive_job(c, reply, 3);
+    } while (not reply.completes());
+}
+
+int main() {
+    VirtualDevice device0("build/client/test_aggregator0.pty");
+    VirtualDevice device1("build/client/test_aggregator1.pty");
+    Aggregator aggregator(socket_path,
+                          {"b0=" + device0.path(), "b1=" + device1.path()});
+    Connection a(socket_path);
+    Connection b(socket_path);
+    test_list_boards(a);
+    test_jobs(a, b);
+    test_errors_without_job(a, b);
+    test_cancel(a, b);
+    test_subscriptions(a, b);
+    printf("test_aggregator: OK\n");
+    return 0;
+}
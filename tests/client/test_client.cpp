@@ -0,0 +1,189 @@
+#include "client_test.h"
+
+#include <string.h>
+
+using namespace controllino::client;
+
+const char* port_link = "build/client/test_client.pty";
+
+// Replies are parsed in place, including nested values and escapes.
+void test_parse_replies() {
+    Reply reply;
+    const char* line = R"({"command":"RX_LOG_SIGNAL","job":7,"time":1234567890123,)"
+                       R"("value":-3,"seq":4,"done":false})";
+    CHECK(reply.parse(line, strlen(line)));
+    CHECK(reply.kind() == Reply::KIND_OUTPUT);
+    CHECK(reply.name().equals("LOG_SIGNAL"));
+    CHECK(reply.job() == 7);
+    CHECK(reply.get("time").as_uint() == 1234567890123ull);
+    CHECK(reply.get("value").as_int() == -3);
+    CHECK(not reply.completes());
+    CHECK(reply.get("missing").is_missing());
+
+    line = R"({"command": "RX_BATCH", "job": 2, "failed": 0, )"
+           R"("results": [{"command": "RX_SET_OUTPUT", "msg": "a \"}\" b"}, null]})";
+    CHECK(reply.parse(line, strlen(line)));
+    CHECK(reply.get("results").type() == Value::TYPE_ARRAY);
+    CHECK(reply.get("results").text().data[reply.get("results").text().size - 1] == ']');
+    CHECK(reply.completes());
+
+    line = R"({"command":"ERR_SET_OUTPUT","job":3,"error":"INVALID_PIN","msg":"a\nb"})";
+    CHECK(reply.parse(line, strlen(line)));
+    CHECK(reply.kind() == Reply::KIND_ERROR);
+    CHECK(reply.get("error").equals("INVALID_PIN"));
+    CHECK(reply.get("msg").str() == "a\nb");
+
+    const char* malformed[] = {
+        "",
+        "[]",
+        R"({"job": 1})",
+        R"({"command": "RX_READY", "job": 1)",
+        R"({"command": "RX_READY", "job": )",
+        R"({"command": "RX_READY"} trailing)",
+        R"({"command": "RX_READY", "results": [1, 2})",
+    };
+    for (const char* text : malformed) {
+        CHECK(not reply.parse(text, strlen(text)));
+    }
+}
+
+// Many requests are in flight at once and every reply reaches its request.
+void test_requests() {
+    VirtualDevice device(port_link);
+    Client client(device.path());
+    CHECK(client.connect());
+
+    Future mode = client.call(Request("GET_PIN_MODE").set("pin", "D43"));
+    CHECK(mode.wait(client, 2000));
+    CHECK(mode.ok());
+    CHECK(mode.reply().get("mode").equals("OUTPUT"));
+
+    Future invalid = client.call(Request("SET_OUTPUT").set("pin", "D99").set("level", "HIGH"));
+    CHECK(invalid.wait(client, 2000));
+    CHECK(not invalid.ok());
+    CHECK(invalid.reply().get("error").equals("INVALID_PIN"));
+
+    client.set_max_in_flight(16);
+    const int count = 500;
+    int answered = 0;
+    for (int i = 0; i < count; ++i) {
+        const char* level = i % 2 ? "HIGH" : "LOW";
+        uint32_t job = client.send(Request("SET_OUTPUT").set("pin", "D40").set("level", level),
+                                   [&answered, level](const Reply& reply) {
+                                       CHECK(reply.kind() == Reply::KIND_OUTPUT);
+                                       CHECK(reply.get("level").equals(level));
+                                       answered++;
+                                   });
+        CHECK(job > 0);
+    }
+    CHECK(client.in_flight() <= 16);
+    while (answered < count) {
+        CHECK(client.poll(2000));
+    }
+    CHECK(client.pending() == 0);
+    CHECK(client.malformed() == 0);
+
+    LogBuffer samples;
+    client.log(Request("LOG_SIGNAL").set("pin", "A0").set("period", 2), samples);
+    while (samples.samples.size() < 20) {
+        CHECK(client.poll(2000));
+    }
+    Future end = client.call(Request("END_LOG_SIGNAL").set("pin", "A0"));
+    CHECK(end.wait(client, 2000));
+    while (not samples.done) {
+        CHECK(client.poll(2000));
+    }
+    CHECK(samples.error.empty());
+    for (size_t i = 0; i < samples.samples.size(); ++i) {
+        CHECK(samples.samples[i].seq == i);
+        CHECK(i == 0 or samples.samples[i].time > samples.samples[i - 1].time);
+    }
+}
+
+// Over the emulated serial line at the board's baudrate, pipelined requests
+// neither overflow the receive buffer of the board nor overwrite each other
+// there.
+void test_pipelining() {
+    VirtualDevice device(port_link, {"--baud", "19200"});
+    Client client(device.path());
+    CHECK(client.connect());
+    client.set_max_in_flight(32);
+    const int count = 100;
+    int answered = 0;
+    for (int i = 0; i < count; ++i) {
+        client.send(Request("GET_INPUT").set("pin", "D30"), [&answered](const Reply& reply) {
+            CHECK(reply.kind() == Reply::KIND_OUTPUT);
+            answered++;
+        });
+    }
+    while (answered < count) {
+        CHECK(client.poll(2000));
+    }
+}
+
+// Malformed requests are answered, also when the board can't read their job,
+// and don't hold back the requests after them.
+void test_malformed_requests() {
+    VirtualDevice device(port_link);
+    Client client(device.path());
+    CHECK(client.connect());
+
+    std::vector<Future> errors;
+    for (int i = 0; i < 3; ++i) {
+        errors.push_back(client.call(Request("GET_INPUT")));
+    }
+    // Too long for the board to read the job.
+    errors.push_back(client.call(Request("GET_INPUT").set("pin", std::string(3000, 'x'))));
+    Future valid = client.call(Request("GET_PIN_MODE").set("pin", "D43"));
+    CHECK(valid.wait(client, 2000));
+    CHECK(valid.ok());
+    for (const Future& error : errors) {
+        CHECK(error.wait(client, 2000));
+        CHECK(error.reply().kind() == Reply::KIND_ERROR);
+    }
+    CHECK(errors[0].reply().get("error").equals("INVALID_KEY"));
+    CHECK(errors[0].reply().job() > 0);
+    CHECK(errors[3].reply().get("error").equals("MESSAGE_TOO_LONG"));
+    CHECK(client.in_flight() == 0);
+    CHECK(client.pending() == 0);
+}
+
+// Pending requests fail when the board goes away, and the client reconnects
+// once it's back.
+void test_reconnect() {
+    VirtualDevice* device = new VirtualDevice(port_link);
+    Client client(port_link);
+    client.set_reconnect_interval(50);
+    int connects = 0;
+    client.on_connect([&connects]() { connects++; });
+    CHECK(client.connect());
+
+    LogBuffer samples;
+    client.log(Request("LOG_SIGNAL").set("pin", "D30").set("period", 10), samples);
+    while (samples.samples.empty()) {
+        CHECK(client.poll(2000));
+    }
+    delete device;
+    while (client.connected()) {
+        client.poll(100);
+    }
+    CHECK(samples.done);
+    CHECK(samples.error == "DISCONNECTED");
+
+    Future queued = client.call(Request("GET_INPUT").set("pin", "D30"));
+    device = new VirtualDevice(port_link);
+    CHECK(queued.wait(client, 5000));
+    CHECK(queued.ok());
+    CHECK(connects == 2);
+    delete device;
+}
+
+int main() {
+    test_parse_replies();
+    test_requests();
+    test_pipelining();
+    test_malformed_requests();
+    test_reconnect();
+    printf("test_client: OK\n");
+    return 0;
+}
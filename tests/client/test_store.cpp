@@ -0,0 +1,284 @@
+#include "client_test.h"
+
+#include <algorithm>
+#include <random>
+
+#include "Recorder.h"
+#include "SampleStore.h"
+
+using namespace controllino::client;
+
+const char* store_path = "build/client/test_store.store";
+const char* copy_path = "build/client/test_store_copy.store";
+
+typedef std::vector<StoredSample> samples_t;
+
+// Samples with repeated times, large jumps and the extremes of the values.
+samples_t make_samples(std::mt19937& random, size_t count, uint64_t time) {
+    samples_t samples;
+    int32_t value = 0;
+    for (size_t i = 0; i < count; ++i) {
+        time += random() % 4 == 0 ? 0 : random() % 2000;
+        switch (random() % 8) {
+        case 0:
+            value = (int32_t) random();
+            break;
+        case 1:
+            value = random() % 2 ? INT32_MAX : INT32_MIN;
+            break;
+        default:
+            value += (int32_t) (random() % 21) - 10;
+        }
+        samples.push_back({time, value});
+    }
+    return samples;
+}
+
+void copy_file(const char* from, const char* to, size_t cut = 0) {
+    FILE* in = fopen(from, "rb");
+    CHECK(in != NULL);
+    std::string data;
+    char buffer[65536];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        data.append(buffer, size);
+    }
+    fclose(in);
+    FILE* out = fopen(to, "wb");
+    CHECK(out != NULL);
+    CHECK(fwrite(data.data(), 1, data.size() - cut, out) == data.size() - cut);
+    fclose(out);
+}
+
+// Compares ranges and downsampled views of a channel with `expected`.
+void check_channel(const SampleStore& store, const std::string& name, const samples_t& expected,
+                   std::mt19937& random) {
+    int channel = store.find_channel(name);
+    CHECK(channel >= 0);
+    CHECK(store.sample_count(channel) == expected.size());
+    CHECK(store.first_time(channel) == expected.front().time);
+    CHECK(store.last_time(channel) == expected.back().time);
+    samples_t all;
+    CHECK(store.read(channel, 0, UINT64_MAX, all) == expected.size());
+    for (size_t i = 0; i < all.size(); ++i) {
+        CHECK(all[i].time == expected[i].time and all[i].value == expected[i].value);
+    }
+
+    uint64_t span = expected.back().time - expected.front().time + 1;
+    for (int round = 0; round < 50; ++round) {
+        uint64_t begin = expected.front().time + random() % span;
+        uint64_t end = begin + random() % (span / (round % 5 + 1));
+        size_t buckets = 1 + random() % 300;
+        samples_t range;
+        store.read(channel, begin, end, range);
+        auto by_time = [](const StoredSample& sample, uint64_t time) {
+            return sample.time < time;
+        };
+        samples_t in_range(std::lower_bound(expected.begin(), expected.end(), begin, by_time),
+                           std::lower_bound(expected.begin(), expected.end(), end, by_time));
+        CHECK(range.size() == in_range.size());
+        for (size_t i = 0; i < range.size(); ++i) {
+            CHECK(range[i].time == in_range[i].time and range[i].value == in_range[i].value);
+        }
+
+        std::vector<Bucket> view = store.downsample(channel, begin, end, buckets);
+        if (end <= begin) {
+            CHECK(view.empty());
+            continue;
+        }
+        CHECK(view.size() == buckets);
+        uint64_t width = (end - begin - 1) / buckets + 1;
+        std::vector<Bucket> brute(buckets);
+        std::vector<double> sums(buckets, 0.0);
+        for (size_t i = 0; i < buckets; ++i) {
+            brute[i] = {begin + i * width, 0, 0, 0, 0.0};
+        }
+        for (const StoredSample& sample : in_range) {
+            Bucket& bucket = brute[(sample.time - begin) / width];
+            bucket.min = bucket.count == 0 ? sample.value : std::min(bucket.min, sample.value);
+            bucket.max = bucket.count == 0 ? sample.value : std::max(bucket.max, sample.value);
+            bucket.count++;
+            sums[(sample.time - begin) / width] += sample.value;
+        }
+        for (size_t i = 0; i < buckets; ++i) {
+            CHECK(view[i].begin == brute[i].begin);
+            CHECK(view[i].count == brute[i].count);
+            if (brute[i].count > 0) {
+                CHECK(view[i].min == brute[i].min and view[i].max == brute[i].max);
+                double mean = sums[i] / brute[i].count;
+                CHECK(std::abs(view[i].mean - mean) <= 1e-6 * std::max(1.0, std::abs(mean)));
+            }
+        }
+    }
+}
+
+// Channels of many chunks and index blocks, read after flushing, which
+// chains the index, and after closing, which writes a directory.
+void test_round_trip(std::mt19937& random) {
+    remove(store_path);
+    std::vector<std::string> names = {"A0", "b1/D30", "job 3"};
+    std::vector<samples_t> expected = {
+        make_samples(random, STORE_CHUNK_SAMPLES * (STORE_INDEX_ENTRIES + 3) + 17, 1000),
+        make_samples(random, 5, 0),
+        make_samples(random, STORE_CHUNK_SAMPLES * 3, 5000000),
+    };
+    SampleWriter writer;
+    CHECK(writer.open(store_path));
+    std::vector<int> channels;
+    for (const std::string& name : names) {
+        channels.push_back(writer.channel(name));
+    }
+    CHECK(writer.channel("A0") == channels[0]);
+    CHECK(writer.channel(std::string(MAX_CHANNEL_NAME, 'x')) == -1);
+    // Interleaved like the samples of a recording.
+    for (size_t i = 0; i < expected[0].size(); ++i) {
+        for (size_t c = 0; c < names.size(); ++c) {
+            if (i < expected[c].size()) {
+                CHECK(writer.append(channels[c], expected[c][i].time, expected[c][i].value));
+            }
+        }
+    }
+    CHECK(not writer.append(channels[1], expected[1].back().time - 1, 0));
+    CHECK(writer.flush());
+
+    SampleStore store;
+    for (int pass = 0; pass < 2; ++pass) {
+        CHECK(store.open(store_path));
+        CHECK(store.channel_count() == names.size());
+        for (size_t c = 0; c < names.size(); ++c) {
+            CHECK(store.channel_name(c) == names[c]);
+            check_channel(store, names[c], expected[c], random);
+        }
+        CHECK(store.find_channel("D99") == -1);
+        CHECK(writer.close());
+    }
+}
+
+// Samples appended after reopening the store go on where it ended.
+void test_append(std::mt19937& random) {
+    remove(store_path);
+    samples_t expected = make_samples(random, 5000, 0);
+    SampleWriter writer;
+    CHECK(writer.open(store_path));
+    int channel = writer.channel("A0");
+    for (size_t i = 0; i < 3000; ++i) {
+        writer.append(channel, expected[i].time, expected[i].value);
+    }
+    CHECK(writer.close());
+
+    CHECK(writer.open(store_path));
+    CHECK(writer.channel("A0") == channel);
+    CHECK(not writer.append(channel, expected[2999].time - 1, 0));
+    for (size_t i = 3000; i < expected.size(); ++i) {
+        writer.append(channel, expected[i].time, expected[i].value);
+    }
+    samples_t other = make_samples(random, 10, 0);
+    int other_channel = writer.channel("A1");
+    for (const StoredSample& sample : other) {
+        writer.append(other_channel, sample.time, sample.value);
+    }
+    CHECK(writer.close());
+
+    SampleStore store;
+    CHECK(store.open(store_path));
+    check_channel(store, "A0", expected, random);
+    check_channel(store, "A1", other, random);
+}
+
+// A store whose writer died is read up to its last complete chunk, and
+// reopening it indexes what wasn't indexed.
+void test_recovery(std::mt19937& random) {
+    remove(store_path);
+    samples_t expected = make_samples(random, 1000000, 0);
+    SampleWriter writer;
+    CHECK(writer.open(store_path));
+    int channel = writer.channel("A0");
+    size_t flushed = 100000;
+    for (size_t i = 0; i < flushed; ++i) {
+        writer.append(channel, expected[i].time, expected[i].value);
+    }
+    CHECK(writer.flush());
+    // The chunks are written once the buffer fills.
+    for (size_t i = flushed; i < expected.size(); ++i) {
+        writer.append(channel, expected[i].time, expected[i].value);
+    }
+
+    // Cut into the last chunk.
+    copy_file(store_path, copy_path, 5);
+    SampleStore store;
+    CHECK(store.open(copy_path));
+    int copy_channel = store.find_channel("A0");
+    CHECK(copy_channel >= 0);
+    uint64_t count = store.sample_count(copy_channel);
+    CHECK(count > flushed and count < expected.size());
+    CHECK((count - flushed) % STORE_CHUNK_SAMPLES == 0);
+    samples_t kept(expected.begin(), expected.begin() + count);
+    check_channel(store, "A0", kept, random);
+    store.close();
+
+    SampleWriter reopened;
+    CHECK(reopened.open(copy_path));
+    CHECK(reopened.channel("A0") == 0);
+    for (size_t i = count; i < expected.size(); ++i) {
+        reopened.append(0, expected[i].time, expected[i].value);
+    }
+    CHECK(reopened.close());
+    CHECK(store.open(copy_path));
+    check_channel(store, "A0", expected, random);
+    CHECK(writer.close());
+    remove(copy_path);
+}
+
+void test_recorder() {
+    remove(store_path);
+    SampleWriter writer;
+    CHECK(writer.open(store_path));
+    Recorder recorder(writer);
+    const char* lines[] = {
+        R"({"command": "LOG_SIGNAL", "job": 7, "pin": "A0", "period": 10})",
+        R"({"command":"RX_LOG_SIGNAL","job":7,"time":100,"value":5,"seq":0,"done":false})",
+        R"({"command":"RX_LOG_SIGNAL","job":5,"time":150,"value":-1,"seq":0,"done":false})",
+        R"({"command":"RX_LOG_SIGNAL","job":7,"time":200,"value":6,"seq":1,"done":true})",
+        // Job 7 logs another pin now.
+        R"({"command": "LOG_SIGNAL", "job": 7, "pin": "A1", "period": 10})",
+        R"({"command":"RX_LOG_SIGNAL","job":7,"time":300,"value":7,"seq":0,"done":false,)"
+        R"("coalesced":2,"min":1,"max":9})",
+        R"({"command":"ERR_LOG_SIGNAL","job":7,"error":"CANCELLED","msg":""})",
+        R"(1000 RX {"command": "LOG_SIGNAL", "job": 1, "board": "b0", "pin": "A2", "period": 1})",
+        R"(1010 TX {"command":"RX_LOG_SIGNAL","job":1,"time":1005,"value":3,"seq":0,"done":false,)"
+        R"("board":"b0"})",
+        R"(1020 TX {"command":"RX_LOG_SIGNAL","job":1,"time":1004,"value":3,"seq":1,"done":false,)"
+        R"("board":"b0"})",
+        R"({"command":"READY","job":0})",
+        "not json",
+    };
+    size_t valid = 0;
+    for (const char* line : lines) {
+        valid += recorder.ingest(line, strlen(line));
+    }
+    CHECK(valid == sizeof(lines) / sizeof(lines[0]) - 1);
+    CHECK(recorder.samples() == 5);
+    CHECK(recorder.dropped() == 1);
+    CHECK(writer.close());
+
+    SampleStore store;
+    CHECK(store.open(store_path));
+    CHECK(store.channel_count() == 4);
+    samples_t samples;
+    CHECK(store.read(store.find_channel("A0"), 0, UINT64_MAX, samples) == 2);
+    CHECK(samples[1].time == 200 and samples[1].value == 6);
+    CHECK(store.sample_count(store.find_channel("A1")) == 1);
+    CHECK(store.sample_count(store.find_channel("job 5")) == 1);
+    CHECK(store.sample_count(store.find_channel("b0/A2")) == 1);
+}
+
+int main() {
+    std::mt19937 random(1);
+    test_round_trip(random);
+    test_append(random);
+    test_recovery(random);
+    test_recorder();
+    remove(store_path);
+    printf("test_store: OK\n");
+    return 0;
+}
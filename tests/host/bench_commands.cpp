@@ -0,0 +1,52 @@
+// Measures what handling a request costs the firmware: the heap allocations
+// of `String`, which are the same as on the device, and the time from the
+// received line to the reply. Times include the simulated serial port, so
+// compare them between builds rather than reading them as device figures.
+#include <chrono>
+
+#include "host_test.h"
+
+typedef struct {
+    const char* name;
+    const char* line;
+} bench_t;
+
+const bench_t benches[] = {
+    {"GET_INPUT", R"({"command": "GET_INPUT", "job": 1, "pin": "D30"})"},
+    {"GET_INPUT analog", R"({"command": "GET_INPUT", "job": 1, "pin": "A0"})"},
+    {"SET_OUTPUT", R"({"command": "SET_OUTPUT", "job": 1, "pin": "D43", "level": "HIGH"})"},
+    {"SET_OUTPUT analog", R"({"command": "SET_OUTPUT", "job": 1, "pin": "DAC0", "level": 128})"},
+    {"GET_PIN_MODE", R"({"command": "GET_PIN_MODE", "job": 1, "pin": "D43"})"},
+    {"SET_PIN_MODE", R"({"command": "SET_PIN_MODE", "job": 1, "pin": "D43", "mode": "OUTPUT"})"},
+    {"SYNC_TIME", R"({"command": "SYNC_TIME", "job": 1, "t0": 1234567890123})"},
+    {"GRANT_CREDIT", R"({"command": "GRANT_CREDIT", "job": 1, "credit": 0})"},
+    {"GET_DEBOUNCE", R"({"command": "GET_DEBOUNCE", "job": 1, "pin": "D30"})"},
+    {"invalid pin", R"({"command": "GET_INPUT", "job": 1, "pin": "D99"})"},
+};
+
+const int runs = 20000;
+
+int main() {
+    sim::boot();
+    sim::output();
+
+    printf("%-20s %12s %10s\n", "request", "allocations", "us");
+    for (const bench_t& bench : benches) {
+        std::string line = bench.line;
+        unsigned long allocations = 0;
+        std::chrono::nanoseconds elapsed(0);
+        for (int i = 0; i < runs; ++i) {
+            unsigned long before = sim::string_allocations();
+            auto start = std::chrono::steady_clock::now();
+            sim::send(line);
+            elapsed += std::chrono::steady_clock::now() - start;
+            allocations += sim::string_allocations() - before;
+            CHECK(sim::output().size() == 1);
+        }
+        printf("%-20s %12.1f %10.2f\n",
+               bench.name,
+               (double) allocations / runs,
+               elapsed.count() / 1000.0 / runs);
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+// Streams millions of generated requests at the firmware and reports the
+// throughput, the worst latency of each kind of message with the line that
+// caused it, and the most the buffers of `String` held at once. Like
+// bench_commands, times include the simulated serial port; compare them
+// between builds. test_fuzz runs the same stream with the sanitizers.
+#include "stress.h"
+
+// bench_stress [MESSAGES [SEED]]
+int main(int argc, char** argv) {
+    unsigned long count = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+    uint32_t seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+
+    sim::boot();
+    sim::output();
+
+    MessageGenerator generator(seed);
+    stress_stats_t stats = run_stress(generator, count);
+    double seconds = stats.elapsed.count() * 1e-9;
+    printf("%lu messages, %lu replies, %lu without reply in %.1f s\n",
+           stats.messages,
+           stats.replies,
+           stats.silent,
+           seconds);
+    printf("%.0f messages/s, %.1f MB/s, %.1f allocations/message\n",
+           stats.messages / seconds,
+           stats.bytes / seconds / 1e6,
+           (double) stats.allocations / stats.messages);
+    printf("String heap high-water mark: %zu bytes\n", stats.heap_high_water);
+    printf("%-10s %10s %10s %10s  %s\n",
+           "kind",
+           "messages",
+           "mean us",
+           "worst us",
+           "worst line");
+    for (int kind = 0; kind < MESSAGE_KINDS; ++kind) {
+        printf("%-10s %10lu %10.2f %10.1f  %.60s\n",
+               message_kind_names[kind],
+               stats.count[kind],
+               stats.total[kind].count() / 1000.0 / std::max(stats.count[kind], 1ul),
+               stats.worst[kind].count() / 1000.0,
+               stats.worst_line[kind].c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,40 @@
+// Minimal helpers for the host tests, which run the firmware on the simulated
+// board from sim/.
+#ifndef CONTROLLINO_HOST_TEST_H
+#define CONTROLLINO_HOST_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include <ArduinoJson.h>
+
+#include "Sim.h"
+
+#define CHECK(condition)                                                               \
+    do {                                                                               \
+        if (not(condition)) {                                                          \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            exit(1);                                                                   \
+        }                                                                              \
+    } while (0)
+
+// Sends `line` and returns the last reply, which must be named `command`.
+inline DynamicJsonDocument request(const std::string& line,
+                                   const char* command,
+                                   size_t capacity = 1024) {
+    sim::send(line);
+    std::vector<std::string> lines = sim::output();
+    CHECK(not lines.empty());
+    DynamicJsonDocument doc(capacity);
+    CHECK(deserializeJson(doc, lines.back().c_str()) == DeserializationError::Ok);
+    if (doc["command"] != command) {
+        fprintf(stderr, "unexpected reply: %s\n", lines.back().c_str());
+    }
+    CHECK(doc["command"] == command);
+    return doc;
+}
+
+#endif /* CONTROLLINO_HOST_TEST_H */
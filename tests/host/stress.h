@@ -0,0 +1,431 @@
+// Streams generated requests at the firmware: well-formed requests of every
+// command with valid and invalid values, batches, and malformed lines made
+// from them. Shared by the fuzz test, which runs it with the sanitizers, and
+// the stress benchmark, which measures it.
+#ifndef CONTROLLINO_STRESS_H
+#define CONTROLLINO_STRESS_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "SerialHandler.h"
+#include "host_test.h"
+
+typedef enum
+{
+    MESSAGE_REQUEST = 0, // Well-formed, with values that may be invalid.
+    MESSAGE_BATCH,
+    MESSAGE_TRUNCATED,
+    MESSAGE_CORRUPTED,
+    MESSAGE_GARBAGE,
+    MESSAGE_LONG,
+    MESSAGE_NESTED,
+    MESSAGE_KINDS,
+} message_kind_t;
+
+const char* const message_kind_names[MESSAGE_KINDS] = {
+    "request", "batch", "truncated", "corrupted", "garbage", "long", "nested",
+};
+
+typedef struct {
+    const char* command;
+    // The keys the command reads, optional ones after the required ones.
+    const char* keys[10];
+} command_keys_t;
+
+const command_keys_t command_keys[] = {
+    {"GET_INPUT", {"pin"}},
+    {"SET_OUTPUT", {"pin", "level", "at"}},
+    {"LOG_SIGNAL", {"pin", "period", "persistent"}},
+    {"END_LOG_SIGNAL", {"pin"}},
+    {"GET_PIN_MODE", {"pin"}},
+    {"SET_PIN_MODE", {"pin", "mode"}},
+    {"LOAD_PIN_MODES", {}},
+    {"SAVE_PIN_MODES", {}},
+    {"RESET_PIN_MODES", {}},
+    {"TRIGGER_PULSE", {"pin", "duration"}},
+    {"CANCEL_JOB", {"target"}},
+    {"SYNC_TIME", {"t0"}},
+    {"GRANT_CREDIT", {"credit"}},
+    {"ADD_RULE",
+     {"condition", "action", "pin", "interval", "threshold", "hysteresis", "target", "level",
+      "duration", "period"}},
+    {"DELETE_RULE", {"rule"}},
+    {"GET_RULE", {"rule"}},
+    {"START_CONTROL_LOOP",
+     {"input", "output", "setpoint", "kp", "period", "ki", "kd", "min", "max", "telemetry"}},
+    {"UPDATE_CONTROL_LOOP", {"setpoint", "kp", "ki", "kd", "telemetry"}},
+    {"STOP_CONTROL_LOOP", {}},
+    {"GET_CONTROL_LOOP", {}},
+    {"WATCH", {"pin", "low", "high", "hysteresis", "dwell", "persistent"}},
+    {"END_WATCH", {"pin"}},
+    {"MEASURE_FREQUENCY", {"pin", "gate"}},
+    {"END_MEASURE_FREQUENCY", {"pin"}},
+    {"ADD_COUNTER", {"counter", "mode", "pin", "pin_b", "period"}},
+    {"DELETE_COUNTER", {"counter"}},
+    {"RESET_COUNTER", {"counter"}},
+    {"GET_COUNTERS", {"counters"}},
+    {"SET_DEBOUNCE", {"pin", "time", "filter"}},
+    {"GET_DEBOUNCE", {"pin"}},
+    {"SET_ADC", {"pin", "resolution", "oversampling", "settling", "scan"}},
+    {"GET_STORAGE", {}},
+};
+
+const size_t command_keys_count = sizeof(command_keys) / sizeof(command_keys[0]);
+
+class MessageGenerator {
+public:
+    explicit MessageGenerator(uint32_t seed) : random_(seed) {
+    }
+
+    // The next line, without its newline, which it never contains.
+    std::string next(message_kind_t& kind) {
+        unsigned int roll = random_() % 100;
+        if (roll < 55) {
+            kind = MESSAGE_REQUEST;
+            return request();
+        } else if (roll < 63) {
+            kind = MESSAGE_BATCH;
+            return batch();
+        } else if (roll < 73) {
+            kind = MESSAGE_TRUNCATED;
+            std::string line = request();
+            return line.substr(0, random_() % line.size());
+        } else if (roll < 85) {
+            kind = MESSAGE_CORRUPTED;
+            return corrupt(random_() % 4 ? request() : batch());
+        } else if (roll < 92) {
+            kind = MESSAGE_GARBAGE;
+            return garbage(random_() % 200);
+        } else if (roll < 96) {
+            kind = MESSAGE_LONG;
+            return long_line();
+        }
+        kind = MESSAGE_NESTED;
+        return nested();
+    }
+
+    // A request of a random command; most values are valid.
+    std::string request(bool with_job = true) {
+        unsigned int roll = random_() % 50;
+        if (roll == 0) {
+            return item(pick(unknown_commands), NULL, with_job);
+        }
+        const command_keys_t& command = command_keys[random_() % command_keys_count];
+        return item(quote(command.command), command.keys, with_job);
+    }
+
+    std::string batch() {
+        size_t count = random_() % 8 ? random_() % 8 : random_() % 40;
+        std::string line = R"({"command": "BATCH", "job": )" + job();
+        if (random_() % 2) {
+            line += random_() % 4 ? R"(, "atomic": true)" : R"(, "atomic": )" + value("");
+        }
+        if (random_() % 20 == 0) {
+            return line + R"(, "commands": )" + value("") + "}";
+        }
+        line += R"(, "commands": [)";
+        for (size_t i = 0; i < count; ++i) {
+            if (i > 0) {
+                line += ", ";
+            }
+            unsigned int roll = random_() % 30;
+            if (roll == 0) {
+                line += R"({"command": "BATCH", "job": 1, "commands": []})";
+            } else if (roll == 1) {
+                line += value("");
+            } else {
+                line += request(random_() % 4 == 0);
+            }
+        }
+        return line + "]}";
+    }
+
+    std::string corrupt(std::string line) {
+        int edits = 1 + random_() % 4;
+        for (int i = 0; i < edits and not line.empty(); ++i) {
+            size_t at = random_() % line.size();
+            switch (random_() % 4) {
+                case 0:
+                    line[at] ^= 1 << (random_() % 8);
+                    break;
+                case 1:
+                    line[at] = pick(json_bytes);
+                    break;
+                case 2:
+                    line.erase(at, 1 + random_() % 8);
+                    break;
+                default:
+                    line.insert(at, line.substr(at, random_() % 16));
+                    break;
+            }
+        }
+        std::replace(line.begin(), line.end(), '\n', ' ');
+        return line;
+    }
+
+    std::string garbage(size_t size) {
+        std::string line;
+        for (size_t i = 0; i < size; ++i) {
+            char c = random_() % 2 ? pick(json_bytes) : (char) random_();
+            line += c == '\n' ? ' ' : c;
+        }
+        return line;
+    }
+
+    // Around and far beyond MAX_MESSAGE_LENGTH: requests padded with a string
+    // or whitespace, and lines of garbage.
+    std::string long_line() {
+        size_t size;
+        switch (random_() % 4) {
+            case 0:
+                size = MAX_MESSAGE_LENGTH - 2 + random_() % 5;
+                break;
+            case 1:
+                size = MAX_MESSAGE_LENGTH + random_() % 8192;
+                break;
+            case 2:
+                size = 1 + random_() % MAX_MESSAGE_LENGTH;
+                break;
+            default:
+                size = 16384 + random_() % 100000;
+                break;
+        }
+        if (random_() % 4 == 0) {
+            return garbage(size);
+        }
+        std::string line = request();
+        if (line.size() + 12 >= size) {
+            return line;
+        }
+        line.pop_back();
+        if (random_() % 2) {
+            return line + R"(, "pad": ")" + std::string(size - line.size() - 12, 'x') + "\"}";
+        }
+        return line + std::string(size - line.size() - 1, ' ') + "}";
+    }
+
+    // Arrays and objects nested beyond what the parser accepts, closed or not.
+    std::string nested() {
+        size_t depth = 1 + random_() % (random_() % 4 ? 16 : 1000);
+        bool objects = random_() % 2;
+        std::string line = R"({"command": "GET_INPUT", "job": 1, "pin": )";
+        for (size_t i = 0; i < depth; ++i) {
+            line += objects ? R"({"a": )" : "[";
+        }
+        line += "1";
+        if (random_() % 4) {
+            for (size_t i = 0; i < depth; ++i) {
+                line += objects ? "}" : "]";
+            }
+            line += "}";
+        }
+        return line;
+    }
+
+    std::mt19937& random() {
+        return random_;
+    }
+
+private:
+    template<typename T, size_t N> const T& pick(const T (&values)[N]) {
+        return values[random_() % N];
+    }
+
+    static std::string quote(const std::string& s) {
+        return "\"" + s + "\"";
+    }
+
+    // A request of `command` with `keys`; a key is left out now and then,
+    // and values are sometimes of the wrong type or out of range.
+    std::string item(const std::string& command, const char* const* keys, bool with_job) {
+        std::string line = "{\"command\": " + command;
+        if (with_job and random_() % 40) {
+            line += ", \"job\": " + job();
+        }
+        for (int i = 0; keys != NULL and i < 10 and keys[i] != NULL; ++i) {
+            if (random_() % (i == 0 ? 25 : 3) == 0) {
+                continue;
+            }
+            line += ", " + quote(keys[i]) + ": " + value(keys[i]);
+        }
+        if (random_() % 20 == 0) {
+            line += R"(, "extra": )" + value("");
+        }
+        return line + "}";
+    }
+
+    std::string job() {
+        if (random_() % 30 == 0) {
+            return pick(invalid_values);
+        }
+        return std::to_string(1 + random_() % 100);
+    }
+
+    // A value for `key`: usually one the command accepts, otherwise anything.
+    std::string value(const std::string& key) {
+        if (key.empty() or random_() % 8 == 0) {
+            return pick(invalid_values);
+        }
+        if (key == "pin" or key == "input" or key == "output" or key == "pin_b" or
+            (key == "target" and random_() % 2)) {
+            return quote(random_() % 10 ? pick(pins) : pick(invalid_pins));
+        } else if (key == "level") {
+            return random_() % 2 ? quote(pick(levels)) : std::to_string(random_() % 300);
+        } else if (key == "mode") {
+            return quote(random_() % 2 ? pick(pin_modes) : pick(counter_modes));
+        } else if (key == "condition") {
+            return quote(pick(conditions));
+        } else if (key == "action") {
+            return quote(pick(actions));
+        } else if (key == "filter") {
+            return quote(pick(filters));
+        } else if (key == "persistent" or key == "scan") {
+            return random_() % 2 ? "true" : "false";
+        } else if (key == "counters") {
+            return "[" + std::to_string(random_() % 10) + ", " + pick(invalid_values) + "]";
+        } else if (key == "t0" or key == "at") {
+            return std::to_string((uint64_t) random_() * 1000 + random_() % 1000);
+        }
+        switch (random_() % 8) {
+            case 0:
+                return pick(numbers);
+            case 1:
+                return std::to_string((int) (random_() % 200) - 100) + ".5";
+            default:
+                return std::to_string(random_() % 2000);
+        }
+    }
+
+    std::mt19937 random_;
+
+    static constexpr const char* pins[] = {
+        "D30", "D31", "D32", "D33", "D34", "D35", "D36", "D37", "D38", "D39", "D40",
+        "D41", "D42", "D43", "D44", "D45", "D46", "D47", "D48", "D49", "A0",  "A1",
+        "A2",  "A3",  "DAC0", "DAC1",
+    };
+    static constexpr const char* invalid_pins[] = {
+        "D99", "", "d30", "D3", "D300", "A4", "DAC2", "D30 ", "INVALID_PIN",
+    };
+    static constexpr const char* levels[] = {"HIGH", "LOW", "high", ""};
+    static constexpr const char* pin_modes[] = {"INPUT", "OUTPUT", "INPUT_PULLUP", "OUT"};
+    static constexpr const char* counter_modes[] = {
+        "RISING", "FALLING", "CHANGE", "QUADRATURE", "BOTH",
+    };
+    static constexpr const char* conditions[] = {
+        "RISING", "FALLING", "CHANGE", "ABOVE", "BELOW", "TIMER", "NEVER",
+    };
+    static constexpr const char* actions[] = {
+        "SET_OUTPUT", "PULSE", "START_LOG", "END_LOG", "EVENT", "EXPLODE",
+    };
+    static constexpr const char* filters[] = {"INTEGRATOR", "STABLE", "MEDIAN"};
+    static constexpr const char* numbers[] = {
+        "0",  "-1", "1", "2147483647", "-2147483648", "4294967295", "4294967296",
+        "18446744073709551615", "18446744073709551616", "-9223372036854775808", "1e300",
+        "-1e-300", "0.0", "-0",
+    };
+    static constexpr const char* invalid_values[] = {
+        "null", "true", "false", R"("")", R"("7")", R"("\u0000\"\\\/")", "[]", "{}",
+        "[1, 2]", R"({"a": 1})", "-1", "1e999", "18446744073709551616", "0.5",
+    };
+    static constexpr const char* unknown_commands[] = {
+        R"("GET_INPU")", R"("")",          R"("READY")", R"("ERROR")", R"("RULE_EVENT")",
+        R"("RX_GET_INPUT")", R"("get_input")", "5",          "null",      "[]",
+    };
+    static constexpr char json_bytes[] = {
+        '{', '}', '[', ']', '"', ':', ',', '\\', ' ', '0', '-', '.', 'e', 't', 'n', '\0',
+    };
+};
+
+constexpr const char* MessageGenerator::pins[];
+constexpr const char* MessageGenerator::invalid_pins[];
+constexpr const char* MessageGenerator::levels[];
+constexpr const char* MessageGenerator::pin_modes[];
+constexpr const char* MessageGenerator::counter_modes[];
+constexpr const char* MessageGenerator::conditions[];
+constexpr const char* MessageGenerator::actions[];
+constexpr const char* MessageGenerator::filters[];
+constexpr const char* MessageGenerator::numbers[];
+constexpr const char* MessageGenerator::invalid_values[];
+constexpr const char* MessageGenerator::unknown_commands[];
+constexpr char MessageGenerator::json_bytes[];
+
+typedef struct {
+    unsigned long messages;
+    unsigned long replies;
+    unsigned long bytes;
+    unsigned long allocations;
+    std::chrono::nanoseconds elapsed;
+    // Per kind of message.
+    unsigned long count[MESSAGE_KINDS];
+    std::chrono::nanoseconds total[MESSAGE_KINDS];
+    std::chrono::nanoseconds worst[MESSAGE_KINDS];
+    std::string worst_line[MESSAGE_KINDS];
+    // Lines without a reply, and the first few of them.
+    unsigned long silent;
+    std::vector<std::string> silent_lines;
+    size_t heap_high_water;
+} stress_stats_t;
+
+// Every line the firmware prints must be a JSON object naming its command.
+inline void check_reply(const std::string& reply, const std::string& line) {
+    DynamicJsonDocument doc(16384);
+    if (deserializeJson(doc, reply.c_str()) != DeserializationError::Ok or
+        not doc.is<JsonObject>() or not doc["command"].is<const char*>()) {
+        fprintf(stderr, "invalid reply: %s\nto: %.200s\n", reply.c_str(), line.c_str());
+        CHECK(false);
+    }
+}
+
+// Sends `count` generated lines, running the board for a while between some
+// of them so that jobs produce output, and checks every reply.
+inline stress_stats_t run_stress(MessageGenerator& generator, unsigned long count) {
+    stress_stats_t stats = stress_stats_t();
+    sim::reset_string_heap_high_water();
+    unsigned long allocations = sim::string_allocations();
+    for (unsigned long i = 0; i < count; ++i) {
+        message_kind_t kind;
+        std::string line = generator.next(kind);
+        auto start = std::chrono::steady_clock::now();
+        sim::send(line);
+        std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+
+        std::vector<std::string> replies = sim::output();
+        for (const std::string& reply : replies) {
+            check_reply(reply, line);
+        }
+        if (replies.empty()) {
+            stats.silent++;
+            if (stats.silent_lines.size() < 10) {
+                stats.silent_lines.push_back(line.substr(0, 200));
+            }
+        }
+        stats.messages++;
+        stats.replies += replies.size();
+        stats.bytes += line.size() + 1;
+        stats.elapsed += elapsed;
+        stats.count[kind]++;
+        stats.total[kind] += elapsed;
+        if (elapsed > stats.worst[kind]) {
+            stats.worst[kind] = elapsed;
+            stats.worst_line[kind] = line.substr(0, 200);
+        }
+
+        if (generator.random()() % 16 == 0) {
+            sim::run(generator.random()() % 5000);
+            for (const std::string& reply : sim::output()) {
+                check_reply(reply, "(none)");
+            }
+        }
+    }
+    stats.allocations = sim::string_allocations() - allocations;
+    stats.heap_high_water = sim::string_heap_high_water();
+    return stats;
+}
+
+#endif /* CONTROLLINO_STRESS_H */
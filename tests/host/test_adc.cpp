@@ -0,0 +1,68 @@
+#include "host_test.h"
+
+int get_input(const char* pin) {
+    std::string line = R"({"command": "GET_INPUT", "job": 1, "pin": ")";
+    DynamicJsonDocument reply = request(line + pin + "\"}", "RX_GET_INPUT");
+    return reply["level"];
+}
+
+// Largest deviation of `reads` readings from `expected`.
+int max_error(const char* pin, int expected, int reads) {
+    int error = 0;
+    for (int i = 0; i < reads; ++i) {
+        int e = abs(get_input(pin) - expected);
+        error = e > error ? e : error;
+    }
+    return error;
+}
+
+void test_oversampling() {
+    sim::set_analog(A0, 2050, 20);
+    CHECK(max_error("A0", 2050 / 4, 50) > 2);
+
+    request(R"({"command": "SET_ADC", "job": 2, "pin": "A0", "resolution": 12, "oversampling": 64})",
+            "RX_SET_ADC");
+    CHECK(max_error("A0", 2050, 50) <= 6);
+
+    request(R"({"command": "SET_ADC", "job": 3, "pin": "A0", "resolution": 16})", "ERR_SET_ADC");
+    request(R"({"command": "SET_ADC", "job": 4, "pin": "D30"})", "ERR_SET_ADC");
+    request(R"({"command": "SET_ADC", "job": 5, "pin": "A0"})", "RX_SET_ADC");
+    CHECK(max_error("A0", 2050 / 4, 10) <= 6);
+}
+
+void test_scan() {
+    sim::set_analog(A0, 1000);
+    sim::set_analog(A1, 3000);
+    sim::set_analog(A2, 400);
+    request(R"({"command": "SET_ADC", "job": 1, "pin": "A0", "resolution": 12, "oversampling": 16, "scan": true})",
+            "RX_SET_ADC");
+    request(R"({"command": "SET_ADC", "job": 2, "pin": "A1", "resolution": 12, "scan": true})",
+            "RX_SET_ADC");
+    sim::run(2000);
+    CHECK(get_input("A0") == 1000);
+    CHECK(get_input("A1") == 3000);
+
+    // Readings come from the cache until the scan refreshed them. The block
+    // being accumulated may still contain old conversions.
+    sim::set_analog(A0, 2000);
+    CHECK(get_input("A0") == 1000);
+    sim::run(2 * 16 * 100);
+    CHECK(get_input("A0") == 2000);
+
+    // Inputs which aren't scanned are still converted on request.
+    CHECK(get_input("A2") == 100);
+    sim::run(1000);
+    CHECK(get_input("A2") == 100);
+
+    request(R"({"command": "SET_ADC", "job": 3, "pin": "A0"})", "RX_SET_ADC");
+    request(R"({"command": "SET_ADC", "job": 4, "pin": "A1"})", "RX_SET_ADC");
+    CHECK(get_input("A1") == 750);
+}
+
+int main() {
+    sim::boot();
+    test_oversampling();
+    test_scan();
+    printf("test_adc: OK\n");
+    return 0;
+}
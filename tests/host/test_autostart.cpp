@@ -0,0 +1,68 @@
+#include "host_test.h"
+
+std::vector<DynamicJsonDocument> samples() {
+    std::vector<DynamicJsonDocument> result;
+    for (const std::string& line : sim::output()) {
+        DynamicJsonDocument doc(1024);
+        CHECK(deserializeJson(doc, line.c_str()) == DeserializationError::Ok);
+        if (doc["command"] == "RX_LOG_SIGNAL") {
+            result.push_back(doc);
+        }
+    }
+    return result;
+}
+
+void start() {
+    sim::output();
+    request(R"({"command": "LOG_SIGNAL", "job": 7, "pin": "D30", "period": 10, "persistent": true})",
+            "RX_LOG_SIGNAL");
+    sim::run(100000);
+    std::vector<DynamicJsonDocument> s = samples();
+    // The first sample was sent along with the reply.
+    CHECK(s.size() >= 9);
+    for (size_t i = 0; i < s.size(); ++i) {
+        CHECK(s[i]["seq"].as<size_t>() == i + 1);
+    }
+}
+
+void restarted() {
+    std::vector<std::string> lines = sim::output();
+    CHECK(not lines.empty());
+    DynamicJsonDocument ready(1024);
+    CHECK(deserializeJson(ready, lines.front().c_str()) == DeserializationError::Ok);
+    CHECK(ready["command"] == "RX_READY");
+    CHECK(ready["boot"] == 2);
+
+    // Samples are held until the host grants credit.
+    sim::run(100000);
+    CHECK(samples().empty());
+    sim::send(R"({"command": "GRANT_CREDIT", "job": 1, "credit": -1})");
+
+    std::vector<DynamicJsonDocument> s = samples();
+    CHECK(s.size() >= 10);
+    CHECK(s[0]["job"] == 7);
+    CHECK(s[0]["time"].as<long long>() <= 1000);
+    for (size_t i = 0; i < s.size(); ++i) {
+        CHECK(s[i]["seq"].as<size_t>() == i);
+        CHECK(not s[i].containsKey("coalesced"));
+    }
+
+    sim::send(R"({"command": "END_LOG_SIGNAL", "job": 8, "pin": "D30"})");
+    sim::run(1000);
+}
+
+void ended() {
+    sim::run(100000);
+    CHECK(samples().empty());
+    DynamicJsonDocument reply = request(R"({"command": "GET_STORAGE", "job": 1})", "RX_GET_STORAGE");
+    CHECK(reply["boot"] == 3);
+}
+
+int main() {
+    sim::erase_flash();
+    CHECK(sim::power_cycle(start) == 0);
+    CHECK(sim::power_cycle(restarted) == 0);
+    CHECK(sim::power_cycle(ended) == 0);
+    printf("test_autostart: OK\n");
+    return 0;
+}
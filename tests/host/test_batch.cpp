@@ -0,0 +1,103 @@
+#include "host_test.h"
+
+#include "ProtocolHandler.h"
+
+// Builds a batch of `count` copies of `item`.
+std::string make_batch(const std::string& item, int count, bool atomic) {
+    std::string line = R"({"command": "BATCH", "job": 1, "atomic": )";
+    line += atomic ? "true" : "false";
+    line += R"(, "commands": [)";
+    for (int i = 0; i < count; ++i) {
+        line += (i > 0) ? "," + item : item;
+    }
+    return line + "]}";
+}
+
+// Items run in order and each gets its own result.
+void test_batch() {
+    sim::boot();
+    sim::output();
+
+    sim::send(
+        R"({"command": "BATCH", "job": 1, "commands": [)"
+        R"({"command": "SET_OUTPUT", "pin": "D43", "level": "HIGH"},)"
+        R"({"command": "GET_PIN_MODE", "pin": "D43"},)"
+        R"({"command": "SET_OUTPUT", "pin": "D99", "level": "LOW"},)"
+        R"({"command": "LOG_SIGNAL", "pin": "A0", "period": 100},)"
+        R"({"command": "BATCH", "commands": []}]})");
+    // The batch is answered first; the samples of the logging job follow.
+    std::vector<std::string> lines = sim::output();
+    CHECK(not lines.empty());
+    DynamicJsonDocument reply(2048);
+    CHECK(deserializeJson(reply, lines[0].c_str()) == DeserializationError::Ok);
+    CHECK(reply["command"] == "RX_BATCH");
+    CHECK(digitalRead(43) == HIGH);
+    CHECK(reply["failed"].as<unsigned int>() == 2);
+    JsonArray results = reply["results"].as<JsonArray>();
+    CHECK(results.size() == 5);
+    CHECK(results[0]["command"] == "RX_SET_OUTPUT");
+    CHECK(results[0]["job"].as<unsigned int>() == 1);
+    CHECK(results[1]["mode"] == "OUTPUT");
+    CHECK(results[2]["error"] == "INVALID_PIN");
+    CHECK(results[3].isNull()); // Logging answers with its samples.
+    CHECK(results[4]["error"] == "INVALID_COMMAND");
+
+    request(R"({"command": "END_LOG_SIGNAL", "job": 2, "pin": "A0"})",
+            "RX_END_LOG_SIGNAL");
+    request(R"({"command": "SET_OUTPUT", "job": 3, "pin": "D43", "level": "LOW"})",
+            "RX_SET_OUTPUT");
+}
+
+// Atomic batches are validated before anything runs and stop at the first
+// failing item.
+void test_atomic_batch() {
+    sim::boot();
+    sim::output();
+
+    auto invalid = request(
+        R"({"command": "BATCH", "job": 1, "atomic": true, "commands": [)"
+        R"({"command": "SET_OUTPUT", "pin": "D43", "level": "HIGH"},)"
+        R"({"command": "SET_OUTPUT", "pin": "D43"}]})",
+        "ERR_BATCH");
+    CHECK(invalid["error"] == "INVALID_BATCH");
+    CHECK(digitalRead(43) == LOW);
+
+    auto reply = request(
+        R"({"command": "BATCH", "job": 1, "atomic": true, "commands": [)"
+        R"({"command": "SET_OUTPUT", "pin": "D42", "level": "HIGH"},)"
+        R"({"command": "SET_OUTPUT", "pin": "D30", "level": "HIGH"},)"
+        R"({"command": "SET_OUTPUT", "pin": "D43", "level": "HIGH"}]})",
+        "RX_BATCH");
+    CHECK(reply["failed"].as<unsigned int>() == 2);
+    JsonArray results = reply["results"].as<JsonArray>();
+    CHECK(results[0]["command"] == "RX_SET_OUTPUT");
+    CHECK(results[1]["error"] == "INVALID_OUTPUT_PIN");
+    CHECK(results[2]["error"] == "SKIPPED");
+    CHECK(digitalRead(42) == HIGH);
+    CHECK(digitalRead(43) == LOW);
+
+    request(R"({"command": "SET_OUTPUT", "job": 2, "pin": "D42", "level": "LOW"})",
+            "RX_SET_OUTPUT");
+}
+
+// A rig's worth of setup fits into one message.
+void test_batch_size() {
+    sim::boot();
+    sim::output();
+
+    std::string item = R"({"command":"SET_PIN_MODE","pin":"D43","mode":"OUTPUT"})";
+    auto reply = request(make_batch(item, MAX_BATCH_COMMANDS, true), "RX_BATCH", 8192);
+    CHECK(reply["failed"].as<unsigned int>() == 0);
+    CHECK(reply["results"].size() == (size_t) MAX_BATCH_COMMANDS);
+
+    auto error = request(make_batch(item, MAX_BATCH_COMMANDS + 1, false), "ERR_BATCH");
+    CHECK(error["error"] == "TOO_MANY_COMMANDS");
+}
+
+int main() {
+    test_batch();
+    test_atomic_batch();
+    test_batch_size();
+    printf("test_batch: OK\n");
+    return 0;
+}
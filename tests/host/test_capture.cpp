@@ -0,0 +1,48 @@
+#include "host_test.h"
+
+#include "Capture.h"
+
+// Entries read back as they were written, including spaces in the lines.
+void test_round_trip() {
+    const char* path = "build/host/test_capture.cap";
+    std::vector<sim::CaptureEntry> written = {
+        {0, false, R"({"command":"RX_READY","job":0,"boot":1})"},
+        {1200, true, R"({"command": "GET_INPUT", "job": 1, "pin": "D30"})"},
+        {1300, false, R"({"command":"RX_GET_INPUT","job":1,"pin":"D30","level":"LOW"})"},
+        {1400, true, ""},
+    };
+    FILE* file = fopen(path, "w");
+    CHECK(file != NULL);
+    for (const sim::CaptureEntry& entry : written) {
+        sim::write_capture_entry(file, entry);
+    }
+    fclose(file);
+
+    std::vector<sim::CaptureEntry> read;
+    CHECK(sim::read_capture(path, read));
+    CHECK(read.size() == written.size());
+    for (size_t i = 0; i < read.size(); ++i) {
+        CHECK(read[i].time == written[i].time);
+        CHECK(read[i].rx == written[i].rx);
+        CHECK(read[i].line == written[i].line);
+    }
+}
+
+void test_invalid_capture() {
+    const char* path = "build/host/test_capture.cap";
+    FILE* file = fopen(path, "w");
+    CHECK(file != NULL);
+    fputs("100 RX {}\n100 XX {}\n", file);
+    fclose(file);
+
+    std::vector<sim::CaptureEntry> read;
+    CHECK(not sim::read_capture(path, read));
+    CHECK(not sim::read_capture("build/host/missing.cap", read));
+}
+
+int main() {
+    test_round_trip();
+    test_invalid_capture();
+    printf("test_capture: OK\n");
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include "host_test.h"
+
+const uint8_t d30 = 30;
+const uint8_t d31 = 31;
+const uint8_t d32 = 32;
+
+// Square wave on `pin`; every `coalesce`-th period the rising and falling edge
+// arrive before the interrupt is served.
+void pulse_train(uint8_t pin, unsigned int periods, uint64_t period_us, unsigned int coalesce) {
+    for (unsigned int i = 0; i < periods; ++i) {
+        bool late = coalesce != 0 and i % coalesce == 0;
+        sim::hold_interrupts(late);
+        sim::set_digital(pin, HIGH);
+        sim::run(period_us / 2, period_us / 2);
+        sim::set_digital(pin, LOW);
+        sim::hold_interrupts(false);
+        sim::run(period_us / 2, period_us / 2);
+    }
+}
+
+// One quadrature step per call; `forward` means A leads B.
+void quadrature_step(int& phase, bool forward) {
+    static const int a[] = {0, 1, 1, 0};
+    static const int b[] = {0, 0, 1, 1};
+    phase = (phase + (forward ? 1 : 3)) % 4;
+    sim::set_digital(d31, a[phase]);
+    sim::set_digital(d32, b[phase]);
+    sim::run(10, 10);
+}
+
+void test_edge_counter() {
+    sim::boot();
+    request(R"({"command": "ADD_COUNTER", "job": 1, "counter": 0, "pin": "D30", "mode": "RISING"})",
+            "RX_ADD_COUNTER");
+
+    // 20 kHz for half a second, with every 7th pair of edges coalesced.
+    pulse_train(d30, 10000, 50, 7);
+    DynamicJsonDocument reply = request(
+        R"({"command": "RESET_COUNTER", "job": 2, "counter": 0})", "RX_RESET_COUNTER");
+    CHECK(reply["count"].as<long long>() == 10000);
+
+    request(R"({"command": "ADD_COUNTER", "job": 3, "counter": 1, "pin": "D31", "mode": "CHANGE"})",
+            "RX_ADD_COUNTER");
+    pulse_train(d31, 1000, 100, 3);
+    pulse_train(d30, 500, 100, 0);
+    reply = request(R"({"command": "GET_COUNTERS", "job": 4})", "RX_GET_COUNTERS");
+    CHECK(reply["counts"]["0"].as<long long>() == 500);
+    CHECK(reply["counts"]["1"].as<long long>() == 2000);
+
+    request(R"({"command": "ADD_COUNTER", "job": 5, "counter": 2, "pin": "D30", "mode": "FALLING"})",
+            "ERR_ADD_COUNTER");
+    request(R"({"command": "DELETE_COUNTER", "job": 6, "counter": 0})", "RX_DELETE_COUNTER");
+    request(R"({"command": "GET_COUNTERS", "job": 7, "counters": [0]})", "ERR_GET_COUNTERS");
+    request(R"({"command": "DELETE_COUNTER", "job": 8, "counter": 1})", "RX_DELETE_COUNTER");
+
+    // Negative ids and periods are rejected instead of wrapping.
+    reply = request(R"({"command": "DELETE_COUNTER", "job": 9, "counter": -1})",
+                    "ERR_DELETE_COUNTER");
+    CHECK(reply["error"] == "INVALID_KEY");
+    reply = request(
+        R"({"command": "ADD_COUNTER", "job": 10, "counter": 0, "pin": "D30", "mode": "RISING", "period": -1})",
+        "ERR_ADD_COUNTER");
+    CHECK(reply["error"] == "INVALID_KEY");
+    reply = request(R"({"command": "GET_COUNTERS", "job": 11, "counters": [-1]})",
+                    "ERR_GET_COUNTERS");
+    CHECK(reply["error"] == "INVALID_KEY");
+}
+
+void test_quadrature_counter() {
+    sim::boot();
+    request(
+        R"({"command": "ADD_COUNTER", "job": 1, "counter": 0, "pin": "D31", "pin_b": "D32", "mode": "QUADRATURE", "period": 10})",
+        "RX_ADD_COUNTER");
+
+    int phase = 0;
+    for (int i = 0; i < 4000; ++i) {
+        quadrature_step(phase, true);
+    }
+    for (int i = 0; i < 1500; ++i) {
+        quadrature_step(phase, false);
+    }
+    DynamicJsonDocument reply =
+        request(R"({"command": "GET_COUNTERS", "job": 2, "counters": [0]})", "RX_GET_COUNTERS");
+    CHECK(reply["counts"]["0"].as<long long>() == 2500);
+
+    // Both inputs changing at once can't be decoded.
+    sim::hold_interrupts(true);
+    quadrature_step(phase, true);
+    quadrature_step(phase, true);
+    sim::hold_interrupts(false);
+    sim::run(20000);
+    std::vector<std::string> lines = sim::output();
+    CHECK(not lines.empty());
+    DynamicJsonDocument stream(1024);
+    CHECK(deserializeJson(stream, lines.back().c_str()) == DeserializationError::Ok);
+    CHECK(stream["job"] == 1);
+    CHECK(stream["count"].as<long long>() == 2500);
+    CHECK(stream["errors"] == 1);
+
+    request(R"({"command": "DELETE_COUNTER", "job": 3, "counter": 0})", "RX_DELETE_COUNTER");
+}
+
+int main() {
+    test_edge_counter();
+    test_quadrature_counter();
+    printf("test_counters: OK\n");
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include "host_test.h"
+
+const uint8_t d30 = 30;
+
+// Closes (or opens) a contact on D30 which bounces `bounces` times, 50 µs
+// apart, before settling.
+void bouncy_edge(int level, int bounces) {
+    for (int i = 0; i < bounces; ++i) {
+        sim::set_digital(d30, (i % 2 == 0) ? level : not level);
+        sim::run(50, 50);
+    }
+    sim::set_digital(d30, level);
+}
+
+std::string get_input() {
+    DynamicJsonDocument reply =
+        request(R"({"command": "GET_INPUT", "job": 1, "pin": "D30"})", "RX_GET_INPUT");
+    return reply["level"].as<const char*>();
+}
+
+void test_filter(const char* filter) {
+    std::string set_debounce = R"({"command": "SET_DEBOUNCE", "job": 2, "pin": "D30", "time": 1000, "filter": ")";
+    request(set_debounce + filter + "\"}", "RX_SET_DEBOUNCE");
+    request(R"({"command": "ADD_COUNTER", "job": 3, "counter": 0, "pin": "D30", "mode": "CHANGE"})",
+            "RX_ADD_COUNTER");
+
+    for (int press = 0; press < 10; ++press) {
+        bouncy_edge(HIGH, 9);
+        CHECK(get_input() == "LOW");
+        sim::run(2000);
+        CHECK(get_input() == "HIGH");
+        bouncy_edge(LOW, 5);
+        sim::run(2000);
+        CHECK(get_input() == "LOW");
+    }
+
+    // A short spike is filtered as a glitch.
+    sim::set_digital(d30, HIGH);
+    sim::run(300);
+    sim::set_digital(d30, LOW);
+    sim::run(2000);
+
+    DynamicJsonDocument reply = request(
+        R"({"command": "RESET_COUNTER", "job": 4, "counter": 0})", "RX_RESET_COUNTER");
+    CHECK(reply["count"].as<long long>() == 20);
+    reply = request(R"({"command": "GET_DEBOUNCE", "job": 5, "pin": "D30"})", "RX_GET_DEBOUNCE");
+    CHECK(reply["filter"] == filter);
+    CHECK(reply["glitches"].as<int>() > 0);
+
+    request(R"({"command": "DELETE_COUNTER", "job": 6, "counter": 0})", "RX_DELETE_COUNTER");
+    request(R"({"command": "SET_DEBOUNCE", "job": 7, "pin": "D30", "time": 0})", "RX_SET_DEBOUNCE");
+}
+
+void test_raw_input() {
+    request(R"({"command": "GET_DEBOUNCE", "job": 1, "pin": "D30"})", "ERR_GET_DEBOUNCE");
+    request(R"({"command": "SET_DEBOUNCE", "job": 2, "pin": "A0", "time": 1000})", "ERR_SET_DEBOUNCE");
+    sim::set_digital(d30, HIGH);
+    CHECK(get_input() == "HIGH");
+    sim::set_digital(d30, LOW);
+}
+
+int main() {
+    sim::boot();
+    test_filter("INTEGRATOR");
+    test_filter("STABLE");
+    test_raw_input();
+    printf("test_debounce: OK\n");
+    return 0;
+}
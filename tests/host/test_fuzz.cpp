@@ -0,0 +1,76 @@
+// Streams generated requests, most of them malformed or with invalid values,
+// at the firmware. The test is built with the sanitizers (see the Makefile),
+// which abort on out-of-range accesses of the firmware's tables; it checks
+// that every reply is well-formed and that the buffers of `String` stay
+// bounded, however long the received lines are.
+#include "stress.h"
+
+// Lines up to MAX_MESSAGE_LENGTH are handled and longer ones are rejected
+// without being buffered.
+void test_long_lines() {
+    const size_t sizes[] = {
+        MAX_MESSAGE_LENGTH - 1, MAX_MESSAGE_LENGTH, MAX_MESSAGE_LENGTH + 1, 100000,
+    };
+    for (size_t size : sizes) {
+        std::string line = R"({"command": "GET_INPUT", "job": 1, "pin": "D30", "pad": ")";
+        line += std::string(size - line.size() - 2, 'x') + "\"}";
+        CHECK(line.size() == size);
+        sim::reset_string_heap_high_water();
+        if (size <= MAX_MESSAGE_LENGTH) {
+            request(line, "RX_GET_INPUT");
+        } else {
+            DynamicJsonDocument reply = request(line, "ERROR");
+            CHECK(reply["error"] == "MESSAGE_TOO_LONG");
+        }
+        CHECK(sim::string_heap_high_water() < 4 * MAX_MESSAGE_LENGTH);
+    }
+    // The line after a long one is read from its start.
+    request(R"({"command": "GET_INPUT", "job": 2, "pin": "D30"})", "RX_GET_INPUT");
+}
+
+// Unknown modes are rejected instead of going unanswered.
+void test_set_pin_mode() {
+    auto error = request(R"({"command": "SET_PIN_MODE", "job": 1, "pin": "D41", "mode": "OUT"})",
+                         "ERR_SET_PIN_MODE");
+    CHECK(error["error"] == "INVALID_PIN_MODE");
+    request(R"({"command": "SET_PIN_MODE", "job": 2, "pin": "D41", "mode": "OUTPUT"})",
+            "RX_SET_PIN_MODE");
+}
+
+// A request without a reply is a LOG_SIGNAL that was accepted; it answers
+// with samples.
+void check_silent(const stress_stats_t& stats) {
+    for (const std::string& line : stats.silent_lines) {
+        DynamicJsonDocument doc(4096);
+        if (deserializeJson(doc, line.c_str()) != DeserializationError::Ok or
+            doc["command"] != "LOG_SIGNAL") {
+            fprintf(stderr, "no reply to: %s\n", line.c_str());
+            CHECK(false);
+        }
+    }
+}
+
+// test_fuzz [SEED [MESSAGES]]
+int main(int argc, char** argv) {
+    uint32_t seed = argc > 1 ? strtoul(argv[1], NULL, 10) : 1;
+    unsigned long count = argc > 2 ? strtoul(argv[2], NULL, 10) : 100000;
+
+    sim::boot();
+    sim::output();
+
+    test_long_lines();
+    test_set_pin_mode();
+
+    MessageGenerator generator(seed);
+    stress_stats_t stats = run_stress(generator, count);
+    check_silent(stats);
+    for (int kind = 0; kind < MESSAGE_KINDS; ++kind) {
+        CHECK(stats.count[kind] > 0);
+    }
+    CHECK(stats.heap_high_water < 8 * MAX_MESSAGE_LENGTH);
+
+    // The board still answers.
+    request(R"({"command": "GET_STORAGE", "job": 1})", "RX_GET_STORAGE");
+    printf("test_fuzz: OK\n");
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include "host_test.h"
+
+#include "Pins.h"
+
+using namespace controllino;
+
+// The accessors fold to constants.
+static_assert(get_pin_number(PIN_D43) == 43, "");
+static_assert(get_pin_mask(PIN_D43) == 1u << 20, "");
+static_assert(get_pin_port(PIN_D43) == PIN_PORT_A, "");
+static_assert(get_pin_type(PIN_A0) == PIN_ANALOG, "");
+static_assert(get_pin_mode_type(PIN_DAC0) == PIN_MODE_TYPE_OUTPUT_ONLY, "");
+static_assert(get_default_pin_mode(PIN_D40) == PIN_MODE_OUTPUT, "");
+static_assert(get_adc_channel(PIN_A0) == 7, "");
+
+// The board description agrees with the pin table of the Arduino core.
+void test_board_matches_variant() {
+    for (int i = 0; i < PIN_INVALID_PIN; ++i) {
+        pin_t pin = (pin_t) i;
+        const PinDescription& description = g_APinDescription[get_pin_number(pin)];
+        CHECK(get_valid_pin_type(get_pin_name(pin)) == pin);
+        if (get_pin_type(pin) == PIN_DIGITAL) {
+            CHECK(description.pPort == get_pin_pio(pin));
+            CHECK(description.ulPin == get_pin_mask(pin));
+        }
+        if (has_pin_capability(pin, PIN_CAP_ANALOG) and
+            has_pin_capability(pin, PIN_CAP_INPUT)) {
+            CHECK(description.ulADCChannelNumber == get_adc_channel(pin));
+        }
+    }
+}
+
+// Outputs are driven through the PIO registers.
+void test_set_output() {
+    sim::boot();
+    request(R"({"command": "SET_OUTPUT", "job": 1, "pin": "D43", "level": "HIGH"})",
+            "RX_SET_OUTPUT");
+    CHECK(digitalRead(43) == HIGH);
+    CHECK(get_pin_level(PIN_D43));
+    request(R"({"command": "SET_OUTPUT", "job": 2, "pin": "D43", "level": "LOW"})",
+            "RX_SET_OUTPUT");
+    CHECK(digitalRead(43) == LOW);
+}
+
+int main() {
+    test_board_matches_variant();
+    test_set_output();
+    printf("test_pins: OK\n");
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "host_test.h"
+
+#include "Clock.h"
+
+// A pulse is acknowledged right away, other requests are served while it runs
+// and its completion is sent once the output fell again.
+void test_pulse_runs_in_background() {
+    sim::boot();
+    sim::output();
+
+    request(R"({"command": "TRIGGER_PULSE", "job": 1, "pin": "D43", "duration": 50})",
+            "ACK_TRIGGER_PULSE");
+    CHECK(digitalRead(43) == HIGH);
+
+    request(R"({"command": "GET_PIN_MODE", "job": 2, "pin": "D43"})", "RX_GET_PIN_MODE");
+    auto busy = request(
+        R"({"command": "TRIGGER_PULSE", "job": 3, "pin": "D43"})", "ERR_TRIGGER_PULSE");
+    CHECK(busy["error"] == "PIN_BUSY");
+    auto cancel = request(
+        R"({"command": "CANCEL_JOB", "job": 4, "target": 1})", "ERR_CANCEL_JOB");
+    CHECK(cancel["error"] == "JOB_NOT_FOUND");
+
+    sim::run(49000);
+    CHECK(digitalRead(43) == HIGH);
+    CHECK(sim::output().empty());
+    sim::run(2000);
+    CHECK(digitalRead(43) == LOW);
+
+    std::vector<std::string> lines = sim::output();
+    CHECK(lines.size() == 1);
+    DynamicJsonDocument doc(1024);
+    CHECK(deserializeJson(doc, lines[0].c_str()) == DeserializationError::Ok);
+    CHECK(doc["command"] == "RX_TRIGGER_PULSE");
+    CHECK(doc["job"].as<unsigned int>() == 1);
+    CHECK(doc["pin"] == "D43");
+}
+
+// Scheduled outputs are acknowledged before they run.
+void test_scheduled_output_is_acknowledged() {
+    sim::boot();
+    sim::output();
+
+    uint64_t at = sim::now() + 10000;
+    std::string line =
+        R"({"command": "SET_OUTPUT", "job": 5, "pin": "D43", "level": "HIGH", "at": )" +
+        std::to_string(at) + "}";
+    auto ack = request(line, "ACK_SET_OUTPUT");
+    CHECK(ack["at"].as<uint64_t>() == at);
+    CHECK(digitalRead(43) == LOW);
+
+    sim::run(11000);
+    CHECK(digitalRead(43) == HIGH);
+    std::vector<std::string> lines = sim::output();
+    CHECK(lines.size() == 1);
+    DynamicJsonDocument doc(1024);
+    CHECK(deserializeJson(doc, lines[0].c_str()) == DeserializationError::Ok);
+    CHECK(doc["command"] == "RX_SET_OUTPUT");
+
+    request(R"({"command": "SET_OUTPUT", "job": 6, "pin": "D43", "level": "LOW"})",
+            "RX_SET_OUTPUT");
+}
+
+// Times which aren't non-negative integers are rejected instead of wrapping.
+void test_invalid_time_is_rejected() {
+    sim::boot();
+    const char* lines[] = {
+        R"({"command": "SET_OUTPUT", "job": 1, "pin": "D43", "level": "HIGH", "at": -1})",
+        R"({"command": "SET_OUTPUT", "job": 2, "pin": "D43", "level": "HIGH", "at": 1.5})",
+        R"({"command": "SET_OUTPUT", "job": 3, "pin": "D43", "level": "HIGH", "at": "now"})",
+    };
+    for (const char* line : lines) {
+        auto error = request(line, "ERR_SET_OUTPUT");
+        CHECK(error["error"] == "INVALID_TIME");
+    }
+    CHECK(digitalRead(43) == LOW);
+}
+
+// Durations and targets of other types are rejected instead of read as defaults.
+void test_invalid_keys_are_rejected() {
+    sim::boot();
+    sim::output();
+    const char* lines[] = {
+        R"({"command": "TRIGGER_PULSE", "job": 1, "pin": "D43", "duration": "50"})",
+        R"({"command": "TRIGGER_PULSE", "job": 2, "pin": "D43", "duration": -1})",
+        R"({"command": "TRIGGER_PULSE", "job": 3, "pin": "D43", "duration": 1.5})",
+    };
+    for (const char* line : lines) {
+        auto error = request(line, "ERR_TRIGGER_PULSE");
+        CHECK(error["error"] == "INVALID_KEY");
+    }
+    CHECK(digitalRead(43) == LOW);
+    auto cancel = request(
+        R"({"command": "CANCEL_JOB", "job": 4, "target": "1"})", "ERR_CANCEL_JOB");
+    CHECK(cancel["error"] == "INVALID_KEY");
+    CHECK(cancel["job"].as<unsigned int>() == 4);
+}
+
+// A rule's pulse isn't started when its end can't be scheduled.
+void test_rule_pulse_with_full_scheduler() {
+    sim::boot();
+    uint64_t at = controllino::clock_micros() + 1000000;
+    for (int job = 1; job <= 16; ++job) {
+        std::string line =
+            R"({"command": "SET_OUTPUT", "job": )" + std::to_string(job) +
+            R"(, "pin": "D42", "level": "HIGH", "at": )" + std::to_string(at) + "}";
+        request(line, "ACK_SET_OUTPUT");
+    }
+    request(R"({"command": "ADD_RULE", "job": 20, "condition": "TIMER", "interval": 10, "action": "PULSE", "target": "D43", "duration": 5})",
+            "RX_ADD_RULE");
+    sim::run(25000);
+    CHECK(digitalRead(43) == LOW);
+    auto reply = request(R"({"command": "GET_RULE", "job": 21, "rule": 20})", "RX_GET_RULE");
+    CHECK(reply["hits"].as<unsigned int>() == 2);
+    CHECK(reply["failures"].as<unsigned int>() == 2);
+
+    // Once the scheduled outputs ran, the pulses go out again.
+    sim::run(1000000);
+    sim::output();
+    CHECK(digitalRead(42) == HIGH);
+    sim::run(6000);
+    reply = request(R"({"command": "GET_RULE", "job": 22, "rule": 20})", "RX_GET_RULE");
+    CHECK(reply["hits"].as<unsigned int>() > reply["failures"].as<unsigned int>());
+    request(R"({"command": "DELETE_RULE", "job": 23, "rule": 20})", "RX_DELETE_RULE");
+}
+
+int main() {
+    test_pulse_runs_in_background();
+    test_scheduled_output_is_acknowledged();
+    test_invalid_time_is_rejected();
+    test_invalid_keys_are_rejected();
+    test_rule_pulse_with_full_scheduler();
+    printf("test_pulse: OK\n");
+    return 0;
+}
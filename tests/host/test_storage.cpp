@@ -0,0 +1,143 @@
+#include "host_test.h"
+
+#include "Flash.h"
+
+std::string get_pin_mode(const char* pin) {
+    std::string line = R"({"command": "GET_PIN_MODE", "job": 1, "pin": ")";
+    DynamicJsonDocument reply = request(line + pin + "\"}", "RX_GET_PIN_MODE");
+    return reply["mode"].as<const char*>();
+}
+
+void set_pin_mode(const char* pin, const char* mode) {
+    std::string line = R"({"command": "SET_PIN_MODE", "job": 2, "pin": ")";
+    request(line + pin + R"(", "mode": ")" + mode + "\"}", "RX_SET_PIN_MODE");
+}
+
+void save_pin_modes() {
+    request(R"({"command": "SAVE_PIN_MODES", "job": 3})", "RX_SAVE_PIN_MODES");
+}
+
+void configure() {
+    CHECK(get_pin_mode("D43") == "OUTPUT");
+    set_pin_mode("D43", "INPUT");
+    save_pin_modes();
+    request(R"({"command": "WATCH", "job": 42, "pin": "A0", "high": 500, "persistent": true})",
+            "RX_WATCH");
+    request(R"({"command": "WATCH", "job": 43, "pin": "A1", "high": 500})", "RX_WATCH");
+
+    DynamicJsonDocument reply = request(R"({"command": "GET_STORAGE", "job": 4})", "RX_GET_STORAGE");
+    // The boot count, the pin modes and the watch.
+    CHECK(reply["writes"] == 3);
+    CHECK(reply["sequence"] == 1);
+    CHECK(reply["boot"] == 1);
+}
+
+void restored() {
+    DynamicJsonDocument reply = request(R"({"command": "GET_STORAGE", "job": 1})", "RX_GET_STORAGE");
+    CHECK(reply["writes"] == 1);
+    CHECK(reply["boot"] == 2);
+    CHECK(reply["used"].as<int>() > 0);
+
+    CHECK(get_pin_mode("D43") == "INPUT");
+    request(R"({"command": "RESET_PIN_MODES", "job": 2})", "RX_RESET_PIN_MODES");
+    CHECK(get_pin_mode("D43") == "OUTPUT");
+    request(R"({"command": "LOAD_PIN_MODES", "job": 3})", "RX_LOAD_PIN_MODES");
+    CHECK(get_pin_mode("D43") == "INPUT");
+
+    // The persistent watch still reports to its job, the other one is gone.
+    request(R"({"command": "END_WATCH", "job": 4, "pin": "A1"})", "ERR_END_WATCH");
+    sim::set_analog(A0, 4000);
+    sim::run(5000);
+    std::vector<std::string> lines = sim::output();
+    CHECK(not lines.empty());
+    DynamicJsonDocument event(1024);
+    CHECK(deserializeJson(event, lines.back().c_str()) == DeserializationError::Ok);
+    CHECK(event["job"] == 42);
+    CHECK(event["state"] == "HIGH");
+
+    request(R"({"command": "END_WATCH", "job": 5, "pin": "A0"})", "RX_END_WATCH");
+    request(R"({"command": "RESET_PIN_MODES", "job": 6})", "RX_RESET_PIN_MODES");
+    save_pin_modes();
+}
+
+void defaults() {
+    request(R"({"command": "END_WATCH", "job": 1, "pin": "A0"})", "ERR_END_WATCH");
+    CHECK(get_pin_mode("D43") == "OUTPUT");
+}
+
+void test_restore() {
+    sim::erase_flash();
+    CHECK(sim::power_cycle(configure) == 0);
+    CHECK(sim::power_cycle(restored) == 0);
+    CHECK(sim::power_cycle(defaults) == 0);
+}
+
+void toggle_many() {
+    for (int i = 0; i < 1000; ++i) {
+        set_pin_mode("D43", (i % 2) ? "OUTPUT" : "INPUT");
+        save_pin_modes();
+    }
+    // Saving an unchanged value does not write.
+    save_pin_modes();
+    DynamicJsonDocument reply = request(R"({"command": "GET_STORAGE", "job": 4})", "RX_GET_STORAGE");
+    CHECK(reply["writes"] == 1001);
+}
+
+void test_wear_leveling() {
+    sim::erase_flash();
+    CHECK(sim::power_cycle(toggle_many) == 0);
+    unsigned int low = sim::flash_erases(0), high = low;
+    for (unsigned int i = 1; i < FLASH_STORAGE_PAGES; ++i) {
+        low = std::min(low, sim::flash_erases(i));
+        high = std::max(high, sim::flash_erases(i));
+    }
+    CHECK(low > 0);
+    CHECK(high - low <= 1);
+}
+
+void save_input() {
+    set_pin_mode("D43", "INPUT");
+    save_pin_modes();
+}
+
+void save_output() {
+    set_pin_mode("D43", "OUTPUT");
+    save_pin_modes();
+}
+
+static size_t tear_ = 0;
+
+void save_output_torn() {
+    sim::tear_flash_write(tear_);
+    save_output();
+}
+
+void exit_with_mode() {
+    std::string mode = get_pin_mode("D43");
+    exit((mode == "INPUT") ? 10 : (mode == "OUTPUT") ? 11 : 12);
+}
+
+// A reset in the middle of a write loses at most that write.
+void test_torn_writes() {
+    sim::erase_flash();
+    int lost = 0, kept = 0;
+    for (size_t bytes = 1; bytes < FLASH_STORAGE_PAGE_SIZE; bytes += 7) {
+        CHECK(sim::power_cycle(save_output) == 0);
+        CHECK(sim::power_cycle(save_input) == 0);
+        CHECK(sim::power_cycle(exit_with_mode) == 10);
+        tear_ = bytes;
+        CHECK(sim::power_cycle(save_output_torn) == 0);
+        int mode = sim::power_cycle(exit_with_mode);
+        CHECK(mode == 10 or mode == 11);
+        (mode == 10) ? lost++ : kept++;
+    }
+    CHECK(lost > 0 and kept > 0);
+}
+
+int main() {
+    test_restore();
+    test_wear_leveling();
+    test_torn_writes();
+    printf("test_storage: OK\n");
+    return 0;
+}
@@ -0,0 +1,34 @@
+#include "host_test.h"
+
+// The loopbacks of the hardware tests, as wired by the virtual device.
+void test_wiring() {
+    sim::connect_loopbacks(0);
+    sim::boot();
+
+    request(R"({"command": "SET_OUTPUT", "job": 1, "pin": "D40", "level": "HIGH"})",
+            "RX_SET_OUTPUT");
+    auto high = request(R"({"command": "GET_INPUT", "job": 2, "pin": "D30"})", "RX_GET_INPUT");
+    CHECK(high["level"] == "HIGH");
+    request(R"({"command": "SET_OUTPUT", "job": 3, "pin": "D40", "level": "LOW"})",
+            "RX_SET_OUTPUT");
+    auto low = request(R"({"command": "GET_INPUT", "job": 4, "pin": "D30"})", "RX_GET_INPUT");
+    CHECK(low["level"] == "LOW");
+
+    // The DAC spans 1/6 to 5/6 of the range of the ADC.
+    request(R"({"command": "SET_OUTPUT", "job": 5, "pin": "DAC0", "level": 255})",
+            "RX_SET_OUTPUT");
+    auto full = request(R"({"command": "GET_INPUT", "job": 6, "pin": "A0"})", "RX_GET_INPUT");
+    CHECK(full["level"].as<int>() == 853);
+    request(R"({"command": "SET_OUTPUT", "job": 7, "pin": "DAC0", "level": 0})",
+            "RX_SET_OUTPUT");
+    auto zero = request(R"({"command": "GET_INPUT", "job": 8, "pin": "A0"})", "RX_GET_INPUT");
+    CHECK(zero["level"].as<int>() == 170);
+
+    sim::disconnect_all();
+}
+
+int main() {
+    test_wiring();
+    printf("test_wiring: OK\n");
+    return 0;
+}
@@ -29,8 +29,11 @@ def get_address_from_serial_number(serial_number: str) -> str:
 
 @pytest.fixture
 def api():
-    serial_number = os.environ["CONTROLLINO_USB_SERIAL_NUMBER"]
-    addr = get_address_from_serial_number(serial_number)
+    # `CONTROLLINO_PORT` selects a port directly, e.g. of the virtual device.
+    addr = os.environ.get("CONTROLLINO_PORT")
+    if addr is None:
+        serial_number = os.environ["CONTROLLINO_USB_SERIAL_NUMBER"]
+        addr = get_address_from_serial_number(serial_number)
     ser = serial.Serial(port=addr, baudrate=19200)
     time.sleep(0.1)
     ser.reset_input_buffer()  # Cleanup potential spills from previous tests
@@ -147,7 +150,6 @@ def test_set_pin_mode_set_signal_get_signal(api):
     assert future.result() == "LOW"
 
 
-@pytest.mark.xfail
 @pytest.mark.timeout(TIMEOUT)
 def test_set_pin_mode_load_save_reset_pin_modes(api):
     future = api.set_pin_mode("D43", "INPUT")
@@ -192,6 +194,19 @@ def test_set_pin_mode_load_save_reset_pin_modes(api):
     assert future.done()
     assert future.result() == "INPUT"
 
+    # Leave the defaults in flash for the next boot.
+    future = api.reset_pin_modes()
+    done = future.wait(WAIT)
+    api.process_errors()
+    assert done
+    future.result()
+
+    future = api.save_pin_modes()
+    done = future.wait(WAIT)
+    api.process_errors()
+    assert done
+    future.result()
+
 
 class TestSetSignal:
     @pytest.mark.timeout(TIMEOUT)
@@ -249,7 +264,6 @@ class TestGetSignal:
 
 
 class TestSetPinMode:
-    @pytest.mark.xfail
     @pytest.mark.timeout(TIMEOUT)
     def test_invalid_pin_mode(self, api):
         future = api.set_pin_mode("D41", "INVALID")
@@ -280,10 +294,44 @@ class TestGetPinMode:
         assert "INVALID_PIN" in str(e.value)
 
 
-# FIXME `trigger_pulse` is broken, as the device sleeps during the
-# pulse, making concurrent logging impossible.
+class CmdTriggerPulse(controllino.Command):
+    def _serialize(self):
+        return {"command": "TRIGGER_PULSE", "pin": "D40", "duration": 1000}
+
+
+@pytest.mark.timeout(TIMEOUT)
 def test_logging_trigger_pulse(api):
-    pass
+    future = api.set_signal("D40", "LOW")
+    done = future.wait(WAIT)
+    api.process_errors()
+    assert done
+    future.result()
+
+    request, recording = api.log_signal("D30", 500)
+    done = request.wait(WAIT)
+    api.process_errors()
+    assert done
+    request.result()
+
+    # The device keeps logging while the pulse runs.
+    time.sleep(0.75)
+    pulse = api.submit(CmdTriggerPulse())
+    time.sleep(2.0)
+    future = api.end_log_signal("D30")
+    done = future.wait(WAIT)
+    api.process_errors()
+    assert done
+
+    done = pulse.wait(WAIT)
+    api.process_errors()
+    assert done
+    pulse.result()
+
+    done = recording.wait(5.0)
+    api.process_errors()
+    assert done
+    result = recording.result()
+    assert result.values[:5] == [0, 0, 1, 1, 0]
 
 
 # TODO Test parallel logging jobs
@@ -548,3 +596,305 @@ class TestEndLogSignal:
         with pytest.raises(controllino.ControllinoError) as e:
             future.result()
         assert "LOGGING_REQUEST_NOT_FOUND" in str(e.value)
+
+
+class CmdSetSignalAt(controllino.Command):
+    # `at = 0` is always in the past, so the command is executed right away.
+    def _serialize(self):
+        return {"command": "SET_OUTPUT", "pin": "D40", "level": "HIGH", "at": 0}
+
+
+class CmdCancelJob(controllino.Command):
+    def _serialize(self):
+        return {"command": "CANCEL_JOB", "target": 65535}
+
+
+class TestScheduledSetSignal:
+    @pytest.mark.timeout(TIMEOUT)
+    def test_scheduled_in_the_past(self, api):
+        future = api.submit(CmdSetSignalAt())
+        future.wait(WAIT)
+        api.process_errors()
+        assert future.done()
+        future.result()
+
+        future = api.get_signal("D30")
+        future.wait(WAIT)
+        api.process_errors()
+        assert future.done()
+        assert future.result() == "HIGH"
+
+    @pytest.mark.timeout(TIMEOUT)
+    def test_cancel_unknown_job(self, api):
+        future = api.submit(CmdCancelJob())
+        future.wait(WAIT)
+        api.process_errors()
+        assert future.done()
+        with pytest.raises(controllino.ControllinoError) as e:
+            future.result()
+        assert "JOB_NOT_FOUND" in str(e.value)
+
+
+class CmdSyncTime(controllino.Command):
+    def _serialize(self):
+        return {"command": "SYNC_TIME", "t0": 1666000000000000}
+
+
+@pytest.mark.timeout(TIMEOUT)
+def test_sync_time(api):
+    future = api.submit(CmdSyncTime())
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    future.result()
+
+
+class CmdAddRule(controllino.Command):
+    def _serialize(self):
+        return {
+            "command": "ADD_RULE",
+            "condition": "RISING",
+            "pin": "D30",
+            "action": "SET_OUTPUT",
+            "target": "D41",
+            "level": "HIGH",
+        }
+
+
+@pytest.mark.timeout(TIMEOUT)
+def test_rule_set_output_on_rising_edge(api):
+    future = api.set_pin_mode("D43", "INPUT")
+    future.wait(WAIT)
+    api.process_errors()
+    future.result()
+
+    for pin in ["D40", "D41"]:
+        future = api.set_signal(pin, "LOW")
+        future.wait(WAIT)
+        api.process_errors()
+        future.result()
+
+    future = api.submit(CmdAddRule())
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    future.result()
+
+    future = api.set_signal("D40", "HIGH")  # Rising edge on D30
+    future.wait(WAIT)
+    api.process_errors()
+    future.result()
+
+    future = api.get_signal("D43")
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    assert future.result() == "HIGH"
+
+
+class CmdStartControlLoop(controllino.Command):
+    def _serialize(self):
+        return {
+            "command": "START_CONTROL_LOOP",
+            "input": "A0",
+            "output": "DAC0",
+            "setpoint": 500,
+            "kp": 0.05,
+            "ki": 2.0,
+            "period": 1000,
+        }
+
+
+class CmdStopControlLoop(controllino.Command):
+    def _serialize(self):
+        return {"command": "STOP_CONTROL_LOOP"}
+
+
+@pytest.mark.timeout(TIMEOUT)
+def test_control_loop(api):
+    future = api.submit(CmdStartControlLoop())
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    future.result()
+
+    time.sleep(1.0)
+    future = api.get_signal("A0")
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    assert abs(future.result() - 500) < 50
+
+    future = api.submit(CmdStopControlLoop())
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    future.result()
+
+
+class CmdStartControlLoopWith(CmdStartControlLoop):
+    config = {}
+
+    def _serialize(self):
+        return {**super()._serialize(), **self.config}
+
+
+@pytest.mark.timeout(TIMEOUT)
+@pytest.mark.parametrize(
+    "config", [{"period": 1000001}, {"min": -1}, {"max": 256}, {"min": 100, "max": 50}]
+)
+def test_control_loop_invalid_configuration(api, config):
+    command = CmdStartControlLoopWith()
+    command.config = config
+    future = api.submit(command)
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    with pytest.raises(controllino.ControllinoError) as e:
+        future.result()
+    assert "INVALID_CONFIGURATION" in str(e.value)
+
+
+class CmdEndWatch(controllino.Command):
+    def _serialize(self):
+        return {"command": "END_WATCH", "pin": "A1"}
+
+
+@pytest.mark.timeout(TIMEOUT)
+def test_end_watch_not_found(api):
+    future = api.submit(CmdEndWatch())
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    with pytest.raises(controllino.ControllinoError) as e:
+        future.result()
+    assert "WATCH_NOT_FOUND" in str(e.value)
+
+
+class CmdMeasureFrequency(controllino.Command):
+    def _serialize(self):
+        return {"command": "MEASURE_FREQUENCY", "pin": "D31", "gate": 1}
+
+
+@pytest.mark.timeout(TIMEOUT)
+def test_measure_frequency_invalid_gate(api):
+    future = api.submit(CmdMeasureFrequency())
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    with pytest.raises(controllino.ControllinoError) as e:
+        future.result()
+    assert "INVALID_GATE" in str(e.value)
+
+
+class CmdAddCounter(controllino.Command):
+    def _serialize(self):
+        return {"command": "ADD_COUNTER", "counter": 0, "pin": "D30", "mode": "RISING"}
+
+
+class CmdDeleteCounter(controllino.Command):
+    def _serialize(self):
+        return {"command": "DELETE_COUNTER", "counter": 0}
+
+
+@pytest.mark.timeout(TIMEOUT)
+def test_counter(api):
+    future = api.submit(CmdAddCounter())
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    future.result()
+
+    for level in ["HIGH", "LOW", "HIGH", "LOW"]:
+        future = api.set_signal("D40", level)  # Edges on D30
+        future.wait(WAIT)
+        api.process_errors()
+        future.result()
+
+    future = api.submit(CmdDeleteCounter())
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    future.result()
+
+
+class CmdSetDebounce(controllino.Command):
+    def _serialize(self):
+        return {"command": "SET_DEBOUNCE", "pin": "D30", "time": 1000}
+
+
+class CmdClearDebounce(controllino.Command):
+    def _serialize(self):
+        return {"command": "SET_DEBOUNCE", "pin": "D30", "time": 0}
+
+
+@pytest.mark.timeout(TIMEOUT)
+def test_debounce(api):
+    future = api.submit(CmdSetDebounce())
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    future.result()
+
+    future = api.set_signal("D40", "HIGH")  # Drives D30
+    future.wait(WAIT)
+    api.process_errors()
+    future.result()
+
+    time.sleep(0.01)
+    future = api.get_signal("D30")
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    assert future.result() == "HIGH"
+
+    future = api.submit(CmdClearDebounce())
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    future.result()
+
+
+class CmdSetAdc(controllino.Command):
+    def _serialize(self):
+        return {"command": "SET_ADC", "pin": "A0", "resolution": 12, "oversampling": 16}
+
+
+class CmdResetAdc(controllino.Command):
+    def _serialize(self):
+        return {"command": "SET_ADC", "pin": "A0"}
+
+
+@pytest.mark.timeout(TIMEOUT)
+def test_set_adc(api):
+    future = api.submit(CmdSetAdc())
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    future.result()
+
+    future = api.get_signal("A0")
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    assert 0 <= future.result() < 4096
+
+    future = api.submit(CmdResetAdc())
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    future.result()
+
+
+class CmdGetStorage(controllino.Command):
+    def _serialize(self):
+        return {"command": "GET_STORAGE"}
+
+
+@pytest.mark.timeout(TIMEOUT)
+def test_get_storage(api):
+    future = api.submit(CmdGetStorage())
+    future.wait(WAIT)
+    api.process_errors()
+    assert future.done()
+    future.result()
@@ -0,0 +1,136 @@
+#!/usr/bin/env python
+"""Estimate offset and drift of a Controllino's device clock.
+
+Uses the ``SYNC_TIME`` ping/echo exchange (see README) NTP-style: each
+exchange yields the host send time ``t0``, the device receive time ``t1``, the
+device send time ``t2`` and the host receive time ``t3``. Since the serial line
+is slow, the time needed to transmit the request and the reply is removed from
+``t0``/``t3`` before the samples are used. A line is then fitted through the
+samples with the smallest round trip delay, which gives the offset and the
+drift of the device clock. All times are in microseconds.
+
+Usage: ``CONTROLLINO_USB_SERIAL_NUMBER=... python tools/clock_sync.py [COUNT]``
+"""
+
+import json
+import os
+import sys
+import time
+
+import serial
+import serial.tools.list_ports
+
+BAUDRATE = 19200
+BITS_PER_BYTE = 10  # 8N1
+
+
+def host_micros() -> int:
+    """Wall clock time in microseconds; shared by all boards on a host."""
+    return time.time_ns() // 1000
+
+
+def line_duration(length: int, baudrate: int = BAUDRATE) -> float:
+    """Transmission time of a line of ``length`` bytes (incl. newline) in µs."""
+    return length * BITS_PER_BYTE * 1e6 / baudrate
+
+
+class ClockSync:
+    """Maps device timestamps to host time.
+
+    Arguments:
+        baudrate: The baudrate of the serial connection
+        window: Number of most recent samples to keep
+        tolerance: Samples whose delay exceeds the minimum delay by more than
+            this (in µs) are ignored for the fit
+    """
+
+    def __init__(self, baudrate=BAUDRATE, window=64, tolerance=200.0):
+        self._baudrate = baudrate
+        self._window = window
+        self._tolerance = tolerance
+        self._samples = []  # (host_mid, device_mid, delay)
+        self.origin = 0.0  # host time
+        self.offset = 0.0  # device time at host time `origin`
+        self.drift = 1.0  # device µs per host µs
+
+    def add_sample(self, t0, t1, t2, t3, request_length, reply_length):
+        """Add one exchange.
+
+        ``request_length`` and ``reply_length`` are the lengths of the lines in
+        bytes, including the newline.
+        """
+        t0 = t0 + line_duration(request_length, self._baudrate)
+        t3 = t3 - line_duration(reply_length, self._baudrate)
+        delay = (t3 - t0) - (t2 - t1)
+        self._samples.append(((t0 + t3) / 2, (t1 + t2) / 2, delay))
+        self._samples = self._samples[-self._window :]
+        self._fit()
+
+    def _fit(self):
+        min_delay = min(delay for _, _, delay in self._samples)
+        good = [
+            (h, d)
+            for h, d, delay in self._samples
+            if delay <= min_delay + self._tolerance
+        ]
+        # Center the data to keep the floating point error small.
+        h_mean = sum(h for h, _ in good) / len(good)
+        d_mean = sum(d for _, d in good) / len(good)
+        var = sum((h - h_mean) ** 2 for h, _ in good)
+        if var > 0.0:
+            cov = sum((h - h_mean) * (d - d_mean) for h, d in good)
+            self.drift = cov / var
+        self.origin = h_mean
+        self.offset = d_mean
+
+    def to_host(self, device_time):
+        """Convert a device timestamp to drift-corrected host time."""
+        return self.origin + (device_time - self.offset) / self.drift
+
+    def to_device(self, host_time):
+        """Convert a host timestamp to device time, e.g. for ``at``."""
+        return self.offset + (host_time - self.origin) * self.drift
+
+
+def sync(ser, clock=None, count=16, job=0xFFF0):
+    """Run ``count`` SYNC_TIME exchanges on ``ser`` and return the estimate.
+
+    Expects no other traffic on the connection while running.
+    """
+    clock = clock or ClockSync(baudrate=ser.baudrate)
+    for i in range(count):
+        t0 = host_micros()
+        request = json.dumps(
+            {"command": "SYNC_TIME", "job": job + i, "t0": t0}
+        ).encode() + b"\n"
+        ser.write(request)
+        while True:
+            reply = ser.readline()
+            t3 = host_micros()
+            msg = json.loads(reply)
+            if msg.get("command") == "RX_SYNC_TIME" and msg.get("job") == job + i:
+                break
+        clock.add_sample(
+            msg["t0"], msg["t1"], msg["t2"], t3, len(request), len(reply)
+        )
+    return clock
+
+
+def main():
+    count = int(sys.argv[1]) if len(sys.argv) > 1 else 16
+    serial_number = os.environ["CONTROLLINO_USB_SERIAL_NUMBER"]
+    port = next(
+        each.device
+        for each in serial.tools.list_ports.comports()
+        if each.serial_number == serial_number
+    )
+    with serial.Serial(port=port, baudrate=BAUDRATE) as ser:
+        time.sleep(0.1)
+        ser.reset_input_buffer()
+        clock = sync(ser, count=count)
+    print(f"offset: {clock.offset:.1f} µs at host time {clock.origin:.1f} µs")
+    print(f"drift:  {(clock.drift - 1.0) * 1e6:+.3f} ppm")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,110 @@
+#!/usr/bin/env python
+"""Record a session with a Controllino for replaying it with ``sim/replay``.
+
+Sits between a client and the board: the client opens the pseudo-terminal
+printed at startup (or the symlink ``LINK``) instead of the port of the board,
+and every line passed on in either direction is also written to ``CAPTURE``
+(see ``sim/Capture.h`` for the format).
+
+Lines are stamped with the device clock. Before the client is served, the
+clock of the board is estimated with ``clock_sync``; host times are then
+converted to device times and moved by the time the line needs on the serial
+line, so that received lines are stamped when the board got their last byte
+and sent lines when the board started to send them.
+
+Usage: ``CONTROLLINO_USB_SERIAL_NUMBER=... python tools/record.py CAPTURE [LINK]``
+"""
+
+import os
+import select
+import sys
+import time
+import tty
+
+import serial
+import serial.tools.list_ports
+
+from clock_sync import BAUDRATE, host_micros, line_duration, sync
+
+
+class Recorder:
+    """Writes the lines of one direction to the capture.
+
+    Arguments:
+        capture: The file to write to
+        direction: ``RX`` for lines the board receives, ``TX`` for lines it
+            sends
+        clock: The clock estimate of the board
+    """
+
+    def __init__(self, capture, direction, clock):
+        self._capture = capture
+        self._direction = direction
+        self._clock = clock
+        self._line = b""
+
+    def feed(self, data: bytes) -> None:
+        """Record the complete lines in ``data``, received at host time now."""
+        now = host_micros()
+        self._line += data
+        while b"\n" in self._line:
+            line, self._line = self._line.split(b"\n", 1)
+            duration = line_duration(len(line) + 1)
+            if self._direction == "RX":
+                host_time = now + duration
+            else:
+                host_time = now - duration
+            device_time = max(0, round(self._clock.to_device(host_time)))
+            text = line.rstrip(b"\r").decode(errors="replace")
+            self._capture.write(f"{device_time} {self._direction} {text}\n")
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        sys.exit(1)
+    path = sys.argv[1]
+    link = sys.argv[2] if len(sys.argv) == 3 else None
+
+    serial_number = os.environ["CONTROLLINO_USB_SERIAL_NUMBER"]
+    port = next(
+        each.device
+        for each in serial.tools.list_ports.comports()
+        if each.serial_number == serial_number
+    )
+    master, slave = os.openpty()
+    tty.setraw(slave)
+    pty = os.ttyname(slave)
+    if link is not None:
+        if os.path.lexists(link):
+            os.unlink(link)
+        os.symlink(pty, link)
+
+    with serial.Serial(port=port, baudrate=BAUDRATE) as ser, open(path, "w") as capture:
+        time.sleep(0.1)
+        ser.reset_input_buffer()
+        clock = sync(ser)
+        ser.timeout = 0
+        rx = Recorder(capture, "RX", clock)
+        tx = Recorder(capture, "TX", clock)
+        print(pty, flush=True)
+        try:
+            while True:
+                readable, _, _ = select.select([master, ser.fileno()], [], [])
+                if master in readable:
+                    data = os.read(master, 4096)
+                    ser.write(data)
+                    rx.feed(data)
+                if ser.fileno() in readable:
+                    data = ser.read(4096)
+                    os.write(master, data)
+                    tx.feed(data)
+        except KeyboardInterrupt:
+            pass
+        finally:
+            if link is not None:
+                os.unlink(link)
+
+
+if __name__ == "__main__":
+    main()